@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "timing.h"
+
+/**
+ * Returns the index into CHOICES of the field FIELD, which is LEN bytes long and not null
+ * terminated, or -1 if it is none of them.
+ *
+ * Parameters:
+ * FIELD - field to find
+ * LEN - length of FIELD
+ * CHOICES - strings to compare against
+ * CHOICE_CT - length of CHOICES
+ *
+ */
+long find_field(const char *FIELD, const size_t LEN, const char *const CHOICES[], const size_t CHOICE_CT) {
+	for (size_t choice = 0; choice < CHOICE_CT; choice++) {
+		if (!strncmp(FIELD, CHOICES[choice], LEN) && CHOICES[choice][LEN] == '\0') {
+			return choice;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Translates one batch line, which holds a root and then each of the SLOT_CT suffixes, all
+ * separated by tabs, with empty fields for empty slots. Returns true if the line was
+ * translated ; otherwise sets translation to a message starting with '?'.
+ *
+ * Replaces:
+ * translation
+ *
+ * Parameters:
+ * LINE - line to translate, without its newline and not null terminated
+ * LEN - length of LINE
+ * translation - set to the translation, which must not be freed
+ *
+ */
+bool translate_batch_line(const char *LINE, const size_t LEN, const char **translation) {
+	size_t len = LEN > 0 && LINE[LEN - 1] == '\r' ? LEN - 1 : LEN;
+	size_t suffix_idxs[SLOT_CT];
+	long root = 0;
+	size_t field = 0, start = 0;
+	for (; start <= len && field <= SLOT_CT; field++) {
+		const char *tab = memchr(LINE + start, '\t', len - start);
+		size_t field_len = (tab ? (size_t) (tab - LINE) : len) - start;
+		long idx = field == 0 ? find_field(LINE + start, field_len, ROOTS, ROOT_CT) : find_field(LINE + start, field_len, SUFFIXES[field - 1], SUFFIX_CTS[field - 1]);
+		if (idx < 0) {
+			*translation = field == 0 ? "?unknown verb" : "?unknown suffix";
+			return false;
+		}
+		if (field == 0) {
+			root = idx;
+		} else {
+			suffix_idxs[field - 1] = idx;
+		}
+		start += field_len + 1;
+	}
+	if (field != SLOT_CT + 1 || start <= len) {
+		*translation = "?expected a root and 6 suffixes, separated by tabs";
+		return false;
+	}
+	*translation = lookup_translation(make_word_key(root, suffix_idxs));
+	return true;
+}
+
+/**
+ * Translates every line of a chunk into its output, one line of output per line of input.
+ * Returns false if out of memory, leaving the output short.
+ *
+ * Replaces:
+ * chunk->output, chunk->output_len, chunk->output_cap, chunk->line_ct, chunk->translate_ns, error_ct
+ *
+ * Parameters:
+ * chunk - chunk to translate
+ * error_ct - set to the # of lines which could not be translated
+ *
+ */
+bool translate_chunk(struct batch_chunk *chunk, size_t *error_ct) {
+	uint64_t start_ns = get_monotonic_ns();
+	bool is_ok = true;
+	*error_ct = 0;
+	chunk->output_len = 0;
+	chunk->line_ct = 0;
+	for (size_t start = 0; start < chunk->input_len;) {
+		const char *newline = memchr(chunk->input + start, '\n', chunk->input_len - start);
+		size_t line_len = (newline ? (size_t) (newline - chunk->input) : chunk->input_len) - start;
+		const char *translation;
+		*error_ct += !translate_batch_line(chunk->input + start, line_len, &translation);
+
+		size_t translation_len = strlen(translation);
+		if (chunk->output_len + translation_len + 1 > chunk->output_cap) {
+			size_t output_cap = 2 * chunk->output_cap + translation_len + 1;
+			char *output = realloc(chunk->output, output_cap);
+			if (output == NULL) {
+				is_ok = false;
+				break;
+			}
+			chunk->output = output;
+			chunk->output_cap = output_cap;
+		}
+		memcpy(chunk->output + chunk->output_len, translation, translation_len);
+		chunk->output[chunk->output_len + translation_len] = '\n';
+		chunk->output_len += translation_len + 1;
+		chunk->line_ct++;
+		start += line_len + 1;
+	}
+	chunk->translate_ns = get_monotonic_ns() - start_ns;
+	return is_ok;
+}
+
+/**
+ * Worker thread ; translates chunks as they are read, until input ends.
+ *
+ * Parameter:
+ * arg - the batch
+ *
+ */
+void *translate_chunks(void *arg) {
+	struct batch *batch = arg;
+	pthread_mutex_lock(&batch->lock);
+	for (;;) {
+		while (batch->taken_ct == batch->read_ct && !batch->is_done_reading) {
+			pthread_cond_wait(&batch->changed, &batch->lock);
+		}
+		if (batch->taken_ct == batch->read_ct) {
+			break;
+		}
+		struct batch_chunk *chunk = &batch->chunks[batch->taken_ct++ % batch->chunk_ct];
+		chunk->state = CHUNK_TRANSLATING;
+		pthread_mutex_unlock(&batch->lock);
+
+		size_t error_ct;
+		bool is_translated = translate_chunk(chunk, &error_ct);
+
+		pthread_mutex_lock(&batch->lock);
+		batch->stats.error_ct += error_ct;
+		batch->is_failed = batch->is_failed || !is_translated;
+		chunk->state = CHUNK_TRANSLATED;
+		pthread_cond_broadcast(&batch->changed);
+	}
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
+}
+
+/**
+ * Writer thread ; writes translated chunks in the order they were read, and frees them
+ * for the reader to reuse. Once a chunk could not be translated, nothing more is written,
+ * so no line of output is ever out of step with its input.
+ *
+ * Parameter:
+ * arg - the batch
+ *
+ */
+void *write_chunks(void *arg) {
+	struct batch *batch = arg;
+	struct batch_stats *stats = &batch->stats;
+	pthread_mutex_lock(&batch->lock);
+	for (;;) {
+		struct batch_chunk *chunk = &batch->chunks[batch->written_ct % batch->chunk_ct];
+		while (!(batch->written_ct < batch->read_ct && chunk->state == CHUNK_TRANSLATED) &&
+			!(batch->is_done_reading && batch->written_ct == batch->read_ct)) {
+			pthread_cond_wait(&batch->changed, &batch->lock);
+		}
+		if (batch->written_ct == batch->read_ct) {
+			break;
+		}
+		bool is_writing = !batch->is_failed;
+		pthread_mutex_unlock(&batch->lock);
+
+		if (is_writing) {
+			fwrite(chunk->output, 1, chunk->output_len, batch->out);
+		}
+		uint64_t latency_ns = get_monotonic_ns() - chunk->read_ns;
+
+		pthread_mutex_lock(&batch->lock);
+		if (stats->chunk_ct == stats->stat_cap) {
+			size_t stat_cap = stats->stat_cap ? 2 * stats->stat_cap : 256;
+			uint64_t *translate_ns = realloc(stats->translate_ns, stat_cap * sizeof(uint64_t));
+			uint64_t *all_latency_ns = translate_ns ? realloc(stats->latency_ns, stat_cap * sizeof(uint64_t)) : NULL;
+			stats->translate_ns = translate_ns ? translate_ns : stats->translate_ns;
+			stats->latency_ns = all_latency_ns ? all_latency_ns : stats->latency_ns;
+			stats->stat_cap = all_latency_ns ? stat_cap : stats->stat_cap;
+		}
+		if (stats->chunk_ct < stats->stat_cap) {
+			stats->translate_ns[stats->chunk_ct] = chunk->translate_ns;
+			stats->latency_ns[stats->chunk_ct++] = latency_ns;
+		}
+		stats->line_ct += chunk->line_ct;
+		stats->input_len += chunk->input_len;
+		chunk->state = CHUNK_FREE;
+		batch->written_ct++;
+		pthread_cond_broadcast(&batch->changed);
+	}
+	pthread_mutex_unlock(&batch->lock);
+	fflush(batch->out);
+	return NULL;
+}
+
+/**
+ * Reads whole lines into a chunk with large buffered reads, starting with any partial line
+ * left from the last chunk, and keeps the partial line at the end for the next. A chunk
+ * grows past BATCH_CHUNK_LEN only to fit a longer line. The chunk is left empty at the end
+ * of input. Returns false if out of memory.
+ *
+ * Replaces:
+ * chunk->input, chunk->input_len, chunk->input_cap, carry, carry_len, carry_cap
+ *
+ * Parameters:
+ * in - file to read
+ * chunk - chunk to fill
+ * carry - partial line left over
+ * carry_len - length of carry
+ * carry_cap - size of carry
+ *
+ */
+bool read_chunk(FILE *in, struct batch_chunk *chunk, char **carry, size_t *carry_len, size_t *carry_cap) {
+	size_t input_cap = chunk->input_cap;
+	while (input_cap < *carry_len + BATCH_CHUNK_LEN) {
+		input_cap = input_cap ? 2 * input_cap : BATCH_CHUNK_LEN;
+	}
+	if (input_cap != chunk->input_cap) {
+		char *input = realloc(chunk->input, input_cap);
+		if (input == NULL) {
+			return false;
+		}
+		chunk->input = input;
+		chunk->input_cap = input_cap;
+	}
+	memcpy(chunk->input, *carry, *carry_len);
+	chunk->input_len = *carry_len;
+	*carry_len = 0;
+
+	/* fread only comes up short at the end of input */
+	bool is_end = false;
+	size_t line_end = 0;
+	for (;;) {
+		size_t read_len = fread(chunk->input + chunk->input_len, 1, chunk->input_cap - chunk->input_len, in);
+		chunk->input_len += read_len;
+		if (chunk->input_len < chunk->input_cap) {
+			is_end = true;
+			break;
+		}
+		for (line_end = chunk->input_len; line_end > 0 && chunk->input[line_end - 1] != '\n'; line_end--);
+		if (line_end > 0) {
+			break;
+		}
+		char *input = realloc(chunk->input, 2 * chunk->input_cap);
+		if (input == NULL) {
+			return false;
+		}
+		chunk->input = input;
+		chunk->input_cap *= 2;
+	}
+	if (is_end) {
+		return true;
+	}
+
+	*carry_len = chunk->input_len - line_end;
+	if (*carry_len > *carry_cap) {
+		char *new_carry = realloc(*carry, *carry_len);
+		if (new_carry == NULL) {
+			return false;
+		}
+		*carry = new_carry;
+		*carry_cap = *carry_len;
+	}
+	memcpy(*carry, chunk->input + line_end, *carry_len);
+	chunk->input_len = line_end;
+	return true;
+}
+
+/**
+ * Translates every line of in (see translate_batch_line) into a line of out, in order.
+ * This thread reads, THREAD_CT workers translate, and one more thread writes, with a few
+ * chunks of lines in flight between them. Returns false if out of memory or a thread
+ * could not start, in which case out stops at the last chunk translated in full. The caller must free stats->translate_ns and stats->latency_ns.
+ *
+ * Replaces:
+ * stats
+ *
+ * Parameters:
+ * in - file of lines to translate
+ * out - file to write translations to
+ * THREAD_CT - # of worker threads, at least 1
+ * stats - timings and totals of the run
+ *
+ */
+bool run_batch(FILE *in, FILE *out, const size_t THREAD_CT, struct batch_stats *stats) {
+	struct batch batch = {
+		.chunk_ct = 2 * THREAD_CT + 2,
+		.out = out
+	};
+	batch.chunks = calloc(batch.chunk_ct, sizeof(struct batch_chunk));
+	pthread_t writer, workers[THREAD_CT];
+	size_t worker_ct = 0;
+	bool is_ok = batch.chunks != NULL;
+	pthread_mutex_init(&batch.lock, NULL);
+	pthread_cond_init(&batch.changed, NULL);
+	bool has_writer = is_ok && pthread_create(&writer, NULL, write_chunks, &batch) == 0;
+	while (has_writer && worker_ct < THREAD_CT && pthread_create(&workers[worker_ct], NULL, translate_chunks, &batch) == 0) {
+		worker_ct++;
+	}
+	is_ok = has_writer && worker_ct == THREAD_CT;
+
+	char *carry = NULL;
+	size_t carry_len = 0, carry_cap = 0;
+	while (is_ok) {
+		struct batch_chunk *chunk = &batch.chunks[batch.read_ct % batch.chunk_ct];
+		pthread_mutex_lock(&batch.lock);
+		while (chunk->state != CHUNK_FREE) {
+			pthread_cond_wait(&batch.changed, &batch.lock);
+		}
+		is_ok = !batch.is_failed;
+		pthread_mutex_unlock(&batch.lock);
+		is_ok = is_ok && read_chunk(in, chunk, &carry, &carry_len, &carry_cap) && !ferror(in);
+		if (!is_ok || chunk->input_len == 0) {
+			break;
+		}
+		chunk->read_ns = get_monotonic_ns();
+		pthread_mutex_lock(&batch.lock);
+		chunk->state = CHUNK_READ;
+		batch.read_ct++;
+		pthread_cond_broadcast(&batch.changed);
+		pthread_mutex_unlock(&batch.lock);
+	}
+
+	pthread_mutex_lock(&batch.lock);
+	batch.is_done_reading = true;
+	pthread_cond_broadcast(&batch.changed);
+	pthread_mutex_unlock(&batch.lock);
+	for (size_t worker = 0; worker < worker_ct; worker++) {
+		pthread_join(workers[worker], NULL);
+	}
+	if (has_writer) {
+		pthread_join(writer, NULL);
+	}
+	for (size_t chunk = 0; batch.chunks && chunk < batch.chunk_ct; chunk++) {
+		free(batch.chunks[chunk].input);
+		free(batch.chunks[chunk].output);
+	}
+	free(batch.chunks);
+	free(carry);
+	pthread_mutex_destroy(&batch.lock);
+	pthread_cond_destroy(&batch.changed);
+	*stats = batch.stats;
+	return is_ok && !batch.is_failed;
+}
+
+/**
+ * Comparison function for qsort over uint64_t.
+ *
+ * Parameters:
+ * a - first value
+ * b - second value
+ *
+ */
+int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Prints the throughput of a batch run, and percentiles of its per-chunk times.
+ * Sorts the timings in stats.
+ *
+ * Parameters:
+ * file - file to print to
+ * stats - stats of the run
+ * ELAPSED_SEC - wall time of the run
+ *
+ */
+void print_batch_stats(FILE *file, struct batch_stats *stats, const double ELAPSED_SEC) {
+	fprintf(file, "Translated %zu lines (%zu failed, %.1f MB) in %.3f s: %.0f lines/s, %.1f MB/s\n",
+		stats->line_ct, stats->error_ct, stats->input_len / 1e6, ELAPSED_SEC, stats->line_ct / ELAPSED_SEC, stats->input_len / 1e6 / ELAPSED_SEC);
+	if (stats->chunk_ct == 0) {
+		return;
+	}
+	qsort(stats->translate_ns, stats->chunk_ct, sizeof(uint64_t), compare_u64);
+	qsort(stats->latency_ns, stats->chunk_ct, sizeof(uint64_t), compare_u64);
+	const size_t P50 = stats->chunk_ct / 2, P99 = stats->chunk_ct * 99 / 100, MAX = stats->chunk_ct - 1;
+	fprintf(file, "%zu chunks ; translate p50 %.2f ms, p99 %.2f ms, max %.2f ms ; read to written p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		stats->chunk_ct, stats->translate_ns[P50] / 1e6, stats->translate_ns[P99] / 1e6, stats->translate_ns[MAX] / 1e6,
+		stats->latency_ns[P50] / 1e6, stats->latency_ns[P99] / 1e6, stats->latency_ns[MAX] / 1e6);
+}
@@ -0,0 +1,73 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* bytes of input read into each chunk at once */
+#define BATCH_CHUNK_LEN (256 * 1024)
+
+/* where a chunk is in the pipeline ; each moves through them in order, then back to free */
+enum chunk_state {
+	CHUNK_FREE,
+	CHUNK_READ,
+	CHUNK_TRANSLATING,
+	CHUNK_TRANSLATED
+};
+
+/* a run of whole input lines, and their translations */
+struct batch_chunk {
+	enum chunk_state state;
+	char *input;
+	size_t input_len;
+	size_t input_cap;
+	char *output;
+	size_t output_len;
+	size_t output_cap;
+	size_t line_ct;
+	/* when the chunk was read, and how long it took to translate */
+	uint64_t read_ns;
+	uint64_t translate_ns;
+};
+
+/* per-chunk timings and totals of a batch run */
+struct batch_stats {
+	size_t line_ct;
+	size_t error_ct;
+	size_t input_len;
+	size_t chunk_ct;
+	/* translate time and read to write time of each chunk, in ns */
+	uint64_t *translate_ns;
+	uint64_t *latency_ns;
+	size_t stat_cap;
+};
+
+/*
+ * Translation pipeline: the caller reads chunks, a pool of workers translates them in any
+ * order, and a writer thread writes them out in the order they were read.
+ */
+struct batch {
+	pthread_mutex_t lock;
+	/* signalled whenever a chunk changes state, or input ends */
+	pthread_cond_t changed;
+	struct batch_chunk *chunks;
+	size_t chunk_ct;
+	/* # of chunks read, handed to workers, and written ; chunk n lives in chunks[n % chunk_ct] */
+	size_t read_ct;
+	size_t taken_ct;
+	size_t written_ct;
+	bool is_done_reading;
+	/* set if a chunk could not be translated ; nothing more is then read or written */
+	bool is_failed;
+	FILE *out;
+	struct batch_stats stats;
+};
+
+bool translate_batch_line(const char *LINE, const size_t LEN, const char **translation);
+bool run_batch(FILE *in, FILE *out, const size_t THREAD_CT, struct batch_stats *stats);
+void print_batch_stats(FILE *file, struct batch_stats *stats, const double ELAPSED_SEC);
+
+#endif
@@ -0,0 +1,505 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "lexicon.h"
+#include "segmenter.h"
+
+/* # of timed batches per benchmark, and # of operations in each */
+#define BATCH_CT 200
+#define OPS_PER_BATCH 1000
+/* # of distinct inputs in a randomized workload ; must be a power of 2 */
+#define WORKLOAD_LEN 4096
+/* # of verbs in the benchmark lexicon, most of them made up */
+#define LEXICON_LEN 4096
+/* # of hardware counters read per benchmark */
+#define COUNTER_CT 3
+
+/* inputs shared by all benchmarks, filled in by make_workloads */
+word_key keys[WORKLOAD_LEN];
+const char *suffix_sets[WORKLOAD_LEN][SLOT_CT];
+char words[WORKLOAD_LEN][MAX_WORD_LEN + 1];
+/* the built in verbs, among many made up ones */
+struct lexicon lexicon;
+/* the built in roots and suffixes */
+struct segmenter segmenter;
+/* mask applied to the operation index ; 0 for a fixed workload */
+size_t workload_mask;
+/* results are written here so the compiler cannot drop the work */
+volatile size_t sink;
+/* # of allocations made through malloc or calloc */
+size_t alloc_ct;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+/**
+ * Counts, then forwards to malloc. Linked in with -Wl,--wrap=malloc.
+ *
+ * Parameter:
+ * size - # of bytes to allocate
+ *
+ */
+void *__wrap_malloc(size_t size) {
+	alloc_ct++;
+	return __real_malloc(size);
+}
+
+/**
+ * Counts, then forwards to calloc. Linked in with -Wl,--wrap=calloc.
+ *
+ * Parameters:
+ * count - # of elements to allocate
+ * size - size of each element
+ *
+ */
+void *__wrap_calloc(size_t count, size_t size) {
+	alloc_ct++;
+	return __real_calloc(count, size);
+}
+
+/**
+ * Returns the next value of a xorshift generator, so workloads are the same on every run.
+ *
+ * Parameter:
+ * state - generator state, which must not be 0
+ *
+ */
+uint32_t xorshift(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+/**
+ * Fills keys, suffix_sets and words with pseudo-random words, lexicon with LEXICON_LEN verbs,
+ * and segmenter with the built in roots.
+ *
+ */
+void make_workloads() {
+	uint32_t state = 2463534242u;
+	for (size_t i = 0; i < WORKLOAD_LEN; i++) {
+		keys[i] = get_combination_key(xorshift(&state) % COMBINATION_CT);
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			suffix_sets[i][slot] = SUFFIXES[slot][get_key_suffix(keys[i], slot)];
+		}
+		get_quechua_word(keys[i], words[i], sizeof(words[i]));
+	}
+	make_segmenter(&segmenter, ROOTS, ROOT_CT);
+
+	init_lexicon(&lexicon);
+	for (size_t verb = 0; verb < LEXICON_LEN; verb++) {
+		char root[32];
+		snprintf(root, sizeof(root), "verb%zu", verb);
+		add_verb(&lexicon, verb < ROOT_CT ? ROOTS[verb] : root, &VERB_FORMS[verb % ROOT_CT]);
+	}
+}
+
+/**
+ * Runs translate() on input i of the current workload, and frees its result.
+ *
+ */
+void bench_translate(size_t i) {
+	i &= workload_mask;
+	char *translation = translate(ROOTS[get_key_root(keys[i])], suffix_sets[i]);
+	sink += translation[0];
+	free(translation);
+}
+
+/**
+ * Runs translate_into() on input i of the current workload.
+ *
+ */
+void bench_translate_into(size_t i) {
+	i &= workload_mask;
+	char translation[MAX_TRANSLATION_LEN + 1];
+	translate_into(ROOTS[get_key_root(keys[i])], suffix_sets[i], translation, sizeof(translation));
+	sink += translation[0];
+}
+
+/**
+ * Runs translate_key() on input i of the current workload.
+ *
+ */
+void bench_translate_key(size_t i) {
+	char translation[MAX_TRANSLATION_LEN + 1];
+	translate_key(keys[i & workload_mask], translation, sizeof(translation));
+	sink += translation[0];
+}
+
+/**
+ * Runs lookup_translation() on input i of the current workload.
+ *
+ */
+void bench_lookup_translation(size_t i) {
+	sink += lookup_translation(keys[i & workload_mask])[0];
+}
+
+/**
+ * Runs find_verb() on input i of the current workload, in a lexicon of LEXICON_LEN verbs.
+ *
+ */
+void bench_find_verb(size_t i) {
+	sink += find_verb(&lexicon, ROOTS[get_key_root(keys[i & workload_mask])]);
+}
+
+/**
+ * Runs translate_lexicon() on input i of the current workload, in a lexicon of LEXICON_LEN verbs.
+ *
+ */
+void bench_translate_lexicon(size_t i) {
+	i &= workload_mask;
+	char translation[MAX_TRANSLATION_LEN + 1];
+	translate_lexicon(&lexicon, ROOTS[get_key_root(keys[i])], suffix_sets[i], translation, sizeof(translation));
+	sink += translation[0];
+}
+
+/**
+ * Runs segment_word() on input i of the current workload, written out as one string.
+ *
+ */
+void bench_segment_word(size_t i) {
+	i &= workload_mask;
+	word_key found[8];
+	sink += segment_word(&segmenter, words[i], strlen(words[i]), found, 8);
+}
+
+/**
+ * Runs conjugate() on input i of the current workload.
+ *
+ */
+void bench_conjugate(size_t i) {
+	word_key key = keys[i & workload_mask];
+	unsigned features = get_key_features(key);
+	char conjugation[MAX_TRANSLATION_LEN + 1];
+	struct appender app = {conjugation, 0, sizeof(conjugation), false};
+	conjugate(&app, &VERB_FORMS[get_key_root(key)], get_key_suffix(key, 3), features & HAS_CHKA, features & HAS_MU, "", features & HAS_RI, false);
+	sink += app.len;
+}
+
+/**
+ * Runs get_sub() on input i of the current workload.
+ *
+ */
+void bench_get_sub(size_t i) {
+	sink += get_sub(suffix_sets[i & workload_mask][3])[0];
+}
+
+/**
+ * Runs is_prefix() on input i of the current workload.
+ *
+ */
+void bench_is_prefix(size_t i) {
+	sink += is_prefix(suffix_sets[i & workload_mask][2], "chka");
+}
+
+/**
+ * Runs is_suffix() on input i of the current workload.
+ *
+ */
+void bench_is_suffix(size_t i) {
+	sink += is_suffix(suffix_sets[i & workload_mask][2], "lla");
+}
+
+/* a benchmarked operation, run on input i of the current workload */
+struct benchmark {
+	const char *name;
+	void (*op)(size_t i);
+};
+
+/* result of running one benchmark on one workload */
+struct result {
+	char name[64];
+	double ns_per_op;
+	double allocs_per_op;
+	/* percentiles of the mean time per operation of each batch of OPS_PER_BATCH, not of single calls */
+	double batch_p50_ns;
+	double batch_p90_ns;
+	double batch_p99_ns;
+	/* cycles, instructions and cache misses per operation ; negative if unavailable */
+	double counters[COUNTER_CT];
+};
+
+/**
+ * Opens a group of hardware counters (cycles, instructions, cache misses) for this thread.
+ * Returns false if any counter is unavailable, in which case none are left open.
+ *
+ * Replaces:
+ * fds
+ *
+ * Parameter:
+ * fds - file descriptor of each counter, group leader first
+ *
+ */
+bool open_counters(int fds[COUNTER_CT]) {
+	const uint64_t CONFIGS[COUNTER_CT] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+	};
+	for (size_t counter = 0; counter < COUNTER_CT; counter++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = CONFIGS[counter];
+		attr.disabled = counter == 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		fds[counter] = syscall(SYS_perf_event_open, &attr, 0, -1, counter == 0 ? -1 : fds[0], 0);
+		if (fds[counter] < 0) {
+			while (counter-- > 0) {
+				close(fds[counter]);
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Comparison function for qsort over doubles.
+ *
+ * Parameters:
+ * a - first double
+ * b - second double
+ *
+ */
+int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Runs a benchmark and returns its result.
+ *
+ * Parameters:
+ * bench - benchmark to run
+ * workload - name of the workload, appended to the benchmark name
+ * mask - mask applied to the operation index (see workload_mask)
+ *
+ */
+struct result run_benchmark(const struct benchmark *bench, const char *workload, const size_t mask) {
+	struct result result;
+	double batch_ns[BATCH_CT];
+	int fds[COUNTER_CT];
+	bool has_counters = open_counters(fds);
+	snprintf(result.name, sizeof(result.name), "%s/%s", bench->name, workload);
+	workload_mask = mask;
+
+	/* warm up caches and branch predictors */
+	for (size_t i = 0; i < OPS_PER_BATCH; i++) {
+		bench->op(i);
+	}
+
+	if (has_counters) {
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+	size_t start_alloc_ct = alloc_ct;
+	double total_ns = 0;
+	for (size_t batch = 0; batch < BATCH_CT; batch++) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t i = batch * OPS_PER_BATCH; i < (batch + 1) * OPS_PER_BATCH; i++) {
+			bench->op(i);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		batch_ns[batch] = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / OPS_PER_BATCH;
+		total_ns += batch_ns[batch];
+	}
+	const double OP_CT = (double) BATCH_CT * OPS_PER_BATCH;
+	result.allocs_per_op = (alloc_ct - start_alloc_ct) / OP_CT;
+	result.ns_per_op = total_ns / BATCH_CT;
+
+	/* read counters, or mark them unavailable */
+	for (size_t counter = 0; counter < COUNTER_CT; counter++) {
+		result.counters[counter] = -1;
+	}
+	if (has_counters) {
+		ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		uint64_t values[1 + COUNTER_CT];
+		if (read(fds[0], values, sizeof(values)) == sizeof(values)) {
+			for (size_t counter = 0; counter < COUNTER_CT; counter++) {
+				result.counters[counter] = values[1 + counter] / OP_CT;
+			}
+		}
+		for (size_t counter = 0; counter < COUNTER_CT; counter++) {
+			close(fds[counter]);
+		}
+	}
+
+	/* percentiles are over per-batch averages ; single calls are too short to time alone */
+	qsort(batch_ns, BATCH_CT, sizeof(double), compare_doubles);
+	result.batch_p50_ns = batch_ns[BATCH_CT / 2];
+	result.batch_p90_ns = batch_ns[BATCH_CT * 9 / 10];
+	result.batch_p99_ns = batch_ns[BATCH_CT * 99 / 100];
+	return result;
+}
+
+/**
+ * Prints a counter value to a JSON file, or null if unavailable.
+ *
+ * Parameters:
+ * file - file to print to
+ * name - JSON key
+ * value - counter value, negative if unavailable
+ *
+ */
+void print_json_counter(FILE *file, const char *name, const double value) {
+	if (value < 0) {
+		fprintf(file, ", \"%s\": null", name);
+	} else {
+		fprintf(file, ", \"%s\": %.2f", name, value);
+	}
+}
+
+/**
+ * Writes results as JSON, one benchmark per line so baselines are easy to read back.
+ * Returns false if the file could not be written.
+ *
+ * Parameters:
+ * FILENAME - file to write to
+ * results - benchmark results
+ * LEN - length of results
+ *
+ */
+bool save_results(const char *FILENAME, const struct result results[], const size_t LEN) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "w")) == NULL) {
+		printf("Could not open %s.\n", FILENAME);
+		return false;
+	}
+	fprintf(file, "{\n\"benchmarks\": [\n");
+	for (size_t i = 0; i < LEN; i++) {
+		fprintf(file, "{\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f", results[i].name, results[i].ns_per_op, results[i].allocs_per_op);
+		fprintf(file, ", \"batch_p50_ns\": %.2f, \"batch_p90_ns\": %.2f, \"batch_p99_ns\": %.2f", results[i].batch_p50_ns, results[i].batch_p90_ns,
+			results[i].batch_p99_ns);
+		print_json_counter(file, "cycles_per_op", results[i].counters[0]);
+		print_json_counter(file, "instructions_per_op", results[i].counters[1]);
+		print_json_counter(file, "cache_misses_per_op", results[i].counters[2]);
+		fprintf(file, "}%s\n", i + 1 < LEN ? "," : "");
+	}
+	fprintf(file, "]\n}\n");
+	fclose(file);
+	return true;
+}
+
+/**
+ * Compares results against a baseline written by save_results, printing each change.
+ * Returns the # of benchmarks that slowed down by more than TOLERANCE. If there is no
+ * baseline yet, writes the results as one and returns 0.
+ *
+ * Parameters:
+ * FILENAME - baseline file
+ * results - benchmark results
+ * LEN - length of results
+ * TOLERANCE - allowed slowdown, as a fraction of the baseline time
+ *
+ */
+size_t compare_baseline(const char *FILENAME, const struct result results[], const size_t LEN, const double TOLERANCE) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "r")) == NULL) {
+		printf("No baseline %s ; writing one.\n", FILENAME);
+		save_results(FILENAME, results, LEN);
+		return 0;
+	}
+	size_t slowdown_ct = 0;
+	char line[1024];
+	printf("\nCompared to %s:\n", FILENAME);
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[64];
+		double baseline_ns;
+		const char *ns = strstr(line, "\"ns_per_op\": ");
+		if (sscanf(line, "{\"name\": \"%63[^\"]\"", name) != 1 || ns == NULL || sscanf(ns, "\"ns_per_op\": %lf", &baseline_ns) != 1) {
+			continue;
+		}
+		for (size_t i = 0; i < LEN; i++) {
+			if (!strcmp(name, results[i].name)) {
+				double change = results[i].ns_per_op / baseline_ns - 1;
+				bool is_slowdown = change > TOLERANCE;
+				printf("%-32s %10.2f -> %10.2f ns/op (%+.1f%%)%s\n", name, baseline_ns, results[i].ns_per_op, 100 * change, is_slowdown ? " SLOWER" : "");
+				slowdown_ct += is_slowdown;
+			}
+		}
+	}
+	fclose(file);
+	return slowdown_ct;
+}
+
+/**
+ * Benchmarks the translator over fixed and randomized workloads.
+ *
+ * Options:
+ * --output FILE - write JSON results to FILE (default bench.json)
+ * --baseline FILE - compare against earlier results, and fail on a slowdown ; if FILE does
+ * 	not exist, the results are written to it
+ * --tolerance PCT - slowdown allowed before failing (default 10)
+ *
+ */
+int main(int argc, char *argv[]) {
+	const char *output = "bench.json", *baseline = NULL;
+	double tolerance = 0.10;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--output")) {
+			output = argv[i + 1];
+		} else if (!strcmp(argv[i], "--baseline")) {
+			baseline = argv[i + 1];
+		} else if (!strcmp(argv[i], "--tolerance")) {
+			tolerance = atof(argv[i + 1]) / 100;
+		}
+	}
+
+	const struct benchmark BENCHMARKS[] = {
+		{"translate", bench_translate},
+		{"translate_into", bench_translate_into},
+		{"translate_key", bench_translate_key},
+		{"lookup_translation", bench_lookup_translation},
+		{"find_verb", bench_find_verb},
+		{"translate_lexicon", bench_translate_lexicon},
+		{"segment_word", bench_segment_word},
+		{"conjugate", bench_conjugate},
+		{"get_sub", bench_get_sub},
+		{"is_prefix", bench_is_prefix},
+		{"is_suffix", bench_is_suffix}
+	};
+	const size_t BENCHMARK_CT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+	struct result results[2 * BENCHMARK_CT];
+	make_workloads();
+
+	printf("%-32s %10s %8s %10s %10s %10s %10s %10s %10s\n", "benchmark", "ns/op", "allocs", "batch p50", "batch p90", "batch p99", "cycles", "instrs", "misses");
+	for (size_t i = 0; i < 2 * BENCHMARK_CT; i++) {
+		/* first every benchmark on one fixed word, then on random words */
+		results[i] = run_benchmark(&BENCHMARKS[i % BENCHMARK_CT], i < BENCHMARK_CT ? "fixed" : "random", i < BENCHMARK_CT ? 0 : WORKLOAD_LEN - 1);
+		printf("%-32s %10.2f %8.2f %10.2f %10.2f %10.2f", results[i].name, results[i].ns_per_op, results[i].allocs_per_op, results[i].batch_p50_ns, results[i].batch_p90_ns,
+			results[i].batch_p99_ns);
+		for (size_t counter = 0; counter < COUNTER_CT; counter++) {
+			if (results[i].counters[counter] < 0) {
+				printf(" %10s", "n/a");
+			} else {
+				printf(" %10.2f", results[i].counters[counter]);
+			}
+		}
+		printf("\n");
+	}
+	if (results[0].counters[0] < 0) {
+		printf("Hardware counters unavailable (see /proc/sys/kernel/perf_event_paranoid) ; only timings reported.\n");
+	}
+
+	if (!save_results(output, results, 2 * BENCHMARK_CT)) {
+		return 1;
+	}
+	printf("Results written to %s.\n", output);
+	if (baseline != NULL && compare_baseline(baseline, results, 2 * BENCHMARK_CT, tolerance)) {
+		printf("Slowdown beyond %.0f%% detected.\n", 100 * tolerance);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "calibration.h"
+
+/**
+ * Builds a ring's boundary table from its per-position medians. Returns false if
+ * there are too many positions, or the medians do not strictly increase.
+ *
+ * Replaces:
+ * cal
+ *
+ * Parameters:
+ * cal - calibration to build
+ * MEDIANS - median distance to each position, from position 0
+ * POSITION_CT - length of MEDIANS
+ *
+ */
+bool make_calibration(struct ring_calibration *cal, const float MEDIANS[], const size_t POSITION_CT) {
+	if (POSITION_CT < 2 || POSITION_CT > MAX_POSITIONS) {
+		return false;
+	}
+	cal->position_ct = POSITION_CT;
+	cal->min_spacing = INFINITY;
+	for (size_t position = 0; position < POSITION_CT; position++) {
+		cal->medians[position] = MEDIANS[position];
+		if (position > 0) {
+			float spacing = MEDIANS[position] - MEDIANS[position - 1];
+			if (!(spacing > 0)) {
+				return false;
+			}
+			cal->min_spacing = spacing < cal->min_spacing ? spacing : cal->min_spacing;
+			cal->boundaries[position] = (MEDIANS[position - 1] + MEDIANS[position]) / 2;
+		}
+	}
+
+	/* accept up to half a spacing beyond the outermost positions */
+	cal->boundaries[0] = MEDIANS[0] - (MEDIANS[1] - MEDIANS[0]) / 2;
+	cal->boundaries[POSITION_CT] = MEDIANS[POSITION_CT - 1] + (MEDIANS[POSITION_CT - 1] - MEDIANS[POSITION_CT - 2]) / 2;
+	for (size_t boundary = POSITION_CT + 1; boundary <= MAX_POSITIONS; boundary++) {
+		cal->boundaries[boundary] = INFINITY;
+	}
+	return true;
+}
+
+/**
+ * Returns the CRC-32 (as used by zlib) of LEN bytes of DATA.
+ *
+ * Parameters:
+ * DATA - bytes to check
+ * LEN - # of bytes
+ *
+ */
+uint32_t get_crc32(const char *DATA, const size_t LEN) {
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < LEN; i++) {
+		crc ^= (unsigned char) DATA[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = crc >> 1 ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+/**
+ * Reads one ring's row, holding its # of positions followed by the median distance to
+ * each. Rows from older versions, holding only a zero distance and an average
+ * difference, are read as evenly spaced positions. Returns false if the row is
+ * malformed or the ring does not have POSITION_CT positions.
+ *
+ * Replaces:
+ * cal
+ *
+ * Parameters:
+ * LINE - row to read, without its new line
+ * cal - calibration of the ring
+ * POSITION_CT - expected # of positions on the ring
+ *
+ */
+bool read_ring_row(const char *LINE, struct ring_calibration *cal, const size_t POSITION_CT) {
+	float values[MAX_POSITIONS + 1];
+	size_t value_ct = 0;
+	char *end;
+	for (float value = strtof(LINE, &end); end != LINE && value_ct <= MAX_POSITIONS; value = strtof(LINE, &end)) {
+		values[value_ct++] = value;
+		LINE = end;
+	}
+
+	if (value_ct == 2) {
+		/* older zero distance and average difference */
+		float medians[MAX_POSITIONS];
+		for (size_t position = 0; position < MAX_POSITIONS; position++) {
+			medians[position] = values[0] + position * values[1];
+		}
+		return make_calibration(cal, medians, POSITION_CT);
+	}
+	return value_ct > 0 && values[0] == value_ct - 1 && value_ct - 1 == POSITION_CT &&
+		make_calibration(cal, values + 1, value_ct - 1);
+}
+
+/**
+ * Reads in ring calibrations from FILENAME (expected: ring_data.txt), as written by
+ * save_calibration. Files from older versions, with no header or checksum, are also
+ * read. Returns false if the file is missing, malformed, of another version, fails its
+ * checksum, or a ring does not have the expected # of positions ; cals may then be
+ * partly overwritten.
+ *
+ * Replaces:
+ * cals
+ *
+ * Parameters:
+ * FILENAME - file to read
+ * cals - calibration of each ring
+ * POSITION_CTS - expected # of positions on each ring
+ * RING_CT - length of cals and POSITION_CTS
+ *
+ */
+bool load_calibration(const char *FILENAME, struct ring_calibration cals[], const size_t POSITION_CTS[], const size_t RING_CT) {
+	FILE *file;
+	char text[MAX_CALIBRATION_LEN + 1];
+	if ((file = fopen(FILENAME, "r")) == NULL) {
+		return false;
+	}
+	size_t len = fread(text, 1, sizeof(text), file);
+	fclose(file);
+	if (len > MAX_CALIBRATION_LEN) {
+		return false;
+	}
+	text[len] = '\0';
+
+	/* a header names the format version, and a last row checksums everything before it */
+	char *line = text;
+	unsigned version;
+	bool has_header = sscanf(text, CALIBRATION_MAGIC " %u", &version) == 1;
+	if (has_header) {
+		uint32_t expected_crc;
+		char *checksum = strstr(text, "\ncrc32 ");
+		if (version != CALIBRATION_VERSION || checksum == NULL ||
+			sscanf(checksum, "\ncrc32 %x", &expected_crc) != 1 || get_crc32(text, checksum + 1 - text) != expected_crc) {
+			return false;
+		}
+		*checksum = '\0';
+		line = strchr(text, '\n') + 1;
+	}
+
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		char *end = strchr(line, '\n');
+		if (*line == '\0') {
+			return false;
+		}
+		if (end != NULL) {
+			*end = '\0';
+		}
+		if (!read_ring_row(line, &cals[ring], POSITION_CTS[ring])) {
+			return false;
+		}
+		line = end != NULL ? end + 1 : line + strlen(line);
+	}
+	return true;
+}
+
+/**
+ * Writes ring calibrations in the format read by load_calibration: a header with the
+ * format version, one row per ring holding its # of positions followed by the median
+ * distance to each, then a CRC-32 of everything before it. Returns false if they did
+ * not fit in MAX_CALIBRATION_LEN or could not be written.
+ *
+ * Parameters:
+ * file - file to write to
+ * cals - calibration of each ring
+ * RING_CT - length of cals
+ *
+ */
+bool save_calibration(FILE *file, const struct ring_calibration cals[], const size_t RING_CT) {
+	char text[MAX_CALIBRATION_LEN];
+	size_t len = snprintf(text, sizeof(text), CALIBRATION_MAGIC " %u\n", CALIBRATION_VERSION);
+	for (size_t ring = 0; ring < RING_CT && len < sizeof(text); ring++) {
+		len += snprintf(text + len, sizeof(text) - len, "%zu", cals[ring].position_ct);
+		for (size_t position = 0; position < cals[ring].position_ct && len < sizeof(text); position++) {
+			len += snprintf(text + len, sizeof(text) - len, " %.3f", cals[ring].medians[position]);
+		}
+		if (len < sizeof(text)) {
+			len += snprintf(text + len, sizeof(text) - len, "\n");
+		}
+	}
+	if (len >= sizeof(text)) {
+		return false;
+	}
+	return fwrite(text, 1, len, file) == len && fprintf(file, "crc32 %08x\n", get_crc32(text, len)) > 0;
+}
+
+/**
+ * Returns the position a distance falls in, or -1 if it lies beyond the outermost
+ * boundaries. Every boundary is compared without branching on the result, so the
+ * cost is the same for every reading.
+ *
+ * Parameters:
+ * cal - calibration of the ring
+ * DISTANCE_CM - distance read from the ring's sensor
+ *
+ */
+long decode_position(const struct ring_calibration *cal, const float DISTANCE_CM) {
+	long above = 0;
+	for (size_t boundary = 0; boundary <= MAX_POSITIONS; boundary++) {
+		above += DISTANCE_CM >= cal->boundaries[boundary];
+	}
+	/* above is 0 before the first position, and position_ct + 1 past the last */
+	return above == 0 || above > cal->position_ct ? -1 : above - 1;
+}
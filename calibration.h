@@ -0,0 +1,37 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* most positions on one ring */
+#define MAX_POSITIONS 8
+/* first word of a calibration file, and the version of its format */
+#define CALIBRATION_MAGIC "muyuchina-calibration"
+#define CALIBRATION_VERSION 2
+/* longest calibration file */
+#define MAX_CALIBRATION_LEN 4096
+
+/* measured position distances of one ring, and the decision boundaries between them */
+struct ring_calibration {
+	size_t position_ct;
+	/* median distance to each position, increasing from position 0 */
+	float medians[MAX_POSITIONS];
+	/*
+	 * boundaries[0] and boundaries[position_ct] are the nearest and farthest accepted
+	 * distances, and boundaries[i] for 0 < i < position_ct is the midpoint between
+	 * positions i - 1 and i. Unused entries hold INFINITY.
+	 */
+	float boundaries[MAX_POSITIONS + 1];
+	/* smallest distance between adjacent positions */
+	float min_spacing;
+};
+
+uint32_t get_crc32(const char *DATA, const size_t LEN);
+bool make_calibration(struct ring_calibration *cal, const float MEDIANS[], const size_t POSITION_CT);
+bool load_calibration(const char *FILENAME, struct ring_calibration cals[], const size_t POSITION_CTS[], const size_t RING_CT);
+bool save_calibration(FILE *file, const struct ring_calibration cals[], const size_t RING_CT);
+long decode_position(const struct ring_calibration *cal, const float DISTANCE_CM);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include "calibration_watch.h"
+
+/**
+ * Waits for the watched file to be rewritten or replaced, and loads every new version
+ * into a fresh calibration set. Versions which fail validation are counted and dropped,
+ * so the last good one stays in use.
+ *
+ * Parameter:
+ * arg - the calibration_watch
+ *
+ */
+void *watch_calibration(void *arg) {
+	struct calibration_watch *watch = arg;
+	char path[PATH_MAX + NAME_MAX + 2];
+	/* inotify events are variable length, and must be read into aligned memory */
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds[] = {{watch->inotify_fd, POLLIN, 0}, {watch->stop_fd, POLLIN, 0}};
+	snprintf(path, sizeof(path), "%s/%s", watch->dir, watch->name);
+
+	while (poll(fds, 2, -1) >= 0 && !(fds[1].revents & POLLIN)) {
+		ssize_t len = read(watch->inotify_fd, events, sizeof(events));
+		bool is_changed = false;
+		for (char *event_ptr = events; len > 0 && event_ptr < events + len;) {
+			const struct inotify_event *event = (const struct inotify_event *) event_ptr;
+			is_changed = is_changed || (event->len > 0 && !strcmp(event->name, watch->name));
+			event_ptr += sizeof(struct inotify_event) + event->len;
+		}
+		if (!is_changed) {
+			continue;
+		}
+
+		struct calibration_set *set = malloc(sizeof(*set));
+		if (set == NULL || !load_calibration(path, set->cals, watch->position_cts, watch->ring_ct)) {
+			free(set);
+			atomic_fetch_add(&watch->reject_ct, 1);
+			continue;
+		}
+		set->generation = atomic_fetch_add(&watch->load_ct, 1) + 1;
+		/* replace any version the main loop has not taken yet */
+		free(atomic_exchange(&watch->pending, set));
+	}
+	return NULL;
+}
+
+/**
+ * Starts a thread which reloads FILENAME whenever it is closed after writing, or
+ * renamed into place. Returns false if the file's directory could not be watched.
+ *
+ * Replaces:
+ * watch
+ *
+ * Parameters:
+ * watch - watch to start
+ * FILENAME - calibration file to watch
+ * POSITION_CTS - expected # of positions on each ring
+ * RING_CT - length of POSITION_CTS, at most MAX_WATCHED_RINGS
+ *
+ */
+bool start_calibration_watch(struct calibration_watch *watch, const char *FILENAME, const size_t POSITION_CTS[], const size_t RING_CT) {
+	const char *slash = strrchr(FILENAME, '/');
+	if (RING_CT > MAX_WATCHED_RINGS || strlen(FILENAME) >= sizeof(watch->dir) || strlen(slash ? slash + 1 : FILENAME) > NAME_MAX) {
+		return false;
+	}
+	/* the directory is watched, since replacing the file gives it a new inode */
+	if (slash == NULL) {
+		strcpy(watch->dir, ".");
+		strcpy(watch->name, FILENAME);
+	} else {
+		snprintf(watch->dir, sizeof(watch->dir), "%.*s", (int) (slash - FILENAME), FILENAME);
+		strcpy(watch->name, slash + 1);
+	}
+	memcpy(watch->position_cts, POSITION_CTS, RING_CT * sizeof(size_t));
+	watch->ring_ct = RING_CT;
+	atomic_init(&watch->pending, NULL);
+	atomic_init(&watch->load_ct, 0);
+	atomic_init(&watch->reject_ct, 0);
+
+	watch->inotify_fd = inotify_init1(IN_CLOEXEC);
+	watch->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (watch->inotify_fd < 0 || watch->stop_fd < 0 ||
+		inotify_add_watch(watch->inotify_fd, watch->dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+		pthread_create(&watch->thread, NULL, watch_calibration, watch) != 0) {
+		close(watch->inotify_fd);
+		close(watch->stop_fd);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Returns the newest calibration loaded since the last call, or NULL if there is none.
+ * The caller owns, and must free, what is returned. Never blocks.
+ *
+ * Parameter:
+ * watch - watch to take from
+ *
+ */
+struct calibration_set *take_calibration(struct calibration_watch *watch) {
+	return atomic_exchange(&watch->pending, NULL);
+}
+
+/**
+ * Stops the watch thread and releases the watch.
+ *
+ * Parameter:
+ * watch - watch to stop
+ *
+ */
+void stop_calibration_watch(struct calibration_watch *watch) {
+	uint64_t stop = 1;
+	if (write(watch->stop_fd, &stop, sizeof(stop)) == sizeof(stop)) {
+		pthread_join(watch->thread, NULL);
+	}
+	close(watch->inotify_fd);
+	close(watch->stop_fd);
+	free(atomic_exchange(&watch->pending, NULL));
+}
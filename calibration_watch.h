@@ -0,0 +1,42 @@
+#ifndef CALIBRATION_WATCH_H
+#define CALIBRATION_WATCH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <linux/limits.h>
+#include "calibration.h"
+
+/* most rings a watched calibration can hold */
+#define MAX_WATCHED_RINGS 16
+
+/* calibration of every ring, as loaded from one version of the file */
+struct calibration_set {
+	/* # of times the file was loaded before this one */
+	size_t generation;
+	struct ring_calibration cals[MAX_WATCHED_RINGS];
+};
+
+/* thread which reloads a calibration file whenever it is replaced or rewritten */
+struct calibration_watch {
+	char dir[PATH_MAX];
+	char name[NAME_MAX + 1];
+	size_t position_cts[MAX_WATCHED_RINGS];
+	size_t ring_ct;
+	int inotify_fd;
+	/* written to ask the thread to stop */
+	int stop_fd;
+	pthread_t thread;
+	/* newest valid calibration not yet taken, or NULL */
+	_Atomic(struct calibration_set *) pending;
+	/* # of loads that passed and failed validation */
+	atomic_size_t load_ct;
+	atomic_size_t reject_ct;
+};
+
+bool start_calibration_watch(struct calibration_watch *watch, const char *FILENAME, const size_t POSITION_CTS[], const size_t RING_CT);
+struct calibration_set *take_calibration(struct calibration_watch *watch);
+void stop_calibration_watch(struct calibration_watch *watch);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "controller.h"
+#include "gpio.h"
+#include "gpiosim_wheel.h"
+#include "timing.h"
+
+/* rounds measured on each schedule ; a ring must read right on most of them */
+#define CDEV_ROUND_CT 5
+
+/* the gpio-sim chip standing in for the wheel */
+struct gpiosim_wheel sim_wheel;
+
+void __real_gpio_write(const int PIN, const bool LEVEL);
+
+/**
+ * Stands in for gpio_write, as cdev_check is linked with --wrap=gpio_write: drives the
+ * pin through the cdev backend, then tells the gpio-sim wheel, so it answers the pulse.
+ *
+ * Parameters:
+ * PIN - pin number, a line offset on the chip
+ * LEVEL - true for high, false for low
+ *
+ */
+void __wrap_gpio_write(const int PIN, const bool LEVEL) {
+	__real_gpio_write(PIN, LEVEL);
+	gpiosim_drive(&sim_wheel, PIN, LEVEL, get_monotonic_ns());
+}
+
+/**
+ * Measures a bank CDEV_ROUND_CT times on a schedule, checking that each ring reads its
+ * own distance on most rounds. Prints each ring at fault, and returns the # of faults.
+ *
+ * Parameters:
+ * bank - sensors to measure with
+ * STR - schedule, as for parse_trigger_schedule
+ * DISTANCES_CM - distance each ring should read
+ *
+ */
+size_t check_bank_schedule(const struct sensor_bank *bank, const char *STR, const float DISTANCES_CM[]) {
+	const float TOLERANCE_CM = 1;
+	struct trigger_schedule schedule;
+	float readings[CDEV_ROUND_CT][MAX_RINGS];
+	if (!parse_trigger_schedule(STR, 3000, &schedule)) {
+		printf("Bad schedule %s\n", STR);
+		return 1;
+	}
+	for (size_t pass = 0; pass < CDEV_ROUND_CT; pass++) {
+		measure_bank_cm(bank, &schedule, NULL, readings[pass]);
+	}
+	size_t fault_ct = 0;
+	for (size_t ring = 0; ring < bank->ring_ct; ring++) {
+		size_t right_ct = 0;
+		for (size_t pass = 0; pass < CDEV_ROUND_CT; pass++) {
+			right_ct += fabsf(readings[pass][ring] - DISTANCES_CM[ring]) <= TOLERANCE_CM;
+		}
+		if (right_ct <= CDEV_ROUND_CT / 2) {
+			printf("On schedule %s, ring %zu read %.2f cm (last of %i), expected %.2f cm\n", STR, ring, readings[CDEV_ROUND_CT - 1][ring],
+				CDEV_ROUND_CT, DISTANCES_CM[ring]);
+			fault_ct++;
+		}
+	}
+	return fault_ct;
+}
+
+/**
+ * Measures known distances through the GPIO character device backend on a gpio-sim chip,
+ * so the kernel's edge timestamps, gpio_wait_edges and the distance math are run without
+ * a Pi. The chip is made, and taken down after, by start_gpiosim_wheel ; it needs root.
+ * Skipped, succeeding, if the gpio-sim module is not loaded. Returns non-zero if a ring
+ * reads the wrong distance, or a trigger write never reached the chip.
+ *
+ */
+int main() {
+	const float DISTANCES_CM[] = {15, 20, 10, 30, 15, 25};
+	const char *SCHEDULES[] = {"0,2,4/1,3,5", "0/1/2/3/4/5"};
+	struct sensor_bank bank = {.ring_ct = sizeof(DISTANCES_CM) / sizeof(DISTANCES_CM[0])};
+	if (!has_gpiosim()) {
+		printf("gpio-sim is not loaded, so the cdev backend was not checked. Load it with \"modprobe gpio-sim\" (see README.md).\n");
+		return 0;
+	}
+	for (size_t ring = 0; ring < bank.ring_ct; ring++) {
+		bank.trigger_pins[ring] = 2 * ring;
+		bank.echo_pins[ring] = 2 * ring + 1;
+	}
+	if (!start_gpiosim_wheel(&sim_wheel, bank.trigger_pins, bank.echo_pins, DISTANCES_CM, bank.ring_ct)) {
+		return 1;
+	}
+	setenv("GPIO_CHIP", sim_wheel.chip_path, 1);
+	setenv("GPIO_PIN_NUMBERS", "offset", 1);
+	start_gpio();
+	setup_sensor_bank(&bank);
+	for (size_t ring = 0; ring < bank.ring_ct; ring++) {
+		gpio_write(bank.trigger_pins[ring], false);
+	}
+
+	size_t fault_ct = 0;
+	for (size_t i = 0; i < sizeof(SCHEDULES) / sizeof(SCHEDULES[0]); i++) {
+		fault_ct += check_bank_schedule(&bank, SCHEDULES[i], DISTANCES_CM);
+	}
+	if (sim_wheel.unseen_ct > 0) {
+		printf("%zu trigger writes did not reach the chip's lines\n", sim_wheel.unseen_ct);
+		fault_ct++;
+	}
+	stop_gpiosim_wheel(&sim_wheel);
+	printf("Measured %zu rings through the GPIO character device on a gpio-sim chip, %zu faults.\n", bank.ring_ct, fault_ct);
+	return fault_ct ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "calibration.h"
+#include "calibration_watch.h"
+#include "check_driver.h"
+
+/**
+ * Writes ring calibrations to FILENAME as save_calibration does, through a temporary
+ * file renamed into place as data_collector does. With CORRUPT, the last digit of the
+ * last median is changed after the checksum is taken. Returns false on failure.
+ *
+ * Parameters:
+ * FILENAME - file to write
+ * cals - calibration of each ring
+ * RING_CT - length of cals
+ * CORRUPT - whether to corrupt the file
+ *
+ */
+bool write_calibration_file(const char *FILENAME, const struct ring_calibration cals[], const size_t RING_CT, const bool CORRUPT) {
+	char *text = NULL, temp[PATH_MAX];
+	size_t len = 0;
+	FILE *stream = open_memstream(&text, &len);
+	if (stream == NULL) {
+		return false;
+	}
+	bool is_saved = save_calibration(stream, cals, RING_CT);
+	fclose(stream);
+	char *checksum = is_saved ? strstr(text, "\ncrc32 ") : NULL;
+	if (checksum == NULL) {
+		free(text);
+		return false;
+	}
+	if (CORRUPT) {
+		checksum[-1] = checksum[-1] == '0' ? '1' : '0';
+	}
+
+	snprintf(temp, sizeof(temp), "%s.tmp", FILENAME);
+	FILE *file = fopen(temp, "w");
+	bool is_written = file != NULL && fwrite(text, 1, len, file) == len;
+	is_written = file != NULL && !fclose(file) && is_written && !rename(temp, FILENAME);
+	free(text);
+	return is_written;
+}
+
+/**
+ * Writes a valid and a corrupted calibration file to a temporary directory, checking
+ * that the valid one loads back to the same medians and decodes distances to the right
+ * positions, and that the corrupted one, and one with the wrong # of positions, are
+ * rejected. Prints each fault, and returns the # of faults.
+ *
+ */
+size_t check_calibration() {
+	const float MEDIANS[][4] = {{10, 20, 30}, {12, 18, 40, 41}};
+	const size_t POSITION_CTS[] = {3, 4}, WRONG_POSITION_CTS[] = {3, 5};
+	/* distances on ring 1, which is unevenly spaced, and the positions they decode to */
+	const float DISTANCES[] = {8.9, 9, 14.9, 15, 28.9, 29, 40.4, 40.5, 41.4, 41.5};
+	const long POSITIONS[] = {-1, 0, 0, 1, 1, 2, 2, 3, 3, -1};
+	const size_t DISTANCE_CT = sizeof(DISTANCES) / sizeof(DISTANCES[0]);
+	struct ring_calibration cals[2], loaded[2];
+	char dir[] = "/tmp/muyuchina-check-XXXXXX", filename[PATH_MAX];
+	if (!make_calibration(&cals[0], MEDIANS[0], 3) || !make_calibration(&cals[1], MEDIANS[1], 4) || mkdtemp(dir) == NULL) {
+		printf("Could not set up calibrations.\n");
+		return 1;
+	}
+	snprintf(filename, sizeof(filename), "%s/ring_data.txt", dir);
+
+	size_t fault_ct = 0;
+	if (!write_calibration_file(filename, cals, 2, false) || !load_calibration(filename, loaded, POSITION_CTS, 2)) {
+		printf("A valid calibration file was rejected.\n");
+		fault_ct++;
+	} else {
+		for (size_t ring = 0; ring < 2; ring++) {
+			for (size_t position = 0; position < POSITION_CTS[ring]; position++) {
+				if (loaded[ring].medians[position] != cals[ring].medians[position]) {
+					printf("Ring %zu position %zu loaded as %.3f cm, saved as %.3f cm\n", ring, position,
+						loaded[ring].medians[position], cals[ring].medians[position]);
+					fault_ct++;
+				}
+			}
+		}
+		for (size_t i = 0; i < DISTANCE_CT; i++) {
+			if (decode_position(&loaded[1], DISTANCES[i]) != POSITIONS[i]) {
+				printf("%.1f cm decoded to position %li, expected %li\n", DISTANCES[i], decode_position(&loaded[1], DISTANCES[i]), POSITIONS[i]);
+				fault_ct++;
+			}
+		}
+		if (load_calibration(filename, loaded, WRONG_POSITION_CTS, 2)) {
+			printf("A calibration file with the wrong # of positions was accepted.\n");
+			fault_ct++;
+		}
+	}
+	if (!write_calibration_file(filename, cals, 2, true) || load_calibration(filename, loaded, POSITION_CTS, 2)) {
+		printf("A calibration file failing its checksum was accepted.\n");
+		fault_ct++;
+	}
+	unlink(filename);
+	rmdir(dir);
+	printf("Wrote and loaded back calibration files, %zu faults.\n", fault_ct);
+	return fault_ct;
+}
+
+/**
+ * Waits up to a second for a calibration watch to load or reject a new version of its
+ * file. Returns the version loaded, or NULL if it was rejected or nothing happened.
+ *
+ * Parameters:
+ * watch - watch to wait on
+ * SEEN_CT - # of versions loaded or rejected so far
+ *
+ */
+struct calibration_set *wait_for_calibration(struct calibration_watch *watch, const size_t SEEN_CT) {
+	for (size_t ms = 0; ms < 1000 && atomic_load(&watch->load_ct) + atomic_load(&watch->reject_ct) <= SEEN_CT; ms++) {
+		usleep(1000);
+	}
+	return take_calibration(watch);
+}
+
+/**
+ * Watches a calibration file in a temporary directory while a valid version, a
+ * corrupted one and another valid one are renamed into place, checking that each valid
+ * version is swapped in, and that the corrupted one is rejected so the one before it
+ * stays in use. Prints each fault, and returns the # of faults.
+ *
+ */
+size_t check_calibration_watch() {
+	const float MEDIANS[][3] = {{10, 20, 30}, {11, 22, 33}};
+	const size_t POSITION_CTS[] = {3};
+	struct ring_calibration cals[2];
+	struct calibration_watch watch;
+	char dir[] = "/tmp/muyuchina-check-XXXXXX", filename[PATH_MAX];
+	if (!make_calibration(&cals[0], MEDIANS[0], 3) || !make_calibration(&cals[1], MEDIANS[1], 3) || mkdtemp(dir) == NULL) {
+		printf("Could not set up calibrations.\n");
+		return 1;
+	}
+	snprintf(filename, sizeof(filename), "%s/ring_data.txt", dir);
+	if (!start_calibration_watch(&watch, filename, POSITION_CTS, 1)) {
+		printf("Could not watch %s.\n", filename);
+		rmdir(dir);
+		return 1;
+	}
+
+	/* first version, corrupted version, second version ; the corrupted one must change nothing */
+	const size_t VERSIONS[] = {0, 0, 1};
+	const bool CORRUPT[] = {false, true, false};
+	size_t fault_ct = 0;
+	for (size_t step = 0; step < 3; step++) {
+		if (!write_calibration_file(filename, &cals[VERSIONS[step]], 1, CORRUPT[step])) {
+			printf("Could not write %s.\n", filename);
+			fault_ct++;
+			break;
+		}
+		struct calibration_set *set = wait_for_calibration(&watch, step);
+		if (CORRUPT[step]) {
+			/* the driver only swaps when there is a new set, so the previous one stays in use */
+			if (set != NULL || atomic_load(&watch.reject_ct) != 1) {
+				printf("A corrupted calibration was swapped in.\n");
+				fault_ct++;
+			}
+		} else if (set == NULL || set->cals[0].medians[1] != MEDIANS[VERSIONS[step]][1]) {
+			printf("Calibration version %zu was not swapped in.\n", step);
+			fault_ct++;
+		}
+		free(set);
+	}
+	stop_calibration_watch(&watch);
+	if (atomic_load(&watch.load_ct) != 2) {
+		printf("Calibration watch loaded %zu versions, expected 2\n", atomic_load(&watch.load_ct));
+		fault_ct++;
+	}
+	unlink(filename);
+	rmdir(dir);
+	printf("Swapped calibration files under a watch, %zu faults.\n", fault_ct);
+	return fault_ct;
+}
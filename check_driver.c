@@ -0,0 +1,24 @@
+#include <stddef.h>
+#include "check_driver.h"
+
+/**
+ * Checks the modules between the sensors and the screen, which tester does not link:
+ * steps a ring filter across a position boundary, writes and loads back valid and
+ * corrupted calibration files and watches them being replaced, compares streaming
+ * statistics against exact ones, records and replays a trace, passes words through the
+ * word queue, reads translated's requests in pieces, and measures the simulated wheel on
+ * a trigger schedule and with neighbouring rings firing together. Needs no Pi. Returns non-zero
+ * if any check finds a fault.
+ *
+ */
+int main() {
+	size_t fault_ct = check_filter();
+	fault_ct += check_calibration();
+	fault_ct += check_calibration_watch();
+	fault_ct += check_stream_stats();
+	fault_ct += check_trace();
+	fault_ct += check_word_queue();
+	fault_ct += check_framing();
+	fault_ct += check_schedule();
+	return fault_ct ? 1 : 0;
+}
@@ -0,0 +1,20 @@
+#ifndef CHECK_DRIVER_H
+#define CHECK_DRIVER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "calibration.h"
+
+/* each check prints its faults and a one line summary, and returns the # of faults */
+size_t check_filter();
+size_t check_calibration();
+size_t check_calibration_watch();
+size_t check_stream_stats();
+size_t check_trace();
+size_t check_word_queue();
+size_t check_framing();
+size_t check_schedule();
+
+bool write_calibration_file(const char *FILENAME, const struct ring_calibration cals[], const size_t RING_CT, const bool CORRUPT);
+
+#endif
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include "calibration.h"
+#include "filter.h"
+#include "check_driver.h"
+
+/**
+ * Feeds a ring's filter readings around the boundary between two positions, checking
+ * that a lone outlier is outvoted by the running median, that a median inside the
+ * hysteresis band holds the position in either direction, and that one just past it
+ * switches. Prints each step at fault, and returns the # of faults.
+ *
+ */
+size_t check_filter() {
+	/* positions at 10, 20 and 30 cm, so the boundaries are at 15 and 25 and the band is 1.5 cm */
+	const float MEDIANS[] = {10, 20, 30};
+	const float DISTANCES[] = {10, 10, 10, 40, 16, 16, 16, 17, 17, 14, 14, 14, 13, 13};
+	const size_t POSITIONS[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0};
+	const size_t STEP_CT = sizeof(DISTANCES) / sizeof(DISTANCES[0]);
+	struct ring_calibration cal;
+	struct ring_filter filter;
+	if (!make_calibration(&cal, MEDIANS, 3) || !init_filter(&filter, 3, 0.15)) {
+		printf("Could not set up a filter.\n");
+		return 1;
+	}
+	size_t fault_ct = 0;
+	for (size_t step = 0; step < STEP_CT; step++) {
+		filter_sample(&filter, DISTANCES[step], &cal);
+		if (filter.position != POSITIONS[step]) {
+			printf("Filter at step %zu read %.0f cm, median %.1f cm: position %zu, expected %zu\n", step, DISTANCES[step],
+				get_window_median(&filter), filter.position, POSITIONS[step]);
+			fault_ct++;
+		}
+	}
+	/* 16, 16, 16 and 16 going up, then 14, 14 and 14 coming down, were inside the band */
+	if (filter.held_ct != 7) {
+		printf("Filter held back %zu changes, expected 7\n", filter.held_ct);
+		fault_ct++;
+	}
+
+	/* a window that is not yet full takes the median of what it has */
+	init_filter(&filter, 4, 0.15);
+	filter_sample(&filter, 10, &cal);
+	filter_sample(&filter, 30, &cal);
+	if (get_window_median(&filter) != 20) {
+		printf("Median of 10 and 30 was %.1f, expected 20\n", get_window_median(&filter));
+		fault_ct++;
+	}
+	printf("Stepped a filter across a position boundary, %zu faults.\n", fault_ct);
+	return fault_ct;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "translate_proto.h"
+#include "check_driver.h"
+
+/**
+ * Splits a stream of requests for translated into reads of every size from a byte to the
+ * whole stream, as a socket may deliver them, and checks that scan_frame finds each
+ * request whole only once all of it has arrived, and exactly as sent, and that a frame
+ * whose len no frame can have is refused from its header alone. Prints each fault, and
+ * returns the # of faults.
+ *
+ */
+size_t check_framing() {
+	/* request 2 holds WORDS, and the rest that many keys */
+	const size_t KEY_CTS[] = {0, 3, 0, MAX_FRAME_WORDS, 1};
+	const char *const WORDS[] = {"wayk'urichkanki", "x"};
+	const size_t READ_LENS[] = {1, 2, 3, 5, 7, 11, 12, 13, 64, 4099, SIZE_MAX};
+	const size_t FRAME_CT = sizeof(KEY_CTS) / sizeof(KEY_CTS[0]);
+	struct byte_buffer stream = {0}, received = {0};
+	size_t frame_ends[sizeof(KEY_CTS) / sizeof(KEY_CTS[0])], fault_ct = 0;
+
+	for (uint32_t id = 0; id < FRAME_CT; id++) {
+		const size_t START = stream.len;
+		struct frame_header header = {0, id, id == 2 ? OP_WORDS : OP_KEYS, 0};
+		bool is_built = append_bytes(&stream, &header, sizeof(header));
+		for (size_t i = 0; id == 2 && i < 2; i++) {
+			uint8_t len = strlen(WORDS[i]);
+			is_built = is_built && append_bytes(&stream, &len, 1) && append_bytes(&stream, WORDS[i], len);
+			header.word_ct++;
+		}
+		for (word_key key = 0; key < KEY_CTS[id]; key++) {
+			is_built = is_built && append_bytes(&stream, &key, sizeof(key));
+			header.word_ct++;
+		}
+		if (!is_built) {
+			printf("Could not build a stream of requests.\n");
+			free_byte_buffer(&stream);
+			return 1;
+		}
+		header.len = stream.len - START - sizeof(header.len);
+		memcpy(stream.data + START, &header, sizeof(header));
+		frame_ends[id] = stream.len;
+	}
+
+	for (size_t i = 0; i < sizeof(READ_LENS) / sizeof(READ_LENS[0]); i++) {
+		size_t frame_ct = 0, taken_len = 0;
+		received.len = 0;
+		for (size_t pos = 0; pos < stream.len;) {
+			size_t read_len = stream.len - pos < READ_LENS[i] ? stream.len - pos : READ_LENS[i];
+			append_bytes(&received, stream.data + pos, read_len);
+			pos += read_len;
+			struct frame_header header;
+			enum frame_scan scan;
+			while ((scan = scan_frame(received.data, received.len, &header)) == SCAN_WHOLE) {
+				const size_t FRAME_LEN = sizeof(header.len) + header.len;
+				if (frame_ct == FRAME_CT || taken_len + FRAME_LEN != frame_ends[frame_ct] || header.id != frame_ct || pos < frame_ends[frame_ct] ||
+					memcmp(received.data, stream.data + taken_len, FRAME_LEN)) {
+					printf("Reading %zu bytes at a time, frame %zu was not request %zu as sent\n", READ_LENS[i], frame_ct, frame_ct);
+					fault_ct++;
+				}
+				consume_bytes(&received, FRAME_LEN);
+				taken_len += FRAME_LEN;
+				frame_ct++;
+			}
+			if (scan == SCAN_BAD_LEN) {
+				printf("Reading %zu bytes at a time, request %zu had a bad len\n", READ_LENS[i], frame_ct);
+				fault_ct++;
+				break;
+			}
+		}
+		if (frame_ct != FRAME_CT || received.len != 0) {
+			printf("Reading %zu bytes at a time, found %zu of %zu requests, with %zu bytes left\n", READ_LENS[i], frame_ct, FRAME_CT, received.len);
+			fault_ct++;
+		}
+	}
+
+	/* too short for a header, and too long for any request */
+	const uint32_t BAD_LENS[] = {sizeof(struct frame_header) - sizeof(uint32_t) - 1, MAX_FRAME_LEN + 1};
+	for (size_t i = 0; i < 2; i++) {
+		struct frame_header header = {BAD_LENS[i], 0, OP_KEYS, 0};
+		if (scan_frame((const uint8_t *) &header, sizeof(header), &header) != SCAN_BAD_LEN ||
+			scan_frame((const uint8_t *) &header, sizeof(header) - 1, &header) != SCAN_PARTIAL) {
+			printf("A frame with len %u was not refused from its header alone\n", BAD_LENS[i]);
+			fault_ct++;
+		}
+	}
+	free_byte_buffer(&stream);
+	free_byte_buffer(&received);
+	printf("Read %zu requests in pieces of %zu sizes, %zu faults.\n", FRAME_CT, sizeof(READ_LENS) / sizeof(READ_LENS[0]), fault_ct);
+	return fault_ct;
+}
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "controller.h"
+#include "gpio_sim.h"
+#include "check_driver.h"
+
+/* rounds measured on each schedule ; the median of them is checked, so a late poll does not count */
+#define SCHEDULE_ROUND_CT 5
+
+/**
+ * Measures the simulated wheel's rings SCHEDULE_ROUND_CT times on a schedule, and gives
+ * each ring's median reading.
+ *
+ * Replaces:
+ * medians
+ *
+ * Parameters:
+ * STR - schedule, as for parse_trigger_schedule
+ * medians - median reading of each ring
+ *
+ */
+void measure_schedule_medians(const char *STR, float medians[]) {
+	struct trigger_schedule schedule;
+	float readings[SCHEDULE_ROUND_CT][MAX_RINGS];
+	parse_trigger_schedule(STR, 3000, &schedule);
+	for (size_t pass = 0; pass < SCHEDULE_ROUND_CT; pass++) {
+		measure_rings_cm(&schedule, NULL, readings[pass]);
+	}
+	for (size_t ring = 0; ring < get_ring_ct(); ring++) {
+		/* insertion sort of the ring's readings */
+		float sorted[SCHEDULE_ROUND_CT];
+		for (size_t pass = 0; pass < SCHEDULE_ROUND_CT; pass++) {
+			size_t at = pass;
+			for (; at > 0 && sorted[at - 1] > readings[pass][ring]; at--) {
+				sorted[at] = sorted[at - 1];
+			}
+			sorted[at] = readings[pass][ring];
+		}
+		medians[ring] = sorted[SCHEDULE_ROUND_CT / 2];
+	}
+}
+
+/**
+ * Measures the built in wheel's rings through the simulated GPIO backend, with
+ * crosstalk between neighbouring rings, checking that the default schedule, which never
+ * fires neighbours together, reads each ring's own distance, and that a schedule firing
+ * neighbours together lets each far ring hear its nearer neighbour's ping, as the
+ * simulation's crosstalk does. Prints each fault, and returns the # of faults.
+ *
+ */
+size_t check_schedule() {
+	/* far and near rings in turn, so each far ring's echo is beaten by a neighbour's ping */
+	const float DISTANCES[] = {30, 10, 25, 12, 28, 15};
+	const float TOLERANCE_CM = 1;
+	float medians[MAX_RINGS];
+	unsetenv("SIM_SCRIPT");
+	unsetenv("SIM_RINGS_PER_WHEEL");
+	setup();
+	sim_set_crosstalk(true);
+	sim_set_noise(0, 0, 0);
+	if (get_ring_ct() != sizeof(DISTANCES) / sizeof(DISTANCES[0]) || sim_sensor_ct() != get_ring_ct()) {
+		printf("The simulated wheel has %zu sensors for %zu rings, expected 6\n", sim_sensor_ct(), get_ring_ct());
+		return 1;
+	}
+	for (size_t ring = 0; ring < get_ring_ct(); ring++) {
+		sim_set_distance(ring, DISTANCES[ring]);
+	}
+
+	size_t fault_ct = 0;
+	measure_schedule_medians("0,2,4/1,3,5", medians);
+	for (size_t ring = 0; ring < get_ring_ct(); ring++) {
+		if (fabsf(medians[ring] - DISTANCES[ring]) > TOLERANCE_CM) {
+			printf("On schedule 0,2,4/1,3,5, ring %zu read %.1f cm, expected %.1f cm\n", ring, medians[ring], DISTANCES[ring]);
+			fault_ct++;
+		}
+	}
+	/* a far ring hears its near neighbour's ping off both rings */
+	measure_schedule_medians("0,1/2,3/4,5", medians);
+	for (size_t ring = 0; ring < get_ring_ct(); ring += 2) {
+		const float HEARD_CM = (DISTANCES[ring] + DISTANCES[ring + 1]) / 2;
+		if (fabsf(medians[ring] - HEARD_CM) > TOLERANCE_CM) {
+			printf("On schedule 0,1/2,3/4,5, ring %zu read %.1f cm, expected crosstalk at %.1f cm\n", ring, medians[ring], HEARD_CM);
+			fault_ct++;
+		}
+	}
+	printf("Measured 6 rings on a two slot schedule and with neighbours sharing a slot, %zu faults.\n", fault_ct);
+	return fault_ct;
+}
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "stream_stats.h"
+#include "check_driver.h"
+
+/**
+ * Compares two doubles, for qsort.
+ *
+ * Parameters:
+ * A - first double
+ * B - second double
+ *
+ */
+int compare_doubles(const void *A, const void *B) {
+	double a = *(const double *) A, b = *(const double *) B;
+	return (a > b) - (a < b);
+}
+
+/**
+ * Feeds seeded samples from uniform, skewed and sorted streams to the streaming
+ * statistics, checking the Welford mean and standard deviation against two exact passes,
+ * and the P-squared median and 90th percentile against the sorted samples. The quantile
+ * estimates must be exact for the first few samples, and within 1% of the samples'
+ * range after. Prints each fault, and returns the # of faults.
+ *
+ */
+size_t check_stream_stats() {
+	const size_t SAMPLE_CT = 10000, SHAPE_CT = 3;
+	const char *SHAPES[] = {"uniform", "skewed", "sorted"};
+	const double QUANTILES[] = {0.5, 0.9};
+	double *samples = malloc(SAMPLE_CT * sizeof(double));
+	if (samples == NULL) {
+		printf("Could not allocate samples.\n");
+		return 1;
+	}
+	srand(1);
+	size_t fault_ct = 0;
+	for (size_t shape = 0; shape < SHAPE_CT; shape++) {
+		for (size_t q = 0; q < 2; q++) {
+			struct stream_stats stats;
+			init_stream_stats(&stats, QUANTILES[q]);
+			for (size_t i = 0; i < SAMPLE_CT; i++) {
+				double uniform = (double) rand() / RAND_MAX;
+				samples[i] = shape == 0 ? 20 + 10 * uniform : shape == 1 ? 20 + 10 * uniform * uniform * uniform : 20 + 10.0 * i / SAMPLE_CT;
+				add_stream_sample(&stats, samples[i]);
+				/* up to QUANTILE_MARKERS samples, the estimate interpolates the samples themselves */
+				if (i + 1 == QUANTILE_MARKERS) {
+					double sorted[QUANTILE_MARKERS];
+					memcpy(sorted, samples, sizeof(sorted));
+					qsort(sorted, QUANTILE_MARKERS, sizeof(double), compare_doubles);
+					double rank = QUANTILES[q] * (QUANTILE_MARKERS - 1);
+					size_t below = rank;
+					double exact = sorted[below] + (rank - below) * (below + 1 < QUANTILE_MARKERS ? sorted[below + 1] - sorted[below] : 0);
+					if (fabs(get_stream_quantile(&stats) - exact) > 1e-9) {
+						printf("%s p%.0f of %i samples was %.4f, expected %.4f\n", SHAPES[shape], 100 * QUANTILES[q], QUANTILE_MARKERS,
+							get_stream_quantile(&stats), exact);
+						fault_ct++;
+					}
+				}
+			}
+
+			double mean = 0, m2 = 0;
+			for (size_t i = 0; i < SAMPLE_CT; i++) {
+				mean += samples[i] / SAMPLE_CT;
+			}
+			for (size_t i = 0; i < SAMPLE_CT; i++) {
+				m2 += (samples[i] - mean) * (samples[i] - mean);
+			}
+			qsort(samples, SAMPLE_CT, sizeof(double), compare_doubles);
+			double stddev = sqrt(m2 / SAMPLE_CT), range = samples[SAMPLE_CT - 1] - samples[0];
+			double rank = QUANTILES[q] * (SAMPLE_CT - 1);
+			size_t below = rank;
+			double exact = samples[below] + (rank - below) * (samples[below + 1] - samples[below]);
+			if (fabs(stats.mean - mean) > 1e-9 * mean || fabs(get_stream_stddev(&stats) - stddev) > 1e-9 * stddev) {
+				printf("%s mean and deviation were %.6f and %.6f, expected %.6f and %.6f\n", SHAPES[shape], stats.mean,
+					get_stream_stddev(&stats), mean, stddev);
+				fault_ct++;
+			}
+			if (fabs(get_stream_quantile(&stats) - exact) > 0.01 * range) {
+				printf("%s p%.0f was estimated as %.4f, expected %.4f\n", SHAPES[shape], 100 * QUANTILES[q], get_stream_quantile(&stats), exact);
+				fault_ct++;
+			}
+		}
+	}
+	free(samples);
+	printf("Compared streaming statistics of %zu samples against exact ones, %zu faults.\n", SAMPLE_CT, fault_ct);
+	return fault_ct;
+}
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "calibration.h"
+#include "filter.h"
+#include "trace.h"
+#include "check_driver.h"
+
+/**
+ * Records seeded pings of several rings to a trace in a temporary directory, maps it
+ * back, and checks every record, that the same filtering of the recorded and the
+ * replayed pings ends on the same positions, that a partly written last record is
+ * ignored, and that a file which is not a trace is refused. Prints each fault, and
+ * returns the # of faults.
+ *
+ */
+size_t check_trace() {
+	const size_t PING_CT = 3000, RING_CT = 3;
+	const float MEDIANS[] = {10, 20, 30};
+	struct trace_writer writer;
+	struct trace trace;
+	struct ring_calibration cal;
+	struct ring_filter recorded[3], replayed[3];
+	char dir[] = "/tmp/muyuchina-check-XXXXXX", filename[PATH_MAX];
+	if (!make_calibration(&cal, MEDIANS, 3) || mkdtemp(dir) == NULL) {
+		printf("Could not set up a trace.\n");
+		return 1;
+	}
+	snprintf(filename, sizeof(filename), "%s/pings.trace", dir);
+	if (!open_trace_writer(&writer, filename)) {
+		printf("Could not record to %s.\n", filename);
+		rmdir(dir);
+		return 1;
+	}
+
+	srand(2);
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		init_filter(&recorded[ring], 3, 0.15);
+		init_filter(&replayed[ring], 3, 0.15);
+	}
+	for (size_t ping = 0; ping < PING_CT; ping++) {
+		size_t ring = ping % RING_CT;
+		/* a ring wanders between positions, with every 50th ping lost */
+		float distance_cm = ping % 50 == 49 ? -1 : 8 + 24 * (float) rand() / RAND_MAX;
+		write_trace_record(&writer, ring, writer.start_ns + 1000 * ping, distance_cm < 0 ? 0 : 58 * distance_cm * 1000, distance_cm);
+		if (distance_cm >= 0) {
+			filter_sample(&recorded[ring], distance_cm, &cal);
+		}
+	}
+	close_trace_writer(&writer);
+
+	size_t fault_ct = 0;
+	if (!map_trace(&trace, filename) || trace.record_ct != PING_CT) {
+		printf("Recorded %zu pings, but could not map them back.\n", PING_CT);
+		fault_ct++;
+	} else {
+		srand(2);
+		for (size_t ping = 0; ping < PING_CT; ping++) {
+			const struct trace_record *record = &trace.records[ping];
+			float distance_cm = ping % 50 == 49 ? -1 : 8 + 24 * (float) rand() / RAND_MAX;
+			if (record->timestamp_ns != 1000 * ping || record->ring != ping % RING_CT || record->distance_cm != distance_cm ||
+				record->echo_ns != (distance_cm < 0 ? 0 : (uint32_t) (58 * distance_cm * 1000))) {
+				printf("Trace record %zu was ring %u at %lu ns, %.3f cm ; expected ring %zu at %zu ns, %.3f cm\n", ping, record->ring,
+					(unsigned long) record->timestamp_ns, record->distance_cm, ping % RING_CT, 1000 * ping, distance_cm);
+				fault_ct++;
+			}
+			if (record->distance_cm >= 0) {
+				filter_sample(&replayed[record->ring], record->distance_cm, &cal);
+			}
+		}
+		for (size_t ring = 0; ring < RING_CT; ring++) {
+			if (replayed[ring].position != recorded[ring].position || replayed[ring].held_ct != recorded[ring].held_ct ||
+				replayed[ring].settle_ct != recorded[ring].settle_ct) {
+				printf("Ring %zu replayed to position %zu with %zu changes, recorded %zu with %zu\n", ring, replayed[ring].position,
+					replayed[ring].settle_ct, recorded[ring].position, recorded[ring].settle_ct);
+				fault_ct++;
+			}
+		}
+		unmap_trace(&trace);
+	}
+
+	/* a recorder killed mid-write leaves part of a record */
+	FILE *file = fopen(filename, "ab");
+	if (file == NULL || fwrite("partial", 1, 7, file) != 7 || fclose(file) || !map_trace(&trace, filename) || trace.record_ct != PING_CT) {
+		printf("A trace with a partly written last record was not mapped to its whole records.\n");
+		fault_ct++;
+	}
+	unmap_trace(&trace);
+	file = fopen(filename, "r+b");
+	if (file == NULL || fwrite("NOTATRC", 1, 8, file) != 8 || fclose(file) || map_trace(&trace, filename)) {
+		printf("A file which is not a trace was mapped.\n");
+		fault_ct++;
+	}
+	unmap_trace(&trace);
+	unlink(filename);
+	rmdir(dir);
+	printf("Recorded and replayed a trace of %zu pings, %zu faults.\n", PING_CT, fault_ct);
+	return fault_ct;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include "word_queue.h"
+#include "renderer.h"
+#include "check_driver.h"
+
+/**
+ * Producer thread of check_word_queue ; pushes keys 1 to WORD_QUEUE_CHECK_CT in order,
+ * yielding whenever the queue is full.
+ *
+ * Parameter:
+ * arg - queue to push to
+ *
+ */
+#define WORD_QUEUE_CHECK_CT 200000
+void *push_check_words(void *arg) {
+	struct word_queue *queue = arg;
+	for (word_key key = 1; key <= WORD_QUEUE_CHECK_CT; key++) {
+		struct word_state state = {key, key};
+		while (!push_word_state(queue, &state)) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Checks that a word queue holds exactly WORD_QUEUE_LEN words and gives them back in
+ * order, that words pushed by one thread while another pops them arrive in order with
+ * none lost or repeated, and that a renderer whose queue is full keeps only the newest
+ * word waiting, counting the ones it replaced as dropped. Prints each fault, and returns
+ * the # of faults.
+ *
+ */
+size_t check_word_queue() {
+	static struct word_queue queue;
+	struct word_state state;
+	size_t fault_ct = 0, push_ct = 0;
+	init_word_queue(&queue);
+	for (word_key key = 1; push_word_state(&queue, &(struct word_state) {key, key}) && push_ct <= WORD_QUEUE_LEN; key++) {
+		push_ct++;
+	}
+	if (push_ct != WORD_QUEUE_LEN || get_word_queue_depth(&queue) != WORD_QUEUE_LEN) {
+		printf("Word queue took %zu words, and holds %zu ; expected %i\n", push_ct, get_word_queue_depth(&queue), WORD_QUEUE_LEN);
+		fault_ct++;
+	}
+	for (word_key key = 1; key <= push_ct; key++) {
+		if (!pop_word_state(&queue, &state) || state.key != key) {
+			printf("Word queue gave back word %u as %u\n", key, state.key);
+			fault_ct++;
+			break;
+		}
+	}
+	if (pop_word_state(&queue, &state)) {
+		printf("Word queue gave back a word it was not given.\n");
+		fault_ct++;
+	}
+
+	/* one producer and one consumer, as the sensing loop and render thread */
+	pthread_t producer;
+	init_word_queue(&queue);
+	if (pthread_create(&producer, NULL, push_check_words, &queue) != 0) {
+		printf("Could not start the producer.\n");
+		return fault_ct + 1;
+	}
+	for (word_key expected = 1; expected <= WORD_QUEUE_CHECK_CT;) {
+		if (!pop_word_state(&queue, &state)) {
+			sched_yield();
+			continue;
+		}
+		if (state.key != expected || state.commit_ns != expected) {
+			printf("Word queue gave word %u after %u\n", state.key, expected - 1);
+			fault_ct++;
+			expected = state.key;
+		}
+		expected++;
+	}
+	pthread_join(producer, NULL);
+
+	/* the render thread is not started, so the queue fills and the newest word waits */
+	static struct renderer renderer;
+	init_word_queue(&renderer.queue);
+	if ((renderer.wake_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		printf("Could not make an eventfd.\n");
+		return fault_ct + 1;
+	}
+	const size_t SUBMIT_CT = WORD_QUEUE_LEN + 3;
+	for (word_key key = 1; key <= SUBMIT_CT; key++) {
+		submit_word(&renderer, key);
+	}
+	size_t pop_ct = 0;
+	for (; pop_word_state(&renderer.queue, &state) && state.key == pop_ct + 1; pop_ct++);
+	flush_words(&renderer);
+	bool is_newest = pop_word_state(&renderer.queue, &state) && state.key == SUBMIT_CT;
+	if (pop_ct != WORD_QUEUE_LEN || !is_newest || renderer.has_pending || renderer.dropped_ct != SUBMIT_CT - WORD_QUEUE_LEN - 1 ||
+		renderer.committed_ct != SUBMIT_CT || renderer.max_queue_depth != WORD_QUEUE_LEN) {
+		printf("A full render queue passed on %zu words in order, then %s, with %lu of %lu dropped and %lu most queued\n", pop_ct,
+			is_newest ? "the newest" : "not the newest", (unsigned long) renderer.dropped_ct, (unsigned long) renderer.committed_ct,
+			(unsigned long) renderer.max_queue_depth);
+		fault_ct++;
+	}
+	close(renderer.wake_fd);
+	printf("Passed %i words between threads through the word queue, %zu faults.\n", WORD_QUEUE_CHECK_CT, fault_ct);
+	return fault_ct;
+}
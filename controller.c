@@ -1,6 +1,10 @@
+#include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
-#include <wiringPi.h>
+#include <string.h>
+#include "controller.h"
+#include "gpio.h"
+#include "timing.h"
+#include "trace.h"
  
 /**
  *  WIRING PI PIN LAYOUT
@@ -28,10 +32,35 @@
  *  ------------------
  *
  */
-const int TRIGGER_PINS[] = {4};
-const int ECHO_PINS[] = {5};
+/**
+ * One HC-SR04 per ring, from most to least central, as TRIGGER / ECHO wiring pi pins:
+ *
+ * ring 0 - WP 4 / WP 5
+ * ring 1 - WP 0 / WP 1
+ * ring 2 - WP 2 / WP 3
+ * ring 3 - WP 21 / WP 22
+ * ring 4 - WP 23 / WP 24
+ * ring 5 - WP 25 / WP 28
+ *
+ * Only plain GPIO pins are used: WP 8 and 9 (I2C, with pull-ups), WP 10 to 14 (SPI),
+ * WP 15 and 16 (the serial console) and WP 30 and 31 (ID_SD / ID_SC, which the
+ * firmware reads a HAT's ID EEPROM over at boot) are left free. Each echo pin needs a
+ * divider to bring the sensor's 5v down to 3.3v.
+ *
+ */
+const int TRIGGER_PINS[] = {4, 0, 2, 21, 23, 25};
+const int ECHO_PINS[] = {5, 1, 3, 22, 24, 28};
 const int RING_CT = sizeof(ECHO_PINS) / sizeof(ECHO_PINS[0]);
 
+/* known constants */
+const int SOUND_SPEED_CM_PER_SEC = 34320;
+const int MAX_ULTRASONIC_RANGE_CM = 400;
+/* longest an echo pin may take to go high after its trigger */
+const uint64_t ECHO_START_TIMEOUT_NS = 5000000;
+
+/* the wheel wired to the pins above, which the single wheel functions measure */
+struct sensor_bank builtin_bank = {0};
+
 /**
  * Sets up pins for usage.
  *
@@ -40,15 +69,37 @@ const int RING_CT = sizeof(ECHO_PINS) / sizeof(ECHO_PINS[0]);
  *
  */
 void setup() {
-	/* set up wiring pi */
-	if (wiringPiSetup() < 0) {
-		printf("Failed to setup wiringpi\n");
-		return 1;
-	}
-	/* set pins */
+	start_gpio();
+	builtin_bank.ring_ct = RING_CT;
 	for (size_t ring = 0; ring < RING_CT; ring++) {
-		pinMode(TRIGGER_PINS[ring], OUTPUT);
-		pinMode(ECHO_PINS[ring], INPUT);
+		builtin_bank.trigger_pins[ring] = TRIGGER_PINS[ring];
+		builtin_bank.echo_pins[ring] = ECHO_PINS[ring];
+	}
+	setup_sensor_bank(&builtin_bank);
+}
+
+/**
+ * Sets up the gpio backend, before any sensor bank. Exits if it cannot.
+ *
+ */
+void start_gpio() {
+	if (!gpio_setup()) {
+		printf("Failed to setup gpio\n");
+		exit(1);
+	}
+}
+
+/**
+ * Sets the trigger pins of a bank for output, and its echo pins for input.
+ *
+ * Parameter:
+ * bank - bank to set up
+ *
+ */
+void setup_sensor_bank(const struct sensor_bank *bank) {
+	for (size_t ring = 0; ring < bank->ring_ct; ring++) {
+		gpio_mode(bank->trigger_pins[ring], GPIO_OUTPUT);
+		gpio_mode(bank->echo_pins[ring], GPIO_INPUT);
 	}
 }
 
@@ -61,31 +112,380 @@ void setup() {
  *
  */
 float measure_ring_cm(const size_t RING) {
-	/* known constants */
-	const int SOUND_SPEED_CM_PER_SEC = 34320;
-	const int MAX_ULTRASONIC_RANGE_CM = 400;
- 
-	/* generate 10us pulse */
-	digitalWrite(TRIGGER_PINS[RING], HIGH);
-	delayMicroseconds(10);
-	digitalWrite(TRIGGER_PINS[RING], LOW);
- 
-	/* get elapsed time in seconds */
-	float start = 0.0, end = 0.0, elapsed_sec;
-	while (!digitalRead(ECHO_PINS[RING])) {
-		start = (float) clock();
-	}
-	while (digitalRead(ECHO_PINS[RING])) {
-		end = (float) clock();
-		/* if out of range, return -1 */
-		if ((end - start) / CLOCKS_PER_SEC * SOUND_SPEED_CM_PER_SEC / 2 > MAX_ULTRASONIC_RANGE_CM) {
-			return -1;
+	struct trigger_schedule schedule = {.slot_ct = 1, .ring_cts = {1}, .rings = {{RING}}};
+	float distances[MAX_RINGS];
+	measure_rings_cm(&schedule, NULL, distances);
+	return distances[RING];
+}
+
+/**
+ * Records every later ping of every ring to writer, or stops recording if writer is NULL.
+ *
+ * Parameter:
+ * writer - trace to record to
+ *
+ */
+void set_trace_writer(struct trace_writer *writer) {
+	builtin_bank.trace_writer = writer;
+}
+
+/**
+ * Counts the time from each later trigger of each ring to the end of its echo, or its
+ * timeout, in histograms[ring], or stops counting if histograms is NULL.
+ *
+ * Parameter:
+ * histograms - one histogram per ring
+ *
+ */
+void set_echo_histograms(struct histogram histograms[]) {
+	builtin_bank.echo_histograms = histograms;
+}
+
+/**
+ * Counts the longest gap between polls of the echo pins in each later measurement of
+ * the built in wheel in histogram, or stops counting if histogram is NULL.
+ *
+ * Parameter:
+ * histogram - histogram to count in
+ *
+ */
+void set_poll_gap_histogram(struct histogram *histogram) {
+	builtin_bank.poll_gaps = histogram;
+}
+
+/**
+ * Returns the # of rings with sensors attached.
+ *
+ */
+size_t get_ring_ct() {
+	return RING_CT;
+}
+
+/**
+ * Reads a trigger schedule from STR, where slots are separated by '/' and the rings
+ * fired together in a slot by ','. For example, "0,2,4/1,3,5" fires the even rings,
+ * then STAGGER_US later the odd rings. Returns false if STR is malformed.
+ *
+ * Replaces:
+ * schedule
+ *
+ * Parameters:
+ * STR - schedule to read
+ * STAGGER_US - time between the start of each slot
+ * schedule - schedule to fill
+ *
+ */
+bool parse_trigger_schedule(const char *STR, const unsigned STAGGER_US, struct trigger_schedule *schedule) {
+	schedule->slot_ct = 1;
+	schedule->ring_cts[0] = 0;
+	schedule->stagger_us = STAGGER_US;
+	while (*STR) {
+		char *end;
+		long ring = strtol(STR, &end, 10);
+		size_t slot = schedule->slot_ct - 1;
+		if (end == STR || ring < 0 || ring >= RING_CT || schedule->ring_cts[slot] == MAX_RINGS) {
+			return false;
 		}
+		schedule->rings[slot][schedule->ring_cts[slot]++] = ring;
+		if (*end == '/') {
+			if (schedule->slot_ct == MAX_TRIGGER_SLOTS) {
+				return false;
+			}
+			schedule->ring_cts[schedule->slot_ct++] = 0;
+		} else if (*end != ',' && *end != '\0') {
+			return false;
+		}
+		STR = *end ? end + 1 : end;
 	}
-	elapsed_sec = (end - start) / CLOCKS_PER_SEC;
- 
+	return true;
+}
+
+/* progress of one ring within measure_bank_cm */
+enum echo_state {
+	ECHO_IDLE,
+	ECHO_WAIT_RISE,
+	ECHO_WAIT_FALL,
+	ECHO_DONE
+};
+
+/* rings of a bank being measured together by measure_bank_cm */
+struct echo_round {
+	const struct sensor_bank *bank;
+	const struct trigger_schedule *schedule;
+	const bool *due;
+	float *distances;
+	enum echo_state states[MAX_RINGS];
+	/* time each ring's trigger pulse ended, and its echo pin went high */
+	uint64_t fired_ns[MAX_RINGS];
+	uint64_t rise_ns[MAX_RINGS];
+	/* # of rings fired whose echo is not in */
+	size_t pending_ct;
+	size_t next_slot;
+	uint64_t start_ns;
+};
+
+/* longest an echo pin stays high within MAX_ULTRASONIC_RANGE_CM */
+uint64_t get_max_echo_ns() {
+	return (uint64_t) 2 * MAX_ULTRASONIC_RANGE_CM * 1000000000 / SOUND_SPEED_CM_PER_SEC;
+}
+
+/**
+ * Returns true iff the next slot of a round should fire: once its stagger has passed, or
+ * sooner if every echo is in.
+ *
+ * Parameters:
+ * round - round in progress
+ * NOW_NS - current time
+ *
+ */
+bool is_slot_due(const struct echo_round *round, const uint64_t NOW_NS) {
+	return round->next_slot < round->schedule->slot_ct &&
+		(round->pending_ct == 0 || NOW_NS >= round->start_ns + (uint64_t) round->next_slot * round->schedule->stagger_us * 1000);
+}
+
+/**
+ * Fires every due ring of the next slot of a round together.
+ *
+ * Replaces:
+ * round
+ *
+ * Parameter:
+ * round - round in progress
+ *
+ */
+void fire_next_slot(struct echo_round *round) {
+	const struct sensor_bank *bank = round->bank;
+	const size_t *rings = round->schedule->rings[round->next_slot];
+	size_t ring_ct = round->schedule->ring_cts[round->next_slot];
+	for (size_t i = 0; i < ring_ct; i++) {
+		if (rings[i] < bank->ring_ct && (round->due == NULL || round->due[rings[i]])) {
+			gpio_write(bank->trigger_pins[rings[i]], true);
+		}
+	}
+	gpio_delay_us(10);
+	uint64_t now_ns = get_monotonic_ns();
+	for (size_t i = 0; i < ring_ct; i++) {
+		if (rings[i] >= bank->ring_ct || (round->due != NULL && !round->due[rings[i]])) {
+			continue;
+		}
+		gpio_write(bank->trigger_pins[rings[i]], false);
+		if (round->states[rings[i]] == ECHO_IDLE) {
+			round->states[rings[i]] = ECHO_WAIT_RISE;
+			round->fired_ns[rings[i]] = now_ns;
+			round->pending_ct++;
+		}
+	}
+	round->next_slot++;
+}
+
+/**
+ * Notes a ring's distance, or -1 if out of range, and records its ping if the bank
+ * records pings.
+ *
+ * Replaces:
+ * round
+ *
+ * Parameters:
+ * round - round in progress
+ * RING - ring whose echo is in
+ * ECHO_NS - time the echo pin was high, or 0 if out of range
+ * DONE_NS - time the echo ended, or timed out
+ *
+ */
+void finish_echo(struct echo_round *round, const size_t RING, const uint64_t ECHO_NS, const uint64_t DONE_NS) {
+	const struct sensor_bank *bank = round->bank;
 	/* has to travel both ways, so divide by 2 */
-	return elapsed_sec * SOUND_SPEED_CM_PER_SEC / 2;
+	round->distances[RING] = ECHO_NS > 0 ? ECHO_NS / 1e9 * SOUND_SPEED_CM_PER_SEC / 2 : -1;
+	round->states[RING] = ECHO_DONE;
+	round->pending_ct--;
+	if (bank->trace_writer != NULL) {
+		write_trace_record(bank->trace_writer, RING, round->fired_ns[RING], ECHO_NS, round->distances[RING]);
+	}
+	if (bank->echo_histograms != NULL) {
+		record_histogram(&bank->echo_histograms[RING], DONE_NS - round->fired_ns[RING]);
+	}
+}
+
+/**
+ * Marks every ring whose echo has not started, or not ended, in time as out of range.
+ *
+ * Replaces:
+ * round
+ *
+ * Parameters:
+ * round - round in progress
+ * NOW_NS - current time
+ *
+ */
+void expire_echoes(struct echo_round *round, const uint64_t NOW_NS) {
+	for (size_t ring = 0; ring < round->bank->ring_ct; ring++) {
+		if ((round->states[ring] == ECHO_WAIT_RISE && NOW_NS - round->fired_ns[ring] > ECHO_START_TIMEOUT_NS) ||
+			(round->states[ring] == ECHO_WAIT_FALL && NOW_NS - round->rise_ns[ring] > get_max_echo_ns())) {
+			finish_echo(round, ring, 0, NOW_NS);
+		}
+	}
 }
 
+/**
+ * Returns the time by which a round next needs attention: when its next slot fires, or
+ * an echo in flight times out.
+ *
+ * Parameter:
+ * round - round in progress
+ *
+ */
+uint64_t get_round_deadline(const struct echo_round *round) {
+	uint64_t deadline_ns = UINT64_MAX;
+	if (round->next_slot < round->schedule->slot_ct) {
+		deadline_ns = round->start_ns + (uint64_t) round->next_slot * round->schedule->stagger_us * 1000;
+	}
+	for (size_t ring = 0; ring < round->bank->ring_ct; ring++) {
+		uint64_t timeout_ns = UINT64_MAX;
+		if (round->states[ring] == ECHO_WAIT_RISE) {
+			timeout_ns = round->fired_ns[ring] + ECHO_START_TIMEOUT_NS + 1;
+		} else if (round->states[ring] == ECHO_WAIT_FALL) {
+			timeout_ns = round->rise_ns[ring] + get_max_echo_ns() + 1;
+		}
+		deadline_ns = timeout_ns < deadline_ns ? timeout_ns : deadline_ns;
+	}
+	return deadline_ns;
+}
 
+/**
+ * Measures a round by polling each echo pin in flight, timing its edges by when they are
+ * seen. Counts the longest gap between polls in the bank's poll gaps.
+ *
+ * Replaces:
+ * round
+ *
+ * Parameter:
+ * round - round to measure
+ *
+ */
+void poll_echoes(struct echo_round *round) {
+	const struct sensor_bank *bank = round->bank;
+	uint64_t poll_ns = round->start_ns, max_gap_ns = 0;
+	while (round->next_slot < round->schedule->slot_ct || round->pending_ct > 0) {
+		uint64_t now_ns = get_monotonic_ns();
+		max_gap_ns = now_ns - poll_ns > max_gap_ns ? now_ns - poll_ns : max_gap_ns;
+		poll_ns = now_ns;
+		if (is_slot_due(round, now_ns)) {
+			fire_next_slot(round);
+			now_ns = get_monotonic_ns();
+		}
+
+		/* collect edges of every ring in flight */
+		for (size_t ring = 0; ring < bank->ring_ct; ring++) {
+			if (round->states[ring] == ECHO_WAIT_RISE && gpio_read(bank->echo_pins[ring])) {
+				round->rise_ns[ring] = now_ns;
+				round->states[ring] = ECHO_WAIT_FALL;
+			} else if (round->states[ring] == ECHO_WAIT_FALL && !gpio_read(bank->echo_pins[ring])) {
+				finish_echo(round, ring, now_ns - round->rise_ns[ring], now_ns);
+			}
+		}
+		expire_echoes(round, now_ns);
+	}
+	if (bank->poll_gaps != NULL) {
+		record_histogram(bank->poll_gaps, max_gap_ns);
+	}
+}
+
+/**
+ * Measures a round by sleeping until an echo pin in flight changes, timing each edge by
+ * when the kernel saw it, so the thread neither spins nor times an edge late.
+ *
+ * Replaces:
+ * round
+ *
+ * Parameter:
+ * round - round to measure
+ *
+ */
+void wait_for_echoes(struct echo_round *round) {
+	const struct sensor_bank *bank = round->bank;
+	while (round->next_slot < round->schedule->slot_ct || round->pending_ct > 0) {
+		uint64_t now_ns = get_monotonic_ns();
+		if (is_slot_due(round, now_ns)) {
+			fire_next_slot(round);
+			now_ns = get_monotonic_ns();
+		}
+
+		int pins[MAX_RINGS];
+		size_t pin_ct = 0;
+		for (size_t ring = 0; ring < bank->ring_ct; ring++) {
+			if (round->states[ring] == ECHO_WAIT_RISE || round->states[ring] == ECHO_WAIT_FALL) {
+				pins[pin_ct++] = bank->echo_pins[ring];
+			}
+		}
+		uint64_t deadline_ns = get_round_deadline(round);
+		struct gpio_edge edges[2 * MAX_RINGS];
+		size_t edge_ct = gpio_wait_edges(pins, pin_ct, deadline_ns > now_ns ? deadline_ns - now_ns : 0, edges, 2 * MAX_RINGS);
+
+		for (size_t i = 0; i < edge_ct; i++) {
+			for (size_t ring = 0; ring < bank->ring_ct; ring++) {
+				/* edges from before the trigger belong to an earlier ping */
+				if (bank->echo_pins[ring] != edges[i].pin || edges[i].ns < round->fired_ns[ring]) {
+					continue;
+				}
+				if (round->states[ring] == ECHO_WAIT_RISE && edges[i].is_rising) {
+					round->rise_ns[ring] = edges[i].ns;
+					round->states[ring] = ECHO_WAIT_FALL;
+				} else if (round->states[ring] == ECHO_WAIT_FALL && !edges[i].is_rising) {
+					finish_echo(round, ring, edges[i].ns - round->rise_ns[ring], edges[i].ns);
+				}
+			}
+		}
+		expire_echoes(round, get_monotonic_ns());
+	}
+}
+
+/**
+ * Measures the distance at several rings of the built in wheel in cm, as
+ * measure_bank_cm does.
+ *
+ * Replaces:
+ * distances
+ *
+ * Parameters:
+ * schedule - order in which to fire the rings
+ * due - whether each ring should be measured, or NULL for all
+ * distances - distance of each ring
+ *
+ */
+void measure_rings_cm(const struct trigger_schedule *schedule, const bool due[], float distances[]) {
+	measure_bank_cm(&builtin_bank, schedule, due, distances);
+}
+
+/**
+ * Measures the distance at several rings of a bank in cm, overlapping their echoes. The rings of
+ * each slot in schedule fire together, and each slot fires stagger_us after the one
+ * before without waiting for earlier echoes (or as soon as they are all in, if sooner),
+ * so rings sharing a slot should be far enough apart not to hear each other. Neighbours
+ * may sit in adjacent slots as long as stagger_us covers the farthest ring's round trip,
+ * as each earlier ping is then back before the next slot fires. Rings that are not due,
+ * or not in the schedule, are left unchanged. Out of range rings get -1. If the gpio backend times
+ * edges, the thread sleeps until echoes change, and distances come from the edge times ;
+ * otherwise it polls the echo pins.
+ *
+ * Replaces:
+ * distances
+ *
+ * Parameters:
+ * bank - sensors to measure with
+ * schedule - order in which to fire the rings
+ * due - whether each ring should be measured, or NULL for all
+ * distances - distance of each ring
+ *
+ */
+void measure_bank_cm(const struct sensor_bank *bank, const struct trigger_schedule *schedule, const bool due[], float distances[]) {
+	struct echo_round round = {.bank = bank, .schedule = schedule, .due = due, .distances = distances};
+	for (size_t ring = 0; ring < MAX_RINGS; ring++) {
+		round.states[ring] = ECHO_IDLE;
+	}
+	round.start_ns = get_monotonic_ns();
+	if (gpio_has_edges()) {
+		wait_for_echoes(&round);
+	} else {
+		poll_echoes(&round);
+	}
+}
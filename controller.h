@@ -1,3 +1,52 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "trace.h"
+#include "histogram.h"
+
+/* most rings a controller can have */
+#define MAX_RINGS 16
+/* most slots in a trigger schedule */
+#define MAX_TRIGGER_SLOTS 8
+
+/* which rings measure_rings_cm fires together, and when */
+struct trigger_schedule {
+	size_t slot_ct;
+	/* rings fired together in each slot */
+	size_t ring_cts[MAX_TRIGGER_SLOTS];
+	size_t rings[MAX_TRIGGER_SLOTS][MAX_RINGS];
+	/* time between the start of consecutive slots */
+	unsigned stagger_us;
+};
+
+/* the sensors of one wheel, and where their pings are recorded */
+struct sensor_bank {
+	size_t ring_ct;
+	/* one HC-SR04 per ring, from most to least central */
+	int trigger_pins[MAX_RINGS];
+	int echo_pins[MAX_RINGS];
+	/* where every ping is recorded, if anywhere */
+	struct trace_writer *trace_writer;
+	/* where each ring's time from trigger to the end of its echo is counted, if anywhere */
+	struct histogram *echo_histograms;
+	/* where the longest gap between two polls of the echo pins in each measurement is
+	 * counted, if anywhere ; an echo edge can be timed late by up to that much. Only
+	 * counted when the gpio backend polls, as edge times come from the kernel */
+	struct histogram *poll_gaps;
+};
+
 void setup();
+void start_gpio();
+void setup_sensor_bank(const struct sensor_bank *bank);
 float measure_ring_cm(size_t ring);
+size_t get_ring_ct();
+bool parse_trigger_schedule(const char *STR, const unsigned STAGGER_US, struct trigger_schedule *schedule);
+void measure_rings_cm(const struct trigger_schedule *schedule, const bool due[], float distances[]);
+void measure_bank_cm(const struct sensor_bank *bank, const struct trigger_schedule *schedule, const bool due[], float distances[]);
+void set_trace_writer(struct trace_writer *writer);
+void set_echo_histograms(struct histogram histograms[]);
+void set_poll_gap_histogram(struct histogram *histogram);
 
+#endif
@@ -1,79 +1,92 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
 #include <stdbool.h>
 #include "controller.h"
+#include "que_to_eng.h"
+#include "calibration.h"
+#include "stream_stats.h"
+#include "histogram.h"
+#include "realtime.h"
+
+/* when each position of a ring has been measured enough */
+struct collection_limits {
+	/* fewest and most in-range readings taken at a position */
+	size_t min_samples;
+	size_t max_samples;
+	/* largest accepted 95% confidence interval half-width of a median, in position spacings */
+	float precision;
+	/* position spacing assumed before a ring's first two positions are measured */
+	float prior_spacing_cm;
+};
+
+/* longest gap between polls of the echo pin in each reading, over the whole run */
+struct histogram poll_gaps;
 
 /**
- * Fills measurements array with POINTS_TO_COLLECT of measurements.
+ * Takes readings of a ring at one position until its median is known precisely enough
+ * relative to the spacing between positions, or limits->max_samples readings were taken.
+ * Until the median is past the previous position's, limits->prior_spacing_cm stands in
+ * for the spacing, and a median which ends up short of it is warned about. Readings are
+ * summarized as they come in rather than stored. Out of range readings are dropped.
+ *
+ * Replaces:
+ * stats
  *
  * Parameters:
- * measurements - array to fill
- * POINTS_TO_COLLECT - # of points to collect
+ * stats - statistics of the position's readings
  * RING - ring index from center
+ * PREVIOUS_MEDIAN - median of the previous position, or NAN for position 0
+ * limits - when to stop
  *
  */
-void get_measurements(float *measurements[], const size_t POINTS_TO_COLLECT, const size_t RING) {
-	/* time between data collection in seconds */
-	const float SEC_BETWEEN_DATA_COLLECT = 0.1;
+void collect_position(struct stream_stats *stats, const size_t RING, const float PREVIOUS_MEDIAN, const struct collection_limits *limits) {
+	/* time between data collection in seconds ; the sensors need about 60 ms for echoes to die down */
+	const float SEC_BETWEEN_DATA_COLLECT = 0.06;
 	const int MICROSEC_IN_SEC = 1000000;
+	size_t dropped_ct = 0;
+	/* an echo edge is timed late by up to the gap between polls, so a gap is an error in distance */
+	const double CM_PER_GAP_NS = 34320 / 2 / 1e9;
+	struct histogram position_gaps = {0};
 
 	/* collect data */
 	printf("Collecting data...\n");
-	for (int i = 0; i < POINTS_TO_COLLECT; i++) {
-		(*measurements)[i] = measure_ring_cm(RING);
-		usleep(SEC_BETWEEN_DATA_COLLECT * MICROSEC_IN_SEC);
-	}
-}
+	set_poll_gap_histogram(&position_gaps);
+	init_stream_stats(stats, 0.5);
+	while (stats->sample_ct + dropped_ct < limits->max_samples) {
+		float distance_cm = measure_ring_cm(RING);
+		if (distance_cm < 0) {
+			dropped_ct++;
+		} else {
+			add_stream_sample(stats, distance_cm);
+		}
 
-/**
- * Returns the median of the array arr of length LEN.
- *
- * Parameters:
- * arr - array to find the median of
- * LEN - length of the array
- *
- */
-float get_median(float arr[], const int LEN) {
-	/* bubble sort array */
-	for (size_t i = 0; i < LEN - 1; i++) {
-		for (size_t j = i + 1; j < LEN; j++) {
-			if (arr[j] > arr[i]) {
-				float temp = arr[j];
-				arr[j] = arr[i];
-				arr[i] = temp;
-			}
+		/* the spacing is to the previous position once there is one, and the median is past it ;
+		 * otherwise no precision could be enough, and every reading would be taken */
+		float spacing_cm = isnan(PREVIOUS_MEDIAN) ? limits->prior_spacing_cm : get_stream_quantile(stats) - PREVIOUS_MEDIAN;
+		if (!(spacing_cm > 0)) {
+			spacing_cm = limits->prior_spacing_cm;
+		}
+		if (stats->sample_ct >= limits->min_samples && get_median_error(stats) < limits->precision * spacing_cm) {
+			break;
 		}
+		usleep(SEC_BETWEEN_DATA_COLLECT * MICROSEC_IN_SEC);
 	}
-
-	/* return average of middle value(s) */
-	return LEN % 2 == 0 ? (arr[LEN / 2 - 1] + arr[LEN / 2]) / 2 : arr[LEN / 2];
-}
-
-/**
- * Returns the standard deviation of the array arr of length LEN.
- *
- * Parameters:
- * arr - array to find the standard deviation of
- * LEN - length of the array
- *
- */
-float get_stddev(float arr[], const int LEN) {
-	/* get mean */
-	float mean = 0;
-	for (size_t i = 0; i < LEN; i++) {
-		mean += arr[i];
+	set_poll_gap_histogram(NULL);
+	merge_histogram(&poll_gaps, &position_gaps);
+	printf("%zu readings (%zu out of range), median %.3f +- %.3f cm.\n", stats->sample_ct, dropped_ct,
+		get_stream_quantile(stats), get_median_error(stats));
+	if (!isnan(PREVIOUS_MEDIAN) && stats->sample_ct > 0 && get_stream_quantile(stats) <= PREVIOUS_MEDIAN) {
+		printf("Warning: this median is not past the previous position's (%.3f cm). Is the ring at the right position?\n", PREVIOUS_MEDIAN);
 	}
-	mean /= LEN;
-	
-	/* get stddev */
-	float stddev = 0;
-	for (size_t i = 0; i < LEN; i++) {
-		stddev += (arr[i] - mean) * (arr[i] - mean) / LEN;
+	/* backends which time edges in the kernel do not poll */
+	if (position_gaps.count > 0) {
+		printf("Timing jitter: echo polls up to %.1f us apart at p99 (%.3f cm), %.1f us at most (%.3f cm).\n",
+			get_histogram_percentile(&position_gaps, 99) / 1e3, get_histogram_percentile(&position_gaps, 99) * CM_PER_GAP_NS,
+			position_gaps.max / 1e3, position_gaps.max * CM_PER_GAP_NS);
 	}
-	stddev = sqrt(stddev);
-	return stddev;
 }
 
 /**
@@ -147,20 +160,17 @@ bool evaluate_data(float medians[], float stddevs[], const int LEN) {
  * Gets data on a certain ring.
  *
  * Replaces:
- * zero_distance, avg_difference
+ * cal
  *
  * Parameters:
- * zero_distance - shortest distance from sensor to ring
- * avg_difference - average difference between two adjacent ring spaces
+ * cal - median distance to each position, and the boundaries between them
  * RING - current ring #
  * SUFFIX_CT - # of suffixes on the current ring
+ * limits - when to stop measuring each position
  *
  */
-void measure_ring(float *zero_distance, float *avg_difference, const int RING, const int SUFFIX_CT) {
-	/* # of data points collected for each suffix */
-	const size_t POINTS_PER_SUFFIX = 30;
-	/* this holds the data retrieved */
-	float *measurements = calloc(POINTS_PER_SUFFIX, sizeof(float));
+void measure_ring(struct ring_calibration *cal, const int RING, const int SUFFIX_CT, const struct collection_limits *limits) {
+	struct stream_stats stats;
 
 	/* these are for data for the user to evaluate */
 	float median_measurements[SUFFIX_CT];
@@ -170,44 +180,42 @@ void measure_ring(float *zero_distance, float *avg_difference, const int RING, c
 		printf("\nBeginning data collection on ring %i.\n", RING);
 		for (size_t suffix = 0; suffix < SUFFIX_CT; suffix++) {
 			/* prompt user to position correct ring */
-			printf("Set ring %i to position %li. Hit enter when ready.", RING, suffix);
+			printf("Set ring %i to position %zu. Hit enter when ready.", RING, suffix);
 			/* pause until user hits enter */
 			while (getchar() != '\n');
 
 			/* take measurements */
-			get_measurements(&measurements, POINTS_PER_SUFFIX, RING);
-			median_measurements[suffix] = get_median(measurements, POINTS_PER_SUFFIX);
-			stddev_measurements[suffix] = get_stddev(measurements, POINTS_PER_SUFFIX);
+			collect_position(&stats, RING, suffix > 0 ? median_measurements[suffix - 1] : NAN, limits);
+			median_measurements[suffix] = get_stream_quantile(&stats);
+			stddev_measurements[suffix] = get_stream_stddev(&stats);
 			printf("Done.\n");
 		}
 		/* repeat measurements if user determines them to be poor */
 		printf("\nRing %i Analysis:\n", RING);
 		repeat_measurements = evaluate_data(median_measurements, stddev_measurements, SUFFIX_CT);
+		/* positions must be measured in order of increasing distance */
+		if (!repeat_measurements && !make_calibration(cal, median_measurements, SUFFIX_CT)) {
+			printf("Positions were not measured in order of increasing distance. Please measure again.\n");
+			repeat_measurements = true;
+		}
 	}
-	
-	free(measurements);
-
-	*avg_difference = get_avg_difference(median_measurements, SUFFIX_CT);
-
-	/* for more accuracy, zero distance is set as offset from center */
-	size_t offset = SUFFIX_CT / 2;
-	*zero_distance = median_measurements[offset] - offset * *avg_difference;
 }
 
 /**
- * Saves data to file, where each row contains a zero distance and an average difference,
- * space-separated. Can also save to console if file already exists and user does not wish
- * to overwrite.
+ * Saves data to file, where each row contains a ring's # of positions followed by the
+ * median distance to each, space-separated, between a version header and a checksum.
+ * Can also save to console if file already exists and user does not wish to overwrite,
+ * or it could not be written.
  *
  * Parameters:
- * zero_distances - shortest distance from sensor to ring
- * avg_differences - average difference between two adjacent ring spaces
- * LEN - length of previous two arrays (should be equal)
+ * cals - calibration of each ring
+ * LEN - length of cals
  *
  */
-void save_data(float zero_distances[], float avg_differences[], const size_t LEN) {
+void save_data(const struct ring_calibration cals[], const size_t LEN) {
 	FILE *file;
 	const char FILENAME[] = "ring_data.txt";
+	const char TEMP_FILENAME[] = "ring_data.txt.tmp";
 	bool to_console = false;
 
 	/* if file exists, prompt if user wants to overwrite */
@@ -221,45 +229,118 @@ void save_data(float zero_distances[], float avg_differences[], const size_t LEN
 		to_console = response == 'N' || response == 'n';
 	}
 
-	/* print out data */
-	file = to_console ? stdout : fopen(FILENAME, "w");
-	for (size_t ring = 0; ring < LEN; ring++) {
-		fprintf(file, "%.3f %.3f\n", zero_distances[ring], avg_differences[ring]);
-	}
+	/* write a new file and rename it over the old, so a running driver never reads half of one */
 	if (!to_console) {
-		printf("Successfully written to %s.\n", FILENAME);
+		if ((file = fopen(TEMP_FILENAME, "w")) != NULL) {
+			bool is_saved = save_calibration(file, cals, LEN);
+			if (fclose(file) == 0 && is_saved && rename(TEMP_FILENAME, FILENAME) == 0) {
+				printf("Successfully written to %s.\n", FILENAME);
+				return;
+			}
+			remove(TEMP_FILENAME);
+		}
+		printf("Could not write to %s.\n", FILENAME);
 	}
+
+	/* print out data */
+	save_calibration(stdout, cals, LEN);
 }
 
 /**
- * Gets information about status of rings, saves found data.
+ * Gets information about status of rings, saves found data. Each position is read
+ * until the 95% confidence interval of its median is within a fraction of the spacing
+ * between positions, so quiet sensors finish quickly.
+ *
+ * Options:
+ * --precision F - largest accepted confidence interval half-width, in position spacings (default 0.05)
+ * --min-samples N - fewest readings of each position (default 10)
+ * --max-samples N - most readings of each position (default 2000)
+ * --spacing CM - position spacing assumed for position 0 of each ring (default: the
+ * 	smallest spacing in ring_data.txt, or 2)
+ * --record FILE - record every ping to a trace FILE
+ * --realtime - lock memory, pin to a CPU and run under SCHED_FIFO while measuring, as
+ * 	far as permitted, so preemption and page faults do not show up as sensor noise
+ * --rt-cpu N - CPU to pin to (default the last online CPU) ; implies --realtime
+ * --rt-priority P - SCHED_FIFO priority, 1 to 99 (default 50) ; implies --realtime
  *
  */
-int main() {
-	/* # of suffixes in each ring, from most to least central */
-	const int SUFFIXES_PER_RING[] = {4, 4, 4, 7, 3, 5};
-	/* # of rings */
-	const size_t RING_CT = sizeof(SUFFIXES_PER_RING) / sizeof(SUFFIXES_PER_RING[0]);
+int main(int argc, char *argv[]) {
+	/* # of rings ; ring i, from most to least central, holds the suffixes of slot i */
+	const size_t RING_CT = SLOT_CT;
+	struct collection_limits limits = {10, 2000, 0.05, 2.0};
+	float spacing_cm = NAN;
+	const char *record_filename = NULL;
+	struct trace_writer recorder;
+	struct realtime_settings realtime = {false, -1, DEFAULT_RT_PRIORITY};
+	struct realtime_status realtime_status;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--realtime")) {
+			realtime.is_enabled = true;
+		} else if (i + 1 == argc) {
+			break;
+		} else if (!strcmp(argv[i], "--precision")) {
+			limits.precision = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--min-samples")) {
+			limits.min_samples = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--max-samples")) {
+			limits.max_samples = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--spacing")) {
+			spacing_cm = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--record")) {
+			record_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--rt-cpu")) {
+			realtime = (struct realtime_settings) {true, atoi(argv[++i]), realtime.priority};
+		} else if (!strcmp(argv[i], "--rt-priority")) {
+			realtime = (struct realtime_settings) {true, realtime.cpu, atoi(argv[++i])};
+		}
+	}
+	if (limits.min_samples < 1 || limits.max_samples < limits.min_samples || !(limits.precision > 0)) {
+		printf("Expected 1 <= min samples <= max samples, and a positive precision.\n");
+		exit(1);
+	}
 
-	/* these two values are the "goal values", which will be saved in a file */
-	float zero_distances[RING_CT];
-	float avg_differences[RING_CT];
+	/* setup pins for raspberry pi */
+	setup();
+	if (record_filename != NULL) {
+		if (!open_trace_writer(&recorder, record_filename)) {
+			printf("Could not create trace %s.\n", record_filename);
+			exit(1);
+		}
+		set_trace_writer(&recorder);
+	}
+	enter_realtime(&realtime, &realtime_status);
+	print_realtime_status(&realtime_status, stdout);
+
+	/* these are the "goal values", which will be saved in a file */
+	struct ring_calibration cals[RING_CT];
+	/* an earlier calibration gives the spacing to expect */
+	struct ring_calibration previous_cals[RING_CT];
+	bool has_previous = load_calibration("ring_data.txt", previous_cals, SUFFIX_CTS, RING_CT);
 
-	printf("Welcome to the ring data collector. This program expects %li rings, with ", RING_CT);
+	printf("Welcome to the ring data collector. This program expects %zu rings, with ", RING_CT);
 	for (size_t ring = 0; ring < RING_CT - 1; ring++) {
-		printf("%i, ", SUFFIXES_PER_RING[ring]);
+		printf("%zu, ", SUFFIX_CTS[ring]);
 	}
-	printf("and %i suffixes on each ring going outward. ", SUFFIXES_PER_RING[RING_CT - 1]);
+	printf("and %zu suffixes on each ring going outward. ", SUFFIX_CTS[RING_CT - 1]);
 	printf("If this information is incorrect, please exit the program.\n");
 	printf("The program will ask to adjust each ring for positions starting at 0. ");
 	printf("0 represents the closest part of the ring to the sensor, and each number after is the next farthest.\n");
 	/* collect data */
 	for (size_t ring = 0; ring < RING_CT; ring++) {
-		measure_ring(&zero_distances[ring], &avg_differences[ring], ring, SUFFIXES_PER_RING[ring]);
+		limits.prior_spacing_cm = !isnan(spacing_cm) ? spacing_cm : has_previous ? previous_cals[ring].min_spacing : 2.0;
+		measure_ring(&cals[ring], ring, SUFFIX_CTS[ring], &limits);
 	}
 
 	/* save data and exit */
-	save_data(zero_distances, avg_differences, RING_CT);
+	if (poll_gaps.count > 0) {
+		print_jitter(stdout, "Echo poll gaps over every reading", &poll_gaps);
+	}
+	if (record_filename != NULL) {
+		set_trace_writer(NULL);
+		close_trace_writer(&recorder);
+		printf("Recorded %zu pings to %s\n", recorder.record_ct, record_filename);
+	}
+	save_data(cals, RING_CT);
 	return 0;
 }
 
@@ -1,116 +1,448 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
 #include "controller.h"
-#include "translator.h"
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "scheduler.h"
+#include "timing.h"
+#include "calibration.h"
+#include "calibration_watch.h"
+#include "wheel.h"
+#include "trace.h"
+#include "driver_stats.h"
+#include "wheel_pool.h"
+#include "renderer.h"
+#include "realtime.h"
 
+/* cleared by SIGINT / SIGTERM to leave the main loop */
+volatile sig_atomic_t running = 1;
 
 /**
- * Reads in data from FILENAME (expected: ring_data.txt).
+ * Signal handler which asks the main loop to stop.
  *
- * Replaces:
- * zero_distances, avg_differences
+ * Parameter:
+ * signal - signal received
+ *
+ */
+void stop_running(int signal) {
+	running = 0;
+}
+
+/**
+ * Feeds every ping of a recorded trace through the wheel as fast as possible, showing
+ * the word whenever it changes, then prints the replay rate. Returns false if the trace
+ * could not be read.
  *
  * Parameters:
- * zero_distances - shortest distance from sensor to ring
- * avg_differences - average difference between two adjacent ring spaces
- * RING_CT - length of previous two arrays (should be equal)
+ * wheel - wheel to decode with
+ * FILENAME - trace to replay
+ * lexicon - verbs beyond the built in ones, or NULL
+ * ROOT - key root of the verb on the wheel (see find_key_root)
+ * IN_PLACE - whether to redraw each word over the last
  *
  */
-void get_data(float *zero_distances[], float *avg_differences, const size_t RING_CT) {
-	const char FILENAME[] = "ring_data.txt";
-	FILE *file;
-
-	/* exit if file could not be found */
-	if ((file = fopen(FILENAME, "r")) == NULL) {
-		printf("Could not find %s. Please run data_collector before this program.\n", FILENAME);
-		exit(1);
+bool replay_trace(struct wheel *wheel, const char *FILENAME, const struct lexicon *lexicon, const size_t ROOT, const bool IN_PLACE) {
+	struct trace trace;
+	if (!map_trace(&trace, FILENAME)) {
+		return false;
 	}
 
-	/* collect data from file if it exists */
-	for (size_t ring = 0; ring < RING_CT; ring++) {
-		if (fscanf("%f %f", &((*zero_distances)[ring]), &((*avg_differences)[ring])) != 2) {
-			printf("Insufficient data in %s\n", FILENAME);
-			exit(1);
+	word_key shown_key = 0;
+	size_t render_ct = 0, skipped_ct = 0;
+	/* rings pinged in the current frame ; each ring is pinged at most once a frame */
+	uint32_t frame_rings = 0;
+	uint64_t start_ns = get_monotonic_ns();
+	for (size_t i = 0; i < trace.record_ct && running; i++) {
+		const struct trace_record *record = &trace.records[i];
+		if (record->ring >= wheel->ring_ct) {
+			skipped_ct++;
+			continue;
 		}
-	}
+		decode_reading(wheel, record->ring, record->distance_cm);
+		frame_rings |= 1u << record->ring;
 
+		/* like the live loop, only look at the word once the frame is over */
+		if (i + 1 < trace.record_ct && trace.records[i + 1].ring < wheel->ring_ct &&
+			!(frame_rings & 1u << trace.records[i + 1].ring)) {
+			continue;
+		}
+		frame_rings = 0;
 
-	fclose(file);
+		/* only show the word when it changes */
+		word_key key = make_word_key(ROOT, wheel->ring_idxs);
+		if (render_ct == 0 || key != shown_key) {
+			render_word(lexicon, key, IN_PLACE && render_ct > 0, NULL, NULL);
+			shown_key = key;
+			render_ct++;
+		}
+	}
+	uint64_t elapsed_ns = get_monotonic_ns() - start_ns;
 
+	printf("Replayed %zu pings (%zu of unknown rings) in %.2f ms, %.0f pings per second\n", trace.record_ct, skipped_ct,
+		elapsed_ns / 1e6, elapsed_ns ? trace.record_ct * 1e9 / elapsed_ns : 0);
+	printf("Rendered %zu words\n", render_ct);
+	unmap_trace(&trace);
+	return true;
+}
+
+/**
+ * Serves every wheel of a wheel file from one process until SIGINT or SIGTERM, then
+ * prints what each worker and wheel did. Returns the exit status.
+ *
+ * Parameters:
+ * FILENAME - wheel file (see load_wheel_configs)
+ * CPU_STR - CPUs to pin workers to, such as "0-3", or NULL for one per online CPU
+ * settings - settings every wheel shares
+ *
+ */
+int run_wheels(const char *FILENAME, const char *CPU_STR, const struct wheel_pool_settings *settings) {
+	static struct wheel_config configs[MAX_WHEELS];
+	static struct wheel_pool pool;
+	size_t config_ct;
+	int cpus[MAX_WHEEL_WORKERS];
+	size_t cpu_ct = 0;
+	if (!load_wheel_configs(FILENAME, settings->lexicon, configs, &config_ct) || config_ct == 0) {
+		printf("Could not read wheels from %s.\n", FILENAME);
+		return 1;
+	}
+	if (CPU_STR != NULL && (cpu_ct = parse_cpu_list(CPU_STR, cpus, MAX_WHEEL_WORKERS)) == 0) {
+		printf("Invalid CPU list %s\n", CPU_STR);
+		return 1;
+	}
+	for (long online_ct = sysconf(_SC_NPROCESSORS_ONLN); CPU_STR == NULL && cpu_ct < MAX_WHEEL_WORKERS && cpu_ct < online_ct; cpu_ct++) {
+		cpus[cpu_ct] = cpu_ct;
+	}
+	cpu_ct = cpu_ct ? cpu_ct : 1;
 
+	/* only this thread takes the stop signals ; the workers keep them blocked */
+	sigset_t stop_signals, old_mask;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+	if (settings->rt_priority > 0 && !lock_memory()) {
+		printf("Could not lock memory ; page faults may still delay pings.\n");
+	}
+	start_gpio();
+	if (!start_wheel_pool(&pool, configs, config_ct, cpus, cpu_ct, settings)) {
+		return 1;
+	}
+	while (running) {
+		sigsuspend(&old_mask);
+	}
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	stop_wheel_pool(&pool);
+	print_wheel_pool_stats(&pool, stdout);
+	return 0;
 }
 
 /**
- * Continuously read input from rings and show the word as well as the translation.
+ * Continuously read input from rings and show the word as well as the translation
+ * whenever the word changes. Rings are sampled on a timer: a ring that is being turned is sampled every frame,
+ * while an idle ring backs off to the idle rate. Stops on SIGINT, printing scheduler
+ * statistics.
+ *
+ * Options:
+ * --rate HZ - target frame rate (default 30)
+ * --idle-rate HZ - lowest sampling rate of an idle ring (default 1)
+ * --schedule SLOTS - rings fired together, e.g. "0,2,4/1,3,5" (the default) fires
+ * 	the even rings, then the odd rings ; adjacent rings should not share a slot
+ * --stagger US - longest time between trigger slots (default 3000, about 50 cm of echo)
+ * --sequential - measure one ring at a time instead of following the schedule
+ * --filter-window N - # of readings in each ring's running median (default 3)
+ * --hysteresis F - how far past the boundary between positions, in position spacings,
+ * 	the median must go to change position (default 0.15)
+ * --record FILE - record every ping to a trace FILE
+ * --replay FILE - decode the pings of a trace FILE instead of reading the sensors
+ * --stats FILE - export stage timings and reading counters to FILE, for driver_stat to show
+ * --stats-interval S - seconds between exports (default 1)
+ * --root ROOT - verb on the wheel (default wayk'u)
+ * --lexicon FILE - verbs of the lexicon FILE may be on the wheel, or any of the --wheels,
+ * 	besides the built in ones ; their words are translated as they are shown, rather than looked up
+ * --publish NAME - publish the wheel's state each frame to the POSIX shared memory
+ * 	segment NAME, such as /muyuchina, for wheel_state and other readers
+ * --wheels FILE - serve every wheel of FILE instead of the built in one (see
+ * 	load_wheel_configs) ; each wheel's stats go to the --stats FILE.NAME, and its state
+ * 	to the --publish segment NAME.WHEEL
+ * --cpus LIST - CPUs to pin the wheel workers to, such as "0-3" (default one per online CPU)
+ * --realtime - lock memory, pin the sensing thread to a CPU and run it under SCHED_FIFO,
+ * 	as far as permitted ; with --wheels, each worker runs under SCHED_FIFO on its CPU
+ * --rt-cpu N - CPU to pin the sensing thread to (default the last online CPU) ; implies --realtime
+ * --rt-priority P - SCHED_FIFO priority, 1 to 99 (default 50) ; implies --realtime
  *
  */
-int main() {
-	/* TODO - Update this to take input as well */
-	const char[] ROOT = "wayk'u";
-	/* # of rings in use */
-	const size_t RING_CT = 6;
-	float *zero_distances = calloc(RING_CT, sizeof(float));
-	float *avg_differences = calloc(RING_CT, sizeof(float));
-	const float MIN_ULTRASONIC_CM = 2.0;
-	const float MAX_ULTRASONIC_CM = 400.0;
-	/* all suffixes */
-	const char *SUFFIXES[][7] = {
-		{"ri", "rpa", "rpari", ""},
-		{"ku", "mu", "kamu", ""},
-		{"chka", "lla", "chkalla", ""},
-		{"ni", "nki", "n", "yku", "nchik", "nkichik", "nku"},
-		{"ña", "raq", ""},
-		{"pis", "taq", "sina", "puni", ""}
-	};
-	/* # of suffixes per ring */
-	const size_t SUFFIX_CTS[] = {4, 4, 4, 7, 3, 5};
-	/* indeces within rings */
-	size_t ring_idxs[] = {0, 0, 0, 0, 0, 0};
+int main(int argc, char *argv[]) {
+	double frame_hz = 30, idle_hz = 1;
+	const char *schedule_str = "0,2,4/1,3,5";
+	unsigned stagger_us = 3000;
+	bool sequential = false;
+	size_t filter_window = 3;
+	float hysteresis = 0.15;
+	const char *record_filename = NULL, *replay_filename = NULL, *stats_filename = NULL, *publish_name = NULL;
+	double stats_interval_sec = 1;
+	const char *wheels_filename = NULL, *cpu_str = NULL;
+	const char *root_name = "wayk'u", *lexicon_filename = NULL;
+	struct realtime_settings realtime = {false, -1, DEFAULT_RT_PRIORITY};
+	struct realtime_status realtime_status;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--sequential")) {
+			sequential = true;
+		} else if (!strcmp(argv[i], "--realtime")) {
+			realtime.is_enabled = true;
+		} else if (i + 1 == argc) {
+			break;
+		} else if (!strcmp(argv[i], "--rate")) {
+			frame_hz = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--idle-rate")) {
+			idle_hz = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--schedule")) {
+			schedule_str = argv[++i];
+		} else if (!strcmp(argv[i], "--stagger")) {
+			stagger_us = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--filter-window")) {
+			filter_window = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--hysteresis")) {
+			hysteresis = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--record")) {
+			record_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--replay")) {
+			replay_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--stats")) {
+			stats_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--stats-interval")) {
+			stats_interval_sec = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--root")) {
+			root_name = argv[++i];
+		} else if (!strcmp(argv[i], "--lexicon")) {
+			lexicon_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--publish")) {
+			publish_name = argv[++i];
+		} else if (!strcmp(argv[i], "--wheels")) {
+			wheels_filename = argv[++i];
+		} else if (!strcmp(argv[i], "--cpus")) {
+			cpu_str = argv[++i];
+		} else if (!strcmp(argv[i], "--rt-cpu")) {
+			realtime = (struct realtime_settings) {true, atoi(argv[++i]), realtime.priority};
+		} else if (!strcmp(argv[i], "--rt-priority")) {
+			realtime = (struct realtime_settings) {true, realtime.cpu, atoi(argv[++i])};
+		}
+	}
+
+	/* verbs beyond the built in ones, which the wheel's root may be one of */
+	static struct lexicon loaded_lexicon;
+	const struct lexicon *lexicon = NULL;
+	if (lexicon_filename != NULL) {
+		if (!load_lexicon(&loaded_lexicon, lexicon_filename)) {
+			printf("Could not load lexicon %s.\n", lexicon_filename);
+			exit(1);
+		}
+		lexicon = &loaded_lexicon;
+	}
+	/* key root of the verb on the wheel */
+	const long ROOT = find_key_root(lexicon, root_name);
+	if (ROOT < 0) {
+		printf("Unknown root %s%s.\n", root_name, lexicon == NULL ? " ; give a --lexicon to use verbs beyond the built in ones" : "");
+		exit(1);
+	}
+	/* # of rings in use ; ring i holds the suffixes of slot i */
+	const size_t RING_CT = SLOT_CT;
+	const char CALIBRATION_FILENAME[] = "ring_data.txt";
+	struct wheel wheel = {.ring_ct = RING_CT, .calibration = calloc(1, sizeof(struct calibration_set))};
+	if (wheel.calibration == NULL) {
+		printf("Could not allocate the calibration.\n");
+		return 1;
+	}
+	struct calibration_watch watch;
+	bool is_watching = false;
+	struct scheduler sched;
+	struct trigger_schedule triggers;
+	struct trace_writer recorder;
+	bool due[RING_CT];
+	float distances[RING_CT];
+	/* time spent in each stage of each frame */
+	struct driver_stats stats;
+	/* where each frame's state is published, and what was published last */
+	struct live_writer publisher;
+	bool is_publishing = false;
+	struct wheel_snapshot snapshot = {0};
+	/* last word shown, and # of times a word was shown */
+	word_key shown_key = 0;
+	size_t render_ct = 0;
+	/* writes words on its own thread, so slow output never delays sensing */
+	static struct renderer renderer;
+	/* only a terminal can be redrawn in place ; pipes get one line pair per change */
+	const bool IN_PLACE = isatty(STDOUT_FILENO);
 	
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		if (!init_filter(&wheel.filters[ring], filter_window, hysteresis)) {
+			printf("Filter window must be 1 to %i readings, and hysteresis below 0.5.\n", MAX_FILTER_WINDOW);
+			exit(1);
+		}
+	}
+
+	/* no SA_RESTART, so a signal wakes the scheduler up */
+	struct sigaction action = {.sa_handler = stop_running};
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	if (wheels_filename != NULL) {
+		if (sequential || record_filename != NULL || replay_filename != NULL) {
+			printf("--sequential, --record and --replay only work with the built in wheel.\n");
+			exit(1);
+		}
+		struct wheel_pool_settings settings = {frame_hz, idle_hz, schedule_str, stagger_us, filter_window, hysteresis, stats_filename,
+			stats_interval_sec, publish_name, realtime.is_enabled ? realtime.priority : 0, lexicon};
+		return run_wheels(wheels_filename, cpu_str, &settings);
+	}
+
+	/* get data which should be saved from data collection program */
+	if (!load_calibration(CALIBRATION_FILENAME, wheel.calibration->cals, SUFFIX_CTS, RING_CT)) {
+		printf("Could not read %s. Please run data_collector before this program.\n", CALIBRATION_FILENAME);
+		exit(1);
+	}
+	/* a trace needs no sensors */
+	if (replay_filename != NULL) {
+		if (!replay_trace(&wheel, replay_filename, lexicon, ROOT, IN_PLACE)) {
+			printf("Could not read trace %s.\n", replay_filename);
+			exit(1);
+		}
+		return 0;
+	}
+
 	/* setup pins for raspberry pi */
 	setup();
+	if (get_ring_ct() < RING_CT) {
+		printf("Expected %zu ring sensors, but only %zu are wired.\n", RING_CT, get_ring_ct());
+		exit(1);
+	}
+	if (!parse_trigger_schedule(schedule_str, stagger_us, &triggers)) {
+		printf("Invalid trigger schedule %s\n", schedule_str);
+		exit(1);
+	}
+	if (record_filename != NULL) {
+		if (!open_trace_writer(&recorder, record_filename)) {
+			printf("Could not create trace %s.\n", record_filename);
+			exit(1);
+		}
+		set_trace_writer(&recorder);
+	}
+	/* pick up recalibrations while running */
+	if (!(is_watching = start_calibration_watch(&watch, CALIBRATION_FILENAME, SUFFIX_CTS, RING_CT))) {
+		printf("Could not watch %s ; recalibrating will need a restart.\n", CALIBRATION_FILENAME);
+	}
 
-	/* get data which should be saved from data collection program */
-	get_data(&zero_distances, &avg_differences);
+	init_driver_stats(&stats, RING_CT);
+	set_echo_histograms(stats.echo_waits);
+	set_poll_gap_histogram(&stats.poll_gaps);
+
+	if (!init_scheduler(&sched, RING_CT, frame_hz, idle_hz)) {
+		printf("Could not start scheduler at %.2f Hz with idle rate %.2f Hz.\n", frame_hz, idle_hz);
+		exit(1);
+	}
+	if (publish_name != NULL && !(is_publishing = open_live_state(&publisher, publish_name))) {
+		printf("Could not publish to shared memory %s ; only stdout will show the word.\n", publish_name);
+	}
+	if (!start_renderer(&renderer, NULL, IN_PLACE, NULL, lexicon, stats_filename)) {
+		printf("Could not start the render thread.\n");
+		exit(1);
+	}
+	/* only this thread senses, so the render and calibration threads are started first and stay as they are */
+	enter_realtime(&realtime, &realtime_status);
 
 	/* main loop */
-	/* TODO? Add way to exit. Maybe not necessary. */
-	while (1) {
-		/* get rings */
-		char *rings[RING_CT];
+	while (running) {
+		if (wait_for_frame(&sched, due) == 0) {
+			continue;
+		}
+
+		/* swap in a new calibration between frames */
+		struct calibration_set *calibration = is_watching ? take_calibration(&watch) : NULL;
+		if (calibration != NULL) {
+			free(wheel.calibration);
+			wheel.calibration = calibration;
+		}
+
+		/* get due rings */
+		uint64_t frame_start_ns = get_monotonic_ns(), sense_ns = 0, decode_ns = 0;
+		if (!sequential) {
+			measure_rings_cm(&triggers, due, distances);
+			sense_ns = get_monotonic_ns() - frame_start_ns;
+		}
 		for (size_t ring = 0; ring < RING_CT; ring++) {
-			float distance_cm = measure_ring_cm(ring);
-			if (MIN_ULTRASONIC_CM < distance_cm && distance_cm < MAX_ULTRASONIC_CM) {
-				size_t ring_pos = 0;
-				while ((ring_pos + 0.5) * avg_differences[ring] < distance_cm - zero_distances[ring]) {
-					ring_pos++;
-				}
-				/* only update if in range */
-				if (ring_pos < SUFFIX_CTS[ring]) {
-					ring_idxs[ring] = ring_pos;
-				}
-				rings[ring] = SUFFIXES[ring][ring_idxs[ring]];
+			if (!due[ring]) {
+				continue;
 			}
+			uint64_t start_ns = get_monotonic_ns();
+			float distance_cm = distances[ring];
+			if (sequential) {
+				distance_cm = measure_ring_cm(ring);
+				sense_ns += get_monotonic_ns() - start_ns;
+				start_ns = get_monotonic_ns();
+			}
+			report_sample(&sched, ring, decode_reading(&wheel, ring, distance_cm));
+			decode_ns += get_monotonic_ns() - start_ns;
 		}
-		char *translation = translate(ROOT, rings);
+		record_histogram(&stats.stages[STAGE_SENSE], sense_ns);
+		record_histogram(&stats.stages[STAGE_DECODE], decode_ns);
 
-		/* print original Quechua word */
-		printf("Quechua word: %s", ROOT);
-		for (size_t ring = 0; ring < SUFFIX_CT; ring++) {
-			printf("%s",rings[ring]);
+		/* only show the word when it changes */
+		word_key key = make_word_key(ROOT, wheel.ring_idxs);
+		flush_words(&renderer);
+		if (render_ct == 0 || key != shown_key) {
+			submit_word(&renderer, key);
+			shown_key = key;
+			render_ct++;
 		}
-		printf("\n");
-
-		/* translate and print */
-		printf("Translation: %s\n", translation);
+		if (is_publishing) {
+			fill_wheel_snapshot(&wheel, lexicon, key, frame_start_ns, &snapshot);
+			publish_snapshot(publisher.state, &snapshot);
+		}
+		uint64_t frame_end_ns = get_monotonic_ns();
+		record_histogram(&stats.stages[STAGE_FRAME], frame_end_ns - frame_start_ns);
+		stats.frame_ct++;
 
-        	/* clean up */
-        	free(translation);
+		/* export between frames, so readers see each frame whole ; the render thread writes the file */
+		if (stats_filename != NULL && frame_end_ns - stats.export_ns >= stats_interval_sec * 1e9) {
+			count_readings(&stats, &wheel);
+			copy_render_stats(&renderer, &stats);
+			stats.wake_late = sched.wake_late_ns;
+			export_stats(&renderer, &stats);
+		}
 	}
 
 	/* clean up and exit */
-	free(zero_distances);
-	free(avg_differences);
+	set_echo_histograms(NULL);
+	set_poll_gap_histogram(NULL);
+	stop_renderer(&renderer);
+	count_readings(&stats, &wheel);
+	copy_render_stats(&renderer, &stats);
+	stats.wake_late = sched.wake_late_ns;
+	if (stats_filename != NULL && !save_driver_stats(&stats, stats_filename)) {
+		printf("Could not write stats to %s\n", stats_filename);
+	}
+	print_scheduler_stats(&sched, stdout);
+	print_driver_stats(&stats, stdout);
+	print_realtime_status(&realtime_status, stdout);
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		print_filter_stats(&wheel.filters[ring], ring, stdout);
+	}
+	close_scheduler(&sched);
+	if (is_publishing) {
+		close_live_state(&publisher);
+	}
+	if (is_watching) {
+		stop_calibration_watch(&watch);
+		printf("Calibration: %zu reloads, %zu rejected\n", atomic_load(&watch.load_ct), atomic_load(&watch.reject_ct));
+	}
+	free(wheel.calibration);
+	if (record_filename != NULL) {
+		set_trace_writer(NULL);
+		close_trace_writer(&recorder);
+		printf("Recorded %zu pings to %s\n", recorder.record_ct, record_filename);
+	}
 	return 0;
 }
 
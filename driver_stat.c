@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "driver_stats.h"
+#include "timing.h"
+
+/* cleared by SIGINT / SIGTERM to stop watching */
+volatile sig_atomic_t running = 1;
+
+/**
+ * Signal handler which stops watching.
+ *
+ * Parameter:
+ * signal - signal received
+ *
+ */
+void stop_running(int signal) {
+	running = 0;
+}
+
+/**
+ * Shows the stats a driver exports with --stats, without disturbing it. Stats are
+ * read from the file the driver renames into place, so they are always whole.
+ *
+ * Usage: driver_stat FILE [--watch S]
+ *
+ * Options:
+ * --watch S - show the stats again every S seconds, in place, until interrupted
+ *
+ */
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Usage: %s FILE [--watch S]\n", argv[0]);
+		return 1;
+	}
+	const char *FILENAME = argv[1];
+	double watch_sec = argc > 3 && !strcmp(argv[2], "--watch") ? atof(argv[3]) : 0;
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	struct driver_stats stats;
+	while (running) {
+		if (!load_driver_stats(&stats, FILENAME)) {
+			printf("Could not read stats from %s.\n", FILENAME);
+			return 1;
+		}
+		if (watch_sec > 0) {
+			/* clear the screen and start at the top */
+			printf("\033[H\033[J");
+		}
+		print_driver_stats(&stats, stdout);
+		printf("Exported %.1f s ago\n", (get_monotonic_ns() - stats.export_ns) / 1e9);
+		fflush(stdout);
+		if (watch_sec <= 0) {
+			break;
+		}
+		usleep(watch_sec * 1e6);
+	}
+	return 0;
+}
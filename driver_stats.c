@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include "driver_stats.h"
+#include "timing.h"
+
+/* name of each stage, in the order of enum driver_stage */
+const char *const STAGE_NAMES[STAGE_CT] = {"sense", "decode", "translate", "render", "frame", "lag"};
+
+/**
+ * Sets up empty stats, starting now.
+ *
+ * Replaces:
+ * stats
+ *
+ * Parameters:
+ * stats - stats to set up
+ * RING_CT - # of rings, at most MAX_STATS_RINGS
+ *
+ */
+void init_driver_stats(struct driver_stats *stats, const size_t RING_CT) {
+	memset(stats, 0, sizeof(*stats));
+	memcpy(stats->magic, DRIVER_STATS_MAGIC, sizeof(stats->magic));
+	stats->version = DRIVER_STATS_VERSION;
+	stats->ring_ct = RING_CT < MAX_STATS_RINGS ? RING_CT : MAX_STATS_RINGS;
+	stats->start_ns = get_monotonic_ns();
+	stats->export_ns = stats->start_ns;
+}
+
+/**
+ * Writes a snapshot of stats to FILENAME. The snapshot is written beside it, then renamed
+ * over it, so a reader never sees a partial one. Returns false if it could not be written.
+ *
+ * Replaces:
+ * stats->export_ns
+ *
+ * Parameters:
+ * stats - stats to write
+ * FILENAME - file to write
+ *
+ */
+bool save_driver_stats(struct driver_stats *stats, const char *FILENAME) {
+	char temp_filename[FILENAME_MAX];
+	FILE *file;
+	snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", FILENAME);
+	if ((file = fopen(temp_filename, "wb")) == NULL) {
+		return false;
+	}
+	stats->export_ns = get_monotonic_ns();
+	bool is_written = fwrite(stats, sizeof(*stats), 1, file) == 1;
+	is_written = fclose(file) == 0 && is_written;
+	return is_written && rename(temp_filename, FILENAME) == 0;
+}
+
+/**
+ * Reads a snapshot written by save_driver_stats. Returns false if the file is missing,
+ * or is not a stats file of this version.
+ *
+ * Replaces:
+ * stats
+ *
+ * Parameters:
+ * stats - stats to fill
+ * FILENAME - file to read
+ *
+ */
+bool load_driver_stats(struct driver_stats *stats, const char *FILENAME) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "rb")) == NULL) {
+		return false;
+	}
+	bool is_read = fread(stats, sizeof(*stats), 1, file) == 1;
+	fclose(file);
+	return is_read && !memcmp(stats->magic, DRIVER_STATS_MAGIC, sizeof(stats->magic)) &&
+		stats->version == DRIVER_STATS_VERSION && stats->ring_ct <= MAX_STATS_RINGS;
+}
+
+/**
+ * Prints a row of a histogram's count and percentiles, in us.
+ *
+ * Parameters:
+ * file - file to print to
+ * NAME - name of the row
+ * histogram - histogram to print
+ *
+ */
+void print_histogram_row(FILE *file, const char *NAME, const struct histogram *histogram) {
+	fprintf(file, "%-10s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f\n", NAME, (unsigned long) histogram->count, get_histogram_mean(histogram) / 1e3,
+		get_histogram_percentile(histogram, 50) / 1e3, get_histogram_percentile(histogram, 90) / 1e3,
+		get_histogram_percentile(histogram, 99) / 1e3, histogram->max / 1e3);
+}
+
+/**
+ * Prints the time taken by each stage and each ring's echoes, the sensing loop's
+ * jitter, and what became of each committed word and each ring's readings.
+ *
+ * Parameters:
+ * stats - stats to print
+ * file - file to print to
+ *
+ */
+void print_driver_stats(const struct driver_stats *stats, FILE *file) {
+	double elapsed_sec = (stats->export_ns - stats->start_ns) / 1e9;
+	fprintf(file, "%lu frames (%.1f per second), %lu rendered, over %.1f s\n", (unsigned long) stats->frame_ct,
+		elapsed_sec > 0 ? stats->frame_ct / elapsed_sec : 0, (unsigned long) stats->render_ct, elapsed_sec);
+	fprintf(file, "%lu words committed, %lu dropped, %lu coalesced ; render queue at %lu, most %lu\n", (unsigned long) stats->words.committed_ct,
+		(unsigned long) stats->words.dropped_ct, (unsigned long) stats->words.coalesced_ct, (unsigned long) stats->words.queue_depth,
+		(unsigned long) stats->words.max_queue_depth);
+	fprintf(file, "%-10s %10s %10s %10s %10s %10s %10s\n", "us", "count", "mean", "p50", "p90", "p99", "max");
+	for (size_t stage = 0; stage < STAGE_CT; stage++) {
+		print_histogram_row(file, STAGE_NAMES[stage], &stats->stages[stage]);
+	}
+	for (size_t ring = 0; ring < stats->ring_ct; ring++) {
+		char name[16];
+		snprintf(name, sizeof(name), "echo %zu", ring);
+		print_histogram_row(file, name, &stats->echo_waits[ring]);
+	}
+	print_histogram_row(file, "wake late", &stats->wake_late);
+	print_histogram_row(file, "poll gap", &stats->poll_gaps);
+	fprintf(file, "%-10s %10s %12s %10s %10s\n", "ring", "readings", "out of range", "ignored", "held");
+	for (size_t ring = 0; ring < stats->ring_ct; ring++) {
+		const struct ring_counters *counters = &stats->rings[ring];
+		fprintf(file, "%-10zu %10lu %12lu %10lu %10lu\n", ring, (unsigned long) counters->reading_ct, (unsigned long) counters->out_of_range_ct,
+			(unsigned long) counters->ignored_ct, (unsigned long) counters->held_ct);
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef DRIVER_STATS_H
+#define DRIVER_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+/* first bytes of every stats file, and the layout version of what follows */
+#define DRIVER_STATS_MAGIC "MUYUSTA"
+#define DRIVER_STATS_VERSION 3
+/* most rings with their own stats, the same as MAX_RINGS */
+#define MAX_STATS_RINGS 16
+
+/* timed stages of each frame of the driver */
+enum driver_stage {
+	/* triggering the due rings and waiting for their echoes */
+	STAGE_SENSE,
+	/* filtering readings and decoding positions */
+	STAGE_DECODE,
+	/* looking up the word and its translation, on the render thread */
+	STAGE_TRANSLATE,
+	/* writing the word to the terminal, on the render thread */
+	STAGE_RENDER,
+	/* sensing, decoding and handing any new word to the render thread */
+	STAGE_FRAME,
+	/* from committing to a word until the render thread has written it */
+	STAGE_LAG,
+	STAGE_CT
+};
+
+/* what became of one ring's readings */
+struct ring_counters {
+	uint64_t reading_ct;
+	/* no echo, or outside the sensor's range (-1 from the controller) */
+	uint64_t out_of_range_ct;
+	/* in range, but beyond every calibrated position */
+	uint64_t ignored_ct;
+	/* the position the reading pointed to was held back by hysteresis */
+	uint64_t held_ct;
+};
+
+/* what became of the words the sensing loop committed to */
+struct word_counters {
+	uint64_t committed_ct;
+	/* found the render queue full, and were replaced by a newer word before it had room */
+	uint64_t dropped_ct;
+	/* queued, but skipped by the render thread for a newer word behind them */
+	uint64_t coalesced_ct;
+	/* words in the render queue at the last export, and the most there have been */
+	uint64_t queue_depth;
+	uint64_t max_queue_depth;
+};
+
+/* everything the driver exports, in the byte order of the machine running it */
+struct driver_stats {
+	char magic[8];
+	uint32_t version;
+	uint32_t ring_ct;
+	/* monotonic times the driver started and the stats were last exported, in ns */
+	uint64_t start_ns;
+	uint64_t export_ns;
+	uint64_t frame_ct;
+	uint64_t render_ct;
+	/* time of each stage, in ns */
+	struct histogram stages[STAGE_CT];
+	/* time from each ring's trigger to the end of its echo, or timeout, in ns */
+	struct histogram echo_waits[MAX_STATS_RINGS];
+	struct ring_counters rings[MAX_STATS_RINGS];
+	struct word_counters words;
+	/* how late each frame woke after its timer tick, and the longest gap between polls of
+	 * the echo pins in each measurement, in ns ; the jitter the real-time mode reduces */
+	struct histogram wake_late;
+	struct histogram poll_gaps;
+};
+
+extern const char *const STAGE_NAMES[STAGE_CT];
+
+void init_driver_stats(struct driver_stats *stats, const size_t RING_CT);
+bool save_driver_stats(struct driver_stats *stats, const char *FILENAME);
+bool load_driver_stats(struct driver_stats *stats, const char *FILENAME);
+void print_driver_stats(const struct driver_stats *stats, FILE *file);
+
+#endif
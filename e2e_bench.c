@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "controller.h"
+#include "gpio_sim.h"
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "timing.h"
+#include "histogram.h"
+#include "wheel.h"
+
+/* distance from each sensor to position 0 of its ring, and between adjacent positions */
+#define FIRST_POSITION_CM 10.0
+#define POSITION_SPACING_CM 5.0
+/* frames a committed word must then hold for, to count as stable */
+#define HOLD_FRAMES 3
+
+/* settings of one benchmark run */
+struct e2e_settings {
+	size_t scenario_ct;
+	float noise_cm;
+	float outlier_rate;
+	float dropout_rate;
+	/* time a ring takes to turn to its new position */
+	uint64_t sweep_ns;
+	/* longest wait for the right word, after which a scenario counts as timed out */
+	uint64_t timeout_ns;
+	size_t filter_window;
+	float hysteresis;
+	uint64_t seed;
+};
+
+/* latency and accuracy over every scenario */
+struct e2e_results {
+	/* time and # of frames from the move to the right word */
+	struct histogram latency_ns;
+	struct histogram frames;
+	size_t timeout_ct;
+	/* words committed on the way that were neither the old nor the new word */
+	size_t wrong_ct;
+	/* scenarios whose right word changed again within HOLD_FRAMES */
+	size_t flicker_ct;
+	size_t move_ct;
+};
+
+/* results are written here so the compiler cannot drop the work */
+volatile size_t sink;
+
+/**
+ * Returns the distance of a ring position from its sensor.
+ *
+ * Parameter:
+ * POSITION - position on the ring
+ *
+ */
+float get_position_cm(const size_t POSITION) {
+	return FIRST_POSITION_CM + POSITION * POSITION_SPACING_CM;
+}
+
+/**
+ * Runs one frame as the driver does: pings every ring, decodes each reading, and looks
+ * up the word's translation. Returns the word.
+ *
+ * Parameters:
+ * wheel - wheel to decode with
+ * triggers - schedule to fire rings by
+ * ROOT - index into ROOTS of the verb on the wheel
+ *
+ */
+word_key run_frame(struct wheel *wheel, const struct trigger_schedule *triggers, const size_t ROOT) {
+	float distances[MAX_RINGS];
+	measure_rings_cm(triggers, NULL, distances);
+	for (size_t ring = 0; ring < wheel->ring_ct; ring++) {
+		decode_reading(wheel, ring, distances[ring]);
+	}
+	word_key key = make_word_key(ROOT, wheel->ring_idxs);
+	sink += lookup_translation(key)[0];
+	return key;
+}
+
+/**
+ * Turns random rings of the simulated wheel to random new positions, then runs frames
+ * until the wheel decodes the new word, and a few more to see that it holds.
+ *
+ * Replaces:
+ * results, positions
+ *
+ * Parameters:
+ * wheel - wheel to decode with
+ * triggers - schedule to fire rings by
+ * ROOT - index into ROOTS of the verb on the wheel
+ * settings - benchmark settings
+ * positions - where each ring is
+ * results - results to add the scenario to
+ *
+ */
+void run_scenario(struct wheel *wheel, const struct trigger_schedule *triggers, const size_t ROOT, const struct e2e_settings *settings,
+	size_t positions[], struct e2e_results *results) {
+	word_key start_key = make_word_key(ROOT, wheel->ring_idxs);
+	/* at least one ring moves, and each other ring moves half the time */
+	size_t first_ring = rand() % wheel->ring_ct;
+	for (size_t ring = 0; ring < wheel->ring_ct; ring++) {
+		if (ring != first_ring && rand() % 2) {
+			continue;
+		}
+		size_t position = rand() % (SUFFIX_CTS[ring] - 1);
+		positions[ring] = position + (position >= positions[ring]);
+		sim_move(ring, get_position_cm(positions[ring]), settings->sweep_ns);
+		results->move_ct++;
+	}
+	word_key target_key = make_word_key(ROOT, positions);
+
+	uint64_t move_ns = get_monotonic_ns(), now_ns = move_ns;
+	word_key shown_key = start_key;
+	size_t frame_ct = 0;
+	while (shown_key != target_key && now_ns - move_ns < settings->timeout_ns) {
+		word_key key = run_frame(wheel, triggers, ROOT);
+		now_ns = get_monotonic_ns();
+		frame_ct++;
+		results->wrong_ct += key != shown_key && key != start_key && key != target_key;
+		shown_key = key;
+	}
+	if (shown_key != target_key) {
+		results->timeout_ct++;
+		return;
+	}
+	record_histogram(&results->latency_ns, now_ns - move_ns);
+	record_histogram(&results->frames, frame_ct);
+
+	bool is_stable = true;
+	for (size_t frame = 0; frame < HOLD_FRAMES; frame++) {
+		is_stable = run_frame(wheel, triggers, ROOT) == target_key && is_stable;
+	}
+	results->flicker_ct += !is_stable;
+}
+
+/**
+ * Writes the settings and results of a run as JSON.
+ * Returns false if the file could not be written.
+ *
+ * Parameters:
+ * FILENAME - file to write
+ * settings - benchmark settings
+ * results - benchmark results
+ *
+ */
+bool save_e2e_results(const char *FILENAME, const struct e2e_settings *settings, const struct e2e_results *results) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "w")) == NULL) {
+		printf("Could not open %s.\n", FILENAME);
+		return false;
+	}
+	fprintf(file, "{\n\"settings\": {\"scenarios\": %zu, \"noise_cm\": %.3f, \"outlier_rate\": %.4f, \"dropout_rate\": %.4f", settings->scenario_ct,
+		settings->noise_cm, settings->outlier_rate, settings->dropout_rate);
+	fprintf(file, ", \"sweep_ms\": %.1f, \"filter_window\": %zu, \"hysteresis\": %.3f, \"seed\": %lu},\n", settings->sweep_ns / 1e6,
+		settings->filter_window, settings->hysteresis, (unsigned long) settings->seed);
+	fprintf(file, "\"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+		get_histogram_mean(&results->latency_ns) / 1e6, get_histogram_percentile(&results->latency_ns, 50) / 1e6,
+		get_histogram_percentile(&results->latency_ns, 90) / 1e6, get_histogram_percentile(&results->latency_ns, 99) / 1e6,
+		results->latency_ns.max / 1e6);
+	fprintf(file, "\"frames\": {\"mean\": %.2f, \"p50\": %lu, \"p99\": %lu, \"max\": %lu},\n", get_histogram_mean(&results->frames),
+		(unsigned long) get_histogram_percentile(&results->frames, 50), (unsigned long) get_histogram_percentile(&results->frames, 99),
+		(unsigned long) results->frames.max);
+	fprintf(file, "\"timeouts\": %zu, \"wrong_words\": %zu, \"flickers\": %zu, \"ring_moves\": %zu\n}\n", results->timeout_ct, results->wrong_ct,
+		results->flicker_ct, results->move_ct);
+	fclose(file);
+	return true;
+}
+
+/**
+ * End to end benchmark of the sensing and decoding path, on the simulated wheel. Each
+ * scenario turns some rings, and times how long the driver's loop, run frame after
+ * frame with no pause between, takes to commit the right word. Prints and saves the
+ * latency and accuracy over every scenario.
+ *
+ * Options:
+ * --scenarios N - # of scenarios (default 1000)
+ * --noise CM - standard deviation of each reading (default 0.3)
+ * --outliers RATE - chance a reading is anywhere in range (default 0.01)
+ * --dropouts RATE - chance a ping gets no echo (default 0.01)
+ * --sweep-ms MS - time a ring takes to turn, passing the positions between (default 0)
+ * --timeout-ms MS - longest wait for the right word (default 1000)
+ * --filter-window N - # of readings in each ring's running median (default 3)
+ * --hysteresis F - hysteresis of each ring's filter, in position spacings (default 0.15)
+ * --seed N - seed for the noise and scenarios (default 1)
+ * --output FILE - file to save results to (default e2e_bench.json)
+ *
+ */
+int main(int argc, char *argv[]) {
+	struct e2e_settings settings = {1000, 0.3, 0.01, 0.01, 0, 1000000000, 3, 0.15, 1};
+	const char *output = "e2e_bench.json";
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--scenarios")) {
+			settings.scenario_ct = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--noise")) {
+			settings.noise_cm = atof(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--outliers")) {
+			settings.outlier_rate = atof(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--dropouts")) {
+			settings.dropout_rate = atof(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--sweep-ms")) {
+			settings.sweep_ns = atof(argv[i + 1]) * 1e6;
+		} else if (!strcmp(argv[i], "--timeout-ms")) {
+			settings.timeout_ns = atof(argv[i + 1]) * 1e6;
+		} else if (!strcmp(argv[i], "--filter-window")) {
+			settings.filter_window = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--hysteresis")) {
+			settings.hysteresis = atof(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--seed")) {
+			settings.seed = strtoull(argv[i + 1], NULL, 10);
+		} else if (!strcmp(argv[i], "--output")) {
+			output = argv[i + 1];
+		}
+	}
+
+	/* index into ROOTS ; wayk'u, as on the driver */
+	const size_t ROOT = 2;
+	const size_t RING_CT = SLOT_CT;
+	struct calibration_set calibration;
+	struct wheel wheel = {.ring_ct = RING_CT, .calibration = &calibration};
+	struct trigger_schedule triggers;
+	size_t positions[SLOT_CT] = {0};
+	static struct e2e_results results;
+	setup();
+	sim_set_noise(settings.noise_cm, settings.outlier_rate, settings.dropout_rate);
+	sim_seed(settings.seed);
+	srand(settings.seed);
+	if (sim_sensor_ct() < RING_CT || !parse_trigger_schedule("0,2,4/1,3,5", 3000, &triggers)) {
+		printf("Could not set up %zu simulated rings.\n", RING_CT);
+		return 1;
+	}
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		float medians[MAX_POSITIONS];
+		for (size_t position = 0; position < SUFFIX_CTS[ring]; position++) {
+			medians[position] = get_position_cm(position);
+		}
+		if (!make_calibration(&calibration.cals[ring], medians, SUFFIX_CTS[ring]) ||
+			!init_filter(&wheel.filters[ring], settings.filter_window, settings.hysteresis)) {
+			printf("Filter window must be 1 to %i readings, and hysteresis below 0.5.\n", MAX_FILTER_WINDOW);
+			return 1;
+		}
+		sim_set_distance(ring, get_position_cm(0));
+	}
+	/* settle on the starting word */
+	for (size_t frame = 0; frame < 2 * settings.filter_window; frame++) {
+		run_frame(&wheel, &triggers, ROOT);
+	}
+
+	uint64_t start_ns = get_monotonic_ns();
+	for (size_t scenario = 0; scenario < settings.scenario_ct; scenario++) {
+		run_scenario(&wheel, &triggers, ROOT, &settings, positions, &results);
+	}
+	double elapsed_sec = (get_monotonic_ns() - start_ns) / 1e9;
+
+	printf("%zu scenarios (%zu ring moves) in %.1f s\n", settings.scenario_ct, results.move_ct, elapsed_sec);
+	printf("Move to right word: mean %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		get_histogram_mean(&results.latency_ns) / 1e6, get_histogram_percentile(&results.latency_ns, 50) / 1e6,
+		get_histogram_percentile(&results.latency_ns, 90) / 1e6, get_histogram_percentile(&results.latency_ns, 99) / 1e6,
+		results.latency_ns.max / 1e6);
+	printf("Frames to right word: mean %.2f, p50 %lu, p99 %lu, max %lu\n", get_histogram_mean(&results.frames),
+		(unsigned long) get_histogram_percentile(&results.frames, 50), (unsigned long) get_histogram_percentile(&results.frames, 99),
+		(unsigned long) results.frames.max);
+	printf("Timed out: %zu, wrong words on the way: %zu, flickered after: %zu\n", results.timeout_ct, results.wrong_ct, results.flicker_ct);
+	return save_e2e_results(output, &settings, &results) ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include "filter.h"
+#include "timing.h"
+
+/**
+ * Sets up a filter. Returns false if WINDOW_LEN is not between 1 and MAX_FILTER_WINDOW,
+ * or HYSTERESIS is not between 0 and 0.5.
+ *
+ * Replaces:
+ * filter
+ *
+ * Parameters:
+ * filter - filter to set up
+ * WINDOW_LEN - # of readings the running median is taken over
+ * HYSTERESIS - how far past the boundary between two positions, as a fraction of their
+ * 	spacing, a reading must go before the position changes
+ *
+ */
+bool init_filter(struct ring_filter *filter, const size_t WINDOW_LEN, const float HYSTERESIS) {
+	if (WINDOW_LEN < 1 || WINDOW_LEN > MAX_FILTER_WINDOW || HYSTERESIS < 0 || HYSTERESIS >= 0.5) {
+		return false;
+	}
+	*filter = (struct ring_filter) {.window_len = WINDOW_LEN, .hysteresis = HYSTERESIS};
+	return true;
+}
+
+/**
+ * Returns the median of the filled part of a filter's window.
+ *
+ * Parameter:
+ * filter - filter to take the median of
+ *
+ */
+float get_window_median(const struct ring_filter *filter) {
+	size_t len = filter->sample_ct < filter->window_len ? filter->sample_ct : filter->window_len;
+	float sorted[MAX_FILTER_WINDOW];
+
+	/* insertion sort ; the window is tiny */
+	for (size_t i = 0; i < len; i++) {
+		size_t j = i;
+		for (; j > 0 && sorted[j - 1] > filter->window[i]; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = filter->window[i];
+	}
+	return len % 2 == 0 ? (sorted[len / 2 - 1] + sorted[len / 2]) / 2 : sorted[len / 2];
+}
+
+/**
+ * Feeds an in-range reading through a ring's filter. The running median of recent
+ * readings is decoded to a position, which only replaces the current one once the
+ * median lies more than hysteresis spacings past the boundary between them. Returns
+ * true iff the filter's position changed.
+ *
+ * Parameters:
+ * filter - filter of the ring
+ * DISTANCE_CM - reading from the ring's sensor
+ * cal - calibration of the ring
+ *
+ */
+bool filter_sample(struct ring_filter *filter, const float DISTANCE_CM, const struct ring_calibration *cal) {
+	filter->window[filter->sample_ct % filter->window_len] = DISTANCE_CM;
+	filter->sample_ct++;
+
+	float median = get_window_median(filter);
+	long raw_position = decode_position(cal, DISTANCE_CM);
+	long position = decode_position(cal, median);
+	if (position < 0) {
+		filter->ignored_ct++;
+		return false;
+	}
+
+	/* start timing a change as soon as the raw reading first disagrees */
+	if (raw_position >= 0 && raw_position != filter->pending_position &&
+		(!filter->has_position || raw_position != filter->position)) {
+		filter->pending_position = raw_position;
+		filter->pending_ns = get_monotonic_ns();
+		filter->pending_sample_ct = filter->sample_ct;
+	}
+
+	if (!filter->has_position) {
+		filter->position = position;
+		filter->has_position = true;
+		return true;
+	}
+	if (position == filter->position) {
+		return false;
+	}
+
+	/* the median must clear the boundary nearest the new position by the hysteresis band */
+	size_t boundary = position > filter->position ? position : position + 1;
+	float band = filter->hysteresis * (cal->medians[boundary] - cal->medians[boundary - 1]);
+	if (position > filter->position ? median < cal->boundaries[boundary] + band : median > cal->boundaries[boundary] - band) {
+		filter->held_ct++;
+		return false;
+	}
+
+	/* settled on a new position */
+	if (position == filter->pending_position) {
+		filter->settle_ct++;
+		filter->settle_ns += get_monotonic_ns() - filter->pending_ns;
+		filter->settle_sample_ct += filter->sample_ct - filter->pending_sample_ct + 1;
+	}
+	filter->position = position;
+	filter->pending_position = position;
+	return true;
+}
+
+/**
+ * Prints how long a ring's filter took on average to settle on a new position.
+ *
+ * Parameters:
+ * filter - filter of the ring
+ * RING - ring number, for the report
+ * file - file to print to
+ *
+ */
+void print_filter_stats(const struct ring_filter *filter, const size_t RING, FILE *file) {
+	if (filter->settle_ct == 0) {
+		fprintf(file, "Ring %zu: no position changes\n", RING);
+		return;
+	}
+	fprintf(file, "Ring %zu: %zu position changes, %.1f samples and %.1f ms to stable on average\n", RING, filter->settle_ct,
+		(double) filter->settle_sample_ct / filter->settle_ct, filter->settle_ns / 1e6 / filter->settle_ct);
+}
@@ -0,0 +1,41 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "calibration.h"
+
+/* longest running median window */
+#define MAX_FILTER_WINDOW 15
+
+/* running median and hysteresis stage between a ring's raw readings and its position */
+struct ring_filter {
+	/* last window_len in-range readings, oldest overwritten first */
+	float window[MAX_FILTER_WINDOW];
+	size_t window_len;
+	size_t sample_ct;
+	/* how far past a decision boundary, in position spacings, the median must go to switch */
+	float hysteresis;
+	/* position currently reported, and whether there is one yet */
+	size_t position;
+	bool has_position;
+	/* raw position being settled on, with when and after how many samples it first appeared */
+	size_t pending_position;
+	uint64_t pending_ns;
+	size_t pending_sample_ct;
+	/* # of readings beyond every position, and held back by hysteresis */
+	size_t ignored_ct;
+	size_t held_ct;
+	/* # of settled changes, and their total time and samples to settle */
+	size_t settle_ct;
+	uint64_t settle_ns;
+	size_t settle_sample_ct;
+};
+
+bool init_filter(struct ring_filter *filter, const size_t WINDOW_LEN, const float HYSTERESIS);
+float get_window_median(const struct ring_filter *filter);
+bool filter_sample(struct ring_filter *filter, const float DISTANCE_CM, const struct ring_calibration *cal);
+void print_filter_stats(const struct ring_filter *filter, const size_t RING, FILE *file);
+
+#endif
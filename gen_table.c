@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "que_to_eng.h"
+#include "hash.h"
+
+/* # of buckets used to find duplicate translations ; must be a power of 2 */
+#define BUCKET_CT 65536
+
+/**
+ * Prints str as the body of a C string literal, escaping where needed.
+ *
+ * Parameters:
+ * file - file to print to
+ * str - string to print
+ *
+ */
+void print_escaped(FILE *file, const char *str) {
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', file);
+		}
+		fputc(*str, file);
+	}
+}
+
+/**
+ * Runs translate() on every root and suffix combination, and prints a C source fragment
+ * with the results to stdout. Identical translations are stored once in TRANSLATION_POOL,
+ * and TRANSLATION_OFFSETS maps each combination index to its translation within it.
+ * Exits non-zero, before printing anything, if it runs out of memory or a combination
+ * does not translate, so make never keeps a truncated table.
+ *
+ */
+int main() {
+	/* offset into pool of each combination */
+	uint32_t *offsets = calloc(COMBINATION_CT, sizeof(uint32_t));
+	/* each bucket is a combination index whose translation starts a pool entry, or -1 */
+	long *buckets = malloc(BUCKET_CT * sizeof(long));
+	char **translations = calloc(COMBINATION_CT, sizeof(char *));
+	uint32_t pool_len = 0;
+	if (offsets == NULL || buckets == NULL || translations == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		free(offsets);
+		free(buckets);
+		free(translations);
+		return 1;
+	}
+	memset(buckets, -1, BUCKET_CT * sizeof(long));
+
+	/* translate everything first, so a failure prints nothing */
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		size_t root, suffix_idxs[SLOT_CT];
+		const char *suffixes[SLOT_CT];
+		get_combination(combination, &root, suffix_idxs);
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			suffixes[slot] = SUFFIXES[slot][suffix_idxs[slot]];
+		}
+		if ((translations[combination] = translate(ROOTS[root], suffixes)) == NULL) {
+			fprintf(stderr, "Could not translate combination %zu.\n", combination);
+			for (size_t done = 0; done < combination; done++) {
+				free(translations[done]);
+			}
+			free(translations);
+			free(buckets);
+			free(offsets);
+			return 1;
+		}
+	}
+
+	printf("/* generated by gen_table ; do not edit */\n\n");
+	printf("static const char TRANSLATION_POOL[] =\n");
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		/* find translation in pool, or add it */
+		size_t bucket = hash_string(translations[combination]) & (BUCKET_CT - 1);
+		while (buckets[bucket] != -1 && strcmp(translations[buckets[bucket]], translations[combination])) {
+			bucket = (bucket + 1) & (BUCKET_CT - 1);
+		}
+		if (buckets[bucket] == -1) {
+			buckets[bucket] = combination;
+			offsets[combination] = pool_len;
+			pool_len += strlen(translations[combination]) + 1;
+			printf("\t\"");
+			print_escaped(stdout, translations[combination]);
+			printf("\\0\"\n");
+		} else {
+			offsets[combination] = offsets[buckets[bucket]];
+		}
+	}
+	printf(";\n\n");
+
+	printf("static const uint32_t TRANSLATION_OFFSETS[%i] = {", COMBINATION_CT);
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		printf(combination % 8 == 0 ? "\n\t%u," : " %u,", offsets[combination]);
+	}
+	printf("\n};\n");
+
+	/* clean up and exit */
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		free(translations[combination]);
+	}
+	free(translations);
+	free(buckets);
+	free(offsets);
+	return 0;
+}
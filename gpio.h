@@ -0,0 +1,36 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* direction of a pin */
+enum gpio_mode {
+	GPIO_INPUT,
+	GPIO_OUTPUT
+};
+
+/* an edge seen on an input pin */
+struct gpio_edge {
+	int pin;
+	bool is_rising;
+	/* CLOCK_MONOTONIC time of the edge, as get_monotonic_ns counts */
+	uint64_t ns;
+};
+
+/*
+ * Pin level access used by the controller. Each backend (gpio_wiringpi.c,
+ * gpio_sim.c, gpio_cdev.c) implements these ; the makefile picks one with GPIO=.
+ * Backends which can time edges as they happen (gpio_cdev.c) return true from
+ * gpio_has_edges, and the controller waits on gpio_wait_edges instead of polling.
+ */
+bool gpio_setup();
+void gpio_mode(const int PIN, const enum gpio_mode MODE);
+void gpio_write(const int PIN, const bool LEVEL);
+bool gpio_read(const int PIN);
+void gpio_delay_us(const unsigned MICROSECONDS);
+bool gpio_has_edges();
+size_t gpio_wait_edges(const int PINS[], const size_t PIN_CT, const uint64_t TIMEOUT_NS, struct gpio_edge edges[], const size_t CAP);
+
+#endif
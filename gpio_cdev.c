@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "gpio.h"
+#include "timing.h"
+
+/* highest pin number that can be requested */
+#define MAX_CDEV_PIN 127
+/* edges the kernel holds for each echo pin until they are read */
+#define EDGE_BUFFER_LEN 16
+/* name the lines are requested under, as shown by gpioinfo */
+#define CONSUMER "muyuchina"
+
+/* BCM line of each wiring pi pin on a Pi's 40 pin header, or -1 if it has none */
+const int WIRINGPI_TO_BCM[] = {17, 18, 27, 22, 23, 24, 25, 4, 2, 3, 8, 7, 10, 9, 11, 14, 15, -1, -1, -1, -1, 5, 6, 13, 19, 26, 12, 16, 20, 21, 0, 1};
+const int WIRINGPI_PIN_CT = sizeof(WIRINGPI_TO_BCM) / sizeof(WIRINGPI_TO_BCM[0]);
+
+/* GPIO chip every pin is on */
+int chip_fd = -1;
+/* whether pins are line offsets on the chip, rather than wiring pi pins */
+bool is_offset_numbering = false;
+/* line request of each pin, or -1 if the pin is not set up */
+int line_fds[MAX_CDEV_PIN + 1];
+
+/**
+ * Opens the GPIO chip named by GPIO_CHIP (/dev/gpiochip0 by default). Pins are wiring pi
+ * pins, so the controller's pin layout holds, unless GPIO_PIN_NUMBERS=offset, in which
+ * case they are line offsets on the chip (as on a gpio-sim chip). Returns false on
+ * failure.
+ *
+ */
+bool gpio_setup() {
+	const char *chip_path = getenv("GPIO_CHIP") ? getenv("GPIO_CHIP") : "/dev/gpiochip0";
+	const char *numbering = getenv("GPIO_PIN_NUMBERS");
+	if (numbering != NULL && strcmp(numbering, "offset") != 0 && strcmp(numbering, "wiringpi") != 0) {
+		printf("GPIO_PIN_NUMBERS must be wiringpi or offset, not %s\n", numbering);
+		return false;
+	}
+	is_offset_numbering = numbering != NULL && strcmp(numbering, "offset") == 0;
+	for (int pin = 0; pin <= MAX_CDEV_PIN; pin++) {
+		line_fds[pin] = -1;
+	}
+	if ((chip_fd = open(chip_path, O_RDWR | O_CLOEXEC)) < 0) {
+		printf("Could not open %s: %s\n", chip_path, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Returns the line offset of a pin on the chip, or -1 if it has none.
+ *
+ * Parameter:
+ * PIN - pin number
+ *
+ */
+int get_line_offset(const int PIN) {
+	if (PIN < 0 || PIN > MAX_CDEV_PIN) {
+		return -1;
+	}
+	if (is_offset_numbering) {
+		return PIN;
+	}
+	return PIN < WIRINGPI_PIN_CT ? WIRINGPI_TO_BCM[PIN] : -1;
+}
+
+/**
+ * Requests a pin's line for input or output. Input lines report both edges, timed by the
+ * kernel on CLOCK_MONOTONIC. Exits if the line cannot be requested, as the wheel cannot
+ * be read without it.
+ *
+ * Parameters:
+ * PIN - pin number
+ * MODE - GPIO_INPUT or GPIO_OUTPUT
+ *
+ */
+void gpio_mode(const int PIN, const enum gpio_mode MODE) {
+	int offset = get_line_offset(PIN);
+	if (offset < 0) {
+		printf("Pin %i has no GPIO line\n", PIN);
+		exit(1);
+	}
+	if (line_fds[PIN] >= 0) {
+		close(line_fds[PIN]);
+		line_fds[PIN] = -1;
+	}
+
+	struct gpio_v2_line_request request;
+	memset(&request, 0, sizeof(request));
+	request.offsets[0] = offset;
+	request.num_lines = 1;
+	strncpy(request.consumer, CONSUMER, sizeof(request.consumer) - 1);
+	if (MODE == GPIO_OUTPUT) {
+		request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+	} else {
+		request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+		request.event_buffer_size = EDGE_BUFFER_LEN;
+	}
+	if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+		printf("Could not request line %i for pin %i: %s\n", offset, PIN, strerror(errno));
+		exit(1);
+	}
+	/* edges are only read once poll says they are there, and then until none are left */
+	fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+	line_fds[PIN] = request.fd;
+}
+
+/**
+ * Drives an output pin high or low.
+ *
+ * Parameters:
+ * PIN - pin number
+ * LEVEL - true for high, false for low
+ *
+ */
+void gpio_write(const int PIN, const bool LEVEL) {
+	struct gpio_v2_line_values values = {.bits = LEVEL, .mask = 1};
+	ioctl(line_fds[PIN], GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+}
+
+/**
+ * Returns true iff an input pin reads high.
+ *
+ * Parameter:
+ * PIN - pin number
+ *
+ */
+bool gpio_read(const int PIN) {
+	struct gpio_v2_line_values values = {.bits = 0, .mask = 1};
+	return ioctl(line_fds[PIN], GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0 && (values.bits & 1);
+}
+
+/**
+ * Busy waits for a number of microseconds.
+ *
+ * Parameter:
+ * MICROSECONDS - time to wait
+ *
+ */
+void gpio_delay_us(const unsigned MICROSECONDS) {
+	uint64_t end_ns = get_monotonic_ns() + (uint64_t) MICROSECONDS * 1000;
+	while (get_monotonic_ns() < end_ns);
+}
+
+/**
+ * Returns true, as the kernel times each edge of an input pin.
+ *
+ */
+bool gpio_has_edges() {
+	return true;
+}
+
+/**
+ * Sleeps until an edge is seen on any of the pins, or TIMEOUT_NS passes, then returns the
+ * # of edges seen. Edges keep the time the kernel saw them, however late they are read.
+ *
+ * Replaces:
+ * edges
+ *
+ * Parameters:
+ * PINS - input pins to watch
+ * PIN_CT - # of pins, at most MAX_CDEV_PIN + 1
+ * TIMEOUT_NS - longest to wait
+ * edges - edges seen, oldest first on each pin
+ * CAP - most edges to return
+ *
+ */
+size_t gpio_wait_edges(const int PINS[], const size_t PIN_CT, const uint64_t TIMEOUT_NS, struct gpio_edge edges[], const size_t CAP) {
+	struct pollfd fds[MAX_CDEV_PIN + 1];
+	for (size_t i = 0; i < PIN_CT; i++) {
+		fds[i] = (struct pollfd) {.fd = line_fds[PINS[i]], .events = POLLIN};
+	}
+	struct timespec timeout = {TIMEOUT_NS / 1000000000, TIMEOUT_NS % 1000000000};
+	if (ppoll(fds, PIN_CT, &timeout, NULL) <= 0) {
+		return 0;
+	}
+
+	size_t edge_ct = 0;
+	for (size_t i = 0; i < PIN_CT && edge_ct < CAP; i++) {
+		if (!(fds[i].revents & POLLIN)) {
+			continue;
+		}
+		struct gpio_v2_line_event events[EDGE_BUFFER_LEN];
+		size_t want_ct = CAP - edge_ct < EDGE_BUFFER_LEN ? CAP - edge_ct : EDGE_BUFFER_LEN;
+		ssize_t len = read(fds[i].fd, events, want_ct * sizeof(events[0]));
+		for (ssize_t j = 0; len > 0 && j < len / (ssize_t) sizeof(events[0]); j++) {
+			edges[edge_ct++] = (struct gpio_edge) {PINS[i], events[j].id == GPIO_V2_LINE_EVENT_RISING_EDGE, events[j].timestamp_ns};
+		}
+	}
+	return edge_ct;
+}
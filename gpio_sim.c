@@ -0,0 +1,443 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "gpio.h"
+#include "gpio_sim.h"
+#include "timing.h"
+
+/* time from the end of a trigger pulse until the echo pin goes high, as on an HC-SR04 */
+#define ECHO_DELAY_NS 400000
+/* longest the echo pin stays high when nothing is heard */
+#define ECHO_TIMEOUT_NS 38000000
+/* speed of sound in cm per ns */
+#define SOUND_SPEED_CM_PER_NS 0.00003432
+/* nearest and farthest distance an outlier echo can report */
+#define MIN_OUTLIER_CM 2
+#define MAX_OUTLIER_CM 400
+/* most moves a SIM_SCRIPT can hold */
+#define MAX_SIM_MOVES 256
+
+/* one simulated ultrasonic sensor facing a ring */
+struct sim_sensor {
+	int trigger_pin;
+	int echo_pin;
+	/* the ring sweeps from move_from_cm to distance_cm between move_start_ns and move_end_ns */
+	float distance_cm;
+	float move_from_cm;
+	uint64_t move_start_ns;
+	uint64_t move_end_ns;
+	bool trigger_high;
+	/* time the last trigger pulse ended, or 0 if never triggered */
+	uint64_t triggered_ns;
+	/* distance the last ping echoes from, with noise, or -1 if it was lost */
+	float ping_cm;
+};
+
+/* a scripted move of one ring, at a time after setup */
+struct sim_move {
+	uint64_t at_ns;
+	size_t sensor;
+	float distance_cm;
+};
+
+struct sim_sensor sensors[MAX_SIM_SENSORS];
+size_t sensor_ct = 0;
+bool crosstalk = true;
+/* # of consecutive sensors facing one wheel ; only sensors of the same wheel hear each other */
+size_t wheel_sensor_ct = MAX_SIM_SENSORS;
+/* standard deviation of every reading, and the chance a ping reads anywhere or is lost */
+float noise_cm = 0;
+float outlier_rate = 0;
+float dropout_rate = 0;
+/* state of the xorshift generator behind all noise */
+uint64_t noise_state = 88172645463325252u;
+/* moves from SIM_SCRIPT, in time order, and how many have happened */
+struct sim_move moves[MAX_SIM_MOVES];
+size_t move_ct = 0;
+size_t done_move_ct = 0;
+uint64_t setup_ns = 0;
+/* held while touching any sensor, so wheels can be polled from several threads */
+pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns a uniformly random number in [0, 1).
+ *
+ */
+double get_uniform() {
+	noise_state ^= noise_state << 13;
+	noise_state ^= noise_state >> 7;
+	noise_state ^= noise_state << 17;
+	return (noise_state >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Returns a normally distributed random number with mean 0 and standard deviation 1.
+ *
+ */
+double get_gaussian() {
+	/* Box-Muller ; 1 - u keeps the logarithm finite */
+	return sqrt(-2 * log(1 - get_uniform())) * cos(2 * M_PI * get_uniform());
+}
+
+/**
+ * Returns where a sensor's ring is at a time, partway through any sweep.
+ *
+ * Parameters:
+ * sensor - sensor facing the ring
+ * NOW_NS - monotonic time
+ *
+ */
+float get_ring_cm(const struct sim_sensor *sensor, const uint64_t NOW_NS) {
+	if (NOW_NS >= sensor->move_end_ns) {
+		return sensor->distance_cm;
+	}
+	if (NOW_NS <= sensor->move_start_ns) {
+		return sensor->move_from_cm;
+	}
+	float progress = (float) (NOW_NS - sensor->move_start_ns) / (sensor->move_end_ns - sensor->move_start_ns);
+	return sensor->move_from_cm + progress * (sensor->distance_cm - sensor->move_from_cm);
+}
+
+/**
+ * Starts a sweep of a sensor's ring from where it is now to DISTANCE_CM. The caller
+ * holds sim_lock.
+ *
+ * Parameters:
+ * SENSOR - sensor number, below MAX_SIM_SENSORS
+ * DISTANCE_CM - distance from sensor to ring at the end of the move
+ * DURATION_NS - time the move takes
+ * NOW_NS - monotonic time the move starts
+ *
+ */
+void move_sensor(const size_t SENSOR, const float DISTANCE_CM, const uint64_t DURATION_NS, const uint64_t NOW_NS) {
+	sensors[SENSOR].move_from_cm = get_ring_cm(&sensors[SENSOR], NOW_NS);
+	sensors[SENSOR].move_start_ns = NOW_NS;
+	sensors[SENSOR].move_end_ns = NOW_NS + DURATION_NS;
+	sensors[SENSOR].distance_cm = DISTANCE_CM;
+}
+
+/**
+ * Reads SIM_SCRIPT, a comma separated list of MS:SENSOR:CM moves, each putting the ring
+ * of SENSOR at CM cm, MS ms after setup. Moves are sorted into time order.
+ *
+ * Parameter:
+ * SCRIPT - value of SIM_SCRIPT
+ *
+ */
+void read_script(const char *SCRIPT) {
+	move_ct = 0;
+	done_move_ct = 0;
+	for (const char *at = SCRIPT; at != NULL && *at && move_ct < MAX_SIM_MOVES;) {
+		double ms;
+		unsigned long sensor;
+		float distance_cm;
+		int len;
+		if (sscanf(at, "%lf:%lu:%f%n", &ms, &sensor, &distance_cm, &len) != 3) {
+			break;
+		}
+		struct sim_move move = {ms * 1e6, sensor, distance_cm};
+		size_t i = move_ct++;
+		for (; i > 0 && moves[i - 1].at_ns > move.at_ns; i--) {
+			moves[i] = moves[i - 1];
+		}
+		moves[i] = move;
+		at += len;
+		at += *at == ',';
+	}
+}
+
+/**
+ * Sets up the simulation from environment variables. Always succeeds.
+ *
+ * SIM_DISTANCES_CM - comma separated distance of each sensor's ring (default 20 cm each)
+ * SIM_CROSSTALK - 0 turns crosstalk off
+ * SIM_RINGS_PER_WHEEL - # of consecutive sensors on each wheel (default all on one)
+ * SIM_NOISE_CM - standard deviation of each reading (default 0)
+ * SIM_OUTLIER_RATE - chance a ping reads a random distance (default 0)
+ * SIM_DROPOUT_RATE - chance a ping gets no echo (default 0)
+ * SIM_SEED - seed for the noise
+ * SIM_SCRIPT - moves to make while running (see read_script)
+ *
+ */
+bool gpio_setup() {
+	const float DEFAULT_DISTANCE_CM = 20;
+	const char *distances = getenv("SIM_DISTANCES_CM");
+	const char *crosstalk_env = getenv("SIM_CROSSTALK");
+	const char *seed_env = getenv("SIM_SEED");
+	const char *wheel_env = getenv("SIM_RINGS_PER_WHEEL");
+	for (size_t sensor = 0; sensor < MAX_SIM_SENSORS; sensor++) {
+		sensors[sensor].distance_cm = DEFAULT_DISTANCE_CM;
+		sensors[sensor].move_end_ns = 0;
+	}
+	for (size_t sensor = 0; distances != NULL && *distances && sensor < MAX_SIM_SENSORS; sensor++) {
+		char *end;
+		sensors[sensor].distance_cm = strtof(distances, &end);
+		distances = *end == ',' ? end + 1 : end;
+	}
+	crosstalk = crosstalk_env == NULL || strcmp(crosstalk_env, "0");
+	wheel_sensor_ct = wheel_env != NULL && atoi(wheel_env) > 0 ? atoi(wheel_env) : MAX_SIM_SENSORS;
+	sim_set_noise(getenv("SIM_NOISE_CM") ? atof(getenv("SIM_NOISE_CM")) : 0, getenv("SIM_OUTLIER_RATE") ? atof(getenv("SIM_OUTLIER_RATE")) : 0,
+		getenv("SIM_DROPOUT_RATE") ? atof(getenv("SIM_DROPOUT_RATE")) : 0);
+	if (seed_env != NULL) {
+		sim_seed(strtoull(seed_env, NULL, 10));
+	}
+	read_script(getenv("SIM_SCRIPT"));
+	setup_ns = get_monotonic_ns();
+	sensor_ct = 0;
+	return true;
+}
+
+/**
+ * Registers a pin. Each output pin starts a new sensor as its trigger, and the next
+ * input pin becomes that sensor's echo.
+ *
+ * Parameters:
+ * PIN - pin number
+ * MODE - GPIO_INPUT or GPIO_OUTPUT
+ *
+ */
+void gpio_mode(const int PIN, const enum gpio_mode MODE) {
+	if (MODE == GPIO_OUTPUT && sensor_ct < MAX_SIM_SENSORS) {
+		sensors[sensor_ct].trigger_pin = PIN;
+		sensors[sensor_ct].echo_pin = -1;
+		sensors[sensor_ct].trigger_high = false;
+		sensors[sensor_ct].triggered_ns = 0;
+		sensor_ct++;
+	} else if (MODE == GPIO_INPUT && sensor_ct > 0 && sensors[sensor_ct - 1].echo_pin < 0) {
+		sensors[sensor_ct - 1].echo_pin = PIN;
+	}
+}
+
+/**
+ * Drives a trigger pin. A high to low transition fires the sensor's ping, which echoes
+ * from wherever the ring is at that moment, give or take the noise.
+ *
+ * Parameters:
+ * PIN - pin number
+ * LEVEL - true for high, false for low
+ *
+ */
+void gpio_write(const int PIN, const bool LEVEL) {
+	pthread_mutex_lock(&sim_lock);
+	uint64_t now_ns = get_monotonic_ns();
+	/* make scripted moves as their time comes */
+	for (; done_move_ct < move_ct && setup_ns + moves[done_move_ct].at_ns <= now_ns; done_move_ct++) {
+		if (moves[done_move_ct].sensor < MAX_SIM_SENSORS) {
+			move_sensor(moves[done_move_ct].sensor, moves[done_move_ct].distance_cm, 0, now_ns);
+		}
+	}
+	for (size_t sensor = 0; sensor < sensor_ct; sensor++) {
+		struct sim_sensor *own = &sensors[sensor];
+		if (own->trigger_pin != PIN) {
+			continue;
+		}
+		if (own->trigger_high && !LEVEL) {
+			own->triggered_ns = now_ns;
+			double chance = get_uniform();
+			if (chance < dropout_rate) {
+				own->ping_cm = -1;
+			} else if (chance < dropout_rate + outlier_rate) {
+				own->ping_cm = MIN_OUTLIER_CM + get_uniform() * (MAX_OUTLIER_CM - MIN_OUTLIER_CM);
+			} else {
+				own->ping_cm = get_ring_cm(own, now_ns) + noise_cm * get_gaussian();
+				own->ping_cm = own->ping_cm < 0 ? 0 : own->ping_cm;
+			}
+		}
+		own->trigger_high = LEVEL;
+	}
+	pthread_mutex_unlock(&sim_lock);
+}
+
+/**
+ * Returns the level of a pin, as gpio_read does. The caller holds sim_lock.
+ *
+ * Parameter:
+ * PIN - pin number
+ *
+ */
+bool read_pin(const int PIN) {
+	uint64_t now_ns = get_monotonic_ns();
+	for (size_t sensor = 0; sensor < sensor_ct; sensor++) {
+		const struct sim_sensor *own = &sensors[sensor];
+		if (own->trigger_pin == PIN) {
+			return own->trigger_high;
+		}
+		if (own->echo_pin != PIN) {
+			continue;
+		}
+		if (own->triggered_ns == 0) {
+			return false;
+		}
+		uint64_t start_ns = own->triggered_ns + ECHO_DELAY_NS;
+		uint64_t end_ns = start_ns + ECHO_TIMEOUT_NS;
+		uint64_t arrival_ns = start_ns + (uint64_t) (2 * own->ping_cm / SOUND_SPEED_CM_PER_NS);
+		if (own->ping_cm >= 0 && arrival_ns < end_ns) {
+			end_ns = arrival_ns;
+		}
+		for (size_t neighbor = sensor == 0 ? 0 : sensor - 1; crosstalk && neighbor <= sensor + 1 && neighbor < sensor_ct; neighbor++) {
+			const struct sim_sensor *other = &sensors[neighbor];
+			if (neighbor == sensor || neighbor / wheel_sensor_ct != sensor / wheel_sensor_ct || other->triggered_ns == 0 || other->ping_cm < 0) {
+				continue;
+			}
+			/* a ping that already echoed back to its own sensor before this trigger has died out */
+			uint64_t other_end_ns = other->triggered_ns + ECHO_DELAY_NS + (uint64_t) (2 * other->ping_cm / SOUND_SPEED_CM_PER_NS);
+			arrival_ns = other->triggered_ns + ECHO_DELAY_NS + (uint64_t) ((other->ping_cm + get_ring_cm(own, other->triggered_ns)) / SOUND_SPEED_CM_PER_NS);
+			if (other_end_ns > own->triggered_ns && start_ns < arrival_ns && arrival_ns < end_ns) {
+				end_ns = arrival_ns;
+			}
+		}
+		return start_ns <= now_ns && now_ns < end_ns;
+	}
+	return false;
+}
+
+/**
+ * Returns the level of a pin. An echo pin is high from ECHO_DELAY_NS after its
+ * trigger until the first ping arrives back: its own echo, or with crosstalk, the
+ * echo of an adjacent sensor's ping off both rings, if that ping was still in flight.
+ *
+ * Parameter:
+ * PIN - pin number
+ *
+ */
+bool gpio_read(const int PIN) {
+	pthread_mutex_lock(&sim_lock);
+	bool level = read_pin(PIN);
+	pthread_mutex_unlock(&sim_lock);
+	return level;
+}
+
+/**
+ * Busy waits for a number of microseconds.
+ *
+ * Parameter:
+ * MICROSECONDS - time to wait
+ *
+ */
+void gpio_delay_us(const unsigned MICROSECONDS) {
+	uint64_t end_ns = get_monotonic_ns() + (uint64_t) MICROSECONDS * 1000;
+	while (get_monotonic_ns() < end_ns);
+}
+
+/**
+ * Returns false, as the simulated wheel can only poll pin levels.
+ *
+ */
+bool gpio_has_edges() {
+	return false;
+}
+
+/**
+ * Never waits, as gpio_has_edges is false. Returns 0.
+ *
+ * Replaces:
+ * edges
+ *
+ * Parameters:
+ * PINS - input pins to watch
+ * PIN_CT - # of pins
+ * TIMEOUT_NS - longest to wait
+ * edges - edges seen
+ * CAP - most edges to return
+ *
+ */
+size_t gpio_wait_edges(const int PINS[], const size_t PIN_CT, const uint64_t TIMEOUT_NS, struct gpio_edge edges[], const size_t CAP) {
+	return 0;
+}
+
+/**
+ * Returns the # of sensors registered so far.
+ *
+ */
+size_t sim_sensor_ct() {
+	return sensor_ct;
+}
+
+/**
+ * Moves the ring in front of a sensor at once.
+ *
+ * Parameters:
+ * SENSOR - sensor number
+ * DISTANCE_CM - new distance from sensor to ring
+ *
+ */
+void sim_set_distance(const size_t SENSOR, const float DISTANCE_CM) {
+	sim_move(SENSOR, DISTANCE_CM, 0);
+}
+
+/**
+ * Turns the ring in front of a sensor, so its distance sweeps steadily from where it
+ * is now to DISTANCE_CM over DURATION_NS, passing every position in between.
+ *
+ * Parameters:
+ * SENSOR - sensor number
+ * DISTANCE_CM - distance from sensor to ring at the end of the move
+ * DURATION_NS - time the move takes
+ *
+ */
+void sim_move(const size_t SENSOR, const float DISTANCE_CM, const uint64_t DURATION_NS) {
+	if (SENSOR < MAX_SIM_SENSORS) {
+		pthread_mutex_lock(&sim_lock);
+		move_sensor(SENSOR, DISTANCE_CM, DURATION_NS, get_monotonic_ns());
+		pthread_mutex_unlock(&sim_lock);
+	}
+}
+
+/**
+ * Returns where the ring in front of a sensor is now, or -1 if there is no such sensor.
+ *
+ * Parameter:
+ * SENSOR - sensor number
+ *
+ */
+float sim_get_distance(const size_t SENSOR) {
+	if (SENSOR >= MAX_SIM_SENSORS) {
+		return -1;
+	}
+	pthread_mutex_lock(&sim_lock);
+	float distance_cm = get_ring_cm(&sensors[SENSOR], get_monotonic_ns());
+	pthread_mutex_unlock(&sim_lock);
+	return distance_cm;
+}
+
+/**
+ * Sets how noisy every later ping is.
+ *
+ * Parameters:
+ * NOISE_CM - standard deviation of each reading around the ring's distance
+ * OUTLIER_RATE - chance a ping reads a distance anywhere in the sensor's range
+ * DROPOUT_RATE - chance a ping gets no echo, so the echo pin times out
+ *
+ */
+void sim_set_noise(const float NOISE_CM, const float OUTLIER_RATE, const float DROPOUT_RATE) {
+	noise_cm = NOISE_CM;
+	outlier_rate = OUTLIER_RATE;
+	dropout_rate = DROPOUT_RATE;
+}
+
+/**
+ * Restarts the noise from a seed, so a run can be repeated.
+ *
+ * Parameter:
+ * SEED - any number
+ *
+ */
+void sim_seed(const uint64_t SEED) {
+	/* xorshift must not start at 0 */
+	noise_state = SEED * 6364136223846793005u + 1442695040888963407u;
+	noise_state = noise_state ? noise_state : 1;
+}
+
+/**
+ * Turns crosstalk between adjacent sensors on or off.
+ *
+ * Parameter:
+ * ENABLED - whether adjacent sensors hear each other
+ *
+ */
+void sim_set_crosstalk(const bool ENABLED) {
+	crosstalk = ENABLED;
+}
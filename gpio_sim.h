@@ -0,0 +1,26 @@
+#ifndef GPIO_SIM_H
+#define GPIO_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* most sensors the simulation can hold */
+#define MAX_SIM_SENSORS 96
+
+/*
+ * Controls for the simulated GPIO backend (gpio_sim.c). Sensors are numbered in the
+ * order their trigger pins are set for output, and sensors with adjacent numbers on
+ * the same wheel hear each other's pings unless crosstalk is turned off. Each ping
+ * can be given Gaussian noise, read a random distance, or be lost. Pins may be used
+ * from several threads at once.
+ */
+size_t sim_sensor_ct();
+void sim_set_distance(const size_t SENSOR, const float DISTANCE_CM);
+void sim_move(const size_t SENSOR, const float DISTANCE_CM, const uint64_t DURATION_NS);
+float sim_get_distance(const size_t SENSOR);
+void sim_set_crosstalk(const bool ENABLED);
+void sim_set_noise(const float NOISE_CM, const float OUTLIER_RATE, const float DROPOUT_RATE);
+void sim_seed(const uint64_t SEED);
+
+#endif
@@ -0,0 +1,82 @@
+#include <wiringPi.h>
+#include "gpio.h"
+
+/**
+ * Sets up wiring pi. Returns false on failure.
+ *
+ */
+bool gpio_setup() {
+	return wiringPiSetup() >= 0;
+}
+
+/**
+ * Sets a pin for input or output.
+ *
+ * Parameters:
+ * PIN - wiring pi pin number
+ * MODE - GPIO_INPUT or GPIO_OUTPUT
+ *
+ */
+void gpio_mode(const int PIN, const enum gpio_mode MODE) {
+	pinMode(PIN, MODE == GPIO_OUTPUT ? OUTPUT : INPUT);
+}
+
+/**
+ * Drives an output pin high or low.
+ *
+ * Parameters:
+ * PIN - wiring pi pin number
+ * LEVEL - true for high, false for low
+ *
+ */
+void gpio_write(const int PIN, const bool LEVEL) {
+	digitalWrite(PIN, LEVEL ? HIGH : LOW);
+}
+
+/**
+ * Returns true iff an input pin reads high.
+ *
+ * Parameter:
+ * PIN - wiring pi pin number
+ *
+ */
+bool gpio_read(const int PIN) {
+	return digitalRead(PIN);
+}
+
+/**
+ * Busy waits for a number of microseconds.
+ *
+ * Parameter:
+ * MICROSECONDS - time to wait
+ *
+ */
+void gpio_delay_us(const unsigned MICROSECONDS) {
+	delayMicroseconds(MICROSECONDS);
+}
+
+/**
+ * Returns false, as wiring pi can only poll pin levels.
+ *
+ */
+bool gpio_has_edges() {
+	return false;
+}
+
+/**
+ * Never waits, as gpio_has_edges is false. Returns 0.
+ *
+ * Replaces:
+ * edges
+ *
+ * Parameters:
+ * PINS - input pins to watch
+ * PIN_CT - # of pins
+ * TIMEOUT_NS - longest to wait
+ * edges - edges seen
+ * CAP - most edges to return
+ *
+ */
+size_t gpio_wait_edges(const int PINS[], const size_t PIN_CT, const uint64_t TIMEOUT_NS, struct gpio_edge edges[], const size_t CAP) {
+	return 0;
+}
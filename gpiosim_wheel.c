@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <sys/eventfd.h>
+#include "gpiosim_wheel.h"
+#include "timing.h"
+
+/* where gpio-sim chips are made */
+#define CONFIGFS_DIR "/sys/kernel/config/gpio-sim"
+/* name of the chip made, under CONFIGFS_DIR */
+#define CHIP_NAME "muyuchina"
+/* time from the end of a trigger pulse until the echo line goes high, as on an HC-SR04 */
+#define ECHO_DELAY_NS 400000
+/* speed of sound in cm per ns */
+#define SOUND_SPEED_CM_PER_NS 0.00003432
+
+/**
+ * Writes a string to a file. Returns false on failure.
+ *
+ * Parameters:
+ * PATH - file to write
+ * STR - string to write
+ *
+ */
+bool write_file(const char *PATH, const char *STR) {
+	int fd = open(PATH, O_WRONLY);
+	bool is_written = fd >= 0 && write(fd, STR, strlen(STR)) == (ssize_t) strlen(STR);
+	if (fd >= 0) {
+		close(fd);
+	}
+	return is_written;
+}
+
+/**
+ * Reads the first line of a file, without its newline. Returns false on failure.
+ *
+ * Replaces:
+ * line
+ *
+ * Parameters:
+ * PATH - file to read
+ * line - where to put the line
+ * LEN - size of line
+ *
+ */
+bool read_file_line(const char *PATH, char *line, const size_t LEN) {
+	FILE *file = fopen(PATH, "r");
+	if (file == NULL) {
+		return false;
+	}
+	bool is_read = fgets(line, LEN, file) != NULL;
+	fclose(file);
+	line[strcspn(line, "\n")] = '\0';
+	return is_read;
+}
+
+/**
+ * Returns true iff the gpio-sim module is loaded, and configfs mounted, so chips can be made.
+ *
+ */
+bool has_gpiosim() {
+	struct stat info;
+	return stat(CONFIGFS_DIR, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/**
+ * Makes a live gpio-sim chip with LINE_CT lines. Returns false on failure, after
+ * printing why.
+ *
+ * Replaces:
+ * wheel
+ *
+ * Parameters:
+ * wheel - wheel whose line_dir and chip_path to set
+ * LINE_CT - # of lines on the chip
+ *
+ */
+bool make_chip(struct gpiosim_wheel *wheel, const int LINE_CT) {
+	char dev_name[NAME_MAX + 1], chip_name[NAME_MAX + 1], line_ct_str[16];
+	snprintf(line_ct_str, sizeof(line_ct_str), "%i", LINE_CT);
+	if (mkdir(CONFIGFS_DIR "/" CHIP_NAME, 0755) != 0 || mkdir(CONFIGFS_DIR "/" CHIP_NAME "/bank0", 0755) != 0) {
+		printf("Could not make %s/%s: %s\n", CONFIGFS_DIR, CHIP_NAME, strerror(errno));
+		return false;
+	}
+	if (!write_file(CONFIGFS_DIR "/" CHIP_NAME "/bank0/num_lines", line_ct_str) || !write_file(CONFIGFS_DIR "/" CHIP_NAME "/live", "1") ||
+		!read_file_line(CONFIGFS_DIR "/" CHIP_NAME "/dev_name", dev_name, sizeof(dev_name)) ||
+		!read_file_line(CONFIGFS_DIR "/" CHIP_NAME "/bank0/chip_name", chip_name, sizeof(chip_name))) {
+		printf("Could not bring up the gpio-sim chip: %s\n", strerror(errno));
+		return false;
+	}
+	snprintf(wheel->line_dir, sizeof(wheel->line_dir), "/sys/devices/platform/%s/%s", dev_name, chip_name);
+	snprintf(wheel->chip_path, sizeof(wheel->chip_path), "/dev/%s", chip_name);
+	return true;
+}
+
+/**
+ * Takes down the chip made by make_chip, if any.
+ *
+ */
+void remove_chip() {
+	write_file(CONFIGFS_DIR "/" CHIP_NAME "/live", "0");
+	rmdir(CONFIGFS_DIR "/" CHIP_NAME "/bank0");
+	rmdir(CONFIGFS_DIR "/" CHIP_NAME);
+}
+
+/**
+ * Opens the line attributes of a sensor, and pulls its echo line low. Returns false on
+ * failure.
+ *
+ * Replaces:
+ * sensor
+ *
+ * Parameters:
+ * LINE_DIR - sysfs directory of the chip's lines
+ * sensor - sensor to open
+ *
+ */
+bool open_sensor(const char *LINE_DIR, struct gpiosim_sensor *sensor) {
+	char path[PATH_MAX + 32];
+	snprintf(path, sizeof(path), "%s/sim_gpio%i/value", LINE_DIR, sensor->trigger_line);
+	sensor->trigger_fd = open(path, O_RDONLY);
+	snprintf(path, sizeof(path), "%s/sim_gpio%i/pull", LINE_DIR, sensor->echo_line);
+	sensor->pull_fd = open(path, O_WRONLY);
+	return sensor->trigger_fd >= 0 && sensor->pull_fd >= 0 && pwrite(sensor->pull_fd, "pull-down", 9, 0) == 9;
+}
+
+/**
+ * Pulls the echo lines whose time has come, and returns the time the next one is due, or
+ * 0 if no ping is in flight. The caller holds wheel->lock.
+ *
+ * Parameters:
+ * wheel - wheel to step
+ * NOW_NS - current time
+ *
+ */
+uint64_t pull_due_echoes(struct gpiosim_wheel *wheel, const uint64_t NOW_NS) {
+	uint64_t next_ns = 0;
+	for (size_t i = 0; i < wheel->sensor_ct; i++) {
+		struct gpiosim_sensor *sensor = &wheel->sensors[i];
+		if (sensor->state == PING_DELAY && NOW_NS >= sensor->rise_ns) {
+			(void) !pwrite(sensor->pull_fd, "pull-up", 7, 0);
+			sensor->state = PING_ECHO;
+		}
+		if (sensor->state == PING_ECHO && NOW_NS >= sensor->fall_ns) {
+			(void) !pwrite(sensor->pull_fd, "pull-down", 9, 0);
+			sensor->state = PING_IDLE;
+		}
+		uint64_t due_ns = sensor->state == PING_DELAY ? sensor->rise_ns : sensor->state == PING_ECHO ? sensor->fall_ns : 0;
+		if (due_ns != 0 && (next_ns == 0 || due_ns < next_ns)) {
+			next_ns = due_ns;
+		}
+	}
+	return next_ns;
+}
+
+/**
+ * Thread which answers the sensors' pings: sleeps until a trigger edge wakes it or the
+ * next echo line is due to be pulled, then pulls it. Timer slack is turned down, so each
+ * pull lands within a few us of its time, as the kernel's timestamp of it sets the
+ * distance read.
+ *
+ * Parameter:
+ * arg - wheel to answer for
+ *
+ */
+void *answer_pings(void *arg) {
+	struct gpiosim_wheel *wheel = arg;
+	prctl(PR_SET_TIMERSLACK, 1);
+	pthread_mutex_lock(&wheel->lock);
+	while (wheel->is_running) {
+		uint64_t now_ns = get_monotonic_ns();
+		uint64_t next_ns = pull_due_echoes(wheel, now_ns);
+		pthread_mutex_unlock(&wheel->lock);
+
+		struct pollfd wake = {.fd = wheel->wake_fd, .events = POLLIN};
+		uint64_t wait_ns = next_ns == 0 ? 0 : next_ns > now_ns ? next_ns - now_ns : 1;
+		struct timespec timeout = {wait_ns / 1000000000, wait_ns % 1000000000};
+		uint64_t wake_ct;
+		if (ppoll(&wake, 1, next_ns == 0 ? NULL : &timeout, NULL) > 0) {
+			(void) !read(wheel->wake_fd, &wake_ct, sizeof(wake_ct));
+		}
+		pthread_mutex_lock(&wheel->lock);
+	}
+	pthread_mutex_unlock(&wheel->lock);
+	return NULL;
+}
+
+/**
+ * Makes a gpio-sim chip act as a wheel of HC-SR04s, one per trigger and echo line offset,
+ * and starts answering their pings. Needs root, and the gpio-sim module loaded. Returns
+ * false on failure, after printing why, with the chip taken down.
+ *
+ * Replaces:
+ * wheel
+ *
+ * Parameters:
+ * wheel - wheel to start
+ * TRIGGER_LINES - trigger line offset of each sensor
+ * ECHO_LINES - echo line offset of each sensor
+ * DISTANCES_CM - distance from each sensor to its ring
+ * SENSOR_CT - # of sensors, at most MAX_GPIOSIM_SENSORS
+ *
+ */
+bool start_gpiosim_wheel(struct gpiosim_wheel *wheel, const int TRIGGER_LINES[], const int ECHO_LINES[], const float DISTANCES_CM[],
+	const size_t SENSOR_CT) {
+	int line_ct = 1;
+	if (SENSOR_CT > MAX_GPIOSIM_SENSORS) {
+		printf("At most %i sensors.\n", MAX_GPIOSIM_SENSORS);
+		return false;
+	}
+	wheel->sensor_ct = SENSOR_CT;
+	wheel->unseen_ct = 0;
+	wheel->is_running = false;
+	wheel->wake_fd = -1;
+	for (size_t i = 0; i < SENSOR_CT; i++) {
+		wheel->sensors[i] = (struct gpiosim_sensor) {TRIGGER_LINES[i], ECHO_LINES[i], DISTANCES_CM[i], -1, -1, false, PING_IDLE, 0, 0};
+		line_ct = TRIGGER_LINES[i] >= line_ct ? TRIGGER_LINES[i] + 1 : line_ct;
+		line_ct = ECHO_LINES[i] >= line_ct ? ECHO_LINES[i] + 1 : line_ct;
+	}
+	if (!make_chip(wheel, line_ct)) {
+		remove_chip();
+		return false;
+	}
+	for (size_t i = 0; i < SENSOR_CT; i++) {
+		if (!open_sensor(wheel->line_dir, &wheel->sensors[i])) {
+			printf("Could not open lines %i and %i: %s\n", TRIGGER_LINES[i], ECHO_LINES[i], strerror(errno));
+			stop_gpiosim_wheel(wheel);
+			return false;
+		}
+	}
+	wheel->is_running = true;
+	pthread_mutex_init(&wheel->lock, NULL);
+	if ((wheel->wake_fd = eventfd(0, EFD_CLOEXEC)) < 0 || pthread_create(&wheel->thread, NULL, answer_pings, wheel) != 0) {
+		printf("Could not start answering pings.\n");
+		wheel->is_running = false;
+		stop_gpiosim_wheel(wheel);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Tells the wheel a trigger line was driven, as soon as the write to it is made. On the
+ * end of a trigger pulse, checks that the chip's line went low too, and starts the
+ * sensor's ping: its echo line is pulled high ECHO_DELAY_NS later, and low again once
+ * sound would be back from the ring. gpio-sim raises no event when a consumer drives an
+ * output line, so the write itself is the edge.
+ *
+ * Parameters:
+ * wheel - wheel the line is on
+ * LINE - line offset driven
+ * LEVEL - level it was driven to
+ * NOW_NS - time it was driven
+ *
+ */
+void gpiosim_drive(struct gpiosim_wheel *wheel, const int LINE, const bool LEVEL, const uint64_t NOW_NS) {
+	pthread_mutex_lock(&wheel->lock);
+	for (size_t i = 0; i < wheel->sensor_ct; i++) {
+		struct gpiosim_sensor *sensor = &wheel->sensors[i];
+		if (sensor->trigger_line != LINE) {
+			continue;
+		}
+		char value = '?';
+		if (pread(sensor->trigger_fd, &value, 1, 0) != 1 || value != (LEVEL ? '1' : '0')) {
+			wheel->unseen_ct++;
+		}
+		if (sensor->trigger_high && !LEVEL && sensor->state == PING_IDLE) {
+			sensor->rise_ns = NOW_NS + ECHO_DELAY_NS;
+			sensor->fall_ns = sensor->rise_ns + (uint64_t) (2 * sensor->distance_cm / SOUND_SPEED_CM_PER_NS);
+			sensor->state = PING_DELAY;
+			uint64_t wake = 1;
+			(void) !write(wheel->wake_fd, &wake, sizeof(wake));
+		}
+		sensor->trigger_high = LEVEL;
+	}
+	pthread_mutex_unlock(&wheel->lock);
+}
+
+/**
+ * Stops answering pings, closes the sensors' lines and takes the chip down.
+ *
+ * Parameter:
+ * wheel - wheel to stop
+ *
+ */
+void stop_gpiosim_wheel(struct gpiosim_wheel *wheel) {
+	if (wheel->is_running) {
+		pthread_mutex_lock(&wheel->lock);
+		wheel->is_running = false;
+		pthread_mutex_unlock(&wheel->lock);
+		uint64_t wake = 1;
+		(void) !write(wheel->wake_fd, &wake, sizeof(wake));
+		pthread_join(wheel->thread, NULL);
+	}
+	if (wheel->wake_fd >= 0) {
+		close(wheel->wake_fd);
+		wheel->wake_fd = -1;
+	}
+	for (size_t i = 0; i < wheel->sensor_ct; i++) {
+		if (wheel->sensors[i].trigger_fd >= 0) {
+			close(wheel->sensors[i].trigger_fd);
+		}
+		if (wheel->sensors[i].pull_fd >= 0) {
+			close(wheel->sensors[i].pull_fd);
+		}
+	}
+	remove_chip();
+}
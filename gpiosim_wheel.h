@@ -0,0 +1,63 @@
+#ifndef GPIOSIM_WHEEL_H
+#define GPIOSIM_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <linux/limits.h>
+
+/* most sensors a gpio-sim wheel can answer for */
+#define MAX_GPIOSIM_SENSORS 16
+
+/* progress of one sensor's ping */
+enum ping_state {
+	PING_IDLE,
+	PING_DELAY,
+	PING_ECHO
+};
+
+/* one HC-SR04 on the chip, facing a ring at a fixed distance */
+struct gpiosim_sensor {
+	int trigger_line;
+	int echo_line;
+	float distance_cm;
+	/* value attribute of the trigger line, and pull attribute of the echo line, open for the whole run */
+	int trigger_fd;
+	int pull_fd;
+	bool trigger_high;
+	enum ping_state state;
+	/* time the echo line is pulled high, then low */
+	uint64_t rise_ns;
+	uint64_t fall_ns;
+};
+
+/*
+ * A gpio-sim chip acting as a wheel of HC-SR04s. The thread answering for the sensors is
+ * told of each trigger edge by gpiosim_drive, and pulls the echo line high and then low
+ * at the times an echo from the ring would, so the kernel timestamps the echo's edges
+ * as it would on a Pi.
+ */
+struct gpiosim_wheel {
+	struct gpiosim_sensor sensors[MAX_GPIOSIM_SENSORS];
+	size_t sensor_ct;
+	/* sysfs directory of the chip's lines, each in sim_gpioN, and its device, for GPIO_CHIP */
+	char line_dir[PATH_MAX];
+	char chip_path[PATH_MAX];
+	pthread_t thread;
+	/* guards the sensors' ping state, which gpiosim_drive changes */
+	pthread_mutex_t lock;
+	/* eventfd written to wake the thread for a new ping, or to stop */
+	int wake_fd;
+	bool is_running;
+	/* # of trigger edges the chip's line did not show, so the write never reached it */
+	size_t unseen_ct;
+};
+
+bool has_gpiosim();
+bool start_gpiosim_wheel(struct gpiosim_wheel *wheel, const int TRIGGER_LINES[], const int ECHO_LINES[], const float DISTANCES_CM[],
+	const size_t SENSOR_CT);
+void gpiosim_drive(struct gpiosim_wheel *wheel, const int LINE, const bool LEVEL, const uint64_t NOW_NS);
+void stop_gpiosim_wheel(struct gpiosim_wheel *wheel);
+
+#endif
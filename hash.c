@@ -0,0 +1,17 @@
+#include "hash.h"
+
+/**
+ * Returns the FNV-1a hash of a null-terminated string, as used by every hash table
+ * over roots and English words.
+ *
+ * Parameter:
+ * STR - string to hash
+ *
+ */
+uint32_t hash_string(const char *STR) {
+	uint32_t hash = 2166136261u;
+	while (*STR) {
+		hash = (hash ^ (unsigned char) *STR++) * 16777619u;
+	}
+	return hash;
+}
@@ -0,0 +1,8 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+
+uint32_t hash_string(const char *STR);
+
+#endif
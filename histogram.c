@@ -0,0 +1,108 @@
+#include "histogram.h"
+
+/**
+ * Returns the bucket a value is counted in.
+ *
+ * Parameter:
+ * VALUE - value to find the bucket of
+ *
+ */
+uint64_t get_histogram_bucket(const uint64_t VALUE) {
+	if (VALUE < (1u << HISTOGRAM_SUB_BITS)) {
+		return VALUE;
+	}
+	if (VALUE >> HISTOGRAM_MAX_BITS) {
+		return HISTOGRAM_BUCKET_CT - 1;
+	}
+	/* the top bit picks the power of 2, and the HISTOGRAM_SUB_BITS below it the bucket within */
+	unsigned shift = 63 - __builtin_clzll(VALUE) - HISTOGRAM_SUB_BITS;
+	return ((uint64_t) (shift + 1) << HISTOGRAM_SUB_BITS) + (VALUE >> shift) - (1u << HISTOGRAM_SUB_BITS);
+}
+
+/**
+ * Returns the largest value counted in a bucket.
+ *
+ * Parameter:
+ * BUCKET - bucket to find the value of
+ *
+ */
+uint64_t get_bucket_value(const uint64_t BUCKET) {
+	if (BUCKET < (1u << HISTOGRAM_SUB_BITS)) {
+		return BUCKET;
+	}
+	unsigned shift = (BUCKET >> HISTOGRAM_SUB_BITS) - 1;
+	uint64_t first = ((BUCKET & ((1u << HISTOGRAM_SUB_BITS) - 1)) + (1u << HISTOGRAM_SUB_BITS)) << shift;
+	return first + ((uint64_t) 1 << shift) - 1;
+}
+
+/**
+ * Counts a value in a histogram.
+ *
+ * Parameters:
+ * histogram - histogram to count in
+ * VALUE - value to count, usually in ns
+ *
+ */
+void record_histogram(struct histogram *histogram, const uint64_t VALUE) {
+	histogram->buckets[get_histogram_bucket(VALUE)]++;
+	histogram->count++;
+	histogram->sum += VALUE;
+	if (VALUE > histogram->max) {
+		histogram->max = VALUE;
+	}
+}
+
+/**
+ * Returns the value below which PERCENTILE % of a histogram's values lie, rounded up
+ * to the end of its bucket but never past the largest value. Returns 0 if it is empty.
+ *
+ * Parameters:
+ * histogram - histogram to read
+ * PERCENTILE - percentile from 0 to 100
+ *
+ */
+uint64_t get_histogram_percentile(const struct histogram *histogram, const double PERCENTILE) {
+	/* rank of the value wanted, from 1 */
+	uint64_t rank = PERCENTILE / 100 * histogram->count + 0.5;
+	rank = rank < 1 ? 1 : rank;
+	uint64_t seen = 0;
+	for (uint64_t bucket = 0; bucket < HISTOGRAM_BUCKET_CT && histogram->count > 0; bucket++) {
+		seen += histogram->buckets[bucket];
+		if (seen >= rank) {
+			uint64_t value = get_bucket_value(bucket);
+			return value < histogram->max ? value : histogram->max;
+		}
+	}
+	return histogram->max;
+}
+
+/**
+ * Returns the mean of a histogram's values, or 0 if it is empty.
+ *
+ * Parameter:
+ * histogram - histogram to read
+ *
+ */
+double get_histogram_mean(const struct histogram *histogram) {
+	return histogram->count ? (double) histogram->sum / histogram->count : 0;
+}
+
+/**
+ * Adds every value of one histogram to another.
+ *
+ * Replaces:
+ * histogram
+ *
+ * Parameters:
+ * histogram - histogram to add to
+ * OTHER - histogram to add
+ *
+ */
+void merge_histogram(struct histogram *histogram, const struct histogram *OTHER) {
+	histogram->count += OTHER->count;
+	histogram->sum += OTHER->sum;
+	histogram->max = OTHER->max > histogram->max ? OTHER->max : histogram->max;
+	for (uint64_t bucket = 0; bucket < HISTOGRAM_BUCKET_CT; bucket++) {
+		histogram->buckets[bucket] += OTHER->buckets[bucket];
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/* each power of 2 is split into 2 ^ HISTOGRAM_SUB_BITS buckets, so values are kept within 1 / 16 */
+#define HISTOGRAM_SUB_BITS 4
+/* values from 2 ^ HISTOGRAM_MAX_BITS up (about 4.3 s in ns) all go in the last bucket */
+#define HISTOGRAM_MAX_BITS 32
+#define HISTOGRAM_BUCKET_CT ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/*
+ * Log-linear histogram of durations, as in HDR histograms: recording costs a few
+ * instructions and no allocation, and any percentile can be read back afterwards.
+ */
+struct histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKET_CT];
+};
+
+void record_histogram(struct histogram *histogram, const uint64_t VALUE);
+uint64_t get_histogram_percentile(const struct histogram *histogram, const double PERCENTILE);
+double get_histogram_mean(const struct histogram *histogram);
+void merge_histogram(struct histogram *histogram, const struct histogram *OTHER);
+
+#endif
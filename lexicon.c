@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lexicon.h"
+#include "hash.h"
+#include "translation_table.h"
+
+/* longest line of a lexicon file */
+#define MAX_LEXICON_LINE_LEN 256
+
+/**
+ * Sets up an empty lexicon.
+ *
+ * Replaces:
+ * lexicon
+ *
+ * Parameter:
+ * lexicon - lexicon to set up
+ *
+ */
+void init_lexicon(struct lexicon *lexicon) {
+	*lexicon = (struct lexicon) {NULL, 0, 0, NULL, 0};
+}
+
+/**
+ * Returns the slot holding ROOT, or the empty slot where it would go.
+ *
+ * Parameters:
+ * lexicon - lexicon to search, which must have slots
+ * ROOT - root to find
+ *
+ */
+size_t find_slot(const struct lexicon *lexicon, const char *ROOT) {
+	size_t mask = lexicon->slot_ct - 1;
+	size_t slot = hash_string(ROOT) & mask;
+	/* linear probing ; the table is at most half full, so runs stay short */
+	while (lexicon->slots[slot] != 0 && strcmp(lexicon->entries[lexicon->slots[slot] - 1].root, ROOT)) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/**
+ * Doubles a lexicon's hash table and reinserts every root. Returns false if out of memory.
+ *
+ * Parameter:
+ * lexicon - lexicon to grow
+ *
+ */
+bool grow_slots(struct lexicon *lexicon) {
+	size_t slot_ct = lexicon->slot_ct ? 2 * lexicon->slot_ct : 16;
+	uint32_t *slots = calloc(slot_ct, sizeof(uint32_t));
+	if (slots == NULL) {
+		return false;
+	}
+	free(lexicon->slots);
+	lexicon->slots = slots;
+	lexicon->slot_ct = slot_ct;
+	for (size_t entry = 0; entry < lexicon->entry_ct; entry++) {
+		lexicon->slots[find_slot(lexicon, lexicon->entries[entry].root)] = entry + 1;
+	}
+	return true;
+}
+
+/**
+ * Adds a copy of a verb to a lexicon. Returns false if the root is already in it,
+ * or out of memory.
+ *
+ * Parameters:
+ * lexicon - lexicon to add to
+ * ROOT - Quechua root
+ * FORMS - English forms of the verb
+ *
+ */
+bool add_verb(struct lexicon *lexicon, const char *ROOT, const struct verb_forms *FORMS) {
+	if (find_verb(lexicon, ROOT) >= 0) {
+		return false;
+	}
+	if (2 * (lexicon->entry_ct + 1) > lexicon->slot_ct && !grow_slots(lexicon)) {
+		return false;
+	}
+	if (lexicon->entry_ct == lexicon->entry_cap) {
+		size_t entry_cap = lexicon->entry_cap ? 2 * lexicon->entry_cap : 8;
+		struct lexicon_entry *entries = realloc(lexicon->entries, entry_cap * sizeof(struct lexicon_entry));
+		if (entries == NULL) {
+			return false;
+		}
+		lexicon->entries = entries;
+		lexicon->entry_cap = entry_cap;
+	}
+
+	struct lexicon_entry entry = {
+		strdup(ROOT), {strdup(FORMS->infinitive), strdup(FORMS->progressive), strdup(FORMS->third_person)}
+	};
+	if (!entry.root || !entry.forms.infinitive || !entry.forms.progressive || !entry.forms.third_person) {
+		free((char *) entry.root);
+		free((char *) entry.forms.infinitive);
+		free((char *) entry.forms.progressive);
+		free((char *) entry.forms.third_person);
+		return false;
+	}
+	lexicon->entries[lexicon->entry_ct++] = entry;
+	lexicon->slots[find_slot(lexicon, ROOT)] = lexicon->entry_ct;
+	return true;
+}
+
+/**
+ * Reads verbs from FILENAME into an empty lexicon. Each line holds a root, its English
+ * infinitive, -ing form and third person singular form, separated by tabs. Blank lines
+ * and lines starting with '#' are skipped. Returns false, printing the line at fault,
+ * if the file is missing, a line is malformed, or a root appears twice.
+ *
+ * Replaces:
+ * lexicon
+ *
+ * Parameters:
+ * lexicon - lexicon to fill
+ * FILENAME - file to read
+ *
+ */
+bool load_lexicon(struct lexicon *lexicon, const char *FILENAME) {
+	FILE *file;
+	char line[MAX_LEXICON_LINE_LEN];
+	init_lexicon(lexicon);
+	if ((file = fopen(FILENAME, "r")) == NULL) {
+		return false;
+	}
+
+	bool is_valid = true;
+	for (size_t line_num = 1; is_valid && fgets(line, sizeof(line), file) != NULL; line_num++) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+		char *fields[4], *rest = line;
+		size_t field_ct = 0;
+		while (rest != NULL && field_ct < 4) {
+			fields[field_ct++] = strsep(&rest, "\t");
+		}
+		is_valid = field_ct == 4 && rest == NULL && *fields[0] && *fields[1] && *fields[2] && *fields[3];
+		if (is_valid) {
+			struct verb_forms forms = {fields[1], fields[2], fields[3]};
+			is_valid = add_verb(lexicon, fields[0], &forms);
+		}
+		if (!is_valid) {
+			printf("%s:%zu: expected a new root and three verb forms, separated by tabs\n", FILENAME, line_num);
+		}
+	}
+	fclose(file);
+	if (!is_valid) {
+		free_lexicon(lexicon);
+	}
+	return is_valid;
+}
+
+/**
+ * Returns the index into lexicon->entries of ROOT, or -1 if it is not in the lexicon.
+ * Takes constant time on average, however many verbs there are.
+ *
+ * Parameters:
+ * lexicon - lexicon to search
+ * ROOT - root to find
+ *
+ */
+long find_verb(const struct lexicon *lexicon, const char *ROOT) {
+	if (lexicon->slot_ct == 0) {
+		return -1;
+	}
+	return (long) lexicon->slots[find_slot(lexicon, ROOT)] - 1;
+}
+
+/**
+ * Translates a root from a lexicon with its suffixes to English, as translate_into
+ * does for the built in roots.
+ *
+ * Returns:
+ * TRANSLATE_OK - out holds the full translation
+ * TRANSLATE_TRUNCATED - out holds as much of the translation as fit in cap bytes
+ * TRANSLATE_UNKNOWN_VERB - root is not in the lexicon ; out is empty
+ * TRANSLATE_UNKNOWN_SUFFIX - suffixes[3] is not a subject suffix ; out is empty
+ *
+ * Parameters:
+ * lexicon - lexicon to find the root in
+ * root - A Quechua root word
+ * suffixes - An array of suffixes (see translate_into)
+ * out - buffer to write the translation to
+ * cap - size of out in bytes ; MAX_TRANSLATION_LEN + 1 always fits
+ *
+ */
+enum translate_status translate_lexicon(const struct lexicon *lexicon, const char *root, const char *suffixes[], char *out, const size_t cap) {
+	long verb = find_verb(lexicon, root);
+	int person = get_person(suffixes[3]);
+	if (cap > 0) {
+		out[0] = '\0';
+	}
+	if (verb < 0) {
+		return TRANSLATE_UNKNOWN_VERB;
+	}
+	if (person < 0) {
+		return TRANSLATE_UNKNOWN_SUFFIX;
+	}
+	return translate_features(&lexicon->entries[verb].forms, person, get_features(suffixes), out, cap);
+}
+
+/**
+ * Returns the key root of ROOT (see make_word_key): its index into ROOTS if it is built
+ * in, so its words keep their precomputed translations, or else LEXICON_KEY_ROOT plus
+ * its index into lexicon->entries. Returns -1 if it is in neither, or past MAX_KEY_ROOTS.
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * ROOT - root to find
+ *
+ */
+long find_key_root(const struct lexicon *lexicon, const char *ROOT) {
+	for (size_t root = 0; root < ROOT_CT; root++) {
+		if (!strcmp(ROOT, ROOTS[root])) {
+			return root;
+		}
+	}
+	long verb = lexicon != NULL ? find_verb(lexicon, ROOT) : -1;
+	return verb < 0 || LEXICON_KEY_ROOT + verb >= MAX_KEY_ROOTS ? -1 : LEXICON_KEY_ROOT + verb;
+}
+
+/**
+ * Returns the root a key's root bits stand for (see find_key_root), or NULL if none.
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * KEY - packed word key
+ *
+ */
+const char *get_key_root_name(const struct lexicon *lexicon, const word_key KEY) {
+	size_t root = get_key_root(KEY);
+	if (root < ROOT_CT) {
+		return ROOTS[root];
+	}
+	return lexicon != NULL && root - LEXICON_KEY_ROOT < lexicon->entry_ct ? lexicon->entries[root - LEXICON_KEY_ROOT].root : NULL;
+}
+
+/**
+ * Returns true iff a key's root is built in or in the lexicon, and each of its suffix
+ * indexes is in range, as is_valid_key does for the built in roots alone.
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * KEY - packed word key
+ *
+ */
+bool is_valid_lexicon_key(const struct lexicon *lexicon, const word_key KEY) {
+	if (get_key_root_name(lexicon, KEY) == NULL) {
+		return false;
+	}
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		if (get_key_suffix(KEY, slot) >= SUFFIX_CTS[slot]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Writes the Quechua word a key stands for, as get_quechua_word does, but for roots of
+ * the lexicon too.
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * KEY - packed word key, for which is_valid_lexicon_key must hold
+ * out - buffer to write the word to
+ * cap - size of out in bytes
+ *
+ */
+enum translate_status get_lexicon_word(const struct lexicon *lexicon, const word_key KEY, char *out, const size_t cap) {
+	struct appender word = {out, 0, cap, false};
+	append_format(&word, "%s", get_key_root_name(lexicon, KEY));
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		append_format(&word, "%s", SUFFIXES[slot][get_key_suffix(KEY, slot)]);
+	}
+	return word.truncated ? TRANSLATE_TRUNCATED : TRANSLATE_OK;
+}
+
+/**
+ * Returns the translation of a key. Built in roots are looked up in the precomputed
+ * table, so nothing is written ; verbs of the lexicon are translated into out.
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * KEY - packed word key, for which is_valid_lexicon_key must hold
+ * out - buffer for a lexicon verb's translation
+ * cap - size of out in bytes ; MAX_TRANSLATION_LEN + 1 always fits
+ *
+ */
+const char *lookup_lexicon_translation(const struct lexicon *lexicon, const word_key KEY, char *out, const size_t cap) {
+	size_t root = get_key_root(KEY);
+	if (root < ROOT_CT) {
+		return lookup_translation(KEY);
+	}
+	translate_features(&lexicon->entries[root - LEXICON_KEY_ROOT].forms, get_key_suffix(KEY, 3), get_key_features(KEY), out, cap);
+	return out;
+}
+
+/**
+ * Returns the name of every key root (see find_key_root), for make_segmenter: ROOTS,
+ * then each verb of the lexicon, with NULL for those which are built in, so each word
+ * segments to one key. The caller must free what is returned. Returns NULL if out of
+ * memory, or the lexicon has more verbs than fit in a key.
+ *
+ * Replaces:
+ * name_ct
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * name_ct - # of names returned
+ *
+ */
+const char **make_key_root_names(const struct lexicon *lexicon, size_t *name_ct) {
+	*name_ct = LEXICON_KEY_ROOT + (lexicon != NULL ? lexicon->entry_ct : 0);
+	const char **names = *name_ct <= MAX_KEY_ROOTS ? malloc(*name_ct * sizeof(names[0])) : NULL;
+	if (names == NULL) {
+		return NULL;
+	}
+	for (size_t root = 0; root < *name_ct; root++) {
+		names[root] = root < ROOT_CT ? ROOTS[root] : lexicon->entries[root - LEXICON_KEY_ROOT].root;
+		if (root >= ROOT_CT && find_key_root(NULL, names[root]) >= 0) {
+			names[root] = NULL;
+		}
+	}
+	return names;
+}
+
+/**
+ * Frees everything a lexicon holds, leaving it empty.
+ *
+ * Parameter:
+ * lexicon - lexicon to free
+ *
+ */
+void free_lexicon(struct lexicon *lexicon) {
+	for (size_t entry = 0; entry < lexicon->entry_ct; entry++) {
+		free((char *) lexicon->entries[entry].root);
+		free((char *) lexicon->entries[entry].forms.infinitive);
+		free((char *) lexicon->entries[entry].forms.progressive);
+		free((char *) lexicon->entries[entry].forms.third_person);
+	}
+	free(lexicon->entries);
+	free(lexicon->slots);
+	init_lexicon(lexicon);
+}
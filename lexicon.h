@@ -0,0 +1,44 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "que_to_eng.h"
+
+/* key root of a lexicon's first verb ; key roots below it index ROOTS */
+#define LEXICON_KEY_ROOT ROOT_CT
+/* most key roots, limited by the root bits of a word key */
+#define MAX_KEY_ROOTS (1 << (32 - KEY_SLOT_BITS * SLOT_CT))
+
+/* a Quechua root and its English forms */
+struct lexicon_entry {
+	const char *root;
+	struct verb_forms forms;
+};
+
+/* verbs loaded at run time, found by root through an open addressing hash table */
+struct lexicon {
+	struct lexicon_entry *entries;
+	size_t entry_ct;
+	size_t entry_cap;
+	/* index into entries + 1 of the root hashed to each slot, or 0 if empty */
+	uint32_t *slots;
+	/* # of slots, a power of 2 kept at least twice entry_ct */
+	size_t slot_ct;
+};
+
+void init_lexicon(struct lexicon *lexicon);
+bool add_verb(struct lexicon *lexicon, const char *ROOT, const struct verb_forms *FORMS);
+bool load_lexicon(struct lexicon *lexicon, const char *FILENAME);
+long find_verb(const struct lexicon *lexicon, const char *ROOT);
+enum translate_status translate_lexicon(const struct lexicon *lexicon, const char *root, const char *suffixes[], char *out, const size_t cap);
+long find_key_root(const struct lexicon *lexicon, const char *ROOT);
+const char *get_key_root_name(const struct lexicon *lexicon, const word_key KEY);
+bool is_valid_lexicon_key(const struct lexicon *lexicon, const word_key KEY);
+enum translate_status get_lexicon_word(const struct lexicon *lexicon, const word_key KEY, char *out, const size_t cap);
+const char *lookup_lexicon_translation(const struct lexicon *lexicon, const word_key KEY, char *out, const size_t cap);
+const char **make_key_root_names(const struct lexicon *lexicon, size_t *name_ct);
+void free_lexicon(struct lexicon *lexicon);
+
+#endif
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "live_state.h"
+#include "histogram.h"
+#include "timing.h"
+
+/* most reader threads */
+#define MAX_READERS 64
+
+/* shape of the run */
+struct live_bench_settings {
+	const char *name;
+	size_t reader_ct;
+	/* snapshots published per second, or 0 to publish as fast as possible */
+	double writer_hz;
+	double seconds;
+};
+
+/* the one writer, and what publishing cost it */
+struct live_bench_writer {
+	pthread_t thread;
+	const struct live_bench_settings *settings;
+	struct live_state *state;
+	/* time each publish_snapshot took */
+	struct histogram publish_ns;
+	uint64_t publish_ct;
+};
+
+/* one reader thread, and what it saw */
+struct live_bench_reader {
+	pthread_t thread;
+	const struct live_state *state;
+	uint64_t read_ct;
+	/* # of read_snapshot calls which gave up while the writer kept changing the snapshot */
+	uint64_t failed_ct;
+	/* # of snapshots read which mixed two frames, or went back in time ; must be 0 */
+	uint64_t torn_ct;
+	/* time from a snapshot being published until it was read */
+	struct histogram age_ns;
+};
+
+/* cleared by the main thread to end the run */
+atomic_bool running = true;
+
+/**
+ * Fills every field of a snapshot from its frame count, so a reader can tell a snapshot
+ * made of two frames from a whole one.
+ *
+ * Replaces:
+ * snapshot
+ *
+ * Parameters:
+ * FRAME_CT - frame count of the snapshot
+ * snapshot - snapshot to fill
+ *
+ */
+void make_test_snapshot(const uint64_t FRAME_CT, struct wheel_snapshot *snapshot) {
+	snapshot->frame_ct = FRAME_CT;
+	snapshot->key = FRAME_CT * 2654435761u;
+	snapshot->ring_ct = MAX_LIVE_RINGS;
+	for (size_t ring = 0; ring < MAX_LIVE_RINGS; ring++) {
+		snapshot->distances_cm[ring] = (FRAME_CT + ring) % 1000;
+		snapshot->positions[ring] = FRAME_CT + ring;
+		snapshot->confidences[ring] = ((FRAME_CT + ring) % 100) / 100.0f;
+	}
+	snprintf(snapshot->word, sizeof(snapshot->word), "%lu", (unsigned long) FRAME_CT);
+	memset(snapshot->translation, 'a' + FRAME_CT % 26, sizeof(snapshot->translation) - 1);
+	snapshot->translation[sizeof(snapshot->translation) - 1] = '\0';
+}
+
+/**
+ * Returns true iff every field of a snapshot agrees with its frame count.
+ *
+ * Parameter:
+ * SNAPSHOT - snapshot read
+ *
+ */
+bool is_whole_snapshot(const struct wheel_snapshot *SNAPSHOT) {
+	struct wheel_snapshot expected = {0};
+	make_test_snapshot(SNAPSHOT->frame_ct, &expected);
+	expected.frame_ns = SNAPSHOT->frame_ns;
+	return memcmp(&expected, SNAPSHOT, sizeof(expected)) == 0;
+}
+
+/**
+ * Thread which publishes snapshots for the length of the run, at a fixed rate or as fast
+ * as it can, timing each publish.
+ *
+ * Parameter:
+ * arg - writer to run
+ *
+ */
+void *run_writer(void *arg) {
+	struct live_bench_writer *writer = arg;
+	struct wheel_snapshot snapshot = {0};
+	uint64_t period_ns = writer->settings->writer_hz > 0 ? 1e9 / writer->settings->writer_hz : 0;
+	uint64_t due_ns = get_monotonic_ns();
+	while (atomic_load_explicit(&running, memory_order_relaxed)) {
+		if (period_ns > 0) {
+			due_ns += period_ns;
+			struct timespec due = {due_ns / 1000000000, due_ns % 1000000000};
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+		}
+		make_test_snapshot(writer->publish_ct + 1, &snapshot);
+		uint64_t start_ns = get_monotonic_ns();
+		snapshot.frame_ns = start_ns;
+		publish_snapshot(writer->state, &snapshot);
+		record_histogram(&writer->publish_ns, get_monotonic_ns() - start_ns);
+		writer->publish_ct++;
+	}
+	return NULL;
+}
+
+/**
+ * Thread which reads snapshots back to back for the length of the run, checking each is
+ * whole and no older than the last.
+ *
+ * Parameter:
+ * arg - reader to run
+ *
+ */
+void *run_reader(void *arg) {
+	struct live_bench_reader *reader = arg;
+	struct wheel_snapshot snapshot;
+	uint64_t last_frame_ct = 0;
+	while (atomic_load_explicit(&running, memory_order_relaxed)) {
+		if (!read_snapshot(reader->state, &snapshot)) {
+			reader->failed_ct++;
+			continue;
+		}
+		reader->read_ct++;
+		if (!is_whole_snapshot(&snapshot) || snapshot.frame_ct < last_frame_ct) {
+			reader->torn_ct++;
+		}
+		last_frame_ct = snapshot.frame_ct;
+		/* the age costs a clock read, so only sample it */
+		if (reader->read_ct % 64 == 0) {
+			uint64_t now_ns = get_monotonic_ns();
+			record_histogram(&reader->age_ns, now_ns > snapshot.frame_ns ? now_ns - snapshot.frame_ns : 0);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Writes the results of a run as JSON. Returns false on failure.
+ *
+ * Parameters:
+ * FILENAME - file to write
+ * settings - run's settings
+ * writer - writer's results
+ * total - every reader's results, merged
+ * ELAPSED_SEC - length of the run
+ *
+ */
+bool save_live_results(const char *FILENAME, const struct live_bench_settings *settings, const struct live_bench_writer *writer,
+	const struct live_bench_reader *total, const double ELAPSED_SEC) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "w")) == NULL) {
+		printf("Could not open %s.\n", FILENAME);
+		return false;
+	}
+	fprintf(file, "{\n\"settings\": {\"readers\": %zu, \"writer_hz\": %.1f, \"seconds\": %.1f},\n", settings->reader_ct, settings->writer_hz,
+		settings->seconds);
+	fprintf(file, "\"publishes_per_sec\": %.1f, \"reads_per_sec\": %.1f,\n", writer->publish_ct / ELAPSED_SEC, total->read_ct / ELAPSED_SEC);
+	fprintf(file, "\"publish_ns\": {\"mean\": %.1f, \"p50\": %lu, \"p99\": %lu, \"p99.9\": %lu, \"max\": %lu},\n",
+		get_histogram_mean(&writer->publish_ns), (unsigned long) get_histogram_percentile(&writer->publish_ns, 50),
+		(unsigned long) get_histogram_percentile(&writer->publish_ns, 99), (unsigned long) get_histogram_percentile(&writer->publish_ns, 99.9),
+		(unsigned long) writer->publish_ns.max);
+	fprintf(file, "\"age_us\": {\"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f},\n", get_histogram_percentile(&total->age_ns, 50) / 1e3,
+		get_histogram_percentile(&total->age_ns, 99) / 1e3, total->age_ns.max / 1e3);
+	fprintf(file, "\"failed_reads\": %lu, \"torn_reads\": %lu\n}\n", (unsigned long) total->failed_ct, (unsigned long) total->torn_ct);
+	fclose(file);
+	return true;
+}
+
+/**
+ * Benchmark of the live state segment: one writer publishes snapshots while several
+ * readers read them back to back, as wheel_state and other readers would. Reports read
+ * throughput, what publishing costs the writer while it is read, how stale reads are, and
+ * any snapshot read which mixed two frames. Fails if any did.
+ *
+ * Options:
+ * --name NAME - shared memory to use (default /muyuchina_bench)
+ * --readers N - # of reader threads (default 4)
+ * --writer-hz R - snapshots published per second (default 0, as fast as possible)
+ * --seconds S - length of the run (default 3)
+ * --output FILE - write JSON results to FILE
+ *
+ */
+int main(int argc, char *argv[]) {
+	struct live_bench_settings settings = {"/muyuchina_bench", 4, 0, 3};
+	const char *output = NULL;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--name")) {
+			settings.name = argv[++i];
+		} else if (!strcmp(argv[i], "--readers")) {
+			settings.reader_ct = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--writer-hz")) {
+			settings.writer_hz = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--seconds")) {
+			settings.seconds = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--output")) {
+			output = argv[++i];
+		}
+	}
+	if (settings.reader_ct > MAX_READERS) {
+		printf("At most %i readers.\n", MAX_READERS);
+		return 1;
+	}
+
+	struct live_writer publisher;
+	if (!open_live_state(&publisher, settings.name)) {
+		printf("Could not create shared memory %s.\n", settings.name);
+		return 1;
+	}
+	const struct live_state *state = attach_live_state(settings.name);
+	if (state == NULL) {
+		printf("Could not attach to shared memory %s.\n", settings.name);
+		close_live_state(&publisher);
+		return 1;
+	}
+	struct live_bench_writer *writer = calloc(1, sizeof(*writer));
+	struct live_bench_reader *readers = calloc(MAX_READERS, sizeof(readers[0]));
+	writer->settings = &settings;
+	writer->state = publisher.state;
+
+	uint64_t start_ns = get_monotonic_ns();
+	if (pthread_create(&writer->thread, NULL, run_writer, writer) != 0) {
+		printf("Could not start the writer.\n");
+		return 1;
+	}
+	for (size_t i = 0; i < settings.reader_ct; i++) {
+		readers[i].state = state;
+		if (pthread_create(&readers[i].thread, NULL, run_reader, &readers[i]) != 0) {
+			printf("Could not start reader %zu.\n", i);
+			return 1;
+		}
+	}
+	usleep(settings.seconds * 1e6);
+	atomic_store(&running, false);
+	pthread_join(writer->thread, NULL);
+	struct live_bench_reader total = {0};
+	for (size_t i = 0; i < settings.reader_ct; i++) {
+		pthread_join(readers[i].thread, NULL);
+		merge_histogram(&total.age_ns, &readers[i].age_ns);
+		total.read_ct += readers[i].read_ct;
+		total.failed_ct += readers[i].failed_ct;
+		total.torn_ct += readers[i].torn_ct;
+	}
+	double elapsed_sec = (get_monotonic_ns() - start_ns) / 1e9;
+
+	printf("%lu snapshots published in %.1f s: %.0f per second\n", (unsigned long) writer->publish_ct, elapsed_sec,
+		writer->publish_ct / elapsed_sec);
+	printf("Publish: mean %.0f ns, p50 %lu ns, p99 %lu ns, p99.9 %lu ns, max %lu ns\n", get_histogram_mean(&writer->publish_ns),
+		(unsigned long) get_histogram_percentile(&writer->publish_ns, 50), (unsigned long) get_histogram_percentile(&writer->publish_ns, 99),
+		(unsigned long) get_histogram_percentile(&writer->publish_ns, 99.9), (unsigned long) writer->publish_ns.max);
+	if (settings.reader_ct > 0) {
+		printf("%lu snapshots read by %zu readers: %.0f per second, %.0f per reader\n", (unsigned long) total.read_ct, settings.reader_ct,
+			total.read_ct / elapsed_sec, total.read_ct / elapsed_sec / settings.reader_ct);
+		printf("Age when read: p50 %.2f us, p99 %.2f us, max %.2f us\n", get_histogram_percentile(&total.age_ns, 50) / 1e3,
+			get_histogram_percentile(&total.age_ns, 99) / 1e3, total.age_ns.max / 1e3);
+	}
+	printf("Failed reads: %lu, torn reads: %lu\n", (unsigned long) total.failed_ct, (unsigned long) total.torn_ct);
+	if (output != NULL) {
+		save_live_results(output, &settings, writer, &total, elapsed_sec);
+	}
+	detach_live_state(state);
+	close_live_state(&publisher);
+	free(writer);
+	free(readers);
+	return total.torn_ct == 0 ? 0 : 1;
+}
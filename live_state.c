@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "live_state.h"
+
+/**
+ * Returns the pid of the process publishing to an existing segment, or 0 if it is not a
+ * live state segment or its writer has exited, so it may be taken over.
+ *
+ * Parameter:
+ * FD - segment, open for reading
+ *
+ */
+pid_t get_live_writer_pid(const int FD) {
+	struct live_state header;
+	const size_t HEADER_LEN = offsetof(struct live_state, seq);
+	if (pread(FD, &header, HEADER_LEN, 0) != (ssize_t) HEADER_LEN || memcmp(header.magic, LIVE_STATE_MAGIC, sizeof(header.magic)) ||
+		header.writer_pid == 0) {
+		return 0;
+	}
+	/* EPERM means the process is there, but belongs to someone else */
+	return kill(header.writer_pid, 0) == 0 || errno == EPERM ? (pid_t) header.writer_pid : 0;
+}
+
+/**
+ * Creates the shared memory segment NAME and readies it for publishing. A segment left
+ * by a writer which has exited is taken over, but not one whose writer is still running,
+ * so two drivers never publish to the same segment. Returns false, printing why if
+ * another writer has it, on failure.
+ *
+ * Replaces:
+ * writer
+ *
+ * Parameters:
+ * writer - writer to open
+ * NAME - POSIX shared memory name, starting with '/'
+ *
+ */
+bool open_live_state(struct live_writer *writer, const char *NAME) {
+	if (strlen(NAME) >= sizeof(writer->name)) {
+		return false;
+	}
+	bool is_created = true;
+	int fd = shm_open(NAME, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0 && errno == EEXIST) {
+		is_created = false;
+		fd = shm_open(NAME, O_RDWR, 0);
+	}
+	if (fd < 0) {
+		return false;
+	}
+	pid_t writer_pid = is_created ? 0 : get_live_writer_pid(fd);
+	if (writer_pid != 0) {
+		printf("Shared memory %s is already published to by process %i.\n", NAME, (int) writer_pid);
+		close(fd);
+		return false;
+	}
+	void *map = ftruncate(fd, sizeof(struct live_state)) == 0 ?
+		mmap(NULL, sizeof(struct live_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (is_created) {
+			shm_unlink(NAME);
+		}
+		return false;
+	}
+	strcpy(writer->name, NAME);
+	writer->state = map;
+
+	/* an odd seq keeps readers off the segment until the first snapshot is in */
+	struct live_state *state = writer->state;
+	atomic_store(&state->seq, 1);
+	memset(&state->snapshot, 0, sizeof(state->snapshot));
+	state->version = LIVE_STATE_VERSION;
+	state->size = sizeof(*state);
+	state->writer_pid = getpid();
+	memcpy(state->magic, LIVE_STATE_MAGIC, sizeof(state->magic));
+	return true;
+}
+
+/**
+ * Replaces the snapshot in a segment. Only one thread may publish to a segment. Never
+ * waits, whatever readers are doing.
+ *
+ * Replaces:
+ * state
+ *
+ * Parameters:
+ * state - segment to publish to
+ * SNAPSHOT - newest snapshot
+ *
+ */
+void publish_snapshot(struct live_state *state, const struct wheel_snapshot *SNAPSHOT) {
+	unsigned seq = atomic_load_explicit(&state->seq, memory_order_relaxed);
+	/* seq is odd from open_live_state until the first snapshot */
+	seq += seq % 2 == 0;
+	atomic_store_explicit(&state->seq, seq, memory_order_relaxed);
+	/* the odd seq must be visible before any of the snapshot changes */
+	atomic_thread_fence(memory_order_release);
+	memcpy(&state->snapshot, SNAPSHOT, sizeof(*SNAPSHOT));
+	atomic_store_explicit(&state->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Unmaps a writer's segment and removes it, so readers attaching later find nothing.
+ * Readers already attached keep the last snapshot.
+ *
+ * Parameter:
+ * writer - writer to close
+ *
+ */
+void close_live_state(struct live_writer *writer) {
+	munmap(writer->state, sizeof(*writer->state));
+	shm_unlink(writer->name);
+	writer->state = NULL;
+}
+
+/**
+ * Maps the segment NAME for reading. Returns NULL if there is no such segment, or it was
+ * not written by a driver of this version.
+ *
+ * Parameter:
+ * NAME - POSIX shared memory name, starting with '/'
+ *
+ */
+const struct live_state *attach_live_state(const char *NAME) {
+	int fd = shm_open(NAME, O_RDONLY, 0);
+	struct stat info;
+	if (fd < 0) {
+		return NULL;
+	}
+	void *map = fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(struct live_state) ?
+		mmap(NULL, sizeof(struct live_state), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	const struct live_state *state = map;
+	if (memcmp(state->magic, LIVE_STATE_MAGIC, sizeof(state->magic)) || state->version != LIVE_STATE_VERSION || state->size != sizeof(*state)) {
+		munmap(map, sizeof(struct live_state));
+		return NULL;
+	}
+	return state;
+}
+
+/**
+ * Copies out the newest snapshot whole, retrying if the writer changed it meanwhile.
+ * Returns false if nothing is published yet, or the writer kept changing it for
+ * MAX_LIVE_READ_TRIES tries.
+ *
+ * Replaces:
+ * snapshot
+ *
+ * Parameters:
+ * state - segment to read
+ * snapshot - snapshot read
+ *
+ */
+bool read_snapshot(const struct live_state *state, struct wheel_snapshot *snapshot) {
+	/* the segment is mapped read only, but atomic loads need a non-const object */
+	atomic_uint *seq = (atomic_uint *) &state->seq;
+	for (size_t try = 0; try < MAX_LIVE_READ_TRIES; try++) {
+		unsigned before = atomic_load_explicit(seq, memory_order_acquire);
+		if (before % 2 == 1) {
+			continue;
+		}
+		memcpy(snapshot, &state->snapshot, sizeof(*snapshot));
+		/* the copy must be done before seq is checked again */
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(seq, memory_order_relaxed) == before) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Unmaps a segment mapped by attach_live_state.
+ *
+ * Parameter:
+ * state - segment to unmap
+ *
+ */
+void detach_live_state(const struct live_state *state) {
+	munmap((void *) state, sizeof(*state));
+}
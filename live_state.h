@@ -0,0 +1,68 @@
+#ifndef LIVE_STATE_H
+#define LIVE_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <linux/limits.h>
+#include "que_to_eng.h"
+
+/* first bytes of every live state segment, and the layout version of what follows */
+#define LIVE_STATE_MAGIC "MUYULIVE"
+#define LIVE_STATE_VERSION 1
+/* POSIX shared memory name the driver publishes to unless told otherwise */
+#define DEFAULT_LIVE_STATE_NAME "/muyuchina"
+/* most rings in a snapshot, the same as MAX_RINGS */
+#define MAX_LIVE_RINGS 16
+/* times a reader retries while the writer keeps updating, before giving up */
+#define MAX_LIVE_READ_TRIES 1000
+
+/* what a wheel said as of one frame */
+struct wheel_snapshot {
+	/* # of frames published, this one included, and when this one was (CLOCK_MONOTONIC) */
+	uint64_t frame_ct;
+	uint64_t frame_ns;
+	word_key key;
+	uint32_t ring_ct;
+	/* last reading of each ring, in range or not, or -1 if it has not been read yet */
+	float distances_cm[MAX_LIVE_RINGS];
+	/* decoded position of each ring, and how surely it is there, from 0 to 1 */
+	uint32_t positions[MAX_LIVE_RINGS];
+	float confidences[MAX_LIVE_RINGS];
+	char word[MAX_WORD_LEN + 1];
+	char translation[MAX_TRANSLATION_LEN + 1];
+};
+
+/*
+ * Shared memory segment holding the newest snapshot of a wheel, guarded by a seqlock:
+ * the one writer makes seq odd, copies the snapshot in, then makes seq even again, and
+ * never waits. Readers copy the snapshot out and keep it only if seq was the same even
+ * number before and after, so they never take a lock, make a syscall, or slow the
+ * writer down, however many there are.
+ */
+struct live_state {
+	char magic[8];
+	uint32_t version;
+	/* sizeof(struct live_state), so a reader built for another layout notices */
+	uint32_t size;
+	uint32_t writer_pid;
+	/* on its own cache line, apart from the header readers only read once */
+	_Alignas(64) atomic_uint seq;
+	_Alignas(64) struct wheel_snapshot snapshot;
+};
+
+/* the publishing end of a live state segment */
+struct live_writer {
+	struct live_state *state;
+	char name[NAME_MAX + 1];
+};
+
+bool open_live_state(struct live_writer *writer, const char *NAME);
+void publish_snapshot(struct live_state *state, const struct wheel_snapshot *SNAPSHOT);
+void close_live_state(struct live_writer *writer);
+const struct live_state *attach_live_state(const char *NAME);
+bool read_snapshot(const struct live_state *state, struct wheel_snapshot *snapshot);
+void detach_live_state(const struct live_state *state);
+
+#endif
@@ -1,6 +1,217 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include "que_to_eng.h"
+
+/* known Quechua roots, in the order used for table lookups */
+const char *const ROOTS[ROOT_CT] = {"t'usu", "puklla", "wayk'u", "awa", "llamk'a"};
+
+/* all suffixes per slot, where "" means the slot is left empty */
+const char *const SUFFIXES[SLOT_CT][MAX_SUFFIX_CT] = {
+	{"ri", "rpa", "rpari", ""},
+	{"ku", "mu", "kamu", ""},
+	{"chka", "lla", "chkalla", ""},
+	{"ni", "nki", "n", "yku", "nchik", "nkichik", "nku"},
+	{"ña", "raq", ""},
+	{"pis", "taq", "sina", "puni", ""}
+};
+
+/* # of suffixes per slot */
+const size_t SUFFIX_CTS[SLOT_CT] = {4, 4, 4, 7, 3, 5};
+
+/* features of each suffix, in the same layout as SUFFIXES */
+const unsigned SUFFIX_FEATURES[SLOT_CT][MAX_SUFFIX_CT] = {
+	{HAS_RI, HAS_RPA, HAS_RPA | HAS_RI, 0},
+	{HAS_KU, HAS_MU, HAS_KU | HAS_MU, 0},
+	{HAS_CHKA, HAS_LLA, HAS_CHKA | HAS_LLA, 0},
+	{0, 0, 0, 0, 0, 0, 0},
+	{HAS_NA, HAS_RAQ, 0},
+	{HAS_PIS, HAS_TAQ, HAS_SINA, HAS_PUNI, 0}
+};
+
+/* English verb forms of each root, in the same order as ROOTS */
+const struct verb_forms VERB_FORMS[ROOT_CT] = {
+	{"dance", "dancing", "dances"},
+	{"play", "playing", "plays"},
+	{"cook", "cooking", "cooks"},
+	{"weave", "weaving", "weaves"},
+	{"work", "working", "works"}
+};
+
+/* English forms of each person, in the same order as the subject slot (3) of SUFFIXES */
+const char *const SUBJECTS[PERSON_CT] = {"I", "you", "he/she", "we (but not you)", "we (including you)", "you all", "they"};
+const char *const POSSESSIVES[PERSON_CT] = {"my ", "your ", "their ", "our ", "our ", "your ", "their "};
+const char *const TO_BES[PERSON_CT] = {"am ", "are ", "is ", "are ", "are ", "are ", "are "};
+const char *const TO_GOS[PERSON_CT] = {"go ", "go ", "goes ", "go ", "go ", "go ", "go "};
+/* description of each bit of enum invalid_rule, from lowest */
+const char *const INVALID_RULE_NAMES[INVALID_RULE_CT] = {
+	"-lla, -puni and -ri (\"like to\" with \"about to\")",
+	"-ña and -ri (\"like to\" with \"already\")",
+	"-lla, -taq and -ña (no known translation)",
+	"-lla, -raq and -taq (no known translation)"
+};
+
+/* index of he/she, the only person taking a distinct present tense */
+const size_t THIRD_SINGULAR = 2;
+
+/**
+ * Returns the index of a root and suffix combination, counting the root
+ * as the most significant digit and slot 5 as the least.
+ *
+ * Parameters:
+ * root - index into ROOTS
+ * suffix_idxs - index into SUFFIXES for each of the SLOT_CT slots
+ *
+ */
+size_t get_combination_idx(const size_t root, const size_t suffix_idxs[]) {
+	size_t combination = root;
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		combination = combination * SUFFIX_CTS[slot] + suffix_idxs[slot];
+	}
+	return combination;
+}
+
+/**
+ * Inverse of get_combination_idx.
+ *
+ * Replaces:
+ * root, suffix_idxs
+ *
+ * Parameters:
+ * combination - index such that 0 <= combination < COMBINATION_CT
+ * root - index into ROOTS
+ * suffix_idxs - index into SUFFIXES for each of the SLOT_CT slots
+ *
+ */
+void get_combination(size_t combination, size_t *root, size_t suffix_idxs[]) {
+	for (size_t slot = SLOT_CT; slot-- > 0;) {
+		suffix_idxs[slot] = combination % SUFFIX_CTS[slot];
+		combination /= SUFFIX_CTS[slot];
+	}
+	*root = combination;
+}
+
+/**
+ * Packs a root and suffix combination into a word key.
+ *
+ * Parameters:
+ * root - index into ROOTS
+ * suffix_idxs - index into SUFFIXES for each of the SLOT_CT slots
+ *
+ */
+word_key make_word_key(const size_t root, const size_t suffix_idxs[]) {
+	word_key key = (word_key) root << (SLOT_CT * KEY_SLOT_BITS);
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		key |= (word_key) suffix_idxs[slot] << (slot * KEY_SLOT_BITS);
+	}
+	return key;
+}
+
+/**
+ * Returns the index into ROOTS stored in key.
+ *
+ * Parameter:
+ * key - packed word key
+ *
+ */
+size_t get_key_root(const word_key key) {
+	return key >> (SLOT_CT * KEY_SLOT_BITS);
+}
+
+/**
+ * Returns the index into SUFFIXES[slot] stored in key.
+ *
+ * Parameters:
+ * key - packed word key
+ * slot - suffix slot, where 0 <= slot < SLOT_CT
+ *
+ */
+size_t get_key_suffix(const word_key key, const size_t slot) {
+	return key >> (slot * KEY_SLOT_BITS) & ((1 << KEY_SLOT_BITS) - 1);
+}
+
+/**
+ * Returns true iff every index in key is in range.
+ *
+ * Parameter:
+ * key - packed word key
+ *
+ */
+bool is_valid_key(const word_key key) {
+	if (get_key_root(key) >= ROOT_CT) {
+		return false;
+	}
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		if (get_key_suffix(key, slot) >= SUFFIX_CTS[slot]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Converts a word key to its combination index (see get_combination_idx).
+ *
+ * Parameter:
+ * key - packed word key
+ *
+ */
+size_t get_key_combination(const word_key key) {
+	size_t combination = get_key_root(key);
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		combination = combination * SUFFIX_CTS[slot] + get_key_suffix(key, slot);
+	}
+	return combination;
+}
+
+/**
+ * Converts a combination index (see get_combination_idx) to its word key.
+ *
+ * Parameter:
+ * combination - index such that 0 <= combination < COMBINATION_CT
+ *
+ */
+word_key get_combination_key(const size_t combination) {
+	size_t root, suffix_idxs[SLOT_CT];
+	get_combination(combination, &root, suffix_idxs);
+	return make_word_key(root, suffix_idxs);
+}
+
+/**
+ * Returns the feature flags (see enum suffix_feature) of every suffix in key.
+ *
+ * Parameter:
+ * key - packed word key
+ *
+ */
+unsigned get_key_features(const word_key key) {
+	unsigned features = 0;
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		features |= SUFFIX_FEATURES[slot][get_key_suffix(key, slot)];
+	}
+	return features;
+}
+
+/**
+ * Writes the Quechua word for key into out, which holds cap bytes.
+ * Returns TRANSLATE_TRUNCATED if it did not fit, otherwise TRANSLATE_OK.
+ *
+ * Parameters:
+ * key - packed word key, for which is_valid_key must hold
+ * out - buffer to write the word to
+ * cap - size of out in bytes
+ *
+ */
+enum translate_status get_quechua_word(const word_key key, char *out, const size_t cap) {
+	struct appender word = {out, 0, cap, false};
+	append_format(&word, "%s", ROOTS[get_key_root(key)]);
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		append_format(&word, "%s", SUFFIXES[slot][get_key_suffix(key, slot)]);
+	}
+	return word.truncated ? TRANSLATE_TRUNCATED : TRANSLATE_OK;
+}
 
 /**
  * Return true iff pre is a prefix of str.
@@ -34,7 +245,7 @@ bool is_suffix(const char *str, const char *suf) {
 }
 
 /**
- * Returns the English subject from the Quechua suffix.
+ * Returns the index into SUBJECTS of the Quechua suffix, or -1 if it is not a subject suffix.
  * 
  * Parameter:
  * suffix - Quechua subject suffix. Options:
@@ -42,178 +253,211 @@ bool is_suffix(const char *str, const char *suf) {
  * 	note that in this program, suffixes which accept an object are not allowed.
  *
  */
-const char *get_sub(const char *suffix) {
-	const size_t SUBJECT_CT = 7;
-	const char *suffixes[] = {"ni", "nki", "n", "yku", "nchik", "nkichik", "nku"};
-	const char *subjects[] = {"I", "you", "he/she", "we (but not you)", "we (including you)", "you all", "they"};
-	for (int i = 0; i < SUBJECT_CT; i++) {
-		if (!strcmp(suffixes[i], suffix)) {
-			return subjects[i];
+int get_person(const char *suffix) {
+	for (int i = 0; i < PERSON_CT; i++) {
+		if (!strcmp(SUFFIXES[3][i], suffix)) {
+			return i;
 		}
 	}
 	/* this only happens if an error has occured */
-	return NULL;
+	return -1;
 }
 
 /**
- * Conjugate verb according to person, whether it's progressive, and whether
- * movement is involved.
+ * Returns the English subject from the Quechua suffix, or NULL if it is not a subject suffix.
+ * 
+ * Parameter:
+ * suffix - Quechua subject suffix (see get_person)
+ *
+ */
+const char *get_sub(const char *suffix) {
+	int person = get_person(suffix);
+	return person < 0 ? NULL : SUBJECTS[person];
+}
+
+/**
+ * Returns the feature flags (see enum suffix_feature) of a suffix array by string
+ * matching. This is the reference for SUFFIX_FEATURES.
  *
- * Frees:
- * adverb
+ * Parameter:
+ * suffixes - An array of suffixes (see translate_into)
+ *
+ */
+unsigned get_features(const char *suffixes[]) {
+	return (is_suffix(suffixes[0], "ri") ? HAS_RI : 0) |
+		(is_prefix(suffixes[0], "rpa") ? HAS_RPA : 0) |
+		(!strcmp(suffixes[1], "ku") || !strcmp(suffixes[1], "kamu") ? HAS_KU : 0) |
+		(is_suffix(suffixes[1], "mu") ? HAS_MU : 0) |
+		(is_prefix(suffixes[2], "chka") ? HAS_CHKA : 0) |
+		(is_suffix(suffixes[2], "lla") ? HAS_LLA : 0) |
+		(!strcmp(suffixes[4], "ña") ? HAS_NA : 0) |
+		(!strcmp(suffixes[4], "raq") ? HAS_RAQ : 0) |
+		(!strcmp(suffixes[5], "pis") ? HAS_PIS : 0) |
+		(!strcmp(suffixes[5], "taq") ? HAS_TAQ : 0) |
+		(!strcmp(suffixes[5], "sina") ? HAS_SINA : 0) |
+		(!strcmp(suffixes[5], "puni") ? HAS_PUNI : 0);
+}
+
+/**
+ * Returns the rules (see enum invalid_rule) that a set of suffix features breaks.
+ * A word has a translation iff this is 0.
+ *
+ * Parameter:
+ * features - feature flags (see enum suffix_feature) of the suffixes
+ *
+ */
+unsigned get_invalid_rules(const unsigned features) {
+	unsigned rules = 0;
+	if ((features & (HAS_LLA | HAS_PUNI | HAS_RI)) == (HAS_LLA | HAS_PUNI | HAS_RI)) {
+		/* this would combine "like to" with "about to" which doesn't make sense */
+		rules |= RULE_LIKE_TO_ABOUT_TO;
+	}
+	if ((features & (HAS_NA | HAS_RI)) == (HAS_NA | HAS_RI)) {
+		/* this would combine "like to" with "already" which doesn't make sense */
+		rules |= RULE_LIKE_TO_ALREADY;
+	}
+
+	/* TODO - Update these. Simply don't know how to translate. */
+	if ((features & (HAS_LLA | HAS_TAQ | HAS_NA)) == (HAS_LLA | HAS_TAQ | HAS_NA)) {
+		rules |= RULE_LLA_TAQ_NA;
+	}
+	if ((features & (HAS_LLA | HAS_RAQ | HAS_TAQ)) == (HAS_LLA | HAS_RAQ | HAS_TAQ)) {
+		rules |= RULE_LLA_RAQ_TAQ;
+	}
+	return rules;
+}
+
+/**
+ * Appends formatted text to app, as sprintf(app->str + app->len, ...) would, but never
+ * writes past app->cap bytes (including the null terminator). Text that does not fit
+ * is dropped and app->truncated is set.
  *
  * Parameters:
- * verb - standard dictionary form of English verb
- * sub - subject of sentence. Options: "I", "we (including you)", "we (but not you)", "you", "you all", "he/she", "they"
+ * app - appender to write to
+ * format - printf style format string
+ *
+ */
+void append_format(struct appender *app, const char *format, ...) {
+	if (app->cap == 0) {
+		app->truncated = true;
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(app->str + app->len, app->cap - app->len, format, args);
+	va_end(args);
+	if (written < 0) {
+		app->truncated = true;
+	} else if ((size_t) written >= app->cap - app->len) {
+		app->truncated = true;
+		app->len = app->cap - 1;
+	} else {
+		app->len += written;
+	}
+}
+
+/**
+ * Conjugate verb according to person, whether it's progressive, and whether
+ * movement is involved, and append it to app.
+ *
+ * Parameters:
+ * app - appender to write the conjugation to
+ * verb - English forms of the verb
+ * person - index into SUBJECTS of the subject
  * progressive - whether it should be progressive
  * movement - whether movement is involved
  * adverb - adverb to be attached to verb
  * pleasure - whether the action is enjoyed rathr than done
  *
  */
-char *conjugate(const char *verb, const char *sub, const bool progressive, const bool movement, char *adverb, const bool pleasure, const bool about_to) {
-	const size_t MAX_TO_BE_LEN = 4;
-	const size_t MAX_TO_GO_LEN = 5;
-	const size_t MAX_CONJUGATION_LEN = 100;
-	
-	/* return value */
-	char *conjugation = calloc(MAX_CONJUGATION_LEN + 1, 1);
-	
+void conjugate(struct appender *app, const struct verb_forms *verb, const size_t person, const bool progressive, const bool movement, const char *adverb, const bool pleasure, const bool about_to) {
 	/* conjugate "to go", "to be", and find possessive variant of subject */
-	char *poss = !strcmp(sub, "I") ? "my " :
-		is_prefix(sub, "you") ? "your " :
-		is_prefix(sub, "we") ? "our " :
-		"their ";
-	char to_be[strlen(adverb) + MAX_TO_BE_LEN];
-	char to_go[MAX_TO_GO_LEN + 1];
-	sprintf(to_be,"%s",
-		!strcmp(sub, "I") ? "am " :
-		!strcmp(sub, "he/she") ? "is " :
-		"are ");
-	sprintf(to_go,"%s", !strcmp(sub, "he/she") ? "goes " : "go ");
+	const char *poss = POSSESSIVES[person];
+	const char *to_be = TO_BES[person];
+	const char *to_go = TO_GOS[person];
 
 	/* conjugate verb */
 	if (pleasure) {
-		sprintf(conjugation, "%s%s", adverb, !strcmp(sub, "he/she") ? "likes to " : "like to ");
+		append_format(app, "%s%s", adverb, person == THIRD_SINGULAR ? "likes to " : "like to ");
 	} else if (about_to) {
-		sprintf(conjugation, "%s%sabout to ", adverb, to_be);
+		append_format(app, "%s%sabout to ", adverb, to_be);
 	}
 	bool infinitive = pleasure || about_to;
 	if (infinitive) {
-		sprintf(to_be, "be ");
-		sprintf(to_go, "go ");
-		adverb[0] = '\0';
+		to_be = "be ";
+		to_go = "go ";
+		adverb = "";
 	}
 	if (movement) {
 		if (progressive) {
-			sprintf(conjugation + strlen(conjugation), "%s%son %sway to %s", to_be, adverb, poss, verb);
+			append_format(app, "%s%son %sway to %s", to_be, adverb, poss, verb->infinitive);
 		} else {
-			sprintf(conjugation + strlen(conjugation), "%s%sto %s", adverb, to_go, verb);
+			append_format(app, "%s%sto %s", adverb, to_go, verb->infinitive);
 		}
+	} else if (progressive) {
+		append_format(app, "%s%s%s", to_be, adverb, verb->progressive);
+	} else if (infinitive || person != THIRD_SINGULAR) {
+		append_format(app, "%s%s", adverb, verb->infinitive);
 	} else {
-		const char *infinitives[] = {"dance", "play", "cook", "weave", "work"};
-		const char *progressives[] = {"dancing", "playing", "cooking", "weaving", "working"};
-		const char *thirdpersons[] = {"dances", "plays", "cooks", "weaves", "works"};
-		bool found_verb = false;
-		for (size_t i = 0; !found_verb && i < sizeof(infinitives) / sizeof(infinitives[0]); i++) {
-			if (!strcmp(verb, infinitives[i])) {
-				if (progressive) {
-					sprintf(conjugation + strlen(conjugation), "%s%s%s", to_be, adverb, progressives[i]);
-				} else if (infinitive || strcmp(sub, "he/she")) {
-					sprintf(conjugation + strlen(conjugation), "%s%s", adverb, infinitives[i]);
-				} else {
-					sprintf(conjugation + strlen(conjugation), "%s%s", adverb, thirdpersons[i]);
-				}
-				found_verb = true;
-			}
-		}
-		if (!found_verb) {
-			exit(1);
-		}
+		append_format(app, "%s%s", adverb, verb->third_person);
 	}
-
-	free(adverb);
-	return conjugation;
-
 }
 
 /**
- * Translates a given root in Quechua with its suffixes to English.
+ * Translates a verb with a subject and suffix features to English, writing the
+ * null-terminated result into out.
+ * Returns TRANSLATE_TRUNCATED if the translation did not fit, otherwise TRANSLATE_OK.
  *
  * Parameters:
- * root - A Quechua root word (t'usuy, pukllay, wayk'uy, away, llamk'ay)
- * suffixes - An array of suffixes with the following options: (or none for all except 3)
- * 	0: ri, rpa, rpari
- * 	1: ku, mu, kamu
- * 	2: chka, lla, chkalla
- * 	3: ni, nki, n, yku, nchik, nkichik, nku
- * 	4: ña, raq
- * 	5: pis, taq, sina, puni
+ * verb - English forms of the verb
+ * person - index into SUBJECTS of the subject
+ * features - feature flags (see enum suffix_feature) of the suffixes
+ * out - buffer to write the translation to
+ * cap - size of out in bytes
  *
  */
-char *translate(const char *root, const char *suffixes[]) {
-	const size_t MAX_TRANSLATION_LEN = 250;
+enum translate_status translate_features(const struct verb_forms *verb, const size_t person, const unsigned features, char *out, const size_t cap) {
 	const size_t MAX_ADVERB_LEN = 25;
-	char *translation = calloc(MAX_TRANSLATION_LEN + 1, 1);
-	char *verb = !strcmp(root, "t'usu") ? "dance" :
-		!strcmp(root, "puklla") ? "play" :
-		!strcmp(root, "wayk'u") ? "cook" :
-		!strcmp(root, "awa") ? "weave" :
-		!strcmp(root, "llamk'a") ? "work" :
-		"unkwnown";
-	const char *sub = get_sub(suffixes[3]);
-	const bool has_ku = !strcmp(suffixes[1], "ku") || !strcmp(suffixes[1], "kamu"),
-		has_mu = is_suffix(suffixes[1], "mu"),
-		has_lla = is_suffix(suffixes[2], "lla"),
-		has_raq = !strcmp(suffixes[4], "raq"),
-		has_chka = is_prefix(suffixes[2], "chka"),
-		has_puni = !strcmp(suffixes[5], "puni"),
-		has_pis = !strcmp(suffixes[5], "pis"),
-		has_ri = is_suffix(suffixes[0], "ri"),
-		has_na = !strcmp(suffixes[4], "ña"),
-		has_taq = !strcmp(suffixes[5], "taq");
-	bool is_valid = true, is_upset = false, about_to = false;
-	char *adverb = calloc(MAX_ADVERB_LEN + 1, 1);
-
-	/* handle invalid combinations */
-	if (has_lla && has_puni && has_ri) {
-		/* this would combine "like to" with "about to" which doesn't make sense */
-		is_valid = false;
-	}
-	if (has_na && has_ri) {
-		/* this would combine "like to" with "already" which doesn't make sense */
-		is_valid = false;
+	struct appender translation = {out, 0, cap, false};
+	char adverb_str[MAX_ADVERB_LEN + 1];
+	struct appender adverb = {adverb_str, 0, sizeof(adverb_str), false};
+	const bool has_ku = features & HAS_KU,
+		has_mu = features & HAS_MU,
+		has_lla = features & HAS_LLA,
+		has_raq = features & HAS_RAQ,
+		has_chka = features & HAS_CHKA,
+		has_puni = features & HAS_PUNI,
+		has_pis = features & HAS_PIS,
+		has_ri = features & HAS_RI,
+		has_na = features & HAS_NA,
+		has_taq = features & HAS_TAQ;
+	bool is_valid = !get_invalid_rules(features), is_upset = false, about_to = false;
+	if (cap > 0) {
+		out[0] = '\0';
 	}
+	adverb_str[0] = '\0';
 
-	/* TODO - Update these. Simply don't know how to translate. */
-	if (has_lla && has_taq && has_na) {
-		is_valid = false;
-	}
-	if (has_lla && has_raq && has_taq) {
-		is_valid = false;
-	}
-	
 	/* handle special suffix combinations (pt 1) */
 	if (has_puni && !has_lla) {
-		sprintf(translation, "of course ");
-	} else if (!strcmp(suffixes[5], "sina")) {
-		sprintf(translation, "most likely, ");
+		append_format(&translation, "of course ");
+	} else if (features & HAS_SINA) {
+		append_format(&translation, "most likely, ");
 	} else if (has_taq && !has_lla) {
-		sprintf(translation, "but ");
+		append_format(&translation, "but ");
 	} else if (has_pis && !has_lla) {
-		sprintf(adverb, "also ");
+		append_format(&adverb, "also ");
 	} else if (has_pis && has_lla) {
-		sprintf(translation, "nonetheless ");
+		append_format(&translation, "nonetheless ");
 	}
 	if (has_na && !has_taq && !has_lla) {
-		sprintf(adverb + strlen(adverb), "still ");
+		append_format(&adverb, "still ");
 		is_upset= true;
 	}
 	if (has_lla && !has_na) {
 		if (has_raq) {
-			sprintf(adverb + strlen(adverb), "still ");
+			append_format(&adverb, "still ");
 		} else {
-			sprintf(adverb + strlen(adverb), "only ");
+			append_format(&adverb, "only ");
 		}
 		if (has_puni) {
 			about_to = true;
@@ -226,43 +470,132 @@ char *translate(const char *root, const char *suffixes[]) {
 	}
 
 	/* add pronoun and conjugate verb */
-	sprintf(translation + strlen(translation), "%s ", sub);
-	char *conjugation = conjugate(verb, sub, has_chka, has_mu, adverb, has_ri, about_to);
-	sprintf(translation + strlen(translation), "%s", conjugation);
-	free(conjugation);
+	append_format(&translation, "%s ", SUBJECTS[person]);
+	conjugate(&translation, verb, person, has_chka, has_mu, adverb_str, has_ri, about_to);
 	
 	/* handle special suffix combinations (pt 2) */
-	if (is_prefix(suffixes[0], "rpa")) {
-		sprintf(translation + strlen(translation), " quickly");
+	if (features & HAS_RPA) {
+		append_format(&translation, " quickly");
 	}
 	if (has_ku) {
-		sprintf(translation + strlen(translation), " alone");
+		append_format(&translation, " alone");
 	}
 	if (has_raq && !has_lla) {
-		sprintf(translation + strlen(translation), " first");
+		append_format(&translation, " first");
 	}
 	if ((has_lla || has_na) && has_taq) {
-		sprintf(translation + strlen(translation), " again");
+		append_format(&translation, " again");
 	}
 	if (has_lla && has_na) {
-		sprintf(translation + strlen(translation), " instead");
+		append_format(&translation, " instead");
 	}
 
 	/* add ! to signal anger */
 	if (is_upset) {
-		sprintf(translation + strlen(translation), "!");
+		append_format(&translation, "!");
 	} else {
-		sprintf(translation + strlen(translation), ".");
+		append_format(&translation, ".");
 	}
 
 	/* capitalize start of translation */
-	if ('a' <= translation[0] && translation[0] <= 'z') {
-		translation[0] -= 'a' - 'A';
+	if (translation.len > 0 && 'a' <= out[0] && out[0] <= 'z') {
+		out[0] -= 'a' - 'A';
 	}
 	if (!is_valid) {
-		sprintf(translation, "Invalid input");
+		translation.len = 0;
+		translation.truncated = false;
+		append_format(&translation, "Invalid input");
 	}
 
-	return translation;
+	return translation.truncated ? TRANSLATE_TRUNCATED : TRANSLATE_OK;
 }
 
+/**
+ * Translates a packed word key to English, writing the null-terminated result into out.
+ * Feature flags come straight from the suffix indices, so no strings are compared.
+ * Allocates nothing, so it is safe to call from several threads at once.
+ *
+ * Returns:
+ * TRANSLATE_OK - out holds the full translation
+ * TRANSLATE_TRUNCATED - out holds as much of the translation as fit in cap bytes
+ * TRANSLATE_UNKNOWN_VERB - the root index is out of range ; out is empty
+ * TRANSLATE_UNKNOWN_SUFFIX - a suffix index is out of range ; out is empty
+ *
+ * Parameters:
+ * key - packed word key
+ * out - buffer to write the translation to
+ * cap - size of out in bytes ; MAX_TRANSLATION_LEN + 1 always fits
+ *
+ */
+enum translate_status translate_key(const word_key key, char *out, const size_t cap) {
+	if (cap > 0) {
+		out[0] = '\0';
+	}
+	if (get_key_root(key) >= ROOT_CT) {
+		return TRANSLATE_UNKNOWN_VERB;
+	}
+	if (!is_valid_key(key)) {
+		return TRANSLATE_UNKNOWN_SUFFIX;
+	}
+	return translate_features(&VERB_FORMS[get_key_root(key)], get_key_suffix(key, 3), get_key_features(key), out, cap);
+}
+
+/**
+ * Translates a given root in Quechua with its suffixes to English, writing the
+ * null-terminated result into out. Allocates nothing, so it is safe to call from
+ * several threads at once.
+ *
+ * Returns:
+ * TRANSLATE_OK - out holds the full translation
+ * TRANSLATE_TRUNCATED - out holds as much of the translation as fit in cap bytes
+ * TRANSLATE_UNKNOWN_VERB - root has no known English verb ; out is empty
+ * TRANSLATE_UNKNOWN_SUFFIX - suffixes[3] is not a subject suffix ; out is empty
+ *
+ * Parameters:
+ * root - A Quechua root word (t'usuy, pukllay, wayk'uy, away, llamk'ay)
+ * suffixes - An array of suffixes with the following options: (or none for all except 3)
+ * 	0: ri, rpa, rpari
+ * 	1: ku, mu, kamu
+ * 	2: chka, lla, chkalla
+ * 	3: ni, nki, n, yku, nchik, nkichik, nku
+ * 	4: ña, raq
+ * 	5: pis, taq, sina, puni
+ * out - buffer to write the translation to
+ * cap - size of out in bytes ; MAX_TRANSLATION_LEN + 1 always fits
+ *
+ */
+enum translate_status translate_into(const char *root, const char *suffixes[], char *out, const size_t cap) {
+	size_t verb = 0;
+	while (verb < ROOT_CT && strcmp(root, ROOTS[verb])) {
+		verb++;
+	}
+	int person = get_person(suffixes[3]);
+	if (cap > 0) {
+		out[0] = '\0';
+	}
+	if (verb == ROOT_CT) {
+		return TRANSLATE_UNKNOWN_VERB;
+	}
+	if (person < 0) {
+		return TRANSLATE_UNKNOWN_SUFFIX;
+	}
+	return translate_features(&VERB_FORMS[verb], person, get_features(suffixes), out, cap);
+}
+
+/**
+ * Translates a given root in Quechua with its suffixes to English.
+ * Returns NULL if the root or subject suffix is unknown, or if out of memory.
+ *
+ * Parameters:
+ * root - A Quechua root word (t'usuy, pukllay, wayk'uy, away, llamk'ay)
+ * suffixes - An array of suffixes (see translate_into)
+ *
+ */
+char *translate(const char *root, const char *suffixes[]) {
+	char *translation = calloc(MAX_TRANSLATION_LEN + 1, 1);
+	if (translation == NULL || translate_into(root, suffixes, translation, MAX_TRANSLATION_LEN + 1) > TRANSLATE_TRUNCATED) {
+		free(translation);
+		return NULL;
+	}
+	return translation;
+}
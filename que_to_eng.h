@@ -1,2 +1,113 @@
+#ifndef QUE_TO_ENG_H
+#define QUE_TO_ENG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* # of known roots */
+#define ROOT_CT 5
+/* # of suffix slots in a word */
+#define SLOT_CT 6
+/* largest # of suffixes in any one slot */
+#define MAX_SUFFIX_CT 7
+/* # of subject suffixes (slot 3) */
+#define PERSON_CT 7
+/* # of root and suffix combinations */
+#define COMBINATION_CT (ROOT_CT * 4 * 4 * 4 * 7 * 3 * 5)
+
+/* longest translation, not counting the null terminator */
+#define MAX_TRANSLATION_LEN 250
+/* longest Quechua word, not counting the null terminator */
+#define MAX_WORD_LEN 64
+
+/*
+ * A word key packs a root and its suffixes into one integer:
+ * bits [3 * slot, 3 * slot + 3) hold the index into SUFFIXES[slot],
+ * and the bits from 3 * SLOT_CT up hold the index into ROOTS.
+ */
+typedef uint32_t word_key;
+#define KEY_SLOT_BITS 3
+
+/* result of translate_into, from best to worst */
+enum translate_status {
+	TRANSLATE_OK,
+	TRANSLATE_TRUNCATED,
+	TRANSLATE_UNKNOWN_VERB,
+	TRANSLATE_UNKNOWN_SUFFIX
+};
+
+/* flags for the meaning-bearing parts of the suffixes in a word */
+enum suffix_feature {
+	HAS_RI = 1 << 0,
+	HAS_RPA = 1 << 1,
+	HAS_KU = 1 << 2,
+	HAS_MU = 1 << 3,
+	HAS_CHKA = 1 << 4,
+	HAS_LLA = 1 << 5,
+	HAS_NA = 1 << 6,
+	HAS_RAQ = 1 << 7,
+	HAS_PIS = 1 << 8,
+	HAS_TAQ = 1 << 9,
+	HAS_SINA = 1 << 10,
+	HAS_PUNI = 1 << 11
+};
+
+/* rules under which a word has no translation */
+enum invalid_rule {
+	RULE_LIKE_TO_ABOUT_TO = 1 << 0,
+	RULE_LIKE_TO_ALREADY = 1 << 1,
+	RULE_LLA_TAQ_NA = 1 << 2,
+	RULE_LLA_RAQ_TAQ = 1 << 3
+};
+#define INVALID_RULE_CT 4
+
+/* English forms of a verb, as used by conjugate */
+struct verb_forms {
+	const char *infinitive;
+	const char *progressive;
+	const char *third_person;
+};
+
+/* length-tracked string builder over a fixed buffer */
+struct appender {
+	char *str;
+	size_t len;
+	size_t cap;
+	bool truncated;
+};
+
+extern const char *const ROOTS[ROOT_CT];
+extern const char *const SUFFIXES[SLOT_CT][MAX_SUFFIX_CT];
+extern const size_t SUFFIX_CTS[SLOT_CT];
+extern const unsigned SUFFIX_FEATURES[SLOT_CT][MAX_SUFFIX_CT];
+extern const struct verb_forms VERB_FORMS[ROOT_CT];
+extern const char *const SUBJECTS[PERSON_CT];
+extern const char *const INVALID_RULE_NAMES[INVALID_RULE_CT];
+
+size_t get_combination_idx(const size_t root, const size_t suffix_idxs[]);
+void get_combination(size_t combination, size_t *root, size_t suffix_idxs[]);
+word_key make_word_key(const size_t root, const size_t suffix_idxs[]);
+size_t get_key_root(const word_key key);
+size_t get_key_suffix(const word_key key, const size_t slot);
+bool is_valid_key(const word_key key);
+size_t get_key_combination(const word_key key);
+word_key get_combination_key(const size_t combination);
+unsigned get_key_features(const word_key key);
+enum translate_status get_quechua_word(const word_key key, char *out, const size_t cap);
+
+bool is_prefix(const char *str, const char *pre);
+bool is_suffix(const char *str, const char *suf);
+int get_person(const char *suffix);
+const char *get_sub(const char *suffix);
+unsigned get_features(const char *suffixes[]);
+unsigned get_invalid_rules(const unsigned features);
+
+void append_format(struct appender *app, const char *format, ...);
+void conjugate(struct appender *app, const struct verb_forms *verb, const size_t person, const bool progressive, const bool movement, const char *adverb, const bool pleasure, const bool about_to);
+enum translate_status translate_features(const struct verb_forms *verb, const size_t person, const unsigned features, char *out, const size_t cap);
+enum translate_status translate_key(const word_key key, char *out, const size_t cap);
+enum translate_status translate_into(const char *root, const char *suffixes[], char *out, const size_t cap);
 char *translate(const char *root, const char *suffixes[]);
 
+#endif
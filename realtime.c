@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "realtime.h"
+
+/**
+ * Locks every page of the process in memory, now and as it grows, and keeps the
+ * allocator from handing pages back, so the sensing loop never waits on a page fault.
+ * Returns false if the process may not lock memory (without CAP_IPC_LOCK, or beyond
+ * RLIMIT_MEMLOCK).
+ *
+ */
+bool lock_memory() {
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		return false;
+	}
+	/* freed memory stays mapped, and large blocks come from the locked heap rather than new mappings */
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	return true;
+}
+
+/**
+ * Touches PREFAULT_STACK_LEN bytes of the calling thread's stack, so its pages are
+ * mapped (and, once memory is locked, locked) before the sensing loop needs them.
+ *
+ */
+void prefault_stack() {
+	volatile unsigned char stack[PREFAULT_STACK_LEN];
+	const size_t PAGE_LEN = sysconf(_SC_PAGESIZE);
+	for (size_t i = 0; i < PREFAULT_STACK_LEN; i += PAGE_LEN) {
+		stack[i] = 0;
+	}
+	/* read back, so the writes count as used */
+	(void) stack[0];
+}
+
+/**
+ * Pins the calling thread to one CPU. Returns false if the CPU is offline or outside
+ * the process's set.
+ *
+ * Parameter:
+ * CPU - CPU to run on
+ *
+ */
+bool pin_thread(const int CPU) {
+	cpu_set_t cpus;
+	if (CPU < 0 || CPU >= CPU_SETSIZE) {
+		return false;
+	}
+	CPU_ZERO(&cpus);
+	CPU_SET(CPU, &cpus);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+/**
+ * Runs the calling thread under SCHED_FIFO, so it is only preempted by higher priority
+ * real-time threads. Returns false if the process lacks CAP_SYS_NICE (or RLIMIT_RTPRIO
+ * is too low), leaving the thread as it was.
+ *
+ * Parameter:
+ * PRIORITY - real-time priority, from 1 to 99
+ *
+ */
+bool set_fifo_priority(const int PRIORITY) {
+	struct sched_param param = {.sched_priority = PRIORITY};
+	return PRIORITY >= sched_get_priority_min(SCHED_FIFO) && PRIORITY <= sched_get_priority_max(SCHED_FIFO) &&
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+/**
+ * Puts the calling thread in real-time mode, if settings enable it: locks memory,
+ * prefaults the stack, pins the thread and raises it to SCHED_FIFO. Each step that is
+ * not permitted is skipped with a note, and the rest still go ahead. Threads started
+ * afterwards inherit the CPU and priority, so start helper threads first.
+ *
+ * Replaces:
+ * status
+ *
+ * Parameters:
+ * settings - real-time settings
+ * status - which steps took effect
+ *
+ */
+void enter_realtime(const struct realtime_settings *settings, struct realtime_status *status) {
+	*status = (struct realtime_status) {-1, 0, false};
+	if (!settings->is_enabled) {
+		return;
+	}
+	if (!(status->is_locked = lock_memory())) {
+		printf("Could not lock memory (%s) ; page faults may still delay pings.\n", strerror(errno));
+	}
+	prefault_stack();
+	int cpu = settings->cpu >= 0 ? settings->cpu : sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (pin_thread(cpu)) {
+		status->cpu = cpu;
+	} else {
+		printf("Could not pin the sensing thread to CPU %i ; it may migrate.\n", cpu);
+	}
+	if (set_fifo_priority(settings->priority)) {
+		status->priority = settings->priority;
+	} else {
+		printf("Could not run under SCHED_FIFO at priority %i (needs CAP_SYS_NICE) ; other tasks may preempt pings.\n", settings->priority);
+	}
+}
+
+/**
+ * Prints which parts of the real-time mode are in effect.
+ *
+ * Parameters:
+ * status - status to print
+ * file - file to print to
+ *
+ */
+void print_realtime_status(const struct realtime_status *status, FILE *file) {
+	if (status->cpu < 0 && status->priority == 0 && !status->is_locked) {
+		fprintf(file, "Real-time mode: off\n");
+		return;
+	}
+	fprintf(file, "Real-time mode:");
+	if (status->cpu >= 0) {
+		fprintf(file, " pinned to CPU %i,", status->cpu);
+	}
+	if (status->priority > 0) {
+		fprintf(file, " SCHED_FIFO %i,", status->priority);
+	}
+	fprintf(file, " memory %s\n", status->is_locked ? "locked" : "not locked");
+}
+
+/**
+ * Prints one line summing up a histogram of delays, in us.
+ *
+ * Parameters:
+ * file - file to print to
+ * NAME - what the delays are
+ * histogram - delays in ns
+ *
+ */
+void print_jitter(FILE *file, const char *NAME, const struct histogram *histogram) {
+	fprintf(file, "%s: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us over %lu\n", NAME, get_histogram_percentile(histogram, 50) / 1e3,
+		get_histogram_percentile(histogram, 99) / 1e3, get_histogram_percentile(histogram, 99.9) / 1e3, histogram->max / 1e3,
+		(unsigned long) histogram->count);
+}
@@ -0,0 +1,39 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+/* bytes of stack touched up front, so the sensing loop never faults one in */
+#define PREFAULT_STACK_LEN (512 * 1024)
+/* SCHED_FIFO priority of the sensing thread unless one is given */
+#define DEFAULT_RT_PRIORITY 50
+
+/* opt-in real-time mode of a sensing thread */
+struct realtime_settings {
+	bool is_enabled;
+	/* CPU to pin the thread to, or -1 for the last online CPU */
+	int cpu;
+	/* SCHED_FIFO priority, from 1 to 99 */
+	int priority;
+};
+
+/* which parts of the real-time mode took effect */
+struct realtime_status {
+	/* CPU the thread is pinned to, or -1 */
+	int cpu;
+	/* SCHED_FIFO priority of the thread, or 0 if it is not real-time */
+	int priority;
+	bool is_locked;
+};
+
+bool lock_memory();
+void prefault_stack();
+bool pin_thread(const int CPU);
+bool set_fifo_priority(const int PRIORITY);
+void enter_realtime(const struct realtime_settings *settings, struct realtime_status *status);
+void print_realtime_status(const struct realtime_status *status, FILE *file);
+void print_jitter(FILE *file, const char *NAME, const struct histogram *histogram);
+
+#endif
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "renderer.h"
+#include "timing.h"
+
+/**
+ * Prints a word and its translation. When redrawing in place, the previous word and
+ * translation are cleared first, so a terminal shows only the current word.
+ *
+ * Replaces:
+ * translate_ns
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones that key may stand for, or NULL
+ * key - word to print
+ * REDRAW - whether to overwrite the previously printed word
+ * NAME - prefix of each line, or NULL
+ * translate_ns - time taken to look up the word and translation, if not NULL
+ *
+ */
+void render_word(const struct lexicon *lexicon, const word_key key, const bool REDRAW, const char *NAME, uint64_t *translate_ns) {
+	uint64_t start_ns = get_monotonic_ns();
+	char word[MAX_WORD_LEN + 1], buffer[MAX_TRANSLATION_LEN + 1];
+	get_lexicon_word(lexicon, key, word, sizeof(word));
+	const char *translation = lookup_lexicon_translation(lexicon, key, buffer, sizeof(buffer));
+	if (translate_ns != NULL) {
+		*translate_ns = get_monotonic_ns() - start_ns;
+	}
+	if (REDRAW) {
+		/* move to the start of the line two lines up, and clear to the end of the screen */
+		printf("\033[2F\033[J");
+	}
+
+	/* print original Quechua word */
+	printf("%s%sQuechua word: %s\n", NAME ? NAME : "", NAME ? ": " : "", word);
+
+	/* print translation */
+	printf("%s%sTranslation: %s\n", NAME ? NAME : "", NAME ? ": " : "", translation);
+	fflush(stdout);
+}
+
+/**
+ * Writes the stats the sensing loop last handed over, if they are not written yet. They
+ * are copied out under the lock, so the sensing loop can hand over newer ones while the
+ * file is written.
+ *
+ * Parameter:
+ * renderer - renderer whose stats to write
+ *
+ */
+void write_handed_stats(struct renderer *renderer) {
+	if (renderer->stats_filename == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&renderer->stats_lock);
+	bool is_export_due = renderer->is_export_due;
+	if (is_export_due) {
+		*renderer->written_stats = *renderer->handed_stats;
+		renderer->is_export_due = false;
+	}
+	pthread_mutex_unlock(&renderer->stats_lock);
+	if (is_export_due) {
+		save_driver_stats(renderer->written_stats, renderer->stats_filename);
+	}
+}
+
+/**
+ * Thread which sleeps until words are queued or stats are handed over, then writes the
+ * newest word and the stats, until the renderer stops and the queue is empty.
+ *
+ * Parameter:
+ * arg - renderer to run
+ *
+ */
+void *render_words(void *arg) {
+	struct renderer *renderer = arg;
+	size_t render_ct = 0;
+	for (bool is_running = true; is_running;) {
+		uint64_t wake_ct;
+		if (read(renderer->wake_fd, &wake_ct, sizeof(wake_ct)) != sizeof(wake_ct)) {
+			continue;
+		}
+		/* read before draining, so words queued before the stop are still written */
+		is_running = atomic_load(&renderer->running);
+		write_handed_stats(renderer);
+		struct word_state state, newest;
+		size_t pop_ct = 0;
+		while (pop_word_state(&renderer->queue, &state)) {
+			newest = state;
+			pop_ct++;
+		}
+		if (pop_ct == 0) {
+			continue;
+		}
+
+		uint64_t translate_ns, start_ns = get_monotonic_ns();
+		if (renderer->output_lock != NULL) {
+			pthread_mutex_lock(renderer->output_lock);
+		}
+		render_word(renderer->lexicon, newest.key, renderer->in_place && render_ct > 0, renderer->name, &translate_ns);
+		if (renderer->output_lock != NULL) {
+			pthread_mutex_unlock(renderer->output_lock);
+		}
+		uint64_t end_ns = get_monotonic_ns();
+		render_ct++;
+
+		pthread_mutex_lock(&renderer->stats_lock);
+		record_histogram(&renderer->translate_ns, translate_ns);
+		record_histogram(&renderer->render_ns, end_ns - start_ns - translate_ns);
+		record_histogram(&renderer->lag_ns, end_ns - newest.commit_ns);
+		renderer->rendered_ct++;
+		renderer->coalesced_ct += pop_ct - 1;
+		pthread_mutex_unlock(&renderer->stats_lock);
+	}
+	return NULL;
+}
+
+/**
+ * Starts a render thread. The thread blocks every signal, so they go to the caller's
+ * threads. Returns false if it could not be started.
+ *
+ * Replaces:
+ * renderer
+ *
+ * Parameters:
+ * renderer - renderer to start
+ * NAME - prefix of each line written, or NULL
+ * IN_PLACE - whether to redraw each word over the last
+ * output_lock - lock to hold around each word written, or NULL
+ * LEXICON - verbs beyond the built in ones that keys may stand for, or NULL
+ * STATS_FILENAME - file to write the stats handed over by export_stats to, or NULL
+ *
+ */
+bool start_renderer(struct renderer *renderer, const char *NAME, const bool IN_PLACE, pthread_mutex_t *output_lock, const struct lexicon *LEXICON,
+	const char *STATS_FILENAME) {
+	memset(renderer, 0, sizeof(*renderer));
+	init_word_queue(&renderer->queue);
+	atomic_init(&renderer->running, true);
+	renderer->name = NAME;
+	renderer->in_place = IN_PLACE;
+	renderer->output_lock = output_lock;
+	renderer->lexicon = LEXICON;
+	renderer->stats_filename = STATS_FILENAME;
+	if (STATS_FILENAME != NULL) {
+		renderer->handed_stats = malloc(sizeof(struct driver_stats));
+		renderer->written_stats = malloc(sizeof(struct driver_stats));
+		if (renderer->handed_stats == NULL || renderer->written_stats == NULL) {
+			free(renderer->handed_stats);
+			free(renderer->written_stats);
+			return false;
+		}
+	}
+	pthread_mutex_init(&renderer->stats_lock, NULL);
+	if ((renderer->wake_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		free(renderer->handed_stats);
+		free(renderer->written_stats);
+		return false;
+	}
+
+	sigset_t all_signals, old_mask;
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+	bool is_started = pthread_create(&renderer->thread, NULL, render_words, renderer) == 0;
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (!is_started) {
+		close(renderer->wake_fd);
+		free(renderer->handed_stats);
+		free(renderer->written_stats);
+	}
+	return is_started;
+}
+
+/**
+ * Wakes the render thread.
+ *
+ * Parameter:
+ * renderer - renderer to wake
+ *
+ */
+void wake_renderer(struct renderer *renderer) {
+	uint64_t wake = 1;
+	/* only fails if the counter is about to overflow, which leaves the thread awake anyway */
+	(void) !write(renderer->wake_fd, &wake, sizeof(wake));
+}
+
+/**
+ * Hands the pending word to the render thread, if there is one and the queue has room.
+ * Called by the sensing loop once a frame, so a word that found the queue full is not
+ * left behind. Never blocks.
+ *
+ * Parameter:
+ * renderer - renderer to hand the word to
+ *
+ */
+void flush_words(struct renderer *renderer) {
+	if (renderer->has_pending && push_word_state(&renderer->queue, &renderer->pending)) {
+		renderer->has_pending = false;
+		size_t depth = get_word_queue_depth(&renderer->queue);
+		renderer->max_queue_depth = depth > renderer->max_queue_depth ? depth : renderer->max_queue_depth;
+		wake_renderer(renderer);
+	}
+}
+
+/**
+ * Commits to a word, to be written by the render thread. If the queue is full, the word
+ * waits for room, replacing (and dropping) any older word still waiting. Never blocks.
+ *
+ * Parameters:
+ * renderer - renderer to write the word
+ * KEY - word committed to
+ *
+ */
+void submit_word(struct renderer *renderer, const word_key KEY) {
+	flush_words(renderer);
+	renderer->dropped_ct += renderer->has_pending;
+	renderer->pending = (struct word_state) {KEY, get_monotonic_ns()};
+	renderer->has_pending = true;
+	renderer->committed_ct++;
+	flush_words(renderer);
+}
+
+/**
+ * Copies the render thread's timings and counters into stats.
+ *
+ * Replaces:
+ * stats
+ *
+ * Parameters:
+ * renderer - renderer to copy from
+ * stats - stats to copy into
+ *
+ */
+void copy_render_stats(struct renderer *renderer, struct driver_stats *stats) {
+	pthread_mutex_lock(&renderer->stats_lock);
+	stats->stages[STAGE_TRANSLATE] = renderer->translate_ns;
+	stats->stages[STAGE_RENDER] = renderer->render_ns;
+	stats->stages[STAGE_LAG] = renderer->lag_ns;
+	stats->render_ct = renderer->rendered_ct;
+	stats->words.coalesced_ct = renderer->coalesced_ct;
+	pthread_mutex_unlock(&renderer->stats_lock);
+	stats->words.committed_ct = renderer->committed_ct;
+	stats->words.dropped_ct = renderer->dropped_ct;
+	stats->words.queue_depth = get_word_queue_depth(&renderer->queue);
+	stats->words.max_queue_depth = renderer->max_queue_depth;
+}
+
+/**
+ * Hands a copy of stats to the render thread, to write to its stats file. Called by the
+ * sensing loop between frames. Never blocks ; returns false without handing them over if
+ * the thread is copying out the last ones, so the caller can try again next frame.
+ *
+ * Replaces:
+ * stats->export_ns
+ *
+ * Parameters:
+ * renderer - renderer whose thread writes the stats
+ * stats - stats to hand over
+ *
+ */
+bool export_stats(struct renderer *renderer, struct driver_stats *stats) {
+	if (renderer->stats_filename == NULL || pthread_mutex_trylock(&renderer->stats_lock) != 0) {
+		return false;
+	}
+	stats->export_ns = get_monotonic_ns();
+	*renderer->handed_stats = *stats;
+	renderer->is_export_due = true;
+	pthread_mutex_unlock(&renderer->stats_lock);
+	wake_renderer(renderer);
+	return true;
+}
+
+/**
+ * Waits for every committed word to be handed over, then stops the render thread once
+ * it has written the last of them.
+ *
+ * Parameter:
+ * renderer - renderer to stop
+ *
+ */
+void stop_renderer(struct renderer *renderer) {
+	for (flush_words(renderer); renderer->has_pending; flush_words(renderer)) {
+		wake_renderer(renderer);
+		usleep(1000);
+	}
+	atomic_store(&renderer->running, false);
+	wake_renderer(renderer);
+	pthread_join(renderer->thread, NULL);
+	close(renderer->wake_fd);
+	pthread_mutex_destroy(&renderer->stats_lock);
+	free(renderer->handed_stats);
+	free(renderer->written_stats);
+}
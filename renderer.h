@@ -0,0 +1,69 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "que_to_eng.h"
+#include "word_queue.h"
+#include "histogram.h"
+#include "driver_stats.h"
+#include "lexicon.h"
+
+/*
+ * Thread which writes the words the sensing loop commits to, so a slow terminal, pipe or
+ * serial console never delays a ping. Words reach it through a word_queue ; when it falls
+ * behind, it skips straight to the newest. It also writes the stats file, so the sensing
+ * loop never waits on the file system.
+ */
+struct renderer {
+	struct word_queue queue;
+	/* eventfd counted up after each push, and to stop ; the thread sleeps on it */
+	int wake_fd;
+	pthread_t thread;
+	atomic_bool running;
+	/* prefix of each line written, or NULL */
+	const char *name;
+	/* whether to redraw each word over the last */
+	bool in_place;
+	/* held around each word written, if several renderers share stdout, or NULL */
+	pthread_mutex_t *output_lock;
+	/* verbs beyond the built in ones that keys may stand for, or NULL */
+	const struct lexicon *lexicon;
+
+	/* only touched by the sensing loop */
+	/* newest word that found the queue full, waiting for room */
+	struct word_state pending;
+	bool has_pending;
+	uint64_t committed_ct;
+	uint64_t dropped_ct;
+	uint64_t max_queue_depth;
+
+	/* held while the thread records a word, and while the sensing loop copies out stats */
+	pthread_mutex_t stats_lock;
+	struct histogram translate_ns;
+	struct histogram render_ns;
+	struct histogram lag_ns;
+	uint64_t rendered_ct;
+	uint64_t coalesced_ct;
+
+	/* file the thread writes stats to, or NULL */
+	const char *stats_filename;
+	/* newest stats the sensing loop handed over, under stats_lock, and whether they are yet to be written */
+	struct driver_stats *handed_stats;
+	bool is_export_due;
+	/* only touched by the thread ; the copy of handed_stats it writes */
+	struct driver_stats *written_stats;
+};
+
+void render_word(const struct lexicon *lexicon, const word_key key, const bool REDRAW, const char *NAME, uint64_t *translate_ns);
+bool start_renderer(struct renderer *renderer, const char *NAME, const bool IN_PLACE, pthread_mutex_t *output_lock, const struct lexicon *LEXICON,
+	const char *STATS_FILENAME);
+void submit_word(struct renderer *renderer, const word_key KEY);
+void flush_words(struct renderer *renderer);
+void copy_render_stats(struct renderer *renderer, struct driver_stats *stats);
+bool export_stats(struct renderer *renderer, struct driver_stats *stats);
+void stop_renderer(struct renderer *renderer);
+
+#endif
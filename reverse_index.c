@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include "reverse_index.h"
+#include "hash.h"
+
+/* most words in one translation */
+#define MAX_DOC_TOKENS 64
+/* # of buckets used to collect distinct words while building ; must be a power of 2 */
+#define VOCAB_BUCKET_CT 65536
+
+/**
+ * Splits PHRASE into lowercase words, dropping punctuation, so "He/she is (still)
+ * cooking!" becomes "he", "she", "is", "still", "cooking". Apostrophes stay inside words.
+ * Words longer than MAX_TOKEN_LEN are cut short. Returns the # of words, at most CAP.
+ *
+ * Replaces:
+ * tokens
+ *
+ * Parameters:
+ * PHRASE - English text
+ * tokens - buffer for the words
+ * CAP - length of tokens
+ *
+ */
+size_t normalize_phrase(const char *PHRASE, char tokens[][MAX_TOKEN_LEN + 1], const size_t CAP) {
+	size_t token_ct = 0, len = 0;
+	for (const char *c = PHRASE; token_ct < CAP; c++) {
+		char lower = 'A' <= *c && *c <= 'Z' ? *c - 'A' + 'a' : *c;
+		bool is_word_char = ('a' <= lower && lower <= 'z') || ('0' <= lower && lower <= '9') || lower == '\'';
+		if (is_word_char) {
+			if (len < MAX_TOKEN_LEN) {
+				tokens[token_ct][len++] = lower;
+			}
+		} else if (len > 0) {
+			tokens[token_ct++][len] = '\0';
+			len = 0;
+		}
+		if (*c == '\0') {
+			break;
+		}
+	}
+	return token_ct;
+}
+
+/* index being built, for qsort to compare token ids by their words */
+const struct reverse_index *sorting_index;
+
+/**
+ * Comparison function for qsort over token ids, by their words.
+ *
+ * Parameters:
+ * a - first token id
+ * b - second token id
+ *
+ */
+int compare_token_ids(const void *a, const void *b) {
+	return strcmp(sorting_index->tokens[*(const uint16_t *) a], sorting_index->tokens[*(const uint16_t *) b]);
+}
+
+/**
+ * Translates every root and suffix combination and indexes the words of each
+ * translation. Takes a few tens of ms. Returns false if out of memory.
+ *
+ * Replaces:
+ * index
+ *
+ * Parameter:
+ * index - index to build
+ *
+ */
+bool build_reverse_index(struct reverse_index *index) {
+	*index = (struct reverse_index) {
+		.tokens = malloc(UINT16_MAX * sizeof(*index->tokens)),
+		.doc_offsets = malloc((COMBINATION_CT + 1) * sizeof(uint32_t)),
+		.doc_tokens = malloc((size_t) COMBINATION_CT * MAX_DOC_TOKENS * sizeof(uint16_t))
+	};
+	/* each bucket holds a token id + 1, or 0 if empty */
+	uint16_t *buckets = calloc(VOCAB_BUCKET_CT, sizeof(uint16_t));
+	if (!index->tokens || !index->doc_offsets || !index->doc_tokens || !buckets) {
+		free(buckets);
+		free_reverse_index(index);
+		return false;
+	}
+
+	/* split each translation into words, numbering words as they are first seen */
+	uint32_t doc_token_ct = 0;
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		word_key key = get_combination_key(combination);
+		char translation[MAX_TRANSLATION_LEN + 1];
+		char words[MAX_DOC_TOKENS][MAX_TOKEN_LEN + 1];
+		size_t word_ct = 0;
+		index->doc_offsets[combination] = doc_token_ct;
+		if (!get_invalid_rules(get_key_features(key))) {
+			translate_key(key, translation, sizeof(translation));
+			word_ct = normalize_phrase(translation, words, MAX_DOC_TOKENS);
+		}
+		for (size_t word = 0; word < word_ct; word++) {
+			size_t bucket = hash_string(words[word]) & (VOCAB_BUCKET_CT - 1);
+			while (buckets[bucket] != 0 && strcmp(index->tokens[buckets[bucket] - 1], words[word])) {
+				bucket = (bucket + 1) & (VOCAB_BUCKET_CT - 1);
+			}
+			if (buckets[bucket] == 0) {
+				/* ids must fit in doc_tokens */
+				if (index->token_ct == UINT16_MAX - 1) {
+					free(buckets);
+					free_reverse_index(index);
+					return false;
+				}
+				strcpy(index->tokens[index->token_ct], words[word]);
+				buckets[bucket] = ++index->token_ct;
+			}
+			index->doc_tokens[doc_token_ct++] = buckets[bucket] - 1;
+		}
+	}
+	index->doc_offsets[COMBINATION_CT] = doc_token_ct;
+	free(buckets);
+	uint16_t *doc_tokens = realloc(index->doc_tokens, doc_token_ct * sizeof(uint16_t));
+	index->doc_tokens = doc_tokens ? doc_tokens : index->doc_tokens;
+
+	/* renumber words in sorted order, so a prefix covers a range of ids */
+	uint16_t *order = malloc(index->token_ct * sizeof(uint16_t)), *new_ids = malloc(index->token_ct * sizeof(uint16_t));
+	char (*sorted)[MAX_TOKEN_LEN + 1] = malloc(index->token_ct * sizeof(*sorted));
+	index->posting_offsets = calloc(index->token_ct + 1, sizeof(uint32_t));
+	if (order == NULL || new_ids == NULL || sorted == NULL || index->posting_offsets == NULL) {
+		free(order);
+		free(new_ids);
+		free(sorted);
+		free_reverse_index(index);
+		return false;
+	}
+	for (size_t token = 0; token < index->token_ct; token++) {
+		order[token] = token;
+	}
+	sorting_index = index;
+	qsort(order, index->token_ct, sizeof(uint16_t), compare_token_ids);
+	for (size_t token = 0; token < index->token_ct; token++) {
+		new_ids[order[token]] = token;
+		strcpy(sorted[token], index->tokens[order[token]]);
+	}
+	free(index->tokens);
+	index->tokens = sorted;
+	for (size_t i = 0; i < doc_token_ct; i++) {
+		index->doc_tokens[i] = new_ids[index->doc_tokens[i]];
+	}
+	free(order);
+	free(new_ids);
+
+	/* count then fill each word's postings, listing a document once however often the word appears */
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			for (size_t token = 0; token < index->token_ct; token++) {
+				index->posting_offsets[token + 1] += index->posting_offsets[token];
+			}
+			index->docs = malloc(index->posting_offsets[index->token_ct] * sizeof(uint32_t));
+			if (index->docs == NULL) {
+				free_reverse_index(index);
+				return false;
+			}
+		}
+		uint32_t *fill = calloc(index->token_ct, sizeof(uint32_t));
+		if (fill == NULL) {
+			free_reverse_index(index);
+			return false;
+		}
+		for (size_t doc = 0; doc < COMBINATION_CT; doc++) {
+			for (uint32_t i = index->doc_offsets[doc]; i < index->doc_offsets[doc + 1]; i++) {
+				uint16_t token = index->doc_tokens[i];
+				bool is_repeat = false;
+				for (uint32_t j = index->doc_offsets[doc]; j < i; j++) {
+					is_repeat = is_repeat || index->doc_tokens[j] == token;
+				}
+				if (is_repeat) {
+					continue;
+				}
+				if (pass == 0) {
+					index->posting_offsets[token + 1]++;
+				} else {
+					index->docs[index->posting_offsets[token] + fill[token]++] = doc;
+				}
+			}
+		}
+		free(fill);
+	}
+	return true;
+}
+
+/**
+ * Returns the first token id whose word is not less than WORD.
+ *
+ * Parameters:
+ * index - index to search
+ * WORD - word to search for
+ *
+ */
+size_t lower_bound_token(const struct reverse_index *index, const char *WORD) {
+	size_t low = 0, high = index->token_ct;
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		if (strcmp(index->tokens[mid], WORD) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/**
+ * Returns true iff the words of a document contain the query at some position. Every
+ * query word must match exactly, except the last, which may be any id in
+ * [last_first, last_end).
+ *
+ * Parameters:
+ * index - index holding the document
+ * DOC - document to check
+ * QUERY - token ids of all but the last query word
+ * QUERY_LEN - # of query words, including the last
+ * LAST_FIRST - first id the last word may be
+ * LAST_END - one past the last id the last word may be
+ *
+ */
+bool has_phrase(const struct reverse_index *index, const uint32_t DOC, const uint16_t QUERY[], const size_t QUERY_LEN, const size_t LAST_FIRST, const size_t LAST_END) {
+	const uint16_t *words = index->doc_tokens + index->doc_offsets[DOC];
+	size_t word_ct = index->doc_offsets[DOC + 1] - index->doc_offsets[DOC];
+	for (size_t start = 0; start + QUERY_LEN <= word_ct; start++) {
+		size_t i = 0;
+		while (i + 1 < QUERY_LEN && words[start + i] == QUERY[i]) {
+			i++;
+		}
+		if (i + 1 == QUERY_LEN && LAST_FIRST <= words[start + i] && words[start + i] < LAST_END) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Finds every word whose translation contains PHRASE, as whole words in order, ignoring
+ * case and punctuation. With PREFIX, the last word of PHRASE may also be the start of a
+ * longer word, so "still coo" matches "still cooking". Returns the # of
+ * matching words, of which the first CAP are written to keys in combination order.
+ *
+ * Replaces:
+ * keys
+ *
+ * Parameters:
+ * index - index to search
+ * PHRASE - English words to find
+ * PREFIX - whether the last word is a prefix
+ * keys - buffer for matching word keys
+ * CAP - length of keys
+ *
+ */
+size_t find_phrase(const struct reverse_index *index, const char *PHRASE, const bool PREFIX, word_key keys[], const size_t CAP) {
+	char words[MAX_QUERY_TOKENS][MAX_TOKEN_LEN + 1];
+	uint16_t query[MAX_QUERY_TOKENS];
+	size_t query_len = normalize_phrase(PHRASE, words, MAX_QUERY_TOKENS);
+	if (query_len == 0) {
+		return 0;
+	}
+
+	/* look up each word, remembering which has the fewest postings */
+	size_t rarest = query_len, rarest_ct = SIZE_MAX;
+	size_t last_first = 0, last_end = 0;
+	for (size_t i = 0; i < query_len; i++) {
+		size_t token = lower_bound_token(index, words[i]);
+		size_t len = strlen(words[i]);
+		if (i + 1 == query_len && PREFIX) {
+			last_first = token;
+			for (last_end = token; last_end < index->token_ct && !strncmp(index->tokens[last_end], words[i], len); last_end++);
+			if (last_first == last_end) {
+				return 0;
+			}
+			continue;
+		}
+		if (token == index->token_ct || strcmp(index->tokens[token], words[i])) {
+			return 0;
+		}
+		if (i + 1 == query_len) {
+			last_first = token;
+			last_end = token + 1;
+		} else {
+			query[i] = token;
+		}
+		size_t posting_ct = index->posting_offsets[token + 1] - index->posting_offsets[token];
+		if (posting_ct < rarest_ct) {
+			rarest = i;
+			rarest_ct = posting_ct;
+		}
+	}
+
+	/* candidates come from the rarest whole word, or else from every word with the prefix */
+	size_t match_ct = 0;
+	if (rarest < query_len) {
+		size_t token = rarest + 1 == query_len ? last_first : query[rarest];
+		for (uint32_t i = index->posting_offsets[token]; i < index->posting_offsets[token + 1]; i++) {
+			uint32_t doc = index->docs[i];
+			if (has_phrase(index, doc, query, query_len, last_first, last_end)) {
+				if (match_ct < CAP) {
+					keys[match_ct] = get_combination_key(doc);
+				}
+				match_ct++;
+			}
+		}
+		return match_ct;
+	}
+
+	/* a lone prefix ; merge its words' postings through a bitmap, to list each document once */
+	uint64_t seen[(COMBINATION_CT + 63) / 64] = {0};
+	for (size_t token = last_first; token < last_end; token++) {
+		for (uint32_t i = index->posting_offsets[token]; i < index->posting_offsets[token + 1]; i++) {
+			seen[index->docs[i] / 64] |= (uint64_t) 1 << index->docs[i] % 64;
+		}
+	}
+	for (uint32_t doc = 0; doc < COMBINATION_CT; doc++) {
+		if (seen[doc / 64] >> doc % 64 & 1) {
+			if (match_ct < CAP) {
+				keys[match_ct] = get_combination_key(doc);
+			}
+			match_ct++;
+		}
+	}
+	return match_ct;
+}
+
+/**
+ * Frees everything an index holds.
+ *
+ * Parameter:
+ * index - index to free
+ *
+ */
+void free_reverse_index(struct reverse_index *index) {
+	free(index->tokens);
+	free(index->posting_offsets);
+	free(index->docs);
+	free(index->doc_offsets);
+	free(index->doc_tokens);
+	*index = (struct reverse_index) {NULL};
+}
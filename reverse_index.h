@@ -0,0 +1,36 @@
+#ifndef REVERSE_INDEX_H
+#define REVERSE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "que_to_eng.h"
+
+/* longest English word kept by the index */
+#define MAX_TOKEN_LEN 31
+/* most words in a phrase query */
+#define MAX_QUERY_TOKENS 32
+
+/*
+ * Inverted index from English words to the translations containing them. Each
+ * combination index (see get_combination_idx) is a document, holding the normalized
+ * words of its translation ; invalid words are left empty.
+ */
+struct reverse_index {
+	/* distinct words, sorted so words sharing a prefix are adjacent */
+	char (*tokens)[MAX_TOKEN_LEN + 1];
+	size_t token_ct;
+	/* postings of token t are docs[posting_offsets[t]] to docs[posting_offsets[t + 1]], increasing */
+	uint32_t *posting_offsets;
+	uint32_t *docs;
+	/* words of document d are doc_tokens[doc_offsets[d]] to doc_tokens[doc_offsets[d + 1]] */
+	uint32_t *doc_offsets;
+	uint16_t *doc_tokens;
+};
+
+bool build_reverse_index(struct reverse_index *index);
+size_t normalize_phrase(const char *PHRASE, char tokens[][MAX_TOKEN_LEN + 1], const size_t CAP);
+size_t find_phrase(const struct reverse_index *index, const char *PHRASE, const bool PREFIX, word_key keys[], const size_t CAP);
+void free_reverse_index(struct reverse_index *index);
+
+#endif
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "scheduler.h"
+#include "timing.h"
+
+/**
+ * Sets up a scheduler which ticks FRAME_HZ times a second. Every ring starts at
+ * the full frame rate. Returns false if the timer could not be created.
+ *
+ * Replaces:
+ * sched
+ *
+ * Parameters:
+ * sched - scheduler to set up
+ * RING_CT - # of rings to schedule, at most MAX_SCHEDULED_RINGS
+ * FRAME_HZ - target frame rate, which is also the rate of a ring that is moving
+ * IDLE_HZ - lowest rate a ring backs off to while it is not moving
+ *
+ */
+bool init_scheduler(struct scheduler *sched, const size_t RING_CT, const double FRAME_HZ, const double IDLE_HZ) {
+	if (RING_CT > MAX_SCHEDULED_RINGS || FRAME_HZ <= 0 || IDLE_HZ <= 0 || IDLE_HZ > FRAME_HZ) {
+		return false;
+	}
+	sched->frame_hz = FRAME_HZ;
+	sched->idle_hz = IDLE_HZ;
+	sched->frame_ns = 1e9 / FRAME_HZ;
+	sched->ring_ct = RING_CT;
+	sched->frame_ct = 0;
+	sched->missed_frame_ct = 0;
+	sched->start_ns = get_monotonic_ns();
+	sched->wake_late_ns = (struct histogram) {0};
+	for (size_t ring = 0; ring < RING_CT; ring++) {
+		sched->rings[ring] = (struct ring_schedule) {FRAME_HZ, sched->start_ns + sched->frame_ns, 0, 0};
+	}
+
+	/* periodic timer, read through epoll so other descriptors can be added later */
+	sched->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (sched->timer_fd < 0 || sched->epoll_fd < 0) {
+		close_scheduler(sched);
+		return false;
+	}
+	struct itimerspec period = {
+		.it_interval = {sched->frame_ns / 1000000000, sched->frame_ns % 1000000000},
+		.it_value = {sched->frame_ns / 1000000000, sched->frame_ns % 1000000000}
+	};
+	struct epoll_event event = {.events = EPOLLIN, .data.fd = sched->timer_fd};
+	sched->arm_ns = get_monotonic_ns();
+	if (timerfd_settime(sched->timer_fd, 0, &period, NULL) < 0 ||
+		epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->timer_fd, &event) < 0) {
+		close_scheduler(sched);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Sleeps until the next frame, then marks which rings are due for a sample, noting how
+ * late after the timer's tick the wait returned.
+ * Returns the # of due rings, which is 0 if the wait was interrupted by a signal.
+ *
+ * Replaces:
+ * due
+ *
+ * Parameters:
+ * sched - scheduler to wait on
+ * due - whether each ring should be sampled this frame
+ *
+ */
+size_t wait_for_frame(struct scheduler *sched, bool due[]) {
+	struct epoll_event event;
+	uint64_t expirations = 0;
+	for (size_t ring = 0; ring < sched->ring_ct; ring++) {
+		due[ring] = false;
+	}
+	if (epoll_wait(sched->epoll_fd, &event, 1, -1) <= 0 ||
+		read(sched->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+		return 0;
+	}
+	/* more than one expiration means the loop ran past at least one frame */
+	sched->frame_ct += expirations;
+	sched->missed_frame_ct += expirations - 1;
+
+	size_t due_ct = 0;
+	uint64_t now_ns = get_monotonic_ns();
+	/* the timer ticks every frame_ns from when it was armed */
+	uint64_t tick_ns = sched->arm_ns + sched->frame_ct * sched->frame_ns;
+	record_histogram(&sched->wake_late_ns, now_ns > tick_ns ? now_ns - tick_ns : 0);
+	for (size_t ring = 0; ring < sched->ring_ct; ring++) {
+		/* half a frame of slack, so rings due just after this tick are not pushed to the next */
+		if (sched->rings[ring].next_due_ns <= now_ns + sched->frame_ns / 2) {
+			due[ring] = true;
+			due_ct++;
+		}
+	}
+	return due_ct;
+}
+
+/**
+ * Records a sample of a ring and schedules its next one. A ring that moved returns
+ * to the full frame rate, while one that did not halves its rate, down to idle_hz.
+ *
+ * Parameters:
+ * sched - scheduler the ring belongs to
+ * RING - ring that was sampled
+ * MOVED - whether the sample showed the ring moving
+ *
+ */
+void report_sample(struct scheduler *sched, const size_t RING, const bool MOVED) {
+	struct ring_schedule *ring = &sched->rings[RING];
+	uint64_t now_ns = get_monotonic_ns();
+	ring->sample_ct++;
+	if (now_ns > ring->next_due_ns + sched->frame_ns) {
+		ring->missed_ct++;
+	}
+	ring->rate_hz = MOVED ? sched->frame_hz : ring->rate_hz / 2;
+	if (ring->rate_hz < sched->idle_hz) {
+		ring->rate_hz = sched->idle_hz;
+	}
+	ring->next_due_ns = now_ns + (uint64_t) (1e9 / ring->rate_hz);
+}
+
+/**
+ * Prints the achieved frame rate and per-ring sampling rates, with missed deadlines.
+ *
+ * Parameters:
+ * sched - scheduler to report on
+ * file - file to print to
+ *
+ */
+void print_scheduler_stats(const struct scheduler *sched, FILE *file) {
+	double elapsed_sec = (get_monotonic_ns() - sched->start_ns) / 1e9;
+	fprintf(file, "Frames: %zu of target %.1f Hz, %zu missed\n", sched->frame_ct, sched->frame_hz, sched->missed_frame_ct);
+	for (size_t ring = 0; ring < sched->ring_ct; ring++) {
+		const struct ring_schedule *ring_sched = &sched->rings[ring];
+		fprintf(file, "Ring %zu: %.2f Hz achieved, %.2f Hz now, %zu samples, %zu missed\n", ring,
+			elapsed_sec > 0 ? ring_sched->sample_ct / elapsed_sec : 0, ring_sched->rate_hz, ring_sched->sample_ct, ring_sched->missed_ct);
+	}
+}
+
+/**
+ * Releases the scheduler's timer.
+ *
+ * Parameter:
+ * sched - scheduler to close
+ *
+ */
+void close_scheduler(struct scheduler *sched) {
+	if (sched->timer_fd >= 0) {
+		close(sched->timer_fd);
+	}
+	if (sched->epoll_fd >= 0) {
+		close(sched->epoll_fd);
+	}
+	sched->timer_fd = sched->epoll_fd = -1;
+}
@@ -0,0 +1,48 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+/* most rings a scheduler can manage ; enough for one worker serving 16 wheels of 6 rings */
+#define MAX_SCHEDULED_RINGS 96
+
+/* sampling state of one ring */
+struct ring_schedule {
+	/* current sampling rate, between the scheduler's idle_hz and frame_hz */
+	double rate_hz;
+	/* monotonic time at which the ring is next due, in ns */
+	uint64_t next_due_ns;
+	/* # of samples taken, and # taken more than a frame after they were due */
+	size_t sample_ct;
+	size_t missed_ct;
+};
+
+/* timerfd driven frame clock which decides which rings to sample on each frame */
+struct scheduler {
+	int timer_fd;
+	int epoll_fd;
+	/* fastest rate any ring is sampled at, and the rate idle rings back off to */
+	double frame_hz;
+	double idle_hz;
+	uint64_t frame_ns;
+	size_t ring_ct;
+	struct ring_schedule rings[MAX_SCHEDULED_RINGS];
+	/* # of frames waited for, and # of frames skipped because the loop ran late */
+	size_t frame_ct;
+	size_t missed_frame_ct;
+	uint64_t start_ns;
+	/* time the timer was armed, and how late after its tick each frame woke up, in ns */
+	uint64_t arm_ns;
+	struct histogram wake_late_ns;
+};
+
+bool init_scheduler(struct scheduler *sched, const size_t RING_CT, const double FRAME_HZ, const double IDLE_HZ);
+size_t wait_for_frame(struct scheduler *sched, bool due[]);
+void report_sample(struct scheduler *sched, const size_t RING, const bool MOVED);
+void print_scheduler_stats(const struct scheduler *sched, FILE *file);
+void close_scheduler(struct scheduler *sched);
+
+#endif
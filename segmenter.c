@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+#include "segmenter.h"
+
+/* byte standing for ñ in normalized text, however it was written */
+#define NORMAL_NYE 0x01
+/* byte standing for any character no root or suffix can use */
+#define NORMAL_UNKNOWN 0xFF
+/* roots a word can start with that are followed without allocating ; more spill to the heap */
+#define SEGMENT_CURSOR_LEN 64
+
+/* root read so far, with its position in the suffix trie */
+struct segment_cursor {
+	uint32_t root;
+	uint32_t node;
+};
+
+/**
+ * Reads one character of UTF-8 text, and normalizes it, so that capitals become lowercase,
+ * every way of writing ñ becomes NORMAL_NYE, and the apostrophe variants ` ´ ‘ ’ ʻ ʼ become
+ * '. Characters which are none of these but outside ASCII become NORMAL_UNKNOWN.
+ * Returns the # of bytes read, at least 1 if LEN is.
+ *
+ * Replaces:
+ * normal
+ *
+ * Parameters:
+ * STR - text to read from
+ * LEN - # of bytes left in STR
+ * normal - where to write the normalized byte
+ *
+ */
+size_t read_symbol(const char *STR, const size_t LEN, uint8_t *normal) {
+	const uint8_t *bytes = (const uint8_t *) STR;
+	uint8_t lead = 'A' <= bytes[0] && bytes[0] <= 'Z' ? bytes[0] - 'A' + 'a' : bytes[0];
+	if (lead < 0x80) {
+		/* n followed by a combining tilde (U+0303) */
+		if (lead == 'n' && LEN >= 3 && bytes[1] == 0xCC && bytes[2] == 0x83) {
+			*normal = NORMAL_NYE;
+			return 3;
+		}
+		*normal = lead == '`' ? '\'' : lead;
+		return 1;
+	}
+	if (LEN >= 2 && lead == 0xC3 && (bytes[1] == 0xB1 || bytes[1] == 0x91)) {
+		*normal = NORMAL_NYE;
+		return 2;
+	}
+	/* ´, ʻ and ʼ */
+	if (LEN >= 2 && ((lead == 0xC2 && bytes[1] == 0xB4) || (lead == 0xCA && (bytes[1] == 0xBB || bytes[1] == 0xBC)))) {
+		*normal = '\'';
+		return 2;
+	}
+	/* ‘ and ’ */
+	if (LEN >= 3 && lead == 0xE2 && bytes[1] == 0x80 && (bytes[2] == 0x98 || bytes[2] == 0x99)) {
+		*normal = '\'';
+		return 3;
+	}
+	size_t len = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+	*normal = NORMAL_UNKNOWN;
+	return len < LEN ? len : LEN;
+}
+
+/**
+ * Sets up a trie holding only its start node. Returns false if out of memory.
+ *
+ * Replaces:
+ * trie
+ *
+ * Parameters:
+ * trie - trie to set up
+ * SYMBOL_CT - # of symbols each node has a transition for
+ *
+ */
+bool init_trie(struct trie *trie, const size_t SYMBOL_CT) {
+	*trie = (struct trie) {
+		.next = calloc(64 * SYMBOL_CT, sizeof(uint32_t)),
+		.node_ct = 1,
+		.node_cap = 64,
+		.first_accepts = calloc(64, sizeof(uint32_t))
+	};
+	return trie->next != NULL && trie->first_accepts != NULL;
+}
+
+/**
+ * Adds a string to a trie, so that reading it from the start node reaches VALUE.
+ * Returns false if it has a character no trie symbol stands for, or out of memory.
+ *
+ * Parameters:
+ * segmenter - segmenter whose symbols the trie uses
+ * trie - trie to add to
+ * STR - UTF-8 string to add
+ * VALUE - value to reach at its end
+ *
+ */
+bool add_to_trie(const struct segmenter *segmenter, struct trie *trie, const char *STR, const uint32_t VALUE) {
+	const size_t SYMBOL_CT = segmenter->symbol_ct;
+	const size_t LEN = strlen(STR);
+	uint32_t node = 0;
+	for (size_t at = 0; at < LEN;) {
+		uint8_t normal;
+		at += read_symbol(STR + at, LEN - at, &normal);
+		if (segmenter->symbols[normal] == 0) {
+			return false;
+		}
+		uint32_t *next = &trie->next[node * SYMBOL_CT + segmenter->symbols[normal] - 1];
+		if (*next == 0) {
+			if (trie->node_ct == trie->node_cap) {
+				size_t node_cap = 2 * trie->node_cap;
+				uint32_t *nexts = realloc(trie->next, node_cap * SYMBOL_CT * sizeof(uint32_t));
+				uint32_t *first_accepts = nexts ? realloc(trie->first_accepts, node_cap * sizeof(uint32_t)) : NULL;
+				if (first_accepts == NULL) {
+					trie->next = nexts ? nexts : trie->next;
+					return false;
+				}
+				memset(nexts + trie->node_cap * SYMBOL_CT, 0, trie->node_cap * SYMBOL_CT * sizeof(uint32_t));
+				memset(first_accepts + trie->node_cap, 0, trie->node_cap * sizeof(uint32_t));
+				trie->next = nexts;
+				trie->first_accepts = first_accepts;
+				trie->node_cap = node_cap;
+				next = &trie->next[node * SYMBOL_CT + segmenter->symbols[normal] - 1];
+			}
+			*next = trie->node_ct++;
+		}
+		node = *next;
+	}
+
+	if (trie->accept_ct == trie->accept_cap) {
+		size_t accept_cap = trie->accept_cap ? 2 * trie->accept_cap : 64;
+		struct trie_accept *accepts = realloc(trie->accepts, accept_cap * sizeof(struct trie_accept));
+		if (accepts == NULL) {
+			return false;
+		}
+		trie->accepts = accepts;
+		trie->accept_cap = accept_cap;
+	}
+	trie->accepts[trie->accept_ct++] = (struct trie_accept) {VALUE, trie->first_accepts[node]};
+	trie->first_accepts[node] = trie->accept_ct;
+	return true;
+}
+
+/**
+ * Adds every character of STR to the segmenter's symbols.
+ *
+ * Parameters:
+ * segmenter - segmenter to add symbols to
+ * STR - UTF-8 string using the symbols
+ *
+ */
+void add_symbols(struct segmenter *segmenter, const char *STR) {
+	const size_t LEN = strlen(STR);
+	for (size_t at = 0; at < LEN;) {
+		uint8_t normal;
+		at += read_symbol(STR + at, LEN - at, &normal);
+		if (normal != NORMAL_UNKNOWN && segmenter->symbols[normal] == 0) {
+			segmenter->symbols[normal] = ++segmenter->symbol_ct;
+		}
+	}
+}
+
+/**
+ * Compiles roots and the suffixes of every slot (see SUFFIXES) into a segmenter. Words are
+ * matched ignoring case, and however ñ and the apostrophe are written. Returns false if a
+ * root uses a character outside ASCII other than ñ, there are over MAX_SEGMENTER_ROOTS
+ * roots, or out of memory.
+ *
+ * Replaces:
+ * segmenter
+ *
+ * Parameters:
+ * segmenter - segmenter to make
+ * ROOT_NAMES - roots words may start with, such as ROOTS ; keys found hold indexes into it,
+ * 	and NULL entries are skipped
+ * ROOT_NAME_CT - length of ROOT_NAMES
+ *
+ */
+bool make_segmenter(struct segmenter *segmenter, const char *const ROOT_NAMES[], const size_t ROOT_NAME_CT) {
+	memset(segmenter, 0, sizeof(*segmenter));
+	if (ROOT_NAME_CT > MAX_SEGMENTER_ROOTS) {
+		return false;
+	}
+	for (size_t root = 0; root < ROOT_NAME_CT; root++) {
+		if (ROOT_NAMES[root] != NULL) {
+			add_symbols(segmenter, ROOT_NAMES[root]);
+		}
+	}
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		for (size_t suffix = 0; suffix < SUFFIX_CTS[slot]; suffix++) {
+			add_symbols(segmenter, SUFFIXES[slot][suffix]);
+		}
+	}
+	bool is_made = init_trie(&segmenter->roots, segmenter->symbol_ct) && init_trie(&segmenter->suffixes, segmenter->symbol_ct);
+	for (size_t root = 0; is_made && root < ROOT_NAME_CT; root++) {
+		is_made = ROOT_NAMES[root] == NULL || add_to_trie(segmenter, &segmenter->roots, ROOT_NAMES[root], root);
+	}
+
+	/* every sequence of one suffix per slot, counting through suffix_idxs like an odometer */
+	size_t suffix_idxs[SLOT_CT] = {0};
+	for (bool is_done = !is_made; !is_done;) {
+		char suffixes[MAX_WORD_LEN + 1] = "";
+		word_key value = 0;
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			strcat(suffixes, SUFFIXES[slot][suffix_idxs[slot]]);
+			value |= suffix_idxs[slot] << (KEY_SLOT_BITS * slot);
+		}
+		is_made = add_to_trie(segmenter, &segmenter->suffixes, suffixes, value);
+		size_t slot = 0;
+		while (slot < SLOT_CT && ++suffix_idxs[slot] == SUFFIX_CTS[slot]) {
+			suffix_idxs[slot++] = 0;
+		}
+		is_done = !is_made || slot == SLOT_CT;
+	}
+	if (!is_made) {
+		free_segmenter(segmenter);
+	}
+	return is_made;
+}
+
+/**
+ * Finds every way to split a whole word into a root and one suffix per slot, reading it
+ * once from left to right. Each root the word could start with is followed through the
+ * suffix trie at the same time, so ambiguous words cost no backtracking. Words are matched
+ * as make_segmenter describes. Whether a split has a translation is left to the caller
+ * (see get_invalid_rules). Returns the # of splits, of which the first CAP are written to
+ * keys, the root bits holding an index into the roots the segmenter was made with. A word
+ * which could start with over SEGMENT_CURSOR_LEN roots at once allocates ; it returns 0 if
+ * that fails.
+ *
+ * Replaces:
+ * keys
+ *
+ * Parameters:
+ * segmenter - segmenter to use
+ * WORD - UTF-8 word, which need not be null terminated
+ * LEN - # of bytes in WORD
+ * keys - buffer for the word keys found
+ * CAP - length of keys
+ *
+ */
+size_t segment_word(const struct segmenter *segmenter, const char *WORD, const size_t LEN, word_key keys[], const size_t CAP) {
+	const size_t SYMBOL_CT = segmenter->symbol_ct;
+	/* roots read so far, each with its position in the suffix trie */
+	struct segment_cursor local_cursors[SEGMENT_CURSOR_LEN], *cursors = local_cursors;
+	size_t cursor_ct = 0, cursor_cap = SEGMENT_CURSOR_LEN;
+	/* position in the root trie, or 0 once no root fits */
+	uint32_t root_node = 0;
+	bool is_in_root = true, is_out_of_memory = false;
+
+	for (size_t at = 0;;) {
+		if (is_in_root) {
+			for (uint32_t accept = segmenter->roots.first_accepts[root_node]; accept != 0; accept = segmenter->roots.accepts[accept - 1].next) {
+				if (cursor_ct == cursor_cap) {
+					struct segment_cursor *grown = malloc(2 * cursor_cap * sizeof(*grown));
+					if (grown == NULL) {
+						is_out_of_memory = true;
+						break;
+					}
+					memcpy(grown, cursors, cursor_ct * sizeof(*grown));
+					if (cursors != local_cursors) {
+						free(cursors);
+					}
+					cursors = grown;
+					cursor_cap *= 2;
+				}
+				cursors[cursor_ct].root = segmenter->roots.accepts[accept - 1].value;
+				cursors[cursor_ct++].node = 0;
+			}
+		}
+		if (is_out_of_memory) {
+			cursor_ct = 0;
+			break;
+		}
+		if (at == LEN) {
+			break;
+		}
+		uint8_t normal;
+		at += read_symbol(WORD + at, LEN - at, &normal);
+		size_t symbol = segmenter->symbols[normal];
+		if (symbol == 0) {
+			cursor_ct = 0;
+			break;
+		}
+		symbol--;
+
+		if (is_in_root) {
+			root_node = segmenter->roots.next[root_node * SYMBOL_CT + symbol];
+			is_in_root = root_node != 0;
+		}
+		size_t live_ct = 0;
+		for (size_t cursor = 0; cursor < cursor_ct; cursor++) {
+			uint32_t node = segmenter->suffixes.next[cursors[cursor].node * SYMBOL_CT + symbol];
+			if (node != 0) {
+				cursors[live_ct].root = cursors[cursor].root;
+				cursors[live_ct++].node = node;
+			}
+		}
+		cursor_ct = live_ct;
+		if (!is_in_root && cursor_ct == 0) {
+			break;
+		}
+	}
+
+	size_t key_ct = 0;
+	for (size_t cursor = 0; cursor < cursor_ct; cursor++) {
+		for (uint32_t accept = segmenter->suffixes.first_accepts[cursors[cursor].node]; accept != 0; accept = segmenter->suffixes.accepts[accept - 1].next) {
+			if (key_ct < CAP) {
+				keys[key_ct] = (word_key) cursors[cursor].root << (KEY_SLOT_BITS * SLOT_CT) | segmenter->suffixes.accepts[accept - 1].value;
+			}
+			key_ct++;
+		}
+	}
+	if (cursors != local_cursors) {
+		free(cursors);
+	}
+	return key_ct;
+}
+
+/**
+ * Frees a trie's tables.
+ *
+ * Parameter:
+ * trie - trie to free
+ *
+ */
+void free_trie(struct trie *trie) {
+	free(trie->next);
+	free(trie->first_accepts);
+	free(trie->accepts);
+	*trie = (struct trie) {NULL};
+}
+
+/**
+ * Frees everything a segmenter holds.
+ *
+ * Parameter:
+ * segmenter - segmenter to free
+ *
+ */
+void free_segmenter(struct segmenter *segmenter) {
+	free_trie(&segmenter->roots);
+	free_trie(&segmenter->suffixes);
+	segmenter->symbol_ct = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "que_to_eng.h"
+
+/* most roots a segmenter can hold, limited by the root bits of a word key */
+#define MAX_SEGMENTER_ROOTS (1 << (32 - KEY_SLOT_BITS * SLOT_CT))
+
+/* value reached at the end of a string in a trie */
+struct trie_accept {
+	uint32_t value;
+	/* index + 1 of the next value at the same node, or 0 if none */
+	uint32_t next;
+};
+
+/*
+ * Trie over normalized symbols, stored as a dense transition table. Node 0 is the
+ * start, and a transition to 0 means there is none.
+ */
+struct trie {
+	/* next node from node n on symbol s is next[n * symbol_ct + s] */
+	uint32_t *next;
+	size_t node_ct;
+	size_t node_cap;
+	/* index + 1 into accepts of the first value ending at each node, or 0 if none */
+	uint32_t *first_accepts;
+	struct trie_accept *accepts;
+	size_t accept_ct;
+	size_t accept_cap;
+};
+
+/*
+ * Splits whole words into a root and one suffix per slot. Roots go in one trie, and
+ * every sequence of suffixes in another, which all roots share.
+ */
+struct segmenter {
+	/* symbol + 1 of each normalized byte, or 0 if no root or suffix uses it */
+	uint8_t symbols[256];
+	size_t symbol_ct;
+	/* values are indexes into the roots the segmenter was made with */
+	struct trie roots;
+	/* values are the suffix bits of a word key */
+	struct trie suffixes;
+};
+
+bool make_segmenter(struct segmenter *segmenter, const char *const ROOT_NAMES[], const size_t ROOT_NAME_CT);
+size_t segment_word(const struct segmenter *segmenter, const char *WORD, const size_t LEN, word_key keys[], const size_t CAP);
+void free_segmenter(struct segmenter *segmenter);
+
+#endif
@@ -0,0 +1,153 @@
+#include <math.h>
+#include "stream_stats.h"
+
+/**
+ * Sets up empty statistics.
+ *
+ * Replaces:
+ * stats
+ *
+ * Parameters:
+ * stats - statistics to set up
+ * QUANTILE - quantile to estimate, 0.5 for the median
+ *
+ */
+void init_stream_stats(struct stream_stats *stats, const double QUANTILE) {
+	*stats = (struct stream_stats) {.quantile = QUANTILE};
+	const double P = QUANTILE;
+	const double DESIRED[QUANTILE_MARKERS] = {1, 1 + 2 * P, 1 + 4 * P, 3 + 2 * P, 5};
+	const double INCREMENTS[QUANTILE_MARKERS] = {0, P / 2, P, (1 + P) / 2, 1};
+	for (size_t marker = 0; marker < QUANTILE_MARKERS; marker++) {
+		stats->positions[marker] = marker + 1;
+		stats->desired[marker] = DESIRED[marker];
+		stats->increments[marker] = INCREMENTS[marker];
+	}
+}
+
+/**
+ * Returns the piecewise-parabolic prediction of a marker's height if it moves by
+ * DIRECTION, as in Jain and Chlamtac's P-squared algorithm.
+ *
+ * Parameters:
+ * stats - statistics holding the marker
+ * MARKER - interior marker to move
+ * DIRECTION - 1 or -1
+ *
+ */
+double get_parabolic_height(const struct stream_stats *stats, const size_t MARKER, const double DIRECTION) {
+	const double *q = stats->heights, *n = stats->positions;
+	const size_t I = MARKER;
+	return q[I] + DIRECTION / (n[I + 1] - n[I - 1]) * (
+		(n[I] - n[I - 1] + DIRECTION) * (q[I + 1] - q[I]) / (n[I + 1] - n[I]) +
+		(n[I + 1] - n[I] - DIRECTION) * (q[I] - q[I - 1]) / (n[I] - n[I - 1]));
+}
+
+/**
+ * Adds a sample to the statistics in constant time and space.
+ *
+ * Parameters:
+ * stats - statistics to update
+ * SAMPLE - new sample
+ *
+ */
+void add_stream_sample(struct stream_stats *stats, const double SAMPLE) {
+	/* Welford's update, which does not lose precision like a sum of squares */
+	stats->sample_ct++;
+	double delta = SAMPLE - stats->mean;
+	stats->mean += delta / stats->sample_ct;
+	stats->m2 += delta * (SAMPLE - stats->mean);
+
+	double *q = stats->heights, *n = stats->positions;
+	/* the first samples become the markers, kept sorted */
+	if (stats->sample_ct <= QUANTILE_MARKERS) {
+		size_t i = stats->sample_ct - 1;
+		for (; i > 0 && q[i - 1] > SAMPLE; i--) {
+			q[i] = q[i - 1];
+		}
+		q[i] = SAMPLE;
+		return;
+	}
+
+	/* find the cell the sample falls in, stretching the outer markers if needed */
+	size_t cell;
+	if (SAMPLE < q[0]) {
+		q[0] = SAMPLE;
+		cell = 0;
+	} else if (SAMPLE >= q[QUANTILE_MARKERS - 1]) {
+		q[QUANTILE_MARKERS - 1] = SAMPLE;
+		cell = QUANTILE_MARKERS - 2;
+	} else {
+		for (cell = 0; SAMPLE >= q[cell + 1]; cell++);
+	}
+	for (size_t marker = cell + 1; marker < QUANTILE_MARKERS; marker++) {
+		n[marker]++;
+	}
+	for (size_t marker = 0; marker < QUANTILE_MARKERS; marker++) {
+		stats->desired[marker] += stats->increments[marker];
+	}
+
+	/* move interior markers which fell behind or ahead of where they should be */
+	for (size_t marker = 1; marker < QUANTILE_MARKERS - 1; marker++) {
+		double offset = stats->desired[marker] - n[marker];
+		if ((offset >= 1 && n[marker + 1] - n[marker] > 1) || (offset <= -1 && n[marker - 1] - n[marker] < -1)) {
+			double direction = offset > 0 ? 1 : -1;
+			double height = get_parabolic_height(stats, marker, direction);
+			if (!(q[marker - 1] < height && height < q[marker + 1])) {
+				/* parabola overshot a neighbour, so interpolate linearly instead */
+				size_t neighbour = direction > 0 ? marker + 1 : marker - 1;
+				height = q[marker] + direction * (q[neighbour] - q[marker]) / (n[neighbour] - n[marker]);
+			}
+			q[marker] = height;
+			n[marker] += direction;
+		}
+	}
+}
+
+/**
+ * Returns the standard deviation of the samples so far.
+ *
+ * Parameter:
+ * stats - statistics of the samples
+ *
+ */
+double get_stream_stddev(const struct stream_stats *stats) {
+	return stats->sample_ct ? sqrt(stats->m2 / stats->sample_ct) : 0;
+}
+
+/**
+ * Returns the estimated quantile of the samples so far. It is exact for the first
+ * QUANTILE_MARKERS samples.
+ *
+ * Parameter:
+ * stats - statistics of the samples
+ *
+ */
+double get_stream_quantile(const struct stream_stats *stats) {
+	if (stats->sample_ct == 0) {
+		return 0;
+	}
+	if (stats->sample_ct > QUANTILE_MARKERS) {
+		return stats->heights[QUANTILE_MARKERS / 2];
+	}
+
+	/* interpolate between the sorted samples */
+	double rank = stats->quantile * (stats->sample_ct - 1);
+	size_t below = rank;
+	double fraction = rank - below;
+	return below + 1 < stats->sample_ct ?
+		stats->heights[below] + fraction * (stats->heights[below + 1] - stats->heights[below]) : stats->heights[below];
+}
+
+/**
+ * Returns the half-width of the 95% confidence interval of the median, taking the
+ * noise to be roughly normal. The median's standard error is then sqrt(pi / 2) times
+ * the mean's.
+ *
+ * Parameter:
+ * stats - statistics of the samples
+ *
+ */
+double get_median_error(const struct stream_stats *stats) {
+	const double Z_95 = 1.96;
+	return stats->sample_ct ? Z_95 * sqrt(M_PI / 2) * get_stream_stddev(stats) / sqrt(stats->sample_ct) : INFINITY;
+}
@@ -0,0 +1,30 @@
+#ifndef STREAM_STATS_H
+#define STREAM_STATS_H
+
+#include <stddef.h>
+
+/* # of markers kept by the P-squared quantile estimator */
+#define QUANTILE_MARKERS 5
+
+/* mean, variance and one quantile of a stream of samples, without storing the samples */
+struct stream_stats {
+	size_t sample_ct;
+	/* Welford running mean, and sum of squared differences from it */
+	double mean;
+	double m2;
+	/* quantile being estimated, between 0 and 1 */
+	double quantile;
+	/* marker heights and positions (from 1), and desired positions and their increments */
+	double heights[QUANTILE_MARKERS];
+	double positions[QUANTILE_MARKERS];
+	double desired[QUANTILE_MARKERS];
+	double increments[QUANTILE_MARKERS];
+};
+
+void init_stream_stats(struct stream_stats *stats, const double QUANTILE);
+void add_stream_sample(struct stream_stats *stats, const double SAMPLE);
+double get_stream_stddev(const struct stream_stats *stats);
+double get_stream_quantile(const struct stream_stats *stats);
+double get_median_error(const struct stream_stats *stats);
+
+#endif
@@ -1,44 +1,733 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "que_to_eng.h"
+#include "translation_table.h"
+#include "lexicon.h"
+#include "reverse_index.h"
+#include "segmenter.h"
+#include "batch.h"
+#include "translate_reference.h"
 
 /**
- i* Generates a random set of suffixes.
+ * Generates a random word key.
  *
- * Array contents: (all but 3 could also be empty)
+ * Suffix slots: (all but 3 could also be empty)
  * 	0: ri, rpa, rpari
- *n 	1: ku, mu, kamu
+ * 	1: ku, mu, kamu
  * 	2: chka, lla, chkalla
  * 	3: ni, nki, n, yku, nchik, nkichik, nku
  * 	4: ña, raq
  * 	5: pis, taq, sina, puni
  *
  */
-const char **get_random_suffixes() {
-	/* all possible suffixes */
-	char *options[][7] = {
-		{"ri", "rpa", "rpari", ""},
-		{"ku", "mu", "kamu", ""},
-		{"chka", "lla", "chkalla", ""},
-		{"ni", "nki", "n", "yku", "nchik", "nkichik", "nku"},
-		{"ña", "raq", ""},
-		{"pis", "taq", "sina", "puni", ""}
-	};
+word_key get_random_key() {
+	size_t suffix_idxs[SLOT_CT];
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		suffix_idxs[slot] = rand() % SUFFIX_CTS[slot];
+	}
+	return make_word_key(rand() % ROOT_CT, suffix_idxs);
+}
 
-	/* I was gonna use an array but this is cooler */
-	const int OPTION_LENS = 0b101011111100100100;
+/**
+ * Compares translate(), translate_key() and lookup_translation() against
+ * translate_reference() for every root and suffix combination, printing each mismatch.
+ * Returns the # of mismatches.
+ *
+ */
+size_t check_table() {
+	size_t mismatch_ct = 0;
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		size_t root, suffix_idxs[SLOT_CT];
+		const char *suffixes[SLOT_CT];
+		get_combination(combination, &root, suffix_idxs);
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			suffixes[slot] = SUFFIXES[slot][suffix_idxs[slot]];
+		}
+		word_key key = make_word_key(root, suffix_idxs);
+		char *reference = translate_reference(ROOTS[root], suffixes);
+		char *translation = translate(ROOTS[root], suffixes);
+		char from_key[MAX_TRANSLATION_LEN + 1];
+		translate_key(key, from_key, sizeof(from_key));
+		const char *lookup = lookup_translation(key);
+		if (reference == NULL || translation == NULL || strcmp(reference, translation) || strcmp(reference, from_key) ||
+			strcmp(reference, lookup)) {
+			printf("Mismatch at combination %zu:\n\treference: %s\n\ttranslate: %s\n\tkey:       %s\n\ttable:     %s\n", combination,
+				reference ? reference : "(none)", translation ? translation : "(none)", from_key, lookup);
+			mismatch_ct++;
+		}
+		free(reference);
+		free(translation);
+	}
+	printf("Checked %i combinations against the reference translator, %zu mismatched.\n", COMBINATION_CT, mismatch_ct);
+	return mismatch_ct;
+}
 
-	const size_t SUFFIX_CT = 6;
-	size_t i, j;
-	const char **result = calloc(SUFFIX_CT, sizeof(char *));
+/**
+ * Checks that every built in root is in the lexicon FILENAME with the same verb forms,
+ * by comparing translate_lexicon() against lookup_translation() for every combination,
+ * and that an unknown root is reported rather than translated. Every word of every verb
+ * must also translate the same from its word key, and segment back to that key. Prints
+ * each mismatch, and returns the # of mismatches.
+ *
+ * Parameter:
+ * FILENAME - lexicon file to check
+ *
+ */
+size_t check_lexicon(const char *FILENAME) {
+	struct lexicon lexicon;
+	if (!load_lexicon(&lexicon, FILENAME)) {
+		printf("Could not load lexicon %s.\n", FILENAME);
+		return 1;
+	}
+	size_t mismatch_ct = 0;
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		size_t root, suffix_idxs[SLOT_CT];
+		const char *suffixes[SLOT_CT];
+		get_combination(combination, &root, suffix_idxs);
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			suffixes[slot] = SUFFIXES[slot][suffix_idxs[slot]];
+		}
+		char translation[MAX_TRANSLATION_LEN + 1];
+		const char *lookup = lookup_translation(make_word_key(root, suffix_idxs));
+		if (translate_lexicon(&lexicon, ROOTS[root], suffixes, translation, sizeof(translation)) > TRANSLATE_TRUNCATED ||
+			strcmp(translation, lookup)) {
+			printf("Mismatch at combination %zu:\n\tlexicon: %s\n\ttable:   %s\n", combination, translation, lookup);
+			mismatch_ct++;
+		}
+	}
+	const char *suffixes[SLOT_CT] = {"", "", "", "ni", "", ""};
+	char translation[MAX_TRANSLATION_LEN + 1];
+	if (translate_lexicon(&lexicon, "not a root", suffixes, translation, sizeof(translation)) != TRANSLATE_UNKNOWN_VERB ||
+		find_key_root(&lexicon, "not a root") >= 0) {
+		printf("Unknown root was translated as: %s\n", translation);
+		mismatch_ct++;
+	}
+
+	/* every verb's words, keyed as the driver, translated and the segmenter key them */
+	struct segmenter segmenter;
+	size_t root_ct, key_ct = 0;
+	const char **roots = make_key_root_names(&lexicon, &root_ct);
+	if (roots == NULL || !make_segmenter(&segmenter, roots, root_ct)) {
+		printf("Could not make segmenter over %s.\n", FILENAME);
+		free(roots);
+		free_lexicon(&lexicon);
+		return mismatch_ct + 1;
+	}
+	for (size_t verb = 0; verb < lexicon.entry_ct; verb++) {
+		const char *root = lexicon.entries[verb].root;
+		long key_root = find_key_root(&lexicon, root);
+		for (size_t combination = 0; key_root >= 0 && combination < COMBINATION_CT / ROOT_CT; combination++, key_ct++) {
+			size_t root_idx, suffix_idxs[SLOT_CT];
+			get_combination(combination, &root_idx, suffix_idxs);
+			for (size_t slot = 0; slot < SLOT_CT; slot++) {
+				suffixes[slot] = SUFFIXES[slot][suffix_idxs[slot]];
+			}
+			word_key key = make_word_key(key_root, suffix_idxs), keys[8];
+			char word[MAX_WORD_LEN + 1], from_key[MAX_TRANSLATION_LEN + 1];
+			translate_lexicon(&lexicon, root, suffixes, translation, sizeof(translation));
+			const char *lookup = lookup_lexicon_translation(&lexicon, key, from_key, sizeof(from_key));
+			get_lexicon_word(&lexicon, key, word, sizeof(word));
+			size_t split_ct = segment_word(&segmenter, word, strlen(word), keys, 8);
+			bool is_found = false;
+			for (size_t i = 0; i < split_ct && i < 8; i++) {
+				is_found = is_found || keys[i] == key;
+			}
+			if (!is_valid_lexicon_key(&lexicon, key) || strcmp(translation, lookup) || !is_found) {
+				printf("Lexicon key mismatch for %s:\n\tlexicon: %s\n\tkey:     %s\n\tsegmented: %s\n", word, translation, lookup,
+					is_found ? "yes" : "no");
+				mismatch_ct++;
+			}
+		}
+		if (key_root < 0) {
+			printf("Lexicon verb %s has no key root.\n", root);
+			mismatch_ct++;
+		}
+	}
+	printf("Checked %i combinations against %zu verbs of %s, and keyed and segmented %zu of their words, %zu mismatched.\n",
+		COMBINATION_CT, lexicon.entry_ct, FILENAME, key_ct, mismatch_ct);
+	free_segmenter(&segmenter);
+	free(roots);
+	free_lexicon(&lexicon);
+	return mismatch_ct;
+}
 
-	for (i = 0; i < SUFFIX_CT; i++) {
-		j = rand() % (OPTION_LENS >> 3*i & 7);
-		result[i] = options[i][j];
+/**
+ * Prints a random word, with a root from the lexicon FILENAME, and its translation.
+ * Returns 0 on success.
+ *
+ * Parameter:
+ * FILENAME - lexicon file to take roots from
+ *
+ */
+int translate_random_lexicon_word(const char *FILENAME) {
+	struct lexicon lexicon;
+	if (!load_lexicon(&lexicon, FILENAME) || lexicon.entry_ct == 0) {
+		printf("Could not load lexicon %s.\n", FILENAME);
+		return 1;
+	}
+	word_key key = get_random_key();
+	const char *root = lexicon.entries[rand() % lexicon.entry_ct].root;
+	const char *suffixes[SLOT_CT];
+	printf("Quechua word: %s", root);
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		suffixes[slot] = SUFFIXES[slot][get_key_suffix(key, slot)];
+		printf("%s", suffixes[slot]);
 	}
+	char translation[MAX_TRANSLATION_LEN + 1];
+	translate_lexicon(&lexicon, root, suffixes, translation, sizeof(translation));
+	printf("\nTranslation: %s\n", translation);
+	free_lexicon(&lexicon);
+	return 0;
+}
 
-	return result;
+/**
+ * Checks that searching the reverse index for the translation of each valid word
+ * finds that word, printing each miss. Returns the # of misses.
+ *
+ */
+size_t check_reverse_index() {
+	struct reverse_index index;
+	word_key *keys = malloc(COMBINATION_CT * sizeof(word_key));
+	if (keys == NULL || !build_reverse_index(&index)) {
+		printf("Could not build reverse index.\n");
+		free(keys);
+		return 1;
+	}
+	size_t miss_ct = 0, query_ct = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		word_key key = get_combination_key(combination);
+		if (get_invalid_rules(get_key_features(key))) {
+			continue;
+		}
+		size_t match_ct = find_phrase(&index, lookup_translation(key), false, keys, COMBINATION_CT);
+		bool is_found = false;
+		for (size_t i = 0; i < match_ct; i++) {
+			is_found = is_found || keys[i] == key;
+		}
+		if (!is_found) {
+			printf("Reverse index missed combination %zu: %s\n", combination, lookup_translation(key));
+			miss_ct++;
+		}
+		query_ct++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+	printf("Searched %zu translations in the reverse index (%.2f us each), %zu missed.\n", query_ct, elapsed_us / query_ct, miss_ct);
+	free_reverse_index(&index);
+	free(keys);
+	return miss_ct;
+}
+
+/**
+ * Prints every word whose translation contains PHRASE (see find_phrase), up to a limit.
+ * Returns 0 on success.
+ *
+ * Parameters:
+ * PHRASE - English words to find
+ * PREFIX - whether the last word of PHRASE may be the start of a longer word
+ *
+ */
+int reverse_translate(const char *PHRASE, const bool PREFIX) {
+	const size_t MAX_SHOWN = 50;
+	struct reverse_index index;
+	word_key *keys = malloc(COMBINATION_CT * sizeof(word_key));
+	if (keys == NULL || !build_reverse_index(&index)) {
+		printf("Could not build reverse index.\n");
+		free(keys);
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t match_ct = find_phrase(&index, PHRASE, PREFIX, keys, COMBINATION_CT);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	for (size_t i = 0; i < match_ct && i < MAX_SHOWN; i++) {
+		char word[MAX_WORD_LEN + 1];
+		get_quechua_word(keys[i], word, sizeof(word));
+		printf("%s\t%s\n", word, lookup_translation(keys[i]));
+	}
+	if (match_ct > MAX_SHOWN) {
+		printf("... and %zu more\n", match_ct - MAX_SHOWN);
+	}
+	printf("%zu words found in %.2f us\n", match_ct, (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3);
+	free_reverse_index(&index);
+	free(keys);
+	return 0;
+}
+
+/**
+ * Writes a word as its root and suffixes separated by dashes, such as "wayk'u-ri-chka-nki".
+ *
+ * Replaces:
+ * out
+ *
+ * Parameters:
+ * lexicon - verbs beyond the built in ones, or NULL for none
+ * key - word to write, for which is_valid_lexicon_key must hold
+ * out - buffer to write to
+ * cap - size of out in bytes
+ *
+ */
+void get_segmented_word(const struct lexicon *lexicon, const word_key key, char *out, const size_t cap) {
+	struct appender word = {out, 0, cap, false};
+	append_format(&word, "%s", get_key_root_name(lexicon, key));
+	for (size_t slot = 0; slot < SLOT_CT; slot++) {
+		const char *suffix = SUFFIXES[slot][get_key_suffix(key, slot)];
+		if (*suffix) {
+			append_format(&word, "-%s", suffix);
+		}
+	}
+}
+
+/**
+ * Checks that every word, and a copy of it in capitals with ’ for its apostrophes and
+ * a combining tilde for its ñ, segments back into its own root and suffixes, and that a
+ * word which could start with 200 roots at once is split off each of them, printing each
+ * miss. Returns the # of misses.
+ *
+ */
+size_t check_segmenter() {
+	struct segmenter segmenter;
+	if (!make_segmenter(&segmenter, ROOTS, ROOT_CT)) {
+		printf("Could not make segmenter.\n");
+		return 1;
+	}
+	size_t miss_ct = 0, ambiguous_ct = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t combination = 0; combination < COMBINATION_CT; combination++) {
+		word_key key = get_combination_key(combination), keys[8];
+		char word[MAX_WORD_LEN + 1], variant[3 * MAX_WORD_LEN + 1];
+		get_quechua_word(key, word, sizeof(word));
+		struct appender app = {variant, 0, sizeof(variant), false};
+		for (const char *c = word; *c; c++) {
+			if (*c == '\'') {
+				append_format(&app, "’");
+			} else if (!strncmp(c, "ñ", strlen("ñ"))) {
+				append_format(&app, "Ñ");
+				c += strlen("ñ") - 1;
+			} else {
+				append_format(&app, "%c", 'a' <= *c && *c <= 'z' ? *c - 'a' + 'A' : *c);
+			}
+		}
+
+		const char *forms[] = {word, variant};
+		for (size_t form = 0; form < 2; form++) {
+			size_t key_ct = segment_word(&segmenter, forms[form], strlen(forms[form]), keys, 8);
+			bool is_found = false;
+			for (size_t i = 0; i < key_ct && i < 8; i++) {
+				is_found = is_found || keys[i] == key;
+			}
+			if (!is_found) {
+				printf("Segmenter missed combination %zu: %s\n", combination, forms[form]);
+				miss_ct++;
+			}
+			ambiguous_ct += form == 0 && key_ct > 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed_ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("Segmented %i words twice (%.0f ns each), %zu ambiguous, %zu missed.\n", COMBINATION_CT, elapsed_ns / (2 * COMBINATION_CT), ambiguous_ct, miss_ct);
+	free_segmenter(&segmenter);
+
+	/* a word which could start with more roots at once than are followed without allocating must still find them all */
+	const char *copies[200];
+	word_key copy_keys[2 * 200];
+	bool is_copy_found[200] = {false};
+	const size_t COPY_CT = sizeof(copies) / sizeof(copies[0]);
+	for (size_t copy = 0; copy < COPY_CT; copy++) {
+		copies[copy] = ROOTS[0];
+	}
+	char copied[MAX_WORD_LEN + 1];
+	snprintf(copied, sizeof(copied), "%srichkanki", ROOTS[0]);
+	if (!make_segmenter(&segmenter, copies, COPY_CT)) {
+		printf("Could not make segmenter.\n");
+		return miss_ct + 1;
+	}
+	size_t copy_key_ct = segment_word(&segmenter, copied, strlen(copied), copy_keys, 2 * COPY_CT);
+	for (size_t i = 0; i < copy_key_ct && i < 2 * COPY_CT; i++) {
+		if (get_key_root(copy_keys[i]) < COPY_CT) {
+			is_copy_found[get_key_root(copy_keys[i])] = true;
+		}
+	}
+	for (size_t copy = 0; copy < COPY_CT; copy++) {
+		if (!is_copy_found[copy]) {
+			printf("Segmenter missed root %zu of %zu in %s\n", copy, COPY_CT, copied);
+			miss_ct++;
+		}
+	}
+	free_segmenter(&segmenter);
+	return miss_ct;
+}
+
+/**
+ * Translates every combination, as batch lines spanning several chunks, on 4 workers,
+ * with a malformed line of each kind and a line ending in \r among them, and checks that
+ * each line of output is the translation of its own line of input, or a message starting
+ * with '?' for each malformed one. Prints each fault, and returns the # of faults.
+ *
+ */
+size_t check_batch() {
+	const char *const MALFORMED[] = {"nuqa\t\t\t\t\t\t", "wayk'u\tx\t\t\t\t\t", "wayk'u\t\t\t\t\t", "wayk'u\t\t\t\t\t\t\t", ""};
+	const size_t MALFORMED_CT = sizeof(MALFORMED) / sizeof(MALFORMED[0]), LINE_CT = COMBINATION_CT + COMBINATION_CT / 97;
+	char *input = NULL, *output = NULL;
+	size_t input_len, output_len;
+	FILE *file = open_memstream(&input, &input_len);
+	if (file == NULL) {
+		printf("Could not write batch input.\n");
+		return 1;
+	}
+	for (size_t line = 0, combination = 0; line < LINE_CT; line++) {
+		if (line % 98 == 97) {
+			fprintf(file, "%s\n", MALFORMED[line / 98 % MALFORMED_CT]);
+			continue;
+		}
+		word_key key = get_combination_key(combination++);
+		fprintf(file, "%s", ROOTS[get_key_root(key)]);
+		for (size_t slot = 0; slot < SLOT_CT; slot++) {
+			fprintf(file, "\t%s", SUFFIXES[slot][get_key_suffix(key, slot)]);
+		}
+		/* the last line has no newline */
+		fprintf(file, "%s", line % 1000 == 999 ? "\r\n" : line + 1 < LINE_CT ? "\n" : "");
+	}
+	fclose(file);
+
+	struct batch_stats stats;
+	FILE *in = fmemopen(input, input_len, "r");
+	FILE *out = open_memstream(&output, &output_len);
+	bool is_ok = in != NULL && out != NULL && run_batch(in, out, 4, &stats);
+	if (in != NULL) {
+		fclose(in);
+	}
+	if (out != NULL) {
+		fclose(out);
+	}
+	free(input);
+	if (!is_ok) {
+		printf("Batch translation failed.\n");
+		free(output);
+		return 1;
+	}
+
+	size_t fault_ct = 0, line = 0, combination = 0;
+	for (char *start = output, *end; start < output + output_len && (end = memchr(start, '\n', output + output_len - start)); start = end + 1) {
+		*end = '\0';
+		bool is_malformed = line % 98 == 97;
+		const char *expected = is_malformed ? "?" : lookup_translation(get_combination_key(combination++));
+		if (is_malformed ? start[0] != '?' : strcmp(start, expected)) {
+			printf("Batch line %zu was \"%s\" ; expected \"%s\"\n", line, start, expected);
+			fault_ct++;
+		}
+		line++;
+	}
+	if (line != LINE_CT || stats.line_ct != LINE_CT || stats.error_ct != LINE_CT / 98 || stats.chunk_ct < 2) {
+		printf("Batch wrote %zu lines (%zu failed) in %zu chunks ; expected %zu lines (%zu failed) in several chunks\n", line,
+			stats.error_ct, stats.chunk_ct, (size_t) LINE_CT, (size_t) LINE_CT / 98);
+		fault_ct++;
+	}
+	free(output);
+	free(stats.translate_ns);
+	free(stats.latency_ns);
+	printf("Translated %zu batch lines in %zu chunks, %zu faults.\n", line, stats.chunk_ct, fault_ct);
+	return fault_ct;
+}
+
+/**
+ * Splits UTF-8 text into words and prints each as a tab-separated line: the word, then
+ * for each way it segments, its root and suffixes and their translation, or nothing if it
+ * does not segment. Prints how many words were known, and how fast, to stderr.
+ * Returns 0 on success.
+ *
+ * Parameters:
+ * file - text to read
+ * lexicon - verbs whose roots are split off besides the built in ones, or NULL for none
+ *
+ */
+int segment_text(FILE *file, const struct lexicon *lexicon) {
+	struct segmenter segmenter;
+	size_t root_ct;
+	const char **roots = make_key_root_names(lexicon, &root_ct);
+	if (roots == NULL || !make_segmenter(&segmenter, roots, root_ct)) {
+		fprintf(stderr, "Could not make segmenter.\n");
+		free(roots);
+		return 1;
+	}
+	char *line = NULL;
+	size_t line_cap = 0, word_ct = 0, known_ct = 0;
+	ssize_t line_len;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ((line_len = getline(&line, &line_cap, file)) >= 0) {
+		/* words are runs of letters, apostrophes and characters outside ASCII, such as ñ and ’ */
+		for (ssize_t at = 0; at < line_len;) {
+			ssize_t end_at = at;
+			while (end_at < line_len && (isalpha((unsigned char) line[end_at]) || line[end_at] == '\'' || line[end_at] == '`' || (unsigned char) line[end_at] >= 0x80)) {
+				end_at++;
+			}
+			if (end_at == at) {
+				at++;
+				continue;
+			}
+			word_key keys[8];
+			size_t key_ct = segment_word(&segmenter, line + at, end_at - at, keys, 8);
+			printf("%.*s", (int) (end_at - at), line + at);
+			for (size_t i = 0; i < key_ct && i < 8; i++) {
+				char segmented[2 * MAX_WORD_LEN + 1], translation[MAX_TRANSLATION_LEN + 1];
+				get_segmented_word(lexicon, keys[i], segmented, sizeof(segmented));
+				printf("\t%s\t%s", segmented, lookup_lexicon_translation(lexicon, keys[i], translation, sizeof(translation)));
+			}
+			printf("\n");
+			word_ct++;
+			known_ct += key_ct > 0;
+			at = end_at;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed_sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "Segmented %zu words, %zu known, in %.3f s (%.0f words/s)\n", word_ct, known_ct, elapsed_sec, word_ct / elapsed_sec);
+	free(line);
+	free_segmenter(&segmenter);
+	free(roots);
+	return 0;
+}
+
+/**
+ * Translates lines of a root and its suffixes from stdin to stdout (see run_batch), and
+ * prints throughput and chunk latency to stderr. Returns 0 on success.
+ *
+ * Parameter:
+ * THREAD_CT - # of worker threads, or 0 for one per core
+ *
+ */
+int translate_batch(const size_t THREAD_CT) {
+	long thread_ct = THREAD_CT ? (long) THREAD_CT : sysconf(_SC_NPROCESSORS_ONLN);
+	if (thread_ct < 1) {
+		thread_ct = 1;
+	}
+	struct batch_stats stats;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bool is_ok = run_batch(stdin, stdout, thread_ct, &stats);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (!is_ok) {
+		fprintf(stderr, "Batch translation failed.\n");
+	}
+	print_batch_stats(stderr, &stats, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	free(stats.translate_ns);
+	free(stats.latency_ns);
+	return is_ok ? 0 : 1;
+}
+
+/* # of combinations translated at a time by one thread, and written out together */
+#define ENUMERATION_BLOCK_LEN 1024
+
+/* output of one block of combinations */
+struct enumeration_block {
+	/* "word\ttranslation\n" for each combination of the block */
+	char *output;
+	size_t output_len;
+	bool is_done;
+};
+
+/*
+ * Every combination, split into blocks which workers translate in any order while the
+ * main thread writes them out in order, with at most slot_ct blocks in flight.
+ */
+struct enumeration {
+	pthread_mutex_t lock;
+	/* signalled whenever a block is translated or written */
+	pthread_cond_t changed;
+	struct enumeration_block *slots;
+	size_t slot_ct;
+	size_t block_ct;
+	/* # of blocks handed to workers, and written ; block n lives in slots[n % slot_ct] */
+	size_t taken_ct;
+	size_t written_ct;
+	/* # of invalid words, and # of them under each rule ; a word breaking several rules counts under the first */
+	size_t invalid_ct;
+	size_t rule_cts[INVALID_RULE_CT];
+};
+
+/**
+ * Translates one block of combinations into its output, and counts its invalid words.
+ *
+ * Replaces:
+ * block->output_len, invalid_ct, rule_cts
+ *
+ * Parameters:
+ * BLOCK - index of the block
+ * block - where the block's output goes
+ * invalid_ct - incremented by the # of invalid words
+ * rule_cts - each incremented by the # of invalid words whose first broken rule it is
+ *
+ */
+void translate_block(const size_t BLOCK, struct enumeration_block *block, size_t *invalid_ct, size_t rule_cts[]) {
+	const size_t MAX_LINE_LEN = MAX_WORD_LEN + MAX_TRANSLATION_LEN + 2;
+	struct appender output = {block->output, 0, ENUMERATION_BLOCK_LEN * MAX_LINE_LEN + 1, false};
+	size_t last = (BLOCK + 1) * ENUMERATION_BLOCK_LEN < COMBINATION_CT ? (BLOCK + 1) * ENUMERATION_BLOCK_LEN : COMBINATION_CT;
+	for (size_t combination = BLOCK * ENUMERATION_BLOCK_LEN; combination < last; combination++) {
+		word_key key = get_combination_key(combination);
+		char word[MAX_WORD_LEN + 1], translation[MAX_TRANSLATION_LEN + 1];
+		get_quechua_word(key, word, sizeof(word));
+		translate_key(key, translation, sizeof(translation));
+		append_format(&output, "%s\t%s\n", word, translation);
+
+		unsigned rules = get_invalid_rules(get_key_features(key));
+		if (rules) {
+			size_t rule = 0;
+			while (!(rules >> rule & 1)) {
+				rule++;
+			}
+			(*invalid_ct)++;
+			rule_cts[rule]++;
+		}
+	}
+	block->output_len = output.len;
+}
+
+/**
+ * Worker thread ; translates blocks in turn until there are none left, waiting while
+ * every slot holds a block not yet written.
+ *
+ * Parameter:
+ * arg - struct enumeration to fill
+ *
+ */
+void *enumerate_blocks(void *arg) {
+	struct enumeration *all = arg;
+	pthread_mutex_lock(&all->lock);
+	for (;;) {
+		while (all->taken_ct < all->block_ct && all->taken_ct - all->written_ct == all->slot_ct) {
+			pthread_cond_wait(&all->changed, &all->lock);
+		}
+		if (all->taken_ct == all->block_ct) {
+			break;
+		}
+		size_t block = all->taken_ct++;
+		struct enumeration_block *slot = &all->slots[block % all->slot_ct];
+		pthread_mutex_unlock(&all->lock);
+
+		size_t invalid_ct = 0, rule_cts[INVALID_RULE_CT] = {0};
+		translate_block(block, slot, &invalid_ct, rule_cts);
+
+		pthread_mutex_lock(&all->lock);
+		all->invalid_ct += invalid_ct;
+		for (size_t rule = 0; rule < INVALID_RULE_CT; rule++) {
+			all->rule_cts[rule] += rule_cts[rule];
+		}
+		slot->is_done = true;
+		pthread_cond_broadcast(&all->changed);
+	}
+	pthread_mutex_unlock(&all->lock);
+	return NULL;
+}
+
+/**
+ * Translates every root and suffix combination across one thread per core, writes
+ * each word and its translation to FILENAME in order as they are translated, and prints
+ * coverage statistics. If not every thread starts, runs on those that did, or on this
+ * one alone. Returns 0 on success.
+ *
+ * Parameter:
+ * FILENAME - file to write words and translations to
+ *
+ */
+int enumerate_all(const char *FILENAME) {
+	const size_t MAX_LINE_LEN = MAX_WORD_LEN + MAX_TRANSLATION_LEN + 2;
+	long thread_ct = sysconf(_SC_NPROCESSORS_ONLN);
+	if (thread_ct < 1) {
+		thread_ct = 1;
+	}
+	struct enumeration all = {
+		.slot_ct = 2 * thread_ct,
+		.block_ct = (COMBINATION_CT + ENUMERATION_BLOCK_LEN - 1) / ENUMERATION_BLOCK_LEN
+	};
+	all.slots = calloc(all.slot_ct, sizeof(struct enumeration_block));
+	for (size_t slot = 0; all.slots != NULL && slot < all.slot_ct; slot++) {
+		if ((all.slots[slot].output = malloc(ENUMERATION_BLOCK_LEN * MAX_LINE_LEN + 1)) == NULL) {
+			all.slot_ct = slot;
+		}
+	}
+	if (all.slots == NULL || all.slot_ct == 0) {
+		printf("Out of memory.\n");
+		free(all.slots);
+		return 1;
+	}
+	FILE *file;
+	if ((file = fopen(FILENAME, "w")) == NULL) {
+		printf("Could not open %s.\n", FILENAME);
+		for (size_t slot = 0; slot < all.slot_ct; slot++) {
+			free(all.slots[slot].output);
+		}
+		free(all.slots);
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_mutex_init(&all.lock, NULL);
+	pthread_cond_init(&all.changed, NULL);
+	pthread_t threads[thread_ct];
+	long worker_ct = 0;
+	while (worker_ct < thread_ct && pthread_create(&threads[worker_ct], NULL, enumerate_blocks, &all) == 0) {
+		worker_ct++;
+	}
+	if (worker_ct < thread_ct) {
+		printf("Could only start %li of %li threads.\n", worker_ct, thread_ct);
+	}
+
+	/* write out blocks in order as they are translated ; with no workers, translate them here */
+	for (size_t block = 0; block < all.block_ct; block++) {
+		struct enumeration_block *slot = &all.slots[block % all.slot_ct];
+		if (worker_ct == 0) {
+			translate_block(block, slot, &all.invalid_ct, all.rule_cts);
+		} else {
+			pthread_mutex_lock(&all.lock);
+			while (!slot->is_done) {
+				pthread_cond_wait(&all.changed, &all.lock);
+			}
+			pthread_mutex_unlock(&all.lock);
+		}
+		fwrite(slot->output, 1, slot->output_len, file);
+		pthread_mutex_lock(&all.lock);
+		slot->is_done = false;
+		all.written_ct++;
+		pthread_cond_broadcast(&all.changed);
+		pthread_mutex_unlock(&all.lock);
+	}
+	for (long thread = 0; thread < worker_ct; thread++) {
+		pthread_join(threads[thread], NULL);
+	}
+	bool is_written = !ferror(file);
+	is_written = fclose(file) == 0 && is_written;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed_sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	for (size_t slot = 0; slot < all.slot_ct; slot++) {
+		free(all.slots[slot].output);
+	}
+	free(all.slots);
+	pthread_mutex_destroy(&all.lock);
+	pthread_cond_destroy(&all.changed);
+	if (!is_written) {
+		printf("Could not write %s.\n", FILENAME);
+		return 1;
+	}
+
+	/* print statistics */
+	printf("Translated %i words into %s using %li threads.\n", COMBINATION_CT, FILENAME, worker_ct ? worker_ct : 1);
+	printf("Invalid input: %zu (%.2f%%), each counted under the first rule it breaks:\n", all.invalid_ct, 100.0 * all.invalid_ct / COMBINATION_CT);
+	for (size_t rule = 0; rule < INVALID_RULE_CT; rule++) {
+		printf("\t%zu (%.2f%%) rejected for %s\n", all.rule_cts[rule], 100.0 * all.rule_cts[rule] / COMBINATION_CT, INVALID_RULE_NAMES[rule]);
+	}
+	printf("Time: %.3f s (%.0f words/s)\n", elapsed_sec, COMBINATION_CT / elapsed_sec);
+	return 0;
 }
 
 /**
@@ -63,30 +752,79 @@ const char **get_random_suffixes() {
  *
  * Author: Alec Kingsley
  *
+ * Options:
+ * --check - compare translate(), translate_key() and the precomputed translation table against
+ * 	the reference translator,
+ * 	check the verbs of lexicon.tsv against the built in ones, search the reverse index
+ * 	for every translation, segment every word, and translate batch lines, some malformed, in order
+ * --lexicon FILE - translate a random word whose root is taken from the lexicon FILE
+ * --reverse [--prefix] PHRASE - list the words whose translation contains PHRASE ;
+ * 	with --prefix, its last word may be the start of a longer word
+ * --segment [--lexicon LEXICON] [FILE] - split each word of FILE (default stdin) into its root
+ * 	and suffixes, and translate it ; with --lexicon, roots of the lexicon file LEXICON are split
+ * 	off too
+ * --batch [THREADS] - translate lines of a root and its 6 suffixes, separated by tabs, from
+ * 	stdin to stdout in order, using THREADS workers (default one per core)
+ * --all [FILE] - translate every word into FILE (default all_words.txt) and print statistics
+ *
  */
 int main(int argc, char *argv[]) {
-	/* set random seed */
-	srand(time(NULL));
-	const char *roots[] = {"t'usu", "puklla", "wayk'u", "awa", "llamk'a"};
-	const char **suffixes = get_random_suffixes();
-	size_t i;
-	const int SUFFIX_CT = 6;
-	const char *root = roots[rand() % (sizeof(roots) / sizeof(roots[0]))];
-	char *translation = translate(root, suffixes);
+	if (argc > 1 && !strcmp(argv[1], "--check")) {
+		size_t mismatch_ct = check_table();
+		mismatch_ct += check_lexicon("lexicon.tsv");
+		mismatch_ct += check_reverse_index();
+		mismatch_ct += check_segmenter();
+		mismatch_ct += check_batch();
+		return mismatch_ct ? 1 : 0;
+	}
+	if (argc > 2 && !strcmp(argv[1], "--reverse")) {
+		bool prefix = argc > 3 && !strcmp(argv[2], "--prefix");
+		return reverse_translate(argv[prefix ? 3 : 2], prefix);
+	}
+	if (argc > 1 && !strcmp(argv[1], "--batch")) {
+		return translate_batch(argc > 2 ? atoi(argv[2]) : 0);
+	}
+	if (argc > 1 && !strcmp(argv[1], "--segment")) {
+		struct lexicon lexicon;
+		bool has_lexicon = argc > 3 && !strcmp(argv[2], "--lexicon");
+		if (has_lexicon && !load_lexicon(&lexicon, argv[3])) {
+			printf("Could not load lexicon %s.\n", argv[3]);
+			return 1;
+		}
+		int file_arg = has_lexicon ? 4 : 2;
+		FILE *file = argc > file_arg ? fopen(argv[file_arg], "r") : stdin;
+		if (file == NULL) {
+			printf("Could not open %s.\n", argv[file_arg]);
+			return 1;
+		}
+		int status = segment_text(file, has_lexicon ? &lexicon : NULL);
+		fclose(file);
+		if (has_lexicon) {
+			free_lexicon(&lexicon);
+		}
+		return status;
+	}
+	if (argc > 1 && !strcmp(argv[1], "--all")) {
+		return enumerate_all(argc > 2 ? argv[2] : "all_words.txt");
+	}
 
-	/* print original Quechua word */
-	printf("Quechua word: %s", root);
-	for (i = 0; i < SUFFIX_CT; i++) {
-		printf("%s",suffixes[i]);
+	/* set random seed ; mix in nanoseconds and pid so runs in the same second differ */
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	srand(now.tv_sec ^ now.tv_nsec ^ getpid());
+	if (argc > 2 && !strcmp(argv[1], "--lexicon")) {
+		return translate_random_lexicon_word(argv[2]);
 	}
-	printf("\n");
+	word_key key = get_random_key();
+	char word[MAX_WORD_LEN + 1];
+	get_quechua_word(key, word, sizeof(word));
+
+	/* print original Quechua word */
+	printf("Quechua word: %s\n", word);
 
 	/* translate and print */
-	printf("Translation: %s\n", translation);
+	printf("Translation: %s\n", lookup_translation(key));
 
-	/* clean up and leave */
-	free(suffixes);
-	free(translation);
 	return 0;
 }
 
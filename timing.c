@@ -0,0 +1,12 @@
+#include <time.h>
+#include "timing.h"
+
+/**
+ * Returns the current monotonic time in ns.
+ *
+ */
+uint64_t get_monotonic_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
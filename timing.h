@@ -0,0 +1,8 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+uint64_t get_monotonic_ns();
+
+#endif
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "timing.h"
+
+/**
+ * Creates FILENAME and writes a trace header to it. Returns false if the file could
+ * not be written.
+ *
+ * Replaces:
+ * writer
+ *
+ * Parameters:
+ * writer - writer to set up
+ * FILENAME - file to record to, replaced if it exists
+ *
+ */
+bool open_trace_writer(struct trace_writer *writer, const char *FILENAME) {
+	struct trace_header header = {TRACE_MAGIC, TRACE_VERSION, sizeof(struct trace_record), get_monotonic_ns()};
+	writer->start_ns = header.start_ns;
+	writer->record_ct = 0;
+	if ((writer->file = fopen(FILENAME, "wb")) == NULL) {
+		return false;
+	}
+	if (fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+		fclose(writer->file);
+		writer->file = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Appends a ping to a trace. Records are buffered, so they only reach the file in
+ * blocks, or when the writer is closed.
+ *
+ * Parameters:
+ * writer - trace to append to
+ * RING - ring that was pinged
+ * TRIGGER_NS - monotonic time of the trigger
+ * ECHO_NS - time the echo pin was high, or 0 if no echo was timed
+ * DISTANCE_CM - distance the echo was decoded to, or -1 if out of range
+ *
+ */
+void write_trace_record(struct trace_writer *writer, const size_t RING, const uint64_t TRIGGER_NS, const uint64_t ECHO_NS, const float DISTANCE_CM) {
+	struct trace_record record = {
+		.timestamp_ns = TRIGGER_NS - writer->start_ns,
+		.echo_ns = ECHO_NS > UINT32_MAX ? UINT32_MAX : ECHO_NS,
+		.distance_cm = DISTANCE_CM,
+		.ring = RING
+	};
+	if (fwrite(&record, sizeof(record), 1, writer->file) == 1) {
+		writer->record_ct++;
+	}
+}
+
+/**
+ * Flushes and closes a trace.
+ *
+ * Parameter:
+ * writer - trace to close
+ *
+ */
+void close_trace_writer(struct trace_writer *writer) {
+	if (writer->file != NULL) {
+		fclose(writer->file);
+		writer->file = NULL;
+	}
+}
+
+/**
+ * Maps a trace file into memory, so its records can be read in place. A partly
+ * written last record, left by a recorder that did not close the trace, is ignored.
+ * Returns false if the file could not be mapped, or is not a trace of this version.
+ *
+ * Replaces:
+ * trace
+ *
+ * Parameters:
+ * trace - trace to fill
+ * FILENAME - file to map
+ *
+ */
+bool map_trace(struct trace *trace, const char *FILENAME) {
+	struct stat info;
+	int fd = open(FILENAME, O_RDONLY | O_CLOEXEC);
+	trace->map = NULL;
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &info) < 0 || info.st_size < sizeof(struct trace_header)) {
+		close(fd);
+		return false;
+	}
+	trace->map_len = info.st_size;
+	trace->map = mmap(NULL, trace->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* the mapping stays valid once the file is closed */
+	close(fd);
+	if (trace->map == MAP_FAILED) {
+		trace->map = NULL;
+		return false;
+	}
+
+	const struct trace_header *header = trace->map;
+	if (memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION ||
+		header->record_size != sizeof(struct trace_record)) {
+		unmap_trace(trace);
+		return false;
+	}
+	trace->records = (const struct trace_record *) (header + 1);
+	trace->record_ct = (trace->map_len - sizeof(*header)) / sizeof(struct trace_record);
+	/* records are read once, front to back */
+	madvise(trace->map, trace->map_len, MADV_SEQUENTIAL);
+	return true;
+}
+
+/**
+ * Unmaps a trace.
+ *
+ * Parameter:
+ * trace - trace to unmap
+ *
+ */
+void unmap_trace(struct trace *trace) {
+	if (trace->map != NULL) {
+		munmap(trace->map, trace->map_len);
+		trace->map = NULL;
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* first bytes of every trace file, and the layout version of what follows */
+#define TRACE_MAGIC "MUYUTRC"
+#define TRACE_VERSION 1
+
+/* start of a trace file ; records follow immediately, to the end of the file */
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	/* sizeof(struct trace_record) when written */
+	uint32_t record_size;
+	/* monotonic time recording started, in ns */
+	uint64_t start_ns;
+};
+
+/* one ping of one ring, in the byte order of the machine which recorded it */
+struct trace_record {
+	/* time of the trigger, since start_ns */
+	uint64_t timestamp_ns;
+	/* time the echo pin was high, or 0 if no echo was timed */
+	uint32_t echo_ns;
+	/* distance the echo was decoded to, or -1 if out of range */
+	float distance_cm;
+	uint16_t ring;
+	uint16_t reserved[3];
+};
+
+/* trace file being recorded */
+struct trace_writer {
+	FILE *file;
+	uint64_t start_ns;
+	size_t record_ct;
+};
+
+/* trace file mapped read only */
+struct trace {
+	const struct trace_record *records;
+	size_t record_ct;
+	void *map;
+	size_t map_len;
+};
+
+bool open_trace_writer(struct trace_writer *writer, const char *FILENAME);
+void write_trace_record(struct trace_writer *writer, const size_t RING, const uint64_t TRIGGER_NS, const uint64_t ECHO_NS, const float DISTANCE_CM);
+void close_trace_writer(struct trace_writer *writer);
+bool map_trace(struct trace *trace, const char *FILENAME);
+void unmap_trace(struct trace *trace);
+
+#endif
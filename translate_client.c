@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "translate_client.h"
+
+/**
+ * Connects to translated. Returns false on failure.
+ *
+ * Replaces:
+ * client
+ *
+ * Parameters:
+ * client - connection to open
+ * PATH - socket translated listens on, or NULL for DEFAULT_TRANSLATE_SOCKET
+ *
+ */
+bool connect_translator(struct translate_client *client, const char *PATH) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	PATH = PATH ? PATH : DEFAULT_TRANSLATE_SOCKET;
+	memset(client, 0, sizeof(*client));
+	if (strlen(PATH) >= sizeof(addr.sun_path)) {
+		return false;
+	}
+	strcpy(addr.sun_path, PATH);
+	if ((client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+		return false;
+	}
+	if (connect(client->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(client->fd);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Sends the request built in client->out, whose body follows its header. Returns false on
+ * failure.
+ *
+ * Replaces:
+ * client
+ * id
+ *
+ * Parameters:
+ * client - connection to send on
+ * OP - what the request asks for
+ * WORD_CT - # of words in the body
+ * id - set to the request's id, if not NULL
+ *
+ */
+bool send_request(struct translate_client *client, const enum frame_op OP, const size_t WORD_CT, uint32_t *id) {
+	struct frame_header header = {client->out.len - sizeof(header.len), client->next_id, OP, WORD_CT};
+	memcpy(client->out.data, &header, sizeof(header));
+	for (size_t sent_len = 0; sent_len < client->out.len;) {
+		ssize_t len = send(client->fd, client->out.data + sent_len, client->out.len - sent_len, MSG_NOSIGNAL);
+		if (len < 0 && errno != EINTR) {
+			return false;
+		}
+		sent_len += len > 0 ? len : 0;
+	}
+	if (id != NULL) {
+		*id = client->next_id;
+	}
+	client->next_id++;
+	return true;
+}
+
+/**
+ * Sends a request to translate words given by key, without waiting for the reply.
+ * Returns false on failure.
+ *
+ * Replaces:
+ * client
+ * id
+ *
+ * Parameters:
+ * client - connection to send on
+ * KEYS - words to translate
+ * KEY_CT - # of words, at most MAX_FRAME_WORDS
+ * id - set to the request's id, if not NULL
+ *
+ */
+bool send_keys(struct translate_client *client, const word_key KEYS[], const size_t KEY_CT, uint32_t *id) {
+	struct frame_header header = {0};
+	client->out.len = 0;
+	return KEY_CT <= MAX_FRAME_WORDS && append_bytes(&client->out, &header, sizeof(header)) &&
+		append_bytes(&client->out, KEYS, KEY_CT * sizeof(KEYS[0])) && send_request(client, OP_KEYS, KEY_CT, id);
+}
+
+/**
+ * Sends a request to split and translate raw Quechua words, without waiting for the
+ * reply. Returns false on failure.
+ *
+ * Replaces:
+ * client
+ * id
+ *
+ * Parameters:
+ * client - connection to send on
+ * WORDS - words to translate, each at most MAX_RAW_WORD_LEN bytes
+ * WORD_CT - # of words, at most MAX_FRAME_WORDS
+ * id - set to the request's id, if not NULL
+ *
+ */
+bool send_words(struct translate_client *client, const char *const WORDS[], const size_t WORD_CT, uint32_t *id) {
+	struct frame_header header = {0};
+	client->out.len = 0;
+	if (WORD_CT > MAX_FRAME_WORDS || !append_bytes(&client->out, &header, sizeof(header))) {
+		return false;
+	}
+	for (size_t i = 0; i < WORD_CT; i++) {
+		size_t len = strlen(WORDS[i]);
+		uint8_t len_byte = len;
+		if (len > MAX_RAW_WORD_LEN || !append_bytes(&client->out, &len_byte, 1) || !append_bytes(&client->out, WORDS[i], len)) {
+			return false;
+		}
+	}
+	return send_request(client, OP_WORDS, WORD_CT, id);
+}
+
+/**
+ * Returns true iff a whole reply has been received, so read_reply will not block.
+ *
+ * Parameter:
+ * client - connection to check
+ *
+ */
+bool is_reply_ready(const struct translate_client *client) {
+	struct frame_header header;
+	return peek_frame(client->in.data + client->taken_len, client->in.len - client->taken_len, &header);
+}
+
+/**
+ * Reads the reply to the oldest request not yet answered, waiting for it if need be.
+ * Returns false if the connection fails, or the reply is malformed.
+ *
+ * Replaces:
+ * client
+ * reply
+ *
+ * Parameters:
+ * client - connection to read from
+ * reply - reply read ; its translations last until the next reply is read
+ *
+ */
+bool read_reply(struct translate_client *client, struct translate_reply *reply) {
+	if (client->taken_len > 0) {
+		consume_bytes(&client->in, client->taken_len);
+		client->taken_len = 0;
+	}
+	struct frame_header header;
+	enum frame_scan scan;
+	while ((scan = scan_frame(client->in.data, client->in.len, &header)) != SCAN_WHOLE) {
+		if (scan == SCAN_BAD_LEN || !reserve_bytes(&client->in, 65536)) {
+			return false;
+		}
+		ssize_t len = recv(client->fd, client->in.data + client->in.len, 65536, 0);
+		if (len == 0 || (len < 0 && errno != EINTR)) {
+			return false;
+		}
+		client->in.len += len > 0 ? len : 0;
+	}
+	if (header.word_ct > MAX_FRAME_WORDS) {
+		return false;
+	}
+
+	const uint8_t *end = client->in.data + sizeof(header.len) + header.len;
+	const uint8_t *pos = client->in.data + sizeof(header);
+	*reply = (struct translate_reply) {header.id, header.code, header.word_ct};
+	for (size_t i = 0; i < header.word_ct; i++) {
+		struct word_entry entry;
+		if (end - pos < (ptrdiff_t) sizeof(entry)) {
+			return false;
+		}
+		memcpy(&entry, pos, sizeof(entry));
+		pos += sizeof(entry);
+		if (end - pos < entry.len) {
+			return false;
+		}
+		reply->words[i] = (struct word_reply) {entry.status, entry.key, (const char *) pos, entry.len};
+		pos += entry.len;
+	}
+	client->taken_len = sizeof(header.len) + header.len;
+	return pos == end;
+}
+
+/**
+ * Translates words given by key, waiting for the reply. Returns false on failure.
+ *
+ * Replaces:
+ * client
+ * reply
+ *
+ * Parameters:
+ * client - connection to use, with no other request in flight
+ * KEYS - words to translate
+ * KEY_CT - # of words, at most MAX_FRAME_WORDS
+ * reply - reply read ; its translations last until the next reply is read
+ *
+ */
+bool translate_keys_remote(struct translate_client *client, const word_key KEYS[], const size_t KEY_CT, struct translate_reply *reply) {
+	return send_keys(client, KEYS, KEY_CT, NULL) && read_reply(client, reply);
+}
+
+/**
+ * Splits and translates raw Quechua words, waiting for the reply. Returns false on
+ * failure.
+ *
+ * Replaces:
+ * client
+ * reply
+ *
+ * Parameters:
+ * client - connection to use, with no other request in flight
+ * WORDS - words to translate
+ * WORD_CT - # of words, at most MAX_FRAME_WORDS
+ * reply - reply read ; its translations last until the next reply is read
+ *
+ */
+bool translate_words_remote(struct translate_client *client, const char *const WORDS[], const size_t WORD_CT, struct translate_reply *reply) {
+	return send_words(client, WORDS, WORD_CT, NULL) && read_reply(client, reply);
+}
+
+/**
+ * Closes a connection to translated.
+ *
+ * Parameter:
+ * client - connection to close
+ *
+ */
+void close_translator(struct translate_client *client) {
+	close(client->fd);
+	free_byte_buffer(&client->in);
+	free_byte_buffer(&client->out);
+}
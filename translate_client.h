@@ -0,0 +1,51 @@
+#ifndef TRANSLATE_CLIENT_H
+#define TRANSLATE_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "que_to_eng.h"
+#include "translate_proto.h"
+
+/* one word of a reply */
+struct word_reply {
+	enum word_status status;
+	/* word translated ; for a raw word, the first way it splits */
+	word_key key;
+	/* translation, not null terminated, which lasts until the next reply is read */
+	const char *translation;
+	size_t len;
+};
+
+/* reply to one request */
+struct translate_reply {
+	uint32_t id;
+	enum frame_status status;
+	size_t word_ct;
+	struct word_reply words[MAX_FRAME_WORDS];
+};
+
+/*
+ * Connection to translated. Requests may be sent one after another without waiting, and
+ * their replies are read back in the order they were sent.
+ */
+struct translate_client {
+	int fd;
+	uint32_t next_id;
+	/* bytes received and not yet read as replies ; the first taken_len belong to the last reply read */
+	struct byte_buffer in;
+	size_t taken_len;
+	/* request being built */
+	struct byte_buffer out;
+};
+
+bool connect_translator(struct translate_client *client, const char *PATH);
+bool send_keys(struct translate_client *client, const word_key KEYS[], const size_t KEY_CT, uint32_t *id);
+bool send_words(struct translate_client *client, const char *const WORDS[], const size_t WORD_CT, uint32_t *id);
+bool is_reply_ready(const struct translate_client *client);
+bool read_reply(struct translate_client *client, struct translate_reply *reply);
+bool translate_keys_remote(struct translate_client *client, const word_key KEYS[], const size_t KEY_CT, struct translate_reply *reply);
+bool translate_words_remote(struct translate_client *client, const char *const WORDS[], const size_t WORD_CT, struct translate_reply *reply);
+void close_translator(struct translate_client *client);
+
+#endif
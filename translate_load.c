@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "translate_client.h"
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "histogram.h"
+#include "timing.h"
+
+/* # of distinct words the load is drawn from */
+#define WORKLOAD_LEN 4096
+/* most requests one connection keeps in flight */
+#define MAX_DEPTH 256
+/* longest to wait for translated to start listening */
+#define CONNECT_TIMEOUT_NS 2000000000
+
+/* shape of the load */
+struct load_settings {
+	const char *socket_path;
+	size_t connection_ct;
+	/* words per request */
+	size_t batch_len;
+	/* most requests in flight on each connection */
+	size_t depth;
+	/* requests per second over every connection, or 0 to send as fast as depth allows */
+	double rate;
+	double seconds;
+	/* whether to send raw words rather than keys */
+	bool is_raw;
+};
+
+/* one connection's share of the load, and what it saw */
+struct load_worker {
+	pthread_t thread;
+	const struct load_settings *settings;
+	size_t index;
+	/* time from when each request was due to be sent until its reply was read */
+	struct histogram latency_ns;
+	uint64_t request_ct;
+	uint64_t word_ct;
+	/* # of words whose reply was not their translation */
+	uint64_t wrong_ct;
+	bool is_failed;
+};
+
+/* words requested, as keys and as raw words */
+word_key keys[WORKLOAD_LEN];
+char words[WORKLOAD_LEN][MAX_WORD_LEN + 1];
+const char *word_ptrs[WORKLOAD_LEN];
+
+/**
+ * Returns the # of words of a reply which are not the translation of the words asked for.
+ *
+ * Parameters:
+ * reply - reply read
+ * FIRST - index into keys of the first word asked for
+ * WORD_CT - # of words asked for
+ *
+ */
+size_t count_wrong_words(const struct translate_reply *reply, const size_t FIRST, const size_t WORD_CT) {
+	if (reply->status != FRAME_OK || reply->word_ct != WORD_CT) {
+		return WORD_CT;
+	}
+	size_t wrong_ct = 0;
+	for (size_t i = 0; i < WORD_CT; i++) {
+		const struct word_reply *word = &reply->words[i];
+		const char *translation = lookup_translation(keys[FIRST + i]);
+		wrong_ct += word->status != WORD_OK || word->key != keys[FIRST + i] || word->len != strlen(translation) ||
+			memcmp(word->translation, translation, word->len) != 0;
+	}
+	return wrong_ct;
+}
+
+/**
+ * Connects to translated, retrying while it starts up. Returns false if it never
+ * answers.
+ *
+ * Replaces:
+ * client
+ *
+ * Parameters:
+ * client - connection to open
+ * PATH - socket translated listens on
+ *
+ */
+bool connect_when_up(struct translate_client *client, const char *PATH) {
+	uint64_t give_up_ns = get_monotonic_ns() + CONNECT_TIMEOUT_NS;
+	while (!connect_translator(client, PATH)) {
+		if (get_monotonic_ns() > give_up_ns) {
+			return false;
+		}
+		usleep(10000);
+	}
+	return true;
+}
+
+/**
+ * Thread which sends requests on one connection, pipelined up to depth deep, for the
+ * length of the run, and times each. With a rate, requests are due at fixed intervals,
+ * and each is timed from when it was due rather than when it was sent, so a server which
+ * falls behind is not flattered by requests it delayed.
+ *
+ * Parameter:
+ * arg - worker to run
+ *
+ */
+void *run_load(void *arg) {
+	struct load_worker *worker = arg;
+	const struct load_settings *settings = worker->settings;
+	struct translate_client client;
+	struct translate_reply *reply = malloc(sizeof(*reply));
+	if (reply == NULL || !connect_when_up(&client, settings->socket_path)) {
+		worker->is_failed = true;
+		free(reply);
+		return NULL;
+	}
+
+	/* when each request in flight was due, and its first word */
+	uint64_t due_ns[MAX_DEPTH];
+	size_t firsts[MAX_DEPTH];
+	const uint64_t INTERVAL_NS = settings->rate > 0 ? settings->connection_ct * 1e9 / settings->rate : 0;
+	uint64_t now_ns = get_monotonic_ns(), end_ns = now_ns + settings->seconds * 1e9;
+	/* connections take turns, rather than all sending at once */
+	uint64_t next_ns = now_ns + INTERVAL_NS * worker->index / settings->connection_ct;
+	size_t sent_ct = 0, done_ct = 0, first = worker->index * settings->batch_len % (WORKLOAD_LEN - settings->batch_len);
+	while (!worker->is_failed) {
+		while (sent_ct - done_ct < settings->depth && now_ns < end_ns && now_ns >= next_ns) {
+			bool is_sent = settings->is_raw ? send_words(&client, word_ptrs + first, settings->batch_len, NULL) :
+				send_keys(&client, keys + first, settings->batch_len, NULL);
+			if (!is_sent) {
+				worker->is_failed = true;
+				break;
+			}
+			due_ns[sent_ct % settings->depth] = INTERVAL_NS ? next_ns : now_ns;
+			firsts[sent_ct % settings->depth] = first;
+			first = (first + settings->batch_len) % (WORKLOAD_LEN - settings->batch_len);
+			next_ns = INTERVAL_NS ? next_ns + INTERVAL_NS : now_ns;
+			sent_ct++;
+		}
+		if (worker->is_failed || (sent_ct == done_ct && now_ns >= end_ns)) {
+			break;
+		}
+
+		if (!is_reply_ready(&client)) {
+			/* wake for the next request due, or else the next reply */
+			uint64_t wait_ns = 1000000000;
+			if (sent_ct - done_ct < settings->depth && now_ns < end_ns) {
+				wait_ns = next_ns > now_ns ? next_ns - now_ns : 0;
+			}
+			struct pollfd fd = {client.fd, POLLIN, 0};
+			struct timespec timeout = {wait_ns / 1000000000, wait_ns % 1000000000};
+			if (sent_ct == done_ct || ppoll(&fd, 1, &timeout, NULL) <= 0) {
+				if (sent_ct == done_ct) {
+					nanosleep(&timeout, NULL);
+				}
+				now_ns = get_monotonic_ns();
+				continue;
+			}
+		}
+		if (!read_reply(&client, reply)) {
+			worker->is_failed = true;
+			break;
+		}
+		now_ns = get_monotonic_ns();
+		record_histogram(&worker->latency_ns, now_ns - due_ns[done_ct % settings->depth]);
+		worker->wrong_ct += count_wrong_words(reply, firsts[done_ct % settings->depth], settings->batch_len);
+		worker->request_ct++;
+		worker->word_ct += settings->batch_len;
+		done_ct++;
+	}
+	close_translator(&client);
+	free(reply);
+	return NULL;
+}
+
+/**
+ * Writes the settings and results of a run as JSON. Returns false on failure.
+ *
+ * Parameters:
+ * FILENAME - file to write
+ * settings - load sent
+ * total - every worker's results, merged
+ * ELAPSED_SEC - length of the run
+ * FAILED_CT - # of connections which failed
+ *
+ */
+bool save_load_results(const char *FILENAME, const struct load_settings *settings, const struct load_worker *total, const double ELAPSED_SEC,
+	const size_t FAILED_CT) {
+	FILE *file;
+	if ((file = fopen(FILENAME, "w")) == NULL) {
+		printf("Could not open %s.\n", FILENAME);
+		return false;
+	}
+	fprintf(file, "{\n\"settings\": {\"connections\": %zu, \"batch\": %zu, \"depth\": %zu, \"rate\": %.1f, \"seconds\": %.1f, \"raw_words\": %s},\n",
+		settings->connection_ct, settings->batch_len, settings->depth, settings->rate, settings->seconds, settings->is_raw ? "true" : "false");
+	fprintf(file, "\"requests_per_sec\": %.1f, \"words_per_sec\": %.1f,\n", total->request_ct / ELAPSED_SEC, total->word_ct / ELAPSED_SEC);
+	fprintf(file, "\"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"p99.9\": %.2f, \"max\": %.2f},\n",
+		get_histogram_mean(&total->latency_ns) / 1e3, get_histogram_percentile(&total->latency_ns, 50) / 1e3,
+		get_histogram_percentile(&total->latency_ns, 90) / 1e3, get_histogram_percentile(&total->latency_ns, 99) / 1e3,
+		get_histogram_percentile(&total->latency_ns, 99.9) / 1e3, total->latency_ns.max / 1e3);
+	fprintf(file, "\"wrong_words\": %lu, \"failed_connections\": %zu\n}\n", (unsigned long) total->wrong_ct, FAILED_CT);
+	fclose(file);
+	return true;
+}
+
+/**
+ * Load generator for translated: sends batches of random valid words over several
+ * connections, pipelined, and reports throughput, latency percentiles and any reply
+ * which is not the word's translation. Fails if any connection fails or any reply is
+ * wrong.
+ *
+ * Options:
+ * --socket PATH - socket translated listens on (default DEFAULT_TRANSLATE_SOCKET)
+ * --connections N - # of connections, each on its own thread (default 4)
+ * --batch N - words per request (default 16)
+ * --depth N - most requests in flight per connection (default 8)
+ * --rate R - requests per second over all connections (default 0, as fast as depth allows)
+ * --seconds S - length of the run (default 5)
+ * --raw - send raw Quechua words to be split, rather than keys
+ * --output FILE - write JSON results to FILE
+ *
+ */
+int main(int argc, char *argv[]) {
+	struct load_settings settings = {DEFAULT_TRANSLATE_SOCKET, 4, 16, 8, 0, 5, false};
+	const char *output = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--raw")) {
+			settings.is_raw = true;
+		} else if (i + 1 == argc) {
+			break;
+		} else if (!strcmp(argv[i], "--socket")) {
+			settings.socket_path = argv[++i];
+		} else if (!strcmp(argv[i], "--connections")) {
+			settings.connection_ct = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--batch")) {
+			settings.batch_len = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--depth")) {
+			settings.depth = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--rate")) {
+			settings.rate = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--seconds")) {
+			settings.seconds = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--output")) {
+			output = argv[++i];
+		}
+	}
+	if (settings.connection_ct == 0 || settings.batch_len == 0 || settings.batch_len > MAX_FRAME_WORDS || settings.depth == 0 ||
+		settings.depth > MAX_DEPTH) {
+		printf("Need at least 1 connection, 1 to %i words per request and a depth of 1 to %i.\n", MAX_FRAME_WORDS, MAX_DEPTH);
+		return 1;
+	}
+
+	/* random valid words, the same every run */
+	srand(1);
+	for (size_t i = 0; i < WORKLOAD_LEN; i++) {
+		do {
+			keys[i] = get_combination_key(rand() % COMBINATION_CT);
+		} while (lookup_translation(keys[i])[0] == '\0');
+		get_quechua_word(keys[i], words[i], sizeof(words[i]));
+		word_ptrs[i] = words[i];
+	}
+
+	struct load_worker *workers = calloc(settings.connection_ct, sizeof(workers[0]));
+	uint64_t start_ns = get_monotonic_ns();
+	for (size_t i = 0; i < settings.connection_ct; i++) {
+		workers[i].settings = &settings;
+		workers[i].index = i;
+		if (pthread_create(&workers[i].thread, NULL, run_load, &workers[i]) != 0) {
+			printf("Could not start connection %zu.\n", i);
+			return 1;
+		}
+	}
+	struct load_worker total = {0};
+	size_t failed_ct = 0;
+	for (size_t i = 0; i < settings.connection_ct; i++) {
+		pthread_join(workers[i].thread, NULL);
+		merge_histogram(&total.latency_ns, &workers[i].latency_ns);
+		total.request_ct += workers[i].request_ct;
+		total.word_ct += workers[i].word_ct;
+		total.wrong_ct += workers[i].wrong_ct;
+		failed_ct += workers[i].is_failed;
+	}
+	double elapsed_sec = (get_monotonic_ns() - start_ns) / 1e9;
+
+	printf("%lu requests (%lu words) on %zu connections in %.1f s: %.0f requests, %.0f words per second\n", (unsigned long) total.request_ct,
+		(unsigned long) total.word_ct, settings.connection_ct, elapsed_sec, total.request_ct / elapsed_sec, total.word_ct / elapsed_sec);
+	if (settings.rate > 0) {
+		printf("Offered %.0f requests per second\n", settings.rate);
+	}
+	printf("Latency: mean %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", get_histogram_mean(&total.latency_ns) / 1e3,
+		get_histogram_percentile(&total.latency_ns, 50) / 1e3, get_histogram_percentile(&total.latency_ns, 90) / 1e3,
+		get_histogram_percentile(&total.latency_ns, 99) / 1e3, get_histogram_percentile(&total.latency_ns, 99.9) / 1e3,
+		total.latency_ns.max / 1e3);
+	printf("Wrong words: %lu, failed connections: %zu\n", (unsigned long) total.wrong_ct, failed_ct);
+	if (output != NULL) {
+		save_load_results(output, &settings, &total, elapsed_sec, failed_ct);
+	}
+	free(workers);
+	return total.wrong_ct == 0 && failed_ct == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include "translate_proto.h"
+
+/**
+ * Makes room for LEN more bytes at the end of a buffer. Returns false if out of memory.
+ *
+ * Replaces:
+ * buffer
+ *
+ * Parameters:
+ * buffer - buffer to grow
+ * LEN - # of bytes to make room for
+ *
+ */
+bool reserve_bytes(struct byte_buffer *buffer, const size_t LEN) {
+	if (buffer->len + LEN <= buffer->cap) {
+		return true;
+	}
+	size_t cap = buffer->cap ? buffer->cap : 4096;
+	while (cap < buffer->len + LEN) {
+		cap *= 2;
+	}
+	uint8_t *data = realloc(buffer->data, cap);
+	if (data == NULL) {
+		return false;
+	}
+	buffer->data = data;
+	buffer->cap = cap;
+	return true;
+}
+
+/**
+ * Adds bytes to the end of a buffer. Returns false if out of memory.
+ *
+ * Replaces:
+ * buffer
+ *
+ * Parameters:
+ * buffer - buffer to add to
+ * DATA - bytes to add
+ * LEN - # of bytes
+ *
+ */
+bool append_bytes(struct byte_buffer *buffer, const void *DATA, const size_t LEN) {
+	if (!reserve_bytes(buffer, LEN)) {
+		return false;
+	}
+	memcpy(buffer->data + buffer->len, DATA, LEN);
+	buffer->len += LEN;
+	return true;
+}
+
+/**
+ * Drops bytes from the start of a buffer.
+ *
+ * Replaces:
+ * buffer
+ *
+ * Parameters:
+ * buffer - buffer to drop from
+ * LEN - # of bytes, at most buffer->len
+ *
+ */
+void consume_bytes(struct byte_buffer *buffer, const size_t LEN) {
+	memmove(buffer->data, buffer->data + LEN, buffer->len - LEN);
+	buffer->len -= LEN;
+}
+
+/**
+ * Frees a buffer, leaving it empty.
+ *
+ * Parameter:
+ * buffer - buffer to free
+ *
+ */
+void free_byte_buffer(struct byte_buffer *buffer) {
+	free(buffer->data);
+	*buffer = (struct byte_buffer) {NULL, 0, 0};
+}
+
+/**
+ * Reads the header of the frame at the start of DATA, if LEN covers it. Returns true iff
+ * the whole frame is there ; its length is sizeof(header.len) + header.len.
+ *
+ * Replaces:
+ * header
+ *
+ * Parameters:
+ * DATA - bytes received
+ * LEN - # of bytes
+ * header - header of the frame
+ *
+ */
+bool peek_frame(const uint8_t *DATA, const size_t LEN, struct frame_header *header) {
+	if (LEN < sizeof(*header)) {
+		return false;
+	}
+	memcpy(header, DATA, sizeof(*header));
+	return LEN - sizeof(header->len) >= header->len;
+}
+
+/**
+ * Reads the header of the frame at the start of DATA, as peek_frame does, and tells
+ * whether the frame is whole, still arriving, or of a length no frame can have. A bad
+ * length is caught as soon as the header arrives, rather than waiting for a body which
+ * may never fit.
+ *
+ * Replaces:
+ * header
+ *
+ * Parameters:
+ * DATA - bytes received
+ * LEN - # of bytes
+ * header - header of the frame
+ *
+ */
+enum frame_scan scan_frame(const uint8_t *DATA, const size_t LEN, struct frame_header *header) {
+	bool is_whole = peek_frame(DATA, LEN, header);
+	if (LEN >= sizeof(*header) && (header->len < sizeof(*header) - sizeof(header->len) || header->len > MAX_FRAME_LEN)) {
+		return SCAN_BAD_LEN;
+	}
+	return is_whole ? SCAN_WHOLE : SCAN_PARTIAL;
+}
@@ -0,0 +1,90 @@
+#ifndef TRANSLATE_PROTO_H
+#define TRANSLATE_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "que_to_eng.h"
+
+/* socket translated listens on unless told otherwise */
+#define DEFAULT_TRANSLATE_SOCKET "/tmp/translated.sock"
+/* most words in one request */
+#define MAX_FRAME_WORDS 1024
+/* longest raw word in a request */
+#define MAX_RAW_WORD_LEN 255
+/* longest frame, not counting its len field ; larger frames end the connection */
+#define MAX_FRAME_LEN (sizeof(struct frame_header) + MAX_FRAME_WORDS * (sizeof(struct word_entry) + MAX_TRANSLATION_LEN))
+
+/* what a request asks for */
+enum frame_op {
+	/* body is word_ct word keys, each a uint32_t */
+	OP_KEYS,
+	/* body is word_ct raw words, each a uint8_t length and then its bytes */
+	OP_WORDS
+};
+
+/* whether a request could be read ; a reply that is not FRAME_OK has no words */
+enum frame_status {
+	FRAME_OK,
+	FRAME_BAD_OP,
+	FRAME_MALFORMED
+};
+
+/* what became of one word of a request */
+enum word_status {
+	WORD_OK,
+	/* the raw word splits more than one way ; the first is translated */
+	WORD_AMBIGUOUS,
+	/* the key is not a root and suffixes */
+	WORD_BAD_KEY,
+	/* the raw word does not split into a root and suffixes */
+	WORD_NO_SPLIT
+};
+
+/*
+ * Start of every request and reply, in host byte order, as both ends share a machine.
+ * Requests are answered in the order they arrive on a connection, and several may be
+ * sent before the first reply is read.
+ */
+struct frame_header {
+	/* # of bytes after this field: the rest of the header and the body */
+	uint32_t len;
+	/* chosen by the client, and echoed in the reply */
+	uint32_t id;
+	/* frame_op of a request, or frame_status of a reply */
+	uint16_t code;
+	uint16_t word_ct;
+};
+
+/* each word of a reply body, followed by len bytes of translation (not null terminated) */
+struct word_entry {
+	word_key key;
+	uint16_t len;
+	uint8_t status;
+	uint8_t reserved;
+};
+
+/* how much of a frame the start of a run of bytes holds */
+enum frame_scan {
+	/* not all of the frame has arrived */
+	SCAN_PARTIAL,
+	SCAN_WHOLE,
+	/* its len is too short or too long for any frame, so nothing after it can be read */
+	SCAN_BAD_LEN
+};
+
+/* growable run of bytes, for frames being built or read */
+struct byte_buffer {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+};
+
+bool reserve_bytes(struct byte_buffer *buffer, const size_t LEN);
+bool append_bytes(struct byte_buffer *buffer, const void *DATA, const size_t LEN);
+void consume_bytes(struct byte_buffer *buffer, const size_t LEN);
+void free_byte_buffer(struct byte_buffer *buffer);
+bool peek_frame(const uint8_t *DATA, const size_t LEN, struct frame_header *header);
+enum frame_scan scan_frame(const uint8_t *DATA, const size_t LEN, struct frame_header *header);
+
+#endif
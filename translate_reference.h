@@ -0,0 +1,9 @@
+#ifndef TRANSLATE_REFERENCE_H
+#define TRANSLATE_REFERENCE_H
+
+#include <stdbool.h>
+
+char *conjugate_reference(const char *verb, const char *sub, const bool progressive, const bool movement, char *adverb, const bool pleasure, const bool about_to);
+char *translate_reference(const char *root, const char *suffixes[]);
+
+#endif
@@ -0,0 +1,572 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "translate_proto.h"
+#include "que_to_eng.h"
+#include "translation_table.h"
+#include "segmenter.h"
+#include "lexicon.h"
+#include "histogram.h"
+#include "timing.h"
+
+/* most events handled per epoll_wait */
+#define MAX_EVENTS 64
+/* bytes read from a connection at once */
+#define READ_LEN 65536
+/* once this many reply bytes wait to be sent on a connection, its requests wait too */
+#define MAX_UNSENT_LEN (1024 * 1024)
+/* once this many request bytes wait to be answered on a connection, it is not read until they are ; room for a longest frame */
+#define MAX_UNANSWERED_LEN (2 * MAX_FRAME_LEN)
+/* most ways one raw word is split */
+#define MAX_SPLITS 8
+
+/* what an epoll event is for */
+enum source_kind {
+	SOURCE_LISTENER,
+	SOURCE_SIGNALS,
+	SOURCE_CLIENT
+};
+
+/* a time, and the offset into a connection's bytes which it applies up to */
+struct byte_mark {
+	uint64_t ns;
+	size_t end;
+};
+
+/* marks in the order they were made, from first on */
+struct mark_queue {
+	struct byte_mark *marks;
+	size_t first;
+	size_t ct;
+	size_t cap;
+};
+
+/* anything the event loop waits on ; only clients use the buffers */
+struct connection {
+	enum source_kind kind;
+	int fd;
+	/* epoll events the connection is registered for */
+	uint32_t events;
+	/* requests received and not yet answered, from in_start on */
+	struct byte_buffer in;
+	size_t in_start;
+	/* # of bytes ever read, and the time of each read not yet answered, ending at that count after it */
+	size_t read_len;
+	struct mark_queue reads;
+	/* replies, of which sent_len bytes are sent */
+	struct byte_buffer out;
+	size_t sent_len;
+	/* time each reply not completely sent was asked for, ending where it ends in out */
+	struct mark_queue replies;
+};
+
+/* what the server has done since it started */
+struct server_stats {
+	uint64_t start_ns;
+	uint64_t connection_ct;
+	uint64_t open_ct;
+	uint64_t request_ct;
+	uint64_t bad_request_ct;
+	/* # of words answered with each word_status */
+	uint64_t word_cts[WORD_NO_SPLIT + 1];
+	/* time from reading the last byte of each request to sending the last byte of its reply */
+	struct histogram latency_ns;
+	/* # of words in each request */
+	struct histogram batch_lens;
+};
+
+const char *const WORD_STATUS_NAMES[] = {"translated", "ambiguous", "bad keys", "not split"};
+
+int epoll_fd;
+/* splits raw words ; read only once made, like the translation table */
+struct segmenter segmenter;
+/* verbs served besides the built in ones, with --lexicon, or NULL */
+const struct lexicon *lexicon = NULL;
+struct server_stats stats;
+
+/**
+ * Registers a source with the event loop for EVENTS, or changes what it is registered
+ * for. Returns false on failure.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameters:
+ * conn - source to register
+ * EVENTS - epoll events to wait for
+ *
+ */
+bool watch_source(struct connection *conn, const uint32_t EVENTS) {
+	struct epoll_event event = {.events = EVENTS, .data.ptr = conn};
+	if (epoll_ctl(epoll_fd, conn->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn->fd, &event) != 0) {
+		return false;
+	}
+	conn->events = EVENTS;
+	return true;
+}
+
+/**
+ * Opens a listening socket at PATH, replacing any socket left there. Returns its fd, or
+ * -1 on failure, after printing why.
+ *
+ * Parameter:
+ * PATH - path of the socket
+ *
+ */
+int open_listener(const char *PATH) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct stat info;
+	if (strlen(PATH) >= sizeof(addr.sun_path)) {
+		printf("Socket path %s is too long.\n", PATH);
+		return -1;
+	}
+	strcpy(addr.sun_path, PATH);
+	if (stat(PATH, &info) == 0 && S_ISSOCK(info.st_mode)) {
+		unlink(PATH);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+		printf("Could not listen on %s: %s\n", PATH, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Accepts every waiting client.
+ *
+ * Parameter:
+ * listener - listening socket
+ *
+ */
+void accept_connections(struct connection *listener) {
+	int fd;
+	while ((fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		struct connection *conn = calloc(1, sizeof(*conn));
+		if (conn == NULL) {
+			close(fd);
+			continue;
+		}
+		*conn = (struct connection) {.kind = SOURCE_CLIENT, .fd = fd};
+		if (!watch_source(conn, EPOLLIN)) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+		stats.connection_ct++;
+		stats.open_ct++;
+	}
+}
+
+/**
+ * Stops serving a client, dropping any requests and replies in flight.
+ *
+ * Parameter:
+ * conn - client to close
+ *
+ */
+void close_connection(struct connection *conn) {
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	free_byte_buffer(&conn->in);
+	free_byte_buffer(&conn->out);
+	free(conn->reads.marks);
+	free(conn->replies.marks);
+	free(conn);
+	stats.open_ct--;
+}
+
+/**
+ * Adds a mark to the end of a queue. Returns false if out of memory.
+ *
+ * Replaces:
+ * queue
+ *
+ * Parameters:
+ * queue - queue to add to
+ * NS - time of the mark
+ * END - offset the time applies up to, no less than any before it
+ *
+ */
+bool push_mark(struct mark_queue *queue, const uint64_t NS, const size_t END) {
+	if (queue->first + queue->ct == queue->cap) {
+		if (queue->first > 0) {
+			memmove(queue->marks, queue->marks + queue->first, queue->ct * sizeof(queue->marks[0]));
+			queue->first = 0;
+		} else {
+			size_t cap = queue->cap ? queue->cap * 2 : 64;
+			struct byte_mark *marks = realloc(queue->marks, cap * sizeof(marks[0]));
+			if (marks == NULL) {
+				return false;
+			}
+			queue->marks = marks;
+			queue->cap = cap;
+		}
+	}
+	queue->marks[queue->first + queue->ct++] = (struct byte_mark) {NS, END};
+	return true;
+}
+
+/**
+ * Returns the time of the read which brought in the byte of a client's requests just
+ * before END, counted in bytes ever read, and forgets the reads before it.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameters:
+ * conn - client asking
+ * END - # of bytes ever read, up to the end of a request
+ *
+ */
+uint64_t take_read_ns(struct connection *conn, const size_t END) {
+	while (conn->reads.ct > 1 && conn->reads.marks[conn->reads.first].end < END) {
+		conn->reads.first++;
+		conn->reads.ct--;
+	}
+	return conn->reads.marks[conn->reads.first].ns;
+}
+
+/**
+ * Adds one word of a reply to a client's output. Returns false if out of memory.
+ *
+ * Replaces:
+ * out
+ *
+ * Parameters:
+ * out - output to add to
+ * KEY - word answered
+ * STATUS - what became of the word
+ *
+ */
+bool answer_word(struct byte_buffer *out, const word_key KEY, const enum word_status STATUS) {
+	/* every built in root's translations are in the table, so only lexicon verbs are translated here */
+	char buffer[MAX_TRANSLATION_LEN + 1];
+	const char *translation = STATUS == WORD_OK || STATUS == WORD_AMBIGUOUS ? lookup_lexicon_translation(lexicon, KEY, buffer, sizeof(buffer)) : "";
+	struct word_entry entry = {KEY, strlen(translation), STATUS, 0};
+	stats.word_cts[STATUS]++;
+	return append_bytes(out, &entry, sizeof(entry)) && append_bytes(out, translation, entry.len);
+}
+
+/**
+ * Returns true iff the body of an OP_WORDS request holds exactly WORD_CT words.
+ *
+ * Parameters:
+ * BODY - body of the request
+ * BODY_LEN - length of BODY
+ * WORD_CT - # of words it should hold
+ *
+ */
+bool is_word_body_whole(const uint8_t *BODY, const size_t BODY_LEN, const size_t WORD_CT) {
+	size_t pos = 0;
+	for (size_t i = 0; i < WORD_CT; i++) {
+		if (pos >= BODY_LEN || pos + 1 + BODY[pos] > BODY_LEN) {
+			return false;
+		}
+		pos += 1 + BODY[pos];
+	}
+	return pos == BODY_LEN;
+}
+
+/**
+ * Adds the reply to one request to a client's output. Returns false if out of memory.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameters:
+ * conn - client asking
+ * REQUEST - header of the request
+ * BODY - body of the request, REQUEST->len - 8 bytes long
+ *
+ */
+bool answer_request(struct connection *conn, const struct frame_header *REQUEST, const uint8_t *BODY) {
+	const size_t BODY_LEN = REQUEST->len - (sizeof(*REQUEST) - sizeof(REQUEST->len));
+	const size_t START = conn->out.len;
+	struct frame_header reply = {0, REQUEST->id, FRAME_OK, REQUEST->word_ct};
+	bool is_written = append_bytes(&conn->out, &reply, sizeof(reply));
+	const bool IS_SIZED = REQUEST->word_ct <= MAX_FRAME_WORDS;
+	if (REQUEST->code == OP_KEYS && IS_SIZED && BODY_LEN == REQUEST->word_ct * sizeof(word_key)) {
+		for (size_t i = 0; is_written && i < REQUEST->word_ct; i++) {
+			word_key key;
+			memcpy(&key, BODY + i * sizeof(key), sizeof(key));
+			is_written = answer_word(&conn->out, key, is_valid_lexicon_key(lexicon, key) ? WORD_OK : WORD_BAD_KEY);
+		}
+	} else if (REQUEST->code == OP_WORDS && IS_SIZED && is_word_body_whole(BODY, BODY_LEN, REQUEST->word_ct)) {
+		for (size_t i = 0, pos = 0; is_written && i < REQUEST->word_ct; i++, pos += 1 + BODY[pos]) {
+			word_key keys[MAX_SPLITS];
+			size_t split_ct = segment_word(&segmenter, (const char *) BODY + pos + 1, BODY[pos], keys, MAX_SPLITS);
+			is_written = answer_word(&conn->out, split_ct ? keys[0] : 0, split_ct == 0 ? WORD_NO_SPLIT : split_ct > 1 ? WORD_AMBIGUOUS : WORD_OK);
+		}
+	} else {
+		reply.code = REQUEST->code == OP_KEYS || REQUEST->code == OP_WORDS ? FRAME_MALFORMED : FRAME_BAD_OP;
+		reply.word_ct = 0;
+		stats.bad_request_ct++;
+	}
+	if (!is_written) {
+		return false;
+	}
+	reply.len = conn->out.len - START - sizeof(reply.len);
+	memcpy(conn->out.data + START, &reply, sizeof(reply));
+	stats.request_ct++;
+	record_histogram(&stats.batch_lens, reply.word_ct);
+	/* timed from the read that completed the request, not the last read */
+	const size_t REQUEST_END = conn->read_len - (conn->in.len - conn->in_start) + sizeof(REQUEST->len) + REQUEST->len;
+	return push_mark(&conn->replies, take_read_ns(conn, REQUEST_END), conn->out.len);
+}
+
+/**
+ * Answers each whole request a client has sent, until its unsent replies reach
+ * MAX_UNSENT_LEN. Returns false if the client sent a frame too long to be a request, or
+ * the server ran out of memory.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameter:
+ * conn - client asking
+ *
+ */
+bool answer_requests(struct connection *conn) {
+	struct frame_header header;
+	while (conn->out.len - conn->sent_len < MAX_UNSENT_LEN) {
+		enum frame_scan scan = scan_frame(conn->in.data + conn->in_start, conn->in.len - conn->in_start, &header);
+		if (scan == SCAN_BAD_LEN) {
+			return false;
+		}
+		if (scan == SCAN_PARTIAL) {
+			break;
+		}
+		if (!answer_request(conn, &header, conn->in.data + conn->in_start + sizeof(header))) {
+			return false;
+		}
+		conn->in_start += sizeof(header.len) + header.len;
+	}
+	/* dropped once per batch of requests, rather than once per request */
+	if (conn->in_start > 0) {
+		consume_bytes(&conn->in, conn->in_start);
+		conn->in_start = 0;
+	}
+	return true;
+}
+
+/**
+ * Reads whatever a client has sent, until MAX_UNANSWERED_LEN bytes wait to be answered,
+ * noting when each read ended. Returns false once it has hung up, or on error.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameter:
+ * conn - client to read
+ *
+ */
+bool read_requests(struct connection *conn) {
+	while (conn->in.len < MAX_UNANSWERED_LEN) {
+		if (!reserve_bytes(&conn->in, READ_LEN)) {
+			return false;
+		}
+		ssize_t len = read(conn->fd, conn->in.data + conn->in.len, READ_LEN);
+		if (len <= 0) {
+			return len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		conn->in.len += len;
+		conn->read_len += len;
+		if (!push_mark(&conn->reads, get_monotonic_ns(), conn->read_len)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Sends as much of a client's replies as the socket takes, timing each reply sent in
+ * full. Returns false on error.
+ *
+ * Replaces:
+ * conn
+ *
+ * Parameter:
+ * conn - client to send to
+ *
+ */
+bool send_replies(struct connection *conn) {
+	while (conn->sent_len < conn->out.len) {
+		ssize_t len = send(conn->fd, conn->out.data + conn->sent_len, conn->out.len - conn->sent_len, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return false;
+		}
+		conn->sent_len += len;
+	}
+	uint64_t now_ns = get_monotonic_ns();
+	struct mark_queue *replies = &conn->replies;
+	while (replies->ct > 0 && replies->marks[replies->first].end <= conn->sent_len) {
+		record_histogram(&stats.latency_ns, now_ns - replies->marks[replies->first].ns);
+		replies->first++;
+		replies->ct--;
+	}
+	if (conn->sent_len == conn->out.len) {
+		conn->out.len = conn->sent_len = 0;
+		replies->first = 0;
+	}
+	return true;
+}
+
+/**
+ * Reads a client's requests, answers them and sends the replies, as far as each can go
+ * without blocking, then waits for whatever it is held up on. A client is not read while
+ * MAX_UNANSWERED_LEN bytes of its requests, or MAX_UNSENT_LEN bytes of replies, wait, so
+ * one which sends faster than it reads is held to what the server can buffer ; it is read
+ * again once they drain. Closes the client once it hangs up, or on error.
+ *
+ * Parameters:
+ * conn - client to serve
+ * EVENTS - epoll events seen on it
+ *
+ */
+void serve_connection(struct connection *conn, const uint32_t EVENTS) {
+	bool is_open = !(EVENTS & EPOLLERR);
+	if (is_open && (EVENTS & (EPOLLIN | EPOLLHUP))) {
+		is_open = read_requests(conn);
+	}
+	/* requests held back while replies were unsent go ahead as the replies leave */
+	bool is_ok = true;
+	size_t unsent_len;
+	do {
+		unsent_len = conn->out.len - conn->sent_len;
+		is_ok = answer_requests(conn) && send_replies(conn);
+	} while (is_ok && conn->in.len > 0 && conn->out.len - conn->sent_len < unsent_len);
+	if (!is_ok || !is_open) {
+		close_connection(conn);
+		return;
+	}
+	bool is_readable = conn->in.len < MAX_UNANSWERED_LEN && conn->out.len - conn->sent_len < MAX_UNSENT_LEN;
+	uint32_t events = (is_readable ? EPOLLIN : 0) | (conn->sent_len < conn->out.len ? EPOLLOUT : 0);
+	if (events != conn->events && !watch_source(conn, events)) {
+		close_connection(conn);
+	}
+}
+
+/**
+ * Prints how many requests and words were answered, and how long requests took.
+ *
+ * Parameter:
+ * file - file to print to
+ *
+ */
+void print_server_stats(FILE *file) {
+	double elapsed_sec = (get_monotonic_ns() - stats.start_ns) / 1e9;
+	uint64_t word_ct = 0;
+	for (size_t status = 0; status <= WORD_NO_SPLIT; status++) {
+		word_ct += stats.word_cts[status];
+	}
+	fprintf(file, "%lu requests (%lu words, %lu bad requests) on %lu connections (%lu open) in %.1f s: %.0f words per second\n",
+		(unsigned long) stats.request_ct, (unsigned long) word_ct, (unsigned long) stats.bad_request_ct, (unsigned long) stats.connection_ct,
+		(unsigned long) stats.open_ct, elapsed_sec, word_ct / elapsed_sec);
+	fprintf(file, "Words:");
+	for (size_t status = 0; status <= WORD_NO_SPLIT; status++) {
+		fprintf(file, " %lu %s%s", (unsigned long) stats.word_cts[status], WORD_STATUS_NAMES[status], status < WORD_NO_SPLIT ? "," : "\n");
+	}
+	fprintf(file, "Request latency: p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us ; mean batch %.1f words\n",
+		get_histogram_percentile(&stats.latency_ns, 50) / 1e3, get_histogram_percentile(&stats.latency_ns, 90) / 1e3,
+		get_histogram_percentile(&stats.latency_ns, 99) / 1e3, get_histogram_percentile(&stats.latency_ns, 99.9) / 1e3,
+		stats.latency_ns.max / 1e3, get_histogram_mean(&stats.batch_lens));
+	fflush(file);
+}
+
+/**
+ * Translation service: answers batches of words, as word keys or raw Quechua words, sent
+ * over a UNIX socket by any number of local clients (see translate_client.h). Answers
+ * for the built in roots come from the precomputed translation table, which all clients
+ * share. One thread serves every client from an epoll loop. Stats go to stderr on
+ * SIGUSR1, and on SIGINT or SIGTERM, which stop the server.
+ *
+ * Options:
+ * --socket PATH - socket to listen on (default DEFAULT_TRANSLATE_SOCKET)
+ * --lexicon FILE - also serve the verbs of the lexicon FILE, keyed as find_key_root
+ * 	describes, and split their roots off raw words
+ *
+ */
+int main(int argc, char *argv[]) {
+	const char *socket_path = DEFAULT_TRANSLATE_SOCKET, *lexicon_filename = NULL;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--socket")) {
+			socket_path = argv[++i];
+		} else if (!strcmp(argv[i], "--lexicon")) {
+			lexicon_filename = argv[++i];
+		}
+	}
+	static struct lexicon loaded;
+	if (lexicon_filename != NULL) {
+		if (!load_lexicon(&loaded, lexicon_filename)) {
+			printf("Could not load lexicon %s.\n", lexicon_filename);
+			return 1;
+		}
+		lexicon = &loaded;
+	}
+	size_t root_ct;
+	const char **roots = make_key_root_names(lexicon, &root_ct);
+	if (roots == NULL || !make_segmenter(&segmenter, roots, root_ct)) {
+		printf("Could not make segmenter.\n");
+		return 1;
+	}
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	struct connection listener = {.kind = SOURCE_LISTENER, .fd = open_listener(socket_path)};
+	struct connection signal_source = {.kind = SOURCE_SIGNALS, .fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)};
+	if (listener.fd < 0 || signal_source.fd < 0 || (epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+		!watch_source(&listener, EPOLLIN) || !watch_source(&signal_source, EPOLLIN)) {
+		printf("Could not start serving: %s\n", strerror(errno));
+		return 1;
+	}
+	stats.start_ns = get_monotonic_ns();
+	printf("Serving translations on %s\n", socket_path);
+	fflush(stdout);
+
+	for (bool is_running = true; is_running;) {
+		struct epoll_event events[MAX_EVENTS];
+		int event_ct = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		for (int i = 0; i < event_ct; i++) {
+			struct connection *conn = events[i].data.ptr;
+			if (conn->kind == SOURCE_LISTENER) {
+				accept_connections(conn);
+			} else if (conn->kind == SOURCE_CLIENT) {
+				serve_connection(conn, events[i].events);
+			} else {
+				struct signalfd_siginfo info;
+				while (read(conn->fd, &info, sizeof(info)) == sizeof(info)) {
+					is_running = is_running && info.ssi_signo == SIGUSR1;
+					print_server_stats(stderr);
+				}
+			}
+		}
+	}
+
+	unlink(socket_path);
+	free_segmenter(&segmenter);
+	free(roots);
+	if (lexicon != NULL) {
+		free_lexicon(&loaded);
+	}
+	return 0;
+}
@@ -0,0 +1,18 @@
+#include <stdint.h>
+#include "que_to_eng.h"
+#include "translation_table.h"
+
+/* generated by gen_table ; defines TRANSLATION_POOL and TRANSLATION_OFFSETS */
+#include "translation_table.inc"
+
+/**
+ * Returns the precomputed translation of a word key.
+ * This is byte-identical to translate(), but needs no allocation and must not be freed.
+ *
+ * Parameter:
+ * key - packed word key, for which is_valid_key must hold
+ *
+ */
+const char *lookup_translation(const word_key key) {
+	return TRANSLATION_POOL + TRANSLATION_OFFSETS[get_key_combination(key)];
+}
@@ -0,0 +1,8 @@
+#ifndef TRANSLATION_TABLE_H
+#define TRANSLATION_TABLE_H
+
+#include "que_to_eng.h"
+
+const char *lookup_translation(const word_key key);
+
+#endif
@@ -0,0 +1,104 @@
+#include <math.h>
+#include <stdio.h>
+#include "wheel.h"
+
+/**
+ * Feeds a reading of a ring through its filter, updating the ring's position once the
+ * filtered reading settles on one. Returns true iff the ring moved, either to another
+ * position or within its position.
+ *
+ * Parameters:
+ * wheel - wheel the ring belongs to
+ * RING - ring that was read
+ * DISTANCE_CM - reading, or -1 if out of range
+ *
+ */
+bool decode_reading(struct wheel *wheel, const size_t RING, const float DISTANCE_CM) {
+	const float MIN_ULTRASONIC_CM = 2.0;
+	const float MAX_ULTRASONIC_CM = 400.0;
+	bool moved = false;
+	wheel->reading_cts[RING]++;
+	wheel->raw_distances[RING] = DISTANCE_CM;
+	wheel->out_of_range_cts[RING] += !(MIN_ULTRASONIC_CM < DISTANCE_CM && DISTANCE_CM < MAX_ULTRASONIC_CM);
+	if (MIN_ULTRASONIC_CM < DISTANCE_CM && DISTANCE_CM < MAX_ULTRASONIC_CM) {
+		/* only update once the filtered reading settles on a position in range */
+		if (filter_sample(&wheel->filters[RING], DISTANCE_CM, &wheel->calibration->cals[RING])) {
+			moved = wheel->ring_idxs[RING] != wheel->filters[RING].position;
+			wheel->ring_idxs[RING] = wheel->filters[RING].position;
+		}
+		moved = moved || fabsf(DISTANCE_CM - wheel->last_distances[RING]) > wheel->calibration->cals[RING].min_spacing / 2;
+		wheel->last_distances[RING] = DISTANCE_CM;
+	}
+	return moved;
+}
+
+/**
+ * Copies the wheel's reading counters into stats.
+ *
+ * Replaces:
+ * stats->rings
+ *
+ * Parameters:
+ * stats - stats to copy into
+ * wheel - wheel whose counters to copy
+ *
+ */
+void count_readings(struct driver_stats *stats, const struct wheel *wheel) {
+	for (size_t ring = 0; ring < stats->ring_ct; ring++) {
+		stats->rings[ring] = (struct ring_counters) {
+			wheel->reading_cts[ring], wheel->out_of_range_cts[ring], wheel->filters[ring].ignored_ct, wheel->filters[ring].held_ct
+		};
+	}
+}
+
+/**
+ * Returns how surely a ring is at its decoded position, from 1 when its running median
+ * sits on the position's calibrated distance down to 0 when it is halfway to the next
+ * position, or 0 if it has no position yet.
+ *
+ * Parameters:
+ * wheel - wheel the ring belongs to
+ * RING - ring to check
+ *
+ */
+float get_ring_confidence(const struct wheel *wheel, const size_t RING) {
+	const struct ring_filter *filter = &wheel->filters[RING];
+	const struct ring_calibration *cal = &wheel->calibration->cals[RING];
+	if (!filter->has_position || filter->sample_ct == 0 || cal->min_spacing <= 0) {
+		return 0;
+	}
+	float confidence = 1 - fabsf(get_window_median(filter) - cal->medians[filter->position]) / (cal->min_spacing / 2);
+	return confidence < 0 ? 0 : confidence;
+}
+
+/**
+ * Brings a snapshot up to date with a frame of the wheel, for publish_snapshot. The word
+ * and translation are only looked up when the word changes.
+ *
+ * Replaces:
+ * snapshot
+ *
+ * Parameters:
+ * wheel - wheel to take the snapshot of
+ * lexicon - verbs beyond the built in ones that KEY may stand for, or NULL
+ * KEY - word the wheel shows
+ * FRAME_NS - time of the frame
+ * snapshot - last snapshot of the wheel, or zeroed for the first
+ *
+ */
+void fill_wheel_snapshot(const struct wheel *wheel, const struct lexicon *lexicon, const word_key KEY, const uint64_t FRAME_NS, struct wheel_snapshot *snapshot) {
+	if (snapshot->word[0] == '\0' || snapshot->key != KEY) {
+		char buffer[MAX_TRANSLATION_LEN + 1];
+		get_lexicon_word(lexicon, KEY, snapshot->word, sizeof(snapshot->word));
+		snprintf(snapshot->translation, sizeof(snapshot->translation), "%s", lookup_lexicon_translation(lexicon, KEY, buffer, sizeof(buffer)));
+	}
+	snapshot->frame_ct++;
+	snapshot->frame_ns = FRAME_NS;
+	snapshot->key = KEY;
+	snapshot->ring_ct = wheel->ring_ct < MAX_LIVE_RINGS ? wheel->ring_ct : MAX_LIVE_RINGS;
+	for (size_t ring = 0; ring < snapshot->ring_ct; ring++) {
+		snapshot->distances_cm[ring] = wheel->reading_cts[ring] > 0 ? wheel->raw_distances[ring] : -1;
+		snapshot->positions[ring] = wheel->ring_idxs[ring];
+		snapshot->confidences[ring] = get_ring_confidence(wheel, ring);
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "controller.h"
+#include "filter.h"
+#include "calibration_watch.h"
+#include "driver_stats.h"
+#include "live_state.h"
+#include "lexicon.h"
+
+/* decoding state of every ring of the wheel */
+struct wheel {
+	size_t ring_ct;
+	/* decision boundaries of each ring, from the data collection program */
+	struct calibration_set *calibration;
+	struct ring_filter filters[MAX_RINGS];
+	/* indeces within rings */
+	size_t ring_idxs[MAX_RINGS];
+	/* last in-range distance of each ring, to notice movement within a position */
+	float last_distances[MAX_RINGS];
+	/* last reading of each ring, in range or not */
+	float raw_distances[MAX_RINGS];
+	/* # of readings of each ring, and how many were out of range */
+	size_t reading_cts[MAX_RINGS];
+	size_t out_of_range_cts[MAX_RINGS];
+};
+
+bool decode_reading(struct wheel *wheel, const size_t RING, const float DISTANCE_CM);
+void count_readings(struct driver_stats *stats, const struct wheel *wheel);
+float get_ring_confidence(const struct wheel *wheel, const size_t RING);
+void fill_wheel_snapshot(const struct wheel *wheel, const struct lexicon *lexicon, const word_key KEY, const uint64_t FRAME_NS, struct wheel_snapshot *snapshot);
+
+#endif
@@ -0,0 +1,481 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "wheel_pool.h"
+#include "translation_table.h"
+#include "timing.h"
+#include "realtime.h"
+
+/**
+ * Reads a comma separated list of exactly SLOT_CT pins. Returns false if STR is malformed.
+ *
+ * Replaces:
+ * pins
+ *
+ * Parameters:
+ * STR - list to read
+ * pins - one pin per ring
+ *
+ */
+bool parse_pin_list(const char *STR, int pins[]) {
+	for (size_t ring = 0; ring < SLOT_CT; ring++) {
+		char *end;
+		long pin = strtol(STR, &end, 10);
+		if (end == STR || pin < 0 || *end != (ring + 1 < SLOT_CT ? ',' : '\0')) {
+			return false;
+		}
+		pins[ring] = pin;
+		STR = end + 1;
+	}
+	return true;
+}
+
+/**
+ * Reads the wheels of FILENAME. Each line holds a wheel's name, the root on it (built in,
+ * or of LEXICON), its calibration file, and the trigger then echo pins of its rings as
+ * comma separated lists, separated by spaces or tabs. For example:
+ *
+ * entrance  wayk'u  ring_data.txt  4,0,2,21,23,25  5,1,3,22,24,28
+ *
+ * Blank lines and lines starting with '#' are skipped. Returns false, printing the
+ * line at fault, if the file is missing, a line is malformed, a name appears twice, or
+ * there are more than MAX_WHEELS wheels.
+ *
+ * Replaces:
+ * configs, config_ct
+ *
+ * Parameters:
+ * FILENAME - file to read
+ * LEXICON - verbs beyond the built in ones that wheels may hold, or NULL
+ * configs - MAX_WHEELS wheels
+ * config_ct - # of wheels read
+ *
+ */
+bool load_wheel_configs(const char *FILENAME, const struct lexicon *LEXICON, struct wheel_config configs[], size_t *config_ct) {
+	FILE *file;
+	char line[MAX_WHEEL_LINE_LEN];
+	*config_ct = 0;
+	if ((file = fopen(FILENAME, "r")) == NULL) {
+		return false;
+	}
+
+	bool is_valid = true;
+	for (size_t line_num = 1; is_valid && fgets(line, sizeof(line), file) != NULL; line_num++) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+		char *fields[5], *rest = line, *field;
+		size_t field_ct = 0;
+		while ((field = strsep(&rest, " \t")) != NULL) {
+			if (*field && field_ct < 5) {
+				fields[field_ct] = field;
+			}
+			field_ct += *field != '\0';
+		}
+		struct wheel_config *config = &configs[*config_ct];
+		is_valid = *config_ct < MAX_WHEELS && field_ct == 5 && strlen(fields[0]) <= MAX_WHEEL_NAME_LEN && strlen(fields[2]) < PATH_MAX;
+		if (is_valid) {
+			strcpy(config->name, fields[0]);
+			strcpy(config->calibration_filename, fields[2]);
+			long root = find_key_root(LEXICON, fields[1]);
+			config->root = root < 0 ? 0 : root;
+			config->bank = (struct sensor_bank) {.ring_ct = SLOT_CT};
+			is_valid = root >= 0 && parse_pin_list(fields[3], config->bank.trigger_pins) && parse_pin_list(fields[4], config->bank.echo_pins);
+		}
+		for (size_t other = 0; is_valid && other < *config_ct; other++) {
+			is_valid = strcmp(configs[other].name, config->name);
+		}
+		if (!is_valid) {
+			printf("%s:%zu: expected a new name, a root%s, a calibration file, and %i trigger then %i echo pins, separated by spaces\n",
+				FILENAME, line_num, LEXICON == NULL ? " (give a --lexicon for verbs beyond the built in ones)" : "", SLOT_CT, SLOT_CT);
+		} else {
+			(*config_ct)++;
+		}
+	}
+	fclose(file);
+	return is_valid;
+}
+
+/**
+ * Reads a list of CPUs such as "0,2-3". Returns the # of CPUs read, or 0 if STR is
+ * malformed or lists more than CAP.
+ *
+ * Replaces:
+ * cpus
+ *
+ * Parameters:
+ * STR - list to read
+ * cpus - CPU numbers in the order listed
+ * CAP - most CPUs cpus can hold
+ *
+ */
+size_t parse_cpu_list(const char *STR, int cpus[], const size_t CAP) {
+	size_t cpu_ct = 0;
+	while (*STR) {
+		char *end;
+		long first = strtol(STR, &end, 10), last = first;
+		if (end == STR || first < 0) {
+			return 0;
+		}
+		if (*end == '-') {
+			STR = end + 1;
+			last = strtol(STR, &end, 10);
+			if (end == STR || last < first) {
+				return 0;
+			}
+		}
+		if (*end != ',' && *end != '\0') {
+			return 0;
+		}
+		for (long cpu = first; cpu <= last; cpu++) {
+			if (cpu_ct == CAP) {
+				return 0;
+			}
+			cpus[cpu_ct++] = cpu;
+		}
+		STR = *end ? end + 1 : end;
+	}
+	return cpu_ct;
+}
+
+/**
+ * Runs one frame of a wheel: measures its due rings, decodes them, and shows the word
+ * if it changed.
+ *
+ * Parameters:
+ * worker - worker serving the wheel
+ * INDEX - index of the wheel within worker->stations
+ * due - whether each ring of the wheel should be measured
+ *
+ */
+void serve_station(struct wheel_worker *worker, const size_t INDEX, const bool due[]) {
+	struct wheel_station *station = worker->stations[INDEX];
+	struct wheel *wheel = &station->wheel;
+	const struct wheel_pool_settings *settings = &worker->pool->settings;
+	size_t due_ct = 0;
+	for (size_t ring = 0; ring < wheel->ring_ct; ring++) {
+		due_ct += due[ring];
+	}
+	if (due_ct == 0) {
+		return;
+	}
+
+	/* swap in a new calibration between frames */
+	struct calibration_set *calibration = station->is_watching ? take_calibration(&station->watch) : NULL;
+	if (calibration != NULL) {
+		free(wheel->calibration);
+		wheel->calibration = calibration;
+	}
+
+	float distances[MAX_RINGS];
+	uint64_t frame_start_ns = get_monotonic_ns();
+	measure_bank_cm(&station->config.bank, &station->triggers, due, distances);
+	uint64_t sensed_ns = get_monotonic_ns();
+	for (size_t ring = 0; ring < wheel->ring_ct; ring++) {
+		if (due[ring]) {
+			report_sample(&worker->sched, INDEX * SLOT_CT + ring, decode_reading(wheel, ring, distances[ring]));
+		}
+	}
+	record_histogram(&station->stats.stages[STAGE_SENSE], sensed_ns - frame_start_ns);
+	record_histogram(&station->stats.stages[STAGE_DECODE], get_monotonic_ns() - sensed_ns);
+
+	/* only show the word when it changes */
+	word_key key = make_word_key(station->config.root, wheel->ring_idxs);
+	flush_words(&station->renderer);
+	if (station->render_ct == 0 || key != station->shown_key) {
+		submit_word(&station->renderer, key);
+		station->shown_key = key;
+		station->render_ct++;
+	}
+	if (station->is_publishing) {
+		fill_wheel_snapshot(wheel, settings->lexicon, key, frame_start_ns, &station->snapshot);
+		publish_snapshot(station->publisher.state, &station->snapshot);
+	}
+	uint64_t frame_end_ns = get_monotonic_ns();
+	record_histogram(&station->stats.stages[STAGE_FRAME], frame_end_ns - frame_start_ns);
+	station->stats.frame_ct++;
+
+	/* export between frames, so readers see each frame whole ; the render thread writes the file */
+	if (settings->stats_filename != NULL && frame_end_ns - station->stats.export_ns >= settings->stats_interval_sec * 1e9) {
+		count_readings(&station->stats, wheel);
+		copy_render_stats(&station->renderer, &station->stats);
+		station->stats.wake_late = worker->sched.wake_late_ns;
+		export_stats(&station->renderer, &station->stats);
+	}
+}
+
+/**
+ * Thread which serves a worker's wheels, one after another each frame, until the pool
+ * stops.
+ *
+ * Parameter:
+ * arg - worker to run
+ *
+ */
+void *serve_wheels(void *arg) {
+	struct wheel_worker *worker = arg;
+	bool due[MAX_SCHEDULED_RINGS];
+	if (worker->pool->settings.rt_priority > 0) {
+		prefault_stack();
+	}
+	while (atomic_load(&worker->pool->running)) {
+		if (wait_for_frame(&worker->sched, due) == 0) {
+			continue;
+		}
+		for (size_t i = 0; i < worker->station_ct; i++) {
+			serve_station(worker, i, &due[i * SLOT_CT]);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Starts a worker's thread already pinned to its CPU, and under SCHED_FIFO if the pool
+ * has a real-time priority, so it never runs a frame anywhere else or at another
+ * priority. If the priority is not permitted, or the CPU is offline or outside the
+ * process's set, the thread is started without it. Returns false if the thread could not
+ * be started at all.
+ *
+ * Replaces:
+ * worker->thread, worker->is_pinned, worker->priority
+ *
+ * Parameter:
+ * worker - worker to start
+ *
+ */
+bool start_worker(struct wheel_worker *worker) {
+	const int PRIORITY = worker->pool->settings.rt_priority;
+	const bool CAN_PIN = worker->cpu >= 0 && worker->cpu < CPU_SETSIZE;
+	const bool CAN_PRIORITIZE = PRIORITY >= sched_get_priority_min(SCHED_FIFO) && PRIORITY <= sched_get_priority_max(SCHED_FIFO);
+	/* with both, then without the priority, then without the CPU, then without either */
+	for (unsigned attempt = 0; attempt < 4; attempt++) {
+		worker->is_pinned = CAN_PIN && !(attempt & 2);
+		worker->priority = CAN_PRIORITIZE && !(attempt & 1) ? PRIORITY : 0;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		if (worker->is_pinned) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(worker->cpu, &cpus);
+			pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+		}
+		if (worker->priority > 0) {
+			struct sched_param param = {.sched_priority = worker->priority};
+			pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+			pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+			pthread_attr_setschedparam(&attr, &param);
+		}
+		bool is_started = pthread_create(&worker->thread, &attr, serve_wheels, worker) == 0;
+		pthread_attr_destroy(&attr);
+		if (is_started) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Sets up one wheel of a pool: its pins, filters, trigger schedule and stats, loads and
+ * starts watching its calibration, and starts its render thread. Returns false, printing why, if any of it fails.
+ *
+ * Replaces:
+ * station
+ *
+ * Parameters:
+ * pool - pool the wheel belongs to
+ * station - wheel to set up
+ * CONFIG - wheel's configuration
+ *
+ */
+bool init_station(struct wheel_pool *pool, struct wheel_station *station, const struct wheel_config *CONFIG) {
+	const struct wheel_pool_settings *settings = &pool->settings;
+	station->config = *CONFIG;
+	station->wheel = (struct wheel) {.ring_ct = CONFIG->bank.ring_ct, .calibration = calloc(1, sizeof(struct calibration_set))};
+	station->is_watching = false;
+	station->is_publishing = false;
+	station->snapshot = (struct wheel_snapshot) {0};
+	station->render_ct = 0;
+	for (size_t ring = 0; ring < station->wheel.ring_ct; ring++) {
+		if (!init_filter(&station->wheel.filters[ring], settings->filter_window, settings->hysteresis)) {
+			printf("Filter window must be 1 to %i readings, and hysteresis below 0.5.\n", MAX_FILTER_WINDOW);
+			return false;
+		}
+	}
+	if (!parse_trigger_schedule(settings->schedule_str, settings->stagger_us, &station->triggers)) {
+		printf("Invalid trigger schedule %s\n", settings->schedule_str);
+		return false;
+	}
+	if (!load_calibration(CONFIG->calibration_filename, station->wheel.calibration->cals, SUFFIX_CTS, station->wheel.ring_ct)) {
+		printf("%s: could not read %s. Please run data_collector for this wheel first.\n", CONFIG->name, CONFIG->calibration_filename);
+		return false;
+	}
+	if (settings->stats_filename != NULL) {
+		snprintf(station->stats_filename, sizeof(station->stats_filename), "%s.%s", settings->stats_filename, CONFIG->name);
+	}
+	if (!start_renderer(&station->renderer, station->config.name, false, &pool->output_lock, settings->lexicon,
+		settings->stats_filename != NULL ? station->stats_filename : NULL)) {
+		printf("%s: could not start the render thread.\n", CONFIG->name);
+		return false;
+	}
+	/* pick up recalibrations while running */
+	if (!(station->is_watching = start_calibration_watch(&station->watch, CONFIG->calibration_filename, SUFFIX_CTS, station->wheel.ring_ct))) {
+		printf("%s: could not watch %s ; recalibrating will need a restart.\n", CONFIG->name, CONFIG->calibration_filename);
+	}
+	if (settings->publish_name != NULL) {
+		char publish_name[NAME_MAX + 1];
+		snprintf(publish_name, sizeof(publish_name), "%s.%s", settings->publish_name, CONFIG->name);
+		if (!(station->is_publishing = open_live_state(&station->publisher, publish_name))) {
+			printf("%s: could not publish to shared memory %s.\n", CONFIG->name, publish_name);
+		}
+	}
+	init_driver_stats(&station->stats, station->wheel.ring_ct);
+	station->config.bank.echo_histograms = station->stats.echo_waits;
+	station->config.bank.poll_gaps = &station->stats.poll_gaps;
+	setup_sensor_bank(&station->config.bank);
+	return true;
+}
+
+/**
+ * Starts serving every wheel of CONFIGS, with one worker thread per CPU of CPUS (or
+ * fewer, if there are fewer wheels). Wheels are dealt to the workers in turn, and each
+ * worker is pinned to its CPU, so a wheel is always measured from the same core. The
+ * gpio backend must already be started. Workers keep the caller's signal mask.
+ * Returns false, printing why, if a wheel or worker could not be set up.
+ *
+ * Replaces:
+ * pool
+ *
+ * Parameters:
+ * pool - pool to start
+ * CONFIGS - wheels to serve
+ * CONFIG_CT - # of wheels, at most MAX_WHEELS
+ * CPUS - CPUs to run workers on
+ * CPU_CT - # of CPUs, at least 1
+ * settings - settings every wheel shares
+ *
+ */
+bool start_wheel_pool(struct wheel_pool *pool, const struct wheel_config CONFIGS[], const size_t CONFIG_CT, const int CPUS[],
+	const size_t CPU_CT, const struct wheel_pool_settings *settings) {
+	pool->settings = *settings;
+	pool->station_ct = 0;
+	pool->worker_ct = 0;
+	atomic_init(&pool->running, true);
+	pthread_mutex_init(&pool->output_lock, NULL);
+	pool->start_ns = get_monotonic_ns();
+	for (size_t i = 0; i < CONFIG_CT; i++) {
+		if (!init_station(pool, &pool->stations[i], &CONFIGS[i])) {
+			free(pool->stations[i].wheel.calibration);
+			stop_wheel_pool(pool);
+			return false;
+		}
+		pool->station_ct++;
+	}
+
+	/* deal the wheels out in turn */
+	size_t worker_ct = CPU_CT < CONFIG_CT ? CPU_CT : CONFIG_CT;
+	worker_ct = worker_ct < MAX_WHEEL_WORKERS ? worker_ct : MAX_WHEEL_WORKERS;
+	for (size_t i = 0; i < worker_ct; i++) {
+		pool->workers[i] = (struct wheel_worker) {.pool = pool, .cpu = CPUS[i]};
+	}
+	for (size_t i = 0; i < pool->station_ct; i++) {
+		struct wheel_worker *worker = &pool->workers[i % worker_ct];
+		worker->stations[worker->station_ct++] = &pool->stations[i];
+	}
+	for (size_t i = 0; i < worker_ct; i++) {
+		struct wheel_worker *worker = &pool->workers[i];
+		if (!init_scheduler(&worker->sched, worker->station_ct * SLOT_CT, settings->frame_hz, settings->idle_hz)) {
+			printf("Could not start scheduler at %.2f Hz with idle rate %.2f Hz.\n", settings->frame_hz, settings->idle_hz);
+			stop_wheel_pool(pool);
+			return false;
+		}
+		if (!start_worker(worker)) {
+			printf("Could not start worker %zu.\n", i);
+			close_scheduler(&worker->sched);
+			stop_wheel_pool(pool);
+			return false;
+		}
+		pool->worker_ct++;
+	}
+	return true;
+}
+
+/**
+ * Stops every worker of a pool, then exports each wheel's stats a last time and
+ * releases its calibration. The pool's stats can still be printed afterwards.
+ *
+ * Parameter:
+ * pool - pool to stop
+ *
+ */
+void stop_wheel_pool(struct wheel_pool *pool) {
+	atomic_store(&pool->running, false);
+	for (size_t i = 0; i < pool->worker_ct; i++) {
+		struct wheel_worker *worker = &pool->workers[i];
+		pthread_join(worker->thread, NULL);
+		close_scheduler(&worker->sched);
+		for (size_t station = 0; station < worker->station_ct; station++) {
+			worker->stations[station]->stats.wake_late = worker->sched.wake_late_ns;
+		}
+	}
+	for (size_t i = 0; i < pool->station_ct; i++) {
+		struct wheel_station *station = &pool->stations[i];
+		stop_renderer(&station->renderer);
+		count_readings(&station->stats, &station->wheel);
+		copy_render_stats(&station->renderer, &station->stats);
+		if (pool->settings.stats_filename != NULL && !save_driver_stats(&station->stats, station->stats_filename)) {
+			printf("Could not write stats to %s\n", station->stats_filename);
+		}
+		if (station->is_watching) {
+			stop_calibration_watch(&station->watch);
+		}
+		if (station->is_publishing) {
+			close_live_state(&station->publisher);
+			station->is_publishing = false;
+		}
+		free(station->wheel.calibration);
+		station->wheel.calibration = NULL;
+	}
+	pthread_mutex_destroy(&pool->output_lock);
+}
+
+/**
+ * Prints what each worker and wheel of a pool did, and the frame rate of every wheel
+ * together.
+ *
+ * Parameters:
+ * pool - pool to report on
+ * file - file to print to
+ *
+ */
+void print_wheel_pool_stats(const struct wheel_pool *pool, FILE *file) {
+	double elapsed_sec = (get_monotonic_ns() - pool->start_ns) / 1e9;
+	size_t frame_ct = 0;
+	for (size_t i = 0; i < pool->worker_ct; i++) {
+		const struct wheel_worker *worker = &pool->workers[i];
+		fprintf(file, "Worker %zu on CPU %i%s%s: %zu wheels, %zu frames of target %.1f Hz, %zu missed\n", i, worker->cpu,
+			worker->is_pinned ? "" : " (not pinned)", worker->priority ? ", SCHED_FIFO" : "", worker->station_ct, worker->sched.frame_ct,
+			worker->sched.frame_hz, worker->sched.missed_frame_ct);
+		print_jitter(file, "  Frame wake late", &worker->sched.wake_late_ns);
+	}
+	for (size_t i = 0; i < pool->station_ct; i++) {
+		const struct wheel_station *station = &pool->stations[i];
+		const struct histogram *frames = &station->stats.stages[STAGE_FRAME];
+		size_t reading_ct = 0, out_of_range_ct = 0;
+		for (size_t ring = 0; ring < station->wheel.ring_ct; ring++) {
+			reading_ct += station->wheel.reading_cts[ring];
+			out_of_range_ct += station->wheel.out_of_range_cts[ring];
+		}
+		fprintf(file, "Wheel %s: %lu frames, %lu words, frame p50 %.2f ms, p99 %.2f ms, %zu readings, %zu out of range\n",
+			station->config.name, (unsigned long) station->stats.frame_ct, (unsigned long) station->stats.render_ct,
+			get_histogram_percentile(frames, 50) / 1e6, get_histogram_percentile(frames, 99) / 1e6, reading_ct, out_of_range_ct);
+		if (station->stats.poll_gaps.count > 0) {
+			print_jitter(file, "  Echo poll gaps", &station->stats.poll_gaps);
+		}
+		frame_ct += station->stats.frame_ct;
+	}
+	fprintf(file, "%zu wheels on %zu workers: %.1f wheel frames per second\n", pool->station_ct, pool->worker_ct,
+		elapsed_sec > 0 ? frame_ct / elapsed_sec : 0);
+}
@@ -0,0 +1,118 @@
+#ifndef WHEEL_POOL_H
+#define WHEEL_POOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <linux/limits.h>
+#include "controller.h"
+#include "que_to_eng.h"
+#include "scheduler.h"
+#include "calibration_watch.h"
+#include "wheel.h"
+#include "driver_stats.h"
+#include "renderer.h"
+#include "live_state.h"
+#include "lexicon.h"
+
+/* most wheels one process can serve, and most worker threads serving them */
+#define MAX_WHEELS 16
+#define MAX_WHEEL_WORKERS 16
+/* longest wheel name in a wheel file */
+#define MAX_WHEEL_NAME_LEN 31
+/* longest line of a wheel file */
+#define MAX_WHEEL_LINE_LEN 512
+
+/* one wheel of a wheel file */
+struct wheel_config {
+	char name[MAX_WHEEL_NAME_LEN + 1];
+	/* key root of the verb on the wheel (see find_key_root) */
+	size_t root;
+	char calibration_filename[PATH_MAX];
+	/* pins of the wheel's sensors ; ring i holds the suffixes of slot i */
+	struct sensor_bank bank;
+};
+
+/* settings every wheel of a pool shares, as given to the driver */
+struct wheel_pool_settings {
+	double frame_hz;
+	double idle_hz;
+	const char *schedule_str;
+	unsigned stagger_us;
+	size_t filter_window;
+	float hysteresis;
+	/* each wheel's stats go to stats_filename.NAME, if stats_filename is not NULL */
+	const char *stats_filename;
+	double stats_interval_sec;
+	/* each wheel's state is published to shared memory publish_name.NAME, if publish_name is not NULL */
+	const char *publish_name;
+	/* SCHED_FIFO priority of the workers, or 0 to leave them as they are */
+	int rt_priority;
+	/* verbs beyond the built in ones that wheels may hold, or NULL */
+	const struct lexicon *lexicon;
+};
+
+/* a wheel being served: its sensors, decoding state and stats */
+struct wheel_station {
+	struct wheel_config config;
+	struct trigger_schedule triggers;
+	struct wheel wheel;
+	struct calibration_watch watch;
+	bool is_watching;
+	/* time spent in each stage of each of the wheel's frames */
+	struct driver_stats stats;
+	char stats_filename[PATH_MAX];
+	/* where each frame's state is published, and what was published last */
+	struct live_writer publisher;
+	bool is_publishing;
+	struct wheel_snapshot snapshot;
+	/* writes the wheel's words, prefixed with its name */
+	struct renderer renderer;
+	/* last word committed to, and # of times the word changed */
+	word_key shown_key;
+	size_t render_ct;
+};
+
+/* thread pinned to one CPU, which serves its wheels one after another each frame */
+struct wheel_worker {
+	pthread_t thread;
+	struct wheel_pool *pool;
+	/* CPU the thread runs on, or -1 if it may run anywhere */
+	int cpu;
+	bool is_pinned;
+	/* SCHED_FIFO priority the thread got, or 0 */
+	int priority;
+	size_t station_ct;
+	struct wheel_station *stations[MAX_WHEELS];
+	/* frame clock for every ring of every station ; station i has rings from i * SLOT_CT */
+	struct scheduler sched;
+};
+
+/*
+ * Every wheel of one process, spread over worker threads. Each wheel has its own
+ * sensors, calibration and decoding state ; the translation table is shared, as it is
+ * only read.
+ */
+struct wheel_pool {
+	size_t station_ct;
+	struct wheel_station stations[MAX_WHEELS];
+	size_t worker_ct;
+	struct wheel_worker workers[MAX_WHEEL_WORKERS];
+	struct wheel_pool_settings settings;
+	/* cleared to stop the workers, which notice within a frame */
+	atomic_bool running;
+	/* held while a word is written, so the words of different wheels do not interleave */
+	pthread_mutex_t output_lock;
+	uint64_t start_ns;
+};
+
+bool load_wheel_configs(const char *FILENAME, const struct lexicon *LEXICON, struct wheel_config configs[], size_t *config_ct);
+size_t parse_cpu_list(const char *STR, int cpus[], const size_t CAP);
+bool start_wheel_pool(struct wheel_pool *pool, const struct wheel_config CONFIGS[], const size_t CONFIG_CT, const int CPUS[],
+	const size_t CPU_CT, const struct wheel_pool_settings *settings);
+void stop_wheel_pool(struct wheel_pool *pool);
+void print_wheel_pool_stats(const struct wheel_pool *pool, FILE *file);
+
+#endif
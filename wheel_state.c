@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "live_state.h"
+#include "timing.h"
+
+/* cleared by SIGINT / SIGTERM to stop following */
+volatile sig_atomic_t running = 1;
+
+/**
+ * Signal handler which stops following.
+ *
+ * Parameter:
+ * signal - signal received
+ *
+ */
+void stop_running(int signal) {
+	running = 0;
+}
+
+/**
+ * Prints a snapshot: the word, its translation, and each ring's reading.
+ *
+ * Parameter:
+ * SNAPSHOT - snapshot to print
+ *
+ */
+void print_snapshot(const struct wheel_snapshot *SNAPSHOT) {
+	printf("%s\n%s\n", SNAPSHOT->word, SNAPSHOT->translation);
+	printf("Key %08x, frame %lu, %.1f ms ago\n", SNAPSHOT->key, (unsigned long) SNAPSHOT->frame_ct,
+		(get_monotonic_ns() - SNAPSHOT->frame_ns) / 1e6);
+	printf("Ring  Distance  Position  Confidence\n");
+	for (size_t ring = 0; ring < SNAPSHOT->ring_ct && ring < MAX_LIVE_RINGS; ring++) {
+		if (SNAPSHOT->distances_cm[ring] < 0) {
+			printf("%4zu  %8s  %8u  %10.2f\n", ring, "-", SNAPSHOT->positions[ring], SNAPSHOT->confidences[ring]);
+		} else {
+			printf("%4zu  %6.1fcm  %8u  %10.2f\n", ring, SNAPSHOT->distances_cm[ring], SNAPSHOT->positions[ring], SNAPSHOT->confidences[ring]);
+		}
+	}
+}
+
+/**
+ * Shows the state a driver publishes with --publish, read from shared memory without
+ * a syscall or a lock, so it can be polled as often as wanted without slowing the driver.
+ *
+ * Usage: wheel_state [NAME] [--follow]
+ *
+ * Options:
+ * NAME - shared memory the driver publishes to (default DEFAULT_LIVE_STATE_NAME)
+ * --follow - show the state again, in place, whenever a new frame is published, until interrupted
+ *
+ */
+int main(int argc, char *argv[]) {
+	const char *name = DEFAULT_LIVE_STATE_NAME;
+	bool is_following = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--follow")) {
+			is_following = true;
+		} else {
+			name = argv[i];
+		}
+	}
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	const struct live_state *state = attach_live_state(name);
+	if (state == NULL) {
+		printf("Nothing is published to %s. Is the driver running with --publish %s?\n", name, name);
+		return 1;
+	}
+	struct wheel_snapshot snapshot;
+	uint64_t shown_frame_ct = 0;
+	while (running) {
+		if (!read_snapshot(state, &snapshot)) {
+			if (!is_following) {
+				printf("Could not read a snapshot from %s.\n", name);
+				detach_live_state(state);
+				return 1;
+			}
+		} else if (snapshot.frame_ct != shown_frame_ct) {
+			if (is_following) {
+				/* clear the screen and start at the top */
+				printf("\033[H\033[J");
+			}
+			print_snapshot(&snapshot);
+			fflush(stdout);
+			shown_frame_ct = snapshot.frame_ct;
+		}
+		if (!is_following) {
+			break;
+		}
+		/* frames come every few ms at most ; no point reading faster than the screen can show */
+		usleep(10000);
+	}
+	detach_live_state(state);
+	return 0;
+}
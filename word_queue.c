@@ -0,0 +1,75 @@
+#include "word_queue.h"
+
+/**
+ * Empties a queue.
+ *
+ * Replaces:
+ * queue
+ *
+ * Parameter:
+ * queue - queue to set up
+ *
+ */
+void init_word_queue(struct word_queue *queue) {
+	atomic_init(&queue->push_ct, 0);
+	atomic_init(&queue->pop_ct, 0);
+}
+
+/**
+ * Adds a state to the back of the queue. Returns false, leaving the queue as it was, if
+ * it is full. Only the producer may call this.
+ *
+ * Replaces:
+ * queue
+ *
+ * Parameters:
+ * queue - queue to push to
+ * STATE - state to push
+ *
+ */
+bool push_word_state(struct word_queue *queue, const struct word_state *STATE) {
+	size_t push_ct = atomic_load_explicit(&queue->push_ct, memory_order_relaxed);
+	if (push_ct - atomic_load_explicit(&queue->pop_ct, memory_order_acquire) == WORD_QUEUE_LEN) {
+		return false;
+	}
+	queue->states[push_ct % WORD_QUEUE_LEN] = *STATE;
+	/* release, so the consumer sees the state before the count that covers it */
+	atomic_store_explicit(&queue->push_ct, push_ct + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Takes the state at the front of the queue. Returns false if it is empty. Only the
+ * consumer may call this.
+ *
+ * Replaces:
+ * queue, state
+ *
+ * Parameters:
+ * queue - queue to pop from
+ * state - state popped
+ *
+ */
+bool pop_word_state(struct word_queue *queue, struct word_state *state) {
+	size_t pop_ct = atomic_load_explicit(&queue->pop_ct, memory_order_relaxed);
+	if (pop_ct == atomic_load_explicit(&queue->push_ct, memory_order_acquire)) {
+		return false;
+	}
+	*state = queue->states[pop_ct % WORD_QUEUE_LEN];
+	/* release, so the producer only reuses the slot once it has been read */
+	atomic_store_explicit(&queue->pop_ct, pop_ct + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Returns the # of states in the queue. Either side may call this ; the other side may
+ * change it at any moment.
+ *
+ * Parameter:
+ * queue - queue to measure
+ *
+ */
+size_t get_word_queue_depth(struct word_queue *queue) {
+	size_t pop_ct = atomic_load_explicit(&queue->pop_ct, memory_order_acquire);
+	return atomic_load_explicit(&queue->push_ct, memory_order_acquire) - pop_ct;
+}
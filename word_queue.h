@@ -0,0 +1,38 @@
+#ifndef WORD_QUEUE_H
+#define WORD_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "que_to_eng.h"
+
+/* # of word states a queue holds ; a power of 2 */
+#define WORD_QUEUE_LEN 64
+/* bytes between the producer's and consumer's counters, so they never share a cache line */
+#define CACHE_LINE_LEN 64
+
+/* a word the sensing loop committed to, and when */
+struct word_state {
+	word_key key;
+	uint64_t commit_ns;
+};
+
+/*
+ * Bounded lock-free queue of word states between exactly one producer thread and one
+ * consumer thread. Each side only writes its own counter, so neither ever waits.
+ */
+struct word_queue {
+	/* # of states ever pushed ; written by the producer */
+	_Alignas(CACHE_LINE_LEN) atomic_size_t push_ct;
+	/* # of states ever popped ; written by the consumer */
+	_Alignas(CACHE_LINE_LEN) atomic_size_t pop_ct;
+	_Alignas(CACHE_LINE_LEN) struct word_state states[WORD_QUEUE_LEN];
+};
+
+void init_word_queue(struct word_queue *queue);
+bool push_word_state(struct word_queue *queue, const struct word_state *STATE);
+bool pop_word_state(struct word_queue *queue, struct word_state *state);
+size_t get_word_queue_depth(struct word_queue *queue);
+
+#endif